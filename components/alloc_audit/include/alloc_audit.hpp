@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <sdkconfig.h>
+
+// Allocation audit: counts the heap allocations made inside audited scopes,
+// per allocation site, so the runtime paths (the BLE stack's callbacks, the
+// input report path) can be checked to never allocate once init is done:
+//
+//   hid_service_init(...);
+//   alloc_audit::start();
+//   ...
+//   {
+//     alloc_audit::Scope scope(ble_gatts_evt_str(event));
+//     ...
+//     // the stack allocates its own messages
+//     alloc_audit::exempt(esp_ble_gatts_send_response, gatts_if, ...);
+//   }
+//   ...
+//   if (alloc_audit::count()) {
+//     alloc_audit::print();
+//   }
+//
+// A site is the innermost scope an allocation was made in (names are stored
+// as pointers, so they must be literals or names from a table) and, where
+// the allocator hook can tell (the host simulator), the address of the code
+// which called the allocator. Allocations of exempt calls, i.e. into the
+// Bluetooth stack, are counted but not against the scope. The allocator hook
+// is the heap's (CONFIG_HEAP_USE_HOOKS) on target, the host simulator
+// replaces malloc and operator new. Without CONFIG_ALLOC_AUDIT everything
+// here compiles to nothing.
+
+namespace alloc_audit {
+
+struct Site {
+  const char *scope{nullptr};
+  uintptr_t caller{0};   ///< 0 if not known
+  bool exempt{false};    ///< made by an exempt call
+  uint32_t count{0};
+  uint32_t bytes{0};
+};
+
+#if CONFIG_ALLOC_AUDIT
+
+/// Clear the counts and start counting, i.e. steady state begins
+void start();
+void stop();
+bool is_auditing();
+
+/// Called by the allocator hook for every allocation, on the allocating task
+void record(size_t size, uintptr_t caller);
+
+/// Allocations made inside scopes since start(), not counting exempt ones
+size_t count();
+size_t bytes();
+/// Allocations which did not fit in CONFIG_ALLOC_AUDIT_SITES sites, so their
+/// site is unknown
+size_t unattributed();
+
+/// The sites, in the order they first allocated
+std::vector<Site> sites();
+/// Log every site, with its counts
+void print();
+
+/// Audits the allocations of the calling task until it goes out of scope.
+/// Scopes nest, the innermost one is the site (a nullptr name stops auditing
+/// until it goes out of scope).
+class Scope {
+public:
+  explicit Scope(const char *name);
+  ~Scope();
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+protected:
+  const char *previous_;
+};
+
+/// Allocations until it goes out of scope are the callee's own (e.g. the
+/// Bluetooth stack's messages), they are counted as exempt
+class Exempt {
+public:
+  Exempt();
+  ~Exempt();
+
+  Exempt(const Exempt &) = delete;
+  Exempt &operator=(const Exempt &) = delete;
+
+protected:
+  bool previous_;
+};
+
+#else
+
+inline void start() {}
+inline void stop() {}
+inline bool is_auditing() { return false; }
+inline void record(size_t, uintptr_t) {}
+inline size_t count() { return 0; }
+inline size_t bytes() { return 0; }
+inline size_t unattributed() { return 0; }
+inline std::vector<Site> sites() { return {}; }
+inline void print() {}
+
+class Scope {
+public:
+  explicit Scope(const char *) {}
+};
+
+class Exempt {
+public:
+  Exempt() {}
+};
+
+#endif
+
+/// Call function, counting its allocations as exempt, e.g. a call into the
+/// Bluetooth stack
+template <typename Function, typename... Args> auto exempt(Function function, Args &&...args) {
+  Exempt exempt;
+  return function(std::forward<Args>(args)...);
+}
+
+} // namespace alloc_audit
@@ -0,0 +1,163 @@
+#include "alloc_audit.hpp"
+
+#if CONFIG_ALLOC_AUDIT
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+#include "logger.hpp"
+
+namespace alloc_audit {
+
+static constexpr size_t SITES = CONFIG_ALLOC_AUDIT_SITES;
+
+// Filled in by the allocator hook, which must not allocate or block: a site
+// is claimed with an atomic increment and published once its key is written.
+// Two tasks which first allocate at the same site at the same time may claim
+// a slot each, sites() merges them.
+struct Slot {
+  const char *scope;
+  uintptr_t caller;
+  bool exempt;
+  std::atomic<bool> ready;
+  std::atomic<uint32_t> count;
+  std::atomic<uint32_t> bytes;
+};
+
+static std::array<Slot, SITES> slots;
+static std::atomic<size_t> num_slots{0};
+static std::atomic<size_t> total_count{0};
+static std::atomic<size_t> total_bytes{0};
+static std::atomic<size_t> unattributed_count{0};
+// checked before anything else, since the hook is called before there are
+// tasks (and thread locals) too
+static std::atomic<bool> auditing{false};
+
+static thread_local const char *current_scope = nullptr;
+static thread_local bool current_exempt = false;
+
+static espp::Logger logger({.tag = "alloc_audit", .level = espp::Logger::Verbosity::INFO});
+
+void start() {
+  auditing = false;
+  for (auto &slot : slots) {
+    slot.ready = false;
+    slot.count = 0;
+    slot.bytes = 0;
+  }
+  num_slots = 0;
+  total_count = 0;
+  total_bytes = 0;
+  unattributed_count = 0;
+  auditing = true;
+}
+
+void stop() { auditing = false; }
+
+bool is_auditing() { return auditing.load(std::memory_order_relaxed); }
+
+void record(size_t size, uintptr_t caller) {
+  if (!auditing.load(std::memory_order_relaxed)) {
+    return;
+  }
+  const char *scope = current_scope;
+  if (!scope) {
+    return;
+  }
+  bool exempt = current_exempt;
+  if (!exempt) {
+    total_count.fetch_add(1, std::memory_order_relaxed);
+    total_bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+  size_t used = std::min(num_slots.load(std::memory_order_acquire), SITES);
+  Slot *site = nullptr;
+  for (size_t i = 0; i < used && !site; i++) {
+    auto &slot = slots[i];
+    if (slot.ready.load(std::memory_order_acquire) && slot.scope == scope && slot.caller == caller &&
+        slot.exempt == exempt) {
+      site = &slot;
+    }
+  }
+  if (!site) {
+    size_t index = num_slots.fetch_add(1, std::memory_order_acq_rel);
+    if (index >= SITES) {
+      unattributed_count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    site = &slots[index];
+    site->scope = scope;
+    site->caller = caller;
+    site->exempt = exempt;
+    site->ready.store(true, std::memory_order_release);
+  }
+  site->count.fetch_add(1, std::memory_order_relaxed);
+  site->bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+size_t count() { return total_count.load(std::memory_order_relaxed); }
+
+size_t bytes() { return total_bytes.load(std::memory_order_relaxed); }
+
+size_t unattributed() { return unattributed_count.load(std::memory_order_relaxed); }
+
+std::vector<Site> sites() {
+  // allocating here would count itself if it were called inside a scope
+  Scope outside(nullptr);
+  std::vector<Site> result;
+  size_t used = std::min(num_slots.load(std::memory_order_acquire), SITES);
+  for (size_t i = 0; i < used; i++) {
+    const auto &slot = slots[i];
+    if (!slot.ready.load(std::memory_order_acquire)) {
+      continue;
+    }
+    auto same = std::find_if(result.begin(), result.end(), [&](const Site &site) {
+      return site.scope == slot.scope && site.caller == slot.caller && site.exempt == slot.exempt;
+    });
+    if (same == result.end()) {
+      same = result.insert(result.end(), {slot.scope, slot.caller, slot.exempt, 0, 0});
+    }
+    same->count += slot.count.load(std::memory_order_relaxed);
+    same->bytes += slot.bytes.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+void print() {
+  Scope outside(nullptr);
+  logger.info("{} allocations ({} bytes) in audited scopes{}", count(), bytes(), is_auditing() ? "" : " (stopped)");
+  for (const auto &site : sites()) {
+    logger.info("  {}{}{}: {} allocations, {} bytes", site.scope,
+                site.caller ? fmt::format(" from {:#x}", site.caller) : std::string(),
+                site.exempt ? " (exempt)" : "", site.count, site.bytes);
+  }
+  if (unattributed()) {
+    logger.warn("  {} allocations at further sites (CONFIG_ALLOC_AUDIT_SITES)", unattributed());
+  }
+}
+
+Scope::Scope(const char *name) : previous_(current_scope) { current_scope = name; }
+
+Scope::~Scope() { current_scope = previous_; }
+
+Exempt::Exempt() : previous_(current_exempt) { current_exempt = true; }
+
+Exempt::~Exempt() { current_exempt = previous_; }
+
+} // namespace alloc_audit
+
+#if CONFIG_HEAP_USE_HOOKS
+#include <esp_heap_caps.h>
+
+// The heap's hooks (CONFIG_HEAP_USE_HOOKS). The hook is called from within
+// the allocator, so the caller's address is not known.
+extern "C" void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t) {
+  if (ptr) {
+    alloc_audit::record(size, 0);
+  }
+}
+
+extern "C" void esp_heap_trace_free_hook(void *) {}
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+#include <esp_err.h>
+#include <sdkconfig.h>
+
+// Battery monitor: turns raw voltage samples from a pluggable source (an
+// ADC, or a stand-in in the host simulator) into a battery level which is
+// only published when it really changed:
+//
+//   battery::Monitor monitor({
+//       .source = battery::adc_source(ADC_CHANNEL_7, 200),
+//       .publish = [](uint8_t percent) { hid_service_set_battery_level(percent); },
+//   });
+//   ...
+//   monitor.update(); // e.g. once a second
+//
+// The samples are averaged (CONFIG_BATTERY_FILTER_SHIFT) and mapped to a
+// percentage by a discharge curve. A level is published when it is at least
+// CONFIG_BATTERY_HYSTERESIS_PERCENT away from the last published one, at most
+// every CONFIG_BATTERY_MIN_PUBLISH_INTERVAL_SECONDS, except that the first
+// level and a drop to CONFIG_BATTERY_CRITICAL_PERCENT are published at once.
+
+namespace battery {
+
+/// A point of a discharge curve, which is given in increasing voltage and
+/// interpolated linearly in between
+struct CurvePoint {
+  uint16_t millivolts;
+  uint8_t percent;
+};
+
+/// A single LiPo / Li-ion cell, resting
+inline constexpr CurvePoint LIPO_CURVE[] = {
+    {3300, 0}, {3500, 5}, {3600, 10}, {3700, 30}, {3750, 50},
+    {3800, 60}, {3900, 75}, {4000, 85}, {4100, 95}, {4200, 100},
+};
+
+/// Take a sample of the battery voltage, false if it failed
+using Source = std::function<bool(uint32_t &millivolts)>;
+/// Publish a new battery level, in percent
+using Publish = std::function<void(uint8_t percent)>;
+
+/// The battery level of a voltage on the curve
+uint8_t percent(std::span<const CurvePoint> curve, uint32_t millivolts);
+
+class Monitor {
+public:
+  struct Config {
+    Source source{nullptr};
+    Publish publish{nullptr};
+    std::span<const CurvePoint> curve{LIPO_CURVE};
+    uint8_t filter_shift{CONFIG_BATTERY_FILTER_SHIFT};
+    uint8_t hysteresis_percent{CONFIG_BATTERY_HYSTERESIS_PERCENT};
+    uint8_t critical_percent{CONFIG_BATTERY_CRITICAL_PERCENT};
+    uint32_t min_interval_ms{CONFIG_BATTERY_MIN_PUBLISH_INTERVAL_SECONDS * 1000};
+  };
+
+  struct Stats {
+    uint32_t samples{0};
+    uint32_t failed_samples{0};
+    uint32_t published{0};
+    uint32_t within_hysteresis{0}; ///< samples whose level was too close to the published one
+    uint32_t rate_limited{0};      ///< samples whose level had to wait for the minimum interval
+  };
+
+  explicit Monitor(const Config &config);
+
+  /// Take a sample and publish the level if it changed enough and the last
+  /// one was published long enough ago. Call it from one task only.
+  /// @return True if a level was published
+  bool update(int64_t now_us);
+  bool update();
+
+  /// The filtered voltage, 0 before the first sample
+  uint32_t millivolts() const;
+  /// The level of the filtered voltage, -1 before the first sample
+  int level() const;
+  /// The last published level, -1 if none was yet
+  int published() const { return published_; }
+  const Stats &stats() const { return stats_; }
+
+protected:
+  Config config_;
+  uint32_t filtered_{0}; ///< millivolts << filter_shift
+  bool sampled_{false};
+  int published_{-1};
+  int64_t published_us_{0};
+  Stats stats_;
+};
+
+/// A source which samples an ADC1 channel (calibrated where the chip
+/// supports it) behind a divider: the battery voltage is divider_x100 / 100
+/// times the channel's
+Source adc_source(int channel, uint32_t divider_x100);
+
+} // namespace battery
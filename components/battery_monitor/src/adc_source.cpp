@@ -0,0 +1,77 @@
+#include "battery_monitor.hpp"
+
+#include <esp_adc/adc_cali.h>
+#include <esp_adc/adc_cali_scheme.h>
+#include <esp_adc/adc_oneshot.h>
+
+#include "logger.hpp"
+
+namespace battery {
+
+static espp::Logger logger({.tag = "battery", .level = espp::Logger::Verbosity::INFO});
+
+static constexpr adc_atten_t ATTENUATION = ADC_ATTEN_DB_12;
+// full scale of an uncalibrated reading at that attenuation, roughly
+static constexpr int UNCALIBRATED_FULL_SCALE_MV = 3100;
+
+Source adc_source(int channel, uint32_t divider_x100) {
+  // the unit is shared by every source (there is one battery)
+  static adc_oneshot_unit_handle_t unit = nullptr;
+  esp_err_t err = ESP_OK;
+  if (!unit) {
+    adc_oneshot_unit_init_cfg_t unit_config = {};
+    unit_config.unit_id = ADC_UNIT_1;
+    err = adc_oneshot_new_unit(&unit_config, &unit);
+  }
+  adc_oneshot_chan_cfg_t channel_config = {
+      .atten = ATTENUATION,
+      .bitwidth = ADC_BITWIDTH_DEFAULT,
+  };
+  if (err == ESP_OK) {
+    err = adc_oneshot_config_channel(unit, adc_channel_t(channel), &channel_config);
+  }
+  if (err != ESP_OK) {
+    logger.error("Could not set up ADC1 channel {}: {}", channel, esp_err_to_name(err));
+    return nullptr;
+  }
+
+  adc_cali_handle_t calibration = nullptr;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+  adc_cali_curve_fitting_config_t calibration_config = {
+      .unit_id = ADC_UNIT_1,
+      .chan = adc_channel_t(channel),
+      .atten = ATTENUATION,
+      .bitwidth = ADC_BITWIDTH_DEFAULT,
+  };
+  err = adc_cali_create_scheme_curve_fitting(&calibration_config, &calibration);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+  adc_cali_line_fitting_config_t calibration_config = {
+      .unit_id = ADC_UNIT_1,
+      .atten = ATTENUATION,
+      .bitwidth = ADC_BITWIDTH_DEFAULT,
+  };
+  err = adc_cali_create_scheme_line_fitting(&calibration_config, &calibration);
+#else
+  err = ESP_ERR_NOT_SUPPORTED;
+#endif
+  if (err != ESP_OK) {
+    logger.warn("ADC1 channel {} is not calibrated ({}), the battery level is approximate", channel,
+                esp_err_to_name(err));
+    calibration = nullptr;
+  }
+
+  return [channel, divider_x100, calibration](uint32_t &millivolts) {
+    int raw = 0;
+    if (adc_oneshot_read(unit, adc_channel_t(channel), &raw) != ESP_OK) {
+      return false;
+    }
+    int mv = 0;
+    if (!calibration || adc_cali_raw_to_voltage(calibration, raw, &mv) != ESP_OK) {
+      mv = raw * UNCALIBRATED_FULL_SCALE_MV / 4095;
+    }
+    millivolts = uint32_t(mv) * divider_x100 / 100;
+    return true;
+  };
+}
+
+} // namespace battery
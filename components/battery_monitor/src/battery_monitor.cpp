@@ -0,0 +1,68 @@
+#include "battery_monitor.hpp"
+
+#include <esp_timer.h>
+
+namespace battery {
+
+uint8_t percent(std::span<const CurvePoint> curve, uint32_t millivolts) {
+  if (curve.empty()) {
+    return 0;
+  }
+  if (millivolts <= curve.front().millivolts) {
+    return curve.front().percent;
+  }
+  for (size_t i = 1; i < curve.size(); i++) {
+    const auto &low = curve[i - 1];
+    const auto &high = curve[i];
+    if (millivolts < high.millivolts) {
+      return low.percent + (millivolts - low.millivolts) * (high.percent - low.percent) /
+                               (high.millivolts - low.millivolts);
+    }
+  }
+  return curve.back().percent;
+}
+
+Monitor::Monitor(const Config &config) : config_(config) {}
+
+bool Monitor::update() { return update(esp_timer_get_time()); }
+
+bool Monitor::update(int64_t now_us) {
+  uint32_t sample = 0;
+  if (!config_.source || !config_.source(sample)) {
+    stats_.failed_samples++;
+    return false;
+  }
+  stats_.samples++;
+  if (!sampled_) {
+    filtered_ = sample << config_.filter_shift;
+    sampled_ = true;
+  } else {
+    filtered_ = filtered_ + sample - (filtered_ >> config_.filter_shift);
+  }
+  int current = level();
+  if (published_ >= 0) {
+    int change = current > published_ ? current - published_ : published_ - current;
+    if (change == 0 || change < config_.hysteresis_percent) {
+      stats_.within_hysteresis++;
+      return false;
+    }
+    bool critical = current <= config_.critical_percent && current < published_;
+    if (!critical && now_us - published_us_ < int64_t(config_.min_interval_ms) * 1000) {
+      stats_.rate_limited++;
+      return false;
+    }
+  }
+  published_ = current;
+  published_us_ = now_us;
+  stats_.published++;
+  if (config_.publish) {
+    config_.publish(current);
+  }
+  return true;
+}
+
+uint32_t Monitor::millivolts() const { return filtered_ >> config_.filter_shift; }
+
+int Monitor::level() const { return sampled_ ? percent(config_.curve, millivolts()) : -1; }
+
+} // namespace battery
@@ -8,19 +8,37 @@
 #include <esp_bt_main.h>
 #include <esp_gatt_common_api.h>
 
+#include "gatt_service_builder.hpp"
+
+extern uint8_t battery_level;
+
+/// Characteristic Presentation Format of the battery level, as sent: an
+/// unsigned 8 bit integer (0x04), exponent 0, unit percentage (0x27AD),
+/// Bluetooth SIG namespace (0x01), description unknown (0x0000)
+inline constexpr uint8_t battery_level_presentation_format[7] = {0x04, 0x00, 0xAD, 0x27, 0x01, 0x00, 0x00};
+
+/// Battery Service Attribute Table
+inline constexpr auto bas_att_db = gatt::service<ESP_GATT_UUID_BATTERY_SERVICE_SVC>(
+  // Battery Level characteristic, UUID: 0x2A19, Properties: read, notify
+  gatt::characteristic<ESP_GATT_UUID_BATTERY_LEVEL, gatt::PROP_READ | gatt::PROP_NOTIFY>(
+    ESP_GATT_PERM_READ, gatt::value(battery_level),
+    gatt::cccd(ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE),
+    gatt::descriptor<ESP_GATT_UUID_CHAR_PRESENT_FORMAT>(
+      ESP_GATT_PERM_READ, gatt::value(battery_level_presentation_format))));
+
 /// Battery Service Attributes Indexes
 enum
 {
-    BAS_IDX_SVC,
+    BAS_IDX_SVC = 0,
 
-    BAS_IDX_BATT_LVL_CHAR,
-    BAS_IDX_BATT_LVL_VAL,
-    BAS_IDX_BATT_LVL_NTF_CFG,
-    BAS_IDX_BATT_LVL_PRES_FMT,
+    BAS_IDX_BATT_LVL_CHAR = bas_att_db.declaration_index(ESP_GATT_UUID_BATTERY_LEVEL),
+    BAS_IDX_BATT_LVL_VAL = bas_att_db.value_index(ESP_GATT_UUID_BATTERY_LEVEL),
+    BAS_IDX_BATT_LVL_NTF_CFG = bas_att_db.descriptor_index(ESP_GATT_UUID_BATTERY_LEVEL,
+                                                           ESP_GATT_UUID_CHAR_CLIENT_CONFIG),
+    BAS_IDX_BATT_LVL_PRES_FMT = bas_att_db.descriptor_index(ESP_GATT_UUID_BATTERY_LEVEL,
+                                                            ESP_GATT_UUID_CHAR_PRESENT_FORMAT),
 
-    BAS_IDX_NB,
+    BAS_IDX_NB = bas_att_db.size(),
 };
 
-extern uint8_t battery_level;
-extern const esp_gatts_attr_db_t bas_att_db[BAS_IDX_NB];
-extern uint16_t bas_handle_table[BAS_IDX_NB];
+extern gatt::HandleTable<bas_att_db> bas_handle_table;
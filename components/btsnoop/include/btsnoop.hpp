@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string_view>
+
+#include <sdkconfig.h>
+
+#include <esp_err.h>
+
+#include "btsnoop_format.hpp"
+
+// Capture of the ATT traffic (and the connection events around it) of the
+// GATT server, in btsnoop format for Wireshark. The caller describes each
+// PDU - the stack does not expose the raw packets - and the capture frames it
+// as an H4 ACL packet on the ATT channel. Records go into a RAM ring of
+// CONFIG_BTSNOOP_RECORDS (the oldest is overwritten), each keeping the first
+// CONFIG_BTSNOOP_SNAPLEN bytes of its PDU, and can be exported as a btsnoop
+// file or saved to a data partition, from which tools/btsnoop_extract.cpp
+// gets the file back:
+//
+//   btsnoop::start();
+//   btsnoop::att(conn_id, btsnoop::Direction::SENT, btsnoop::format::ATT_HANDLE_VALUE_NTF,
+//                btsnoop::le16(handle), {data, length});
+//   btsnoop::save("btsnoop");
+//
+// Without CONFIG_BTSNOOP_CAPTURE everything here compiles to nothing.
+
+namespace btsnoop {
+
+enum class Direction : uint8_t {
+  SENT = 0,     ///< by us (the peripheral)
+  RECEIVED = 1, ///< from the central
+};
+
+/// Receives the exported file, a chunk at a time
+typedef std::function<void(std::span<const uint8_t> chunk)> writer_fn;
+
+/// Little endian bytes of ATT parameters, e.g. le16(handle, offset)
+template <typename... Values> constexpr std::array<uint8_t, 2 * sizeof...(Values)> le16(Values... values) {
+  std::array<uint8_t, 2 * sizeof...(Values)> bytes{};
+  size_t i = 0;
+  ((bytes[i++] = uint16_t(values) & 0xff, bytes[i++] = uint16_t(values) >> 8), ...);
+  return bytes;
+}
+
+#if CONFIG_BTSNOOP_CAPTURE
+
+/// Clear the ring and start capturing
+void start();
+void stop();
+bool is_capturing();
+
+/// An ATT PDU: its opcode, fixed parameters and value
+void att(uint16_t conn_id, Direction direction, uint8_t opcode, std::span<const uint8_t> params,
+         std::span<const uint8_t> value = {});
+/// An HCI event (e.g. a connection completing), received from the controller
+void hci_event(uint8_t code, std::span<const uint8_t> params);
+
+/// Records in the ring, and the number overwritten since start()
+size_t size();
+size_t overwritten();
+
+/// Write the records, oldest first, as a btsnoop file
+/// @return The number of records written
+size_t export_file(const writer_fn &write);
+
+/// Erase the start of the data partition and save the capture there. Capturing
+/// is paused meanwhile, since writing to flash is slow.
+esp_err_t save(std::string_view partition_label);
+
+#else
+
+inline void start() {}
+inline void stop() {}
+inline bool is_capturing() { return false; }
+inline void att(uint16_t, Direction, uint8_t, std::span<const uint8_t>, std::span<const uint8_t> = {}) {}
+inline void hci_event(uint8_t, std::span<const uint8_t>) {}
+inline size_t size() { return 0; }
+inline size_t overwritten() { return 0; }
+inline size_t export_file(const writer_fn &) { return 0; }
+inline esp_err_t save(std::string_view) { return ESP_ERR_NOT_SUPPORTED; }
+
+#endif
+
+} // namespace btsnoop
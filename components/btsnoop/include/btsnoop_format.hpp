@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// The btsnoop file format (RFC 1761 style, as written by Android / BlueZ and
+// read by Wireshark), with H4 framed HCI packets as its datalink.
+//
+// The format is shared by the firmware and the host-side extractor
+// (tools/btsnoop_extract.cpp), so this header only depends on the C++
+// standard library.
+//
+// Layout (all integers big endian):
+//
+//   file header: "btsnoop\0", version (1), datalink (1002 = HCI UART / H4)
+//   records:     original length, included length, flags, cumulative drops,
+//                timestamp (microseconds since 0 AD), then the packet
+//
+// In a partition the records are followed by erased flash, i.e. a record
+// header whose original length is 0xFFFFFFFF ends the capture.
+
+namespace btsnoop::format {
+
+static constexpr char MAGIC[8] = {'b', 't', 's', 'n', 'o', 'o', 'p', '\0'};
+static constexpr uint32_t VERSION = 1;
+static constexpr uint32_t DATALINK_H4 = 1002;
+
+static constexpr size_t FILE_HEADER_SIZE = 16;
+static constexpr size_t RECORD_HEADER_SIZE = 24;
+
+static constexpr uint32_t FLAG_RECEIVED = 0x1;      ///< else sent
+static constexpr uint32_t FLAG_COMMAND_EVENT = 0x2; ///< else data (ACL)
+
+/// Microseconds from 0 AD to 1970-01-01, the timestamps' epoch
+static constexpr int64_t EPOCH_OFFSET_US = 0x00dcddb30f2f8000LL;
+/// Original length of the erased flash after the last record
+static constexpr uint32_t END_OF_CAPTURE = 0xFFFFFFFF;
+
+// H4 packet types
+static constexpr uint8_t H4_ACL = 0x02;
+static constexpr uint8_t H4_EVENT = 0x04;
+
+/// H4 type, ACL header (handle + flags, length), L2CAP header (length, CID)
+static constexpr size_t ACL_FRAMING_SIZE = 1 + 4 + 4;
+/// H4 type, event code, parameter length
+static constexpr size_t EVENT_FRAMING_SIZE = 1 + 2;
+/// First (automatically flushable) fragment of an L2CAP PDU
+static constexpr uint16_t ACL_PB_FIRST_FLUSHABLE = 0x2000;
+static constexpr uint16_t L2CAP_CID_ATT = 0x0004;
+
+// HCI events
+static constexpr uint8_t HCI_DISCONNECTION_COMPLETE = 0x05;
+static constexpr uint8_t HCI_LE_META = 0x3E;
+static constexpr uint8_t HCI_LE_CONNECTION_COMPLETE = 0x01;
+static constexpr uint8_t HCI_LE_CONNECTION_UPDATE_COMPLETE = 0x03;
+
+// ATT opcodes (Core spec Vol 3 Part F 3.4.8)
+enum AttOpcode : uint8_t {
+  ATT_ERROR_RSP = 0x01,
+  ATT_EXCHANGE_MTU_REQ = 0x02,
+  ATT_EXCHANGE_MTU_RSP = 0x03,
+  ATT_FIND_INFORMATION_REQ = 0x04,
+  ATT_FIND_INFORMATION_RSP = 0x05,
+  ATT_FIND_BY_TYPE_VALUE_REQ = 0x06,
+  ATT_FIND_BY_TYPE_VALUE_RSP = 0x07,
+  ATT_READ_BY_TYPE_REQ = 0x08,
+  ATT_READ_BY_TYPE_RSP = 0x09,
+  ATT_READ_REQ = 0x0A,
+  ATT_READ_RSP = 0x0B,
+  ATT_READ_BLOB_REQ = 0x0C,
+  ATT_READ_BLOB_RSP = 0x0D,
+  ATT_READ_BY_GROUP_TYPE_REQ = 0x10,
+  ATT_READ_BY_GROUP_TYPE_RSP = 0x11,
+  ATT_WRITE_REQ = 0x12,
+  ATT_WRITE_RSP = 0x13,
+  ATT_PREPARE_WRITE_REQ = 0x16,
+  ATT_PREPARE_WRITE_RSP = 0x17,
+  ATT_EXECUTE_WRITE_REQ = 0x18,
+  ATT_EXECUTE_WRITE_RSP = 0x19,
+  ATT_HANDLE_VALUE_NTF = 0x1B,
+  ATT_HANDLE_VALUE_IND = 0x1D,
+  ATT_HANDLE_VALUE_CFM = 0x1E,
+  ATT_WRITE_CMD = 0x52,
+};
+
+constexpr std::string_view att_opcode_name(uint8_t opcode) {
+  switch (opcode) {
+  case ATT_ERROR_RSP: return "Error Response";
+  case ATT_EXCHANGE_MTU_REQ: return "Exchange MTU Request";
+  case ATT_EXCHANGE_MTU_RSP: return "Exchange MTU Response";
+  case ATT_FIND_INFORMATION_REQ: return "Find Information Request";
+  case ATT_FIND_INFORMATION_RSP: return "Find Information Response";
+  case ATT_FIND_BY_TYPE_VALUE_REQ: return "Find By Type Value Request";
+  case ATT_FIND_BY_TYPE_VALUE_RSP: return "Find By Type Value Response";
+  case ATT_READ_BY_TYPE_REQ: return "Read By Type Request";
+  case ATT_READ_BY_TYPE_RSP: return "Read By Type Response";
+  case ATT_READ_REQ: return "Read Request";
+  case ATT_READ_RSP: return "Read Response";
+  case ATT_READ_BLOB_REQ: return "Read Blob Request";
+  case ATT_READ_BLOB_RSP: return "Read Blob Response";
+  case ATT_READ_BY_GROUP_TYPE_REQ: return "Read By Group Type Request";
+  case ATT_READ_BY_GROUP_TYPE_RSP: return "Read By Group Type Response";
+  case ATT_WRITE_REQ: return "Write Request";
+  case ATT_WRITE_RSP: return "Write Response";
+  case ATT_PREPARE_WRITE_REQ: return "Prepare Write Request";
+  case ATT_PREPARE_WRITE_RSP: return "Prepare Write Response";
+  case ATT_EXECUTE_WRITE_REQ: return "Execute Write Request";
+  case ATT_EXECUTE_WRITE_RSP: return "Execute Write Response";
+  case ATT_HANDLE_VALUE_NTF: return "Handle Value Notification";
+  case ATT_HANDLE_VALUE_IND: return "Handle Value Indication";
+  case ATT_HANDLE_VALUE_CFM: return "Handle Value Confirmation";
+  case ATT_WRITE_CMD: return "Write Command";
+  default: return "Unknown";
+  }
+}
+
+/// The response opcode of a request, 0 if the opcode is not a request
+constexpr uint8_t att_response_opcode(uint8_t opcode) {
+  switch (opcode) {
+  case ATT_EXCHANGE_MTU_REQ:
+  case ATT_FIND_INFORMATION_REQ:
+  case ATT_FIND_BY_TYPE_VALUE_REQ:
+  case ATT_READ_BY_TYPE_REQ:
+  case ATT_READ_REQ:
+  case ATT_READ_BLOB_REQ:
+  case ATT_READ_BY_GROUP_TYPE_REQ:
+  case ATT_WRITE_REQ:
+  case ATT_PREPARE_WRITE_REQ:
+  case ATT_EXECUTE_WRITE_REQ:
+    return opcode + 1;
+  case ATT_HANDLE_VALUE_IND:
+    return ATT_HANDLE_VALUE_CFM;
+  default:
+    return 0;
+  }
+}
+
+struct RecordHeader {
+  uint32_t original_length;
+  uint32_t included_length;
+  uint32_t flags;
+  uint32_t cumulative_drops;
+  int64_t timestamp_us; ///< since 0 AD
+};
+
+inline void put_be32(uint8_t *out, uint32_t value) {
+  out[0] = value >> 24;
+  out[1] = value >> 16;
+  out[2] = value >> 8;
+  out[3] = value;
+}
+
+inline uint32_t get_be32(const uint8_t *in) {
+  return (uint32_t(in[0]) << 24) | (uint32_t(in[1]) << 16) | (uint32_t(in[2]) << 8) | in[3];
+}
+
+inline void encode_file_header(uint8_t *out) {
+  for (size_t i = 0; i < sizeof(MAGIC); i++) {
+    out[i] = MAGIC[i];
+  }
+  put_be32(out + 8, VERSION);
+  put_be32(out + 12, DATALINK_H4);
+}
+
+/// @return false unless it is a btsnoop header of H4 packets
+inline bool decode_file_header(const uint8_t *in) {
+  for (size_t i = 0; i < sizeof(MAGIC); i++) {
+    if (in[i] != uint8_t(MAGIC[i])) {
+      return false;
+    }
+  }
+  return get_be32(in + 8) == VERSION && get_be32(in + 12) == DATALINK_H4;
+}
+
+inline void encode_record_header(uint8_t *out, const RecordHeader &header) {
+  put_be32(out, header.original_length);
+  put_be32(out + 4, header.included_length);
+  put_be32(out + 8, header.flags);
+  put_be32(out + 12, header.cumulative_drops);
+  put_be32(out + 16, uint64_t(header.timestamp_us) >> 32);
+  put_be32(out + 20, uint32_t(header.timestamp_us));
+}
+
+inline RecordHeader decode_record_header(const uint8_t *in) {
+  return {get_be32(in), get_be32(in + 4), get_be32(in + 8), get_be32(in + 12),
+          int64_t((uint64_t(get_be32(in + 16)) << 32) | get_be32(in + 20))};
+}
+
+} // namespace btsnoop::format
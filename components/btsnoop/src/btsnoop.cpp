@@ -0,0 +1,185 @@
+#include "btsnoop.hpp"
+
+#if CONFIG_BTSNOOP_CAPTURE
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include <esp_partition.h>
+#include <esp_timer.h>
+
+#include "logger.hpp"
+
+namespace btsnoop {
+
+using namespace format;
+
+static constexpr size_t RECORDS = CONFIG_BTSNOOP_RECORDS;
+static constexpr size_t SNAPLEN = CONFIG_BTSNOOP_SNAPLEN;
+static_assert(SNAPLEN <= UINT8_MAX, "the snap length must fit in a byte");
+
+struct Slot {
+  int64_t time_us;
+  uint16_t conn_id;
+  uint16_t length;   ///< of the PDU / event (code and parameters)
+  uint8_t included;  ///< bytes of it kept in data
+  uint8_t h4_type;
+  Direction direction;
+  uint8_t data[SNAPLEN];
+};
+
+static std::array<Slot, RECORDS> slots;
+// records captured since start(), the next one goes to slots[next % RECORDS]
+static size_t next = 0;
+static std::atomic<bool> capturing{false};
+static std::mutex slots_mutex;
+
+static espp::Logger logger({.tag = "btsnoop", .level = espp::Logger::Verbosity::INFO});
+
+void start() {
+  std::lock_guard<std::mutex> lock(slots_mutex);
+  next = 0;
+  capturing = true;
+}
+
+void stop() { capturing = false; }
+
+bool is_capturing() { return capturing.load(std::memory_order_relaxed); }
+
+static void record(uint8_t h4_type, uint16_t conn_id, Direction direction,
+                   std::initializer_list<std::span<const uint8_t>> parts) {
+  if (!is_capturing()) {
+    return;
+  }
+  int64_t now = esp_timer_get_time();
+  std::lock_guard<std::mutex> lock(slots_mutex);
+  auto &slot = slots[next++ % RECORDS];
+  slot.time_us = now;
+  slot.conn_id = conn_id;
+  slot.h4_type = h4_type;
+  slot.direction = direction;
+  slot.length = 0;
+  slot.included = 0;
+  for (auto part : parts) {
+    size_t n = std::min(part.size(), SNAPLEN - slot.included);
+    std::copy_n(part.begin(), n, slot.data + slot.included);
+    slot.included += n;
+    slot.length += part.size();
+  }
+}
+
+void att(uint16_t conn_id, Direction direction, uint8_t opcode, std::span<const uint8_t> params,
+         std::span<const uint8_t> value) {
+  record(H4_ACL, conn_id, direction, {std::span<const uint8_t>(&opcode, 1), params, value});
+}
+
+void hci_event(uint8_t code, std::span<const uint8_t> params) {
+  record(H4_EVENT, 0, Direction::RECEIVED, {std::span<const uint8_t>(&code, 1), params});
+}
+
+size_t size() {
+  std::lock_guard<std::mutex> lock(slots_mutex);
+  return std::min(next, RECORDS);
+}
+
+size_t overwritten() {
+  std::lock_guard<std::mutex> lock(slots_mutex);
+  return next > RECORDS ? next - RECORDS : 0;
+}
+
+// The record header and H4 framing of a slot, followed by its data
+static size_t frame(const Slot &slot, uint8_t *out) {
+  uint8_t *framing = out + RECORD_HEADER_SIZE;
+  size_t framing_size;
+  size_t original;
+  if (slot.h4_type == H4_ACL) {
+    uint16_t handle = slot.conn_id | ACL_PB_FIRST_FLUSHABLE;
+    uint16_t acl_length = 4 + slot.length;
+    framing[0] = H4_ACL;
+    framing[1] = handle;
+    framing[2] = handle >> 8;
+    framing[3] = acl_length;
+    framing[4] = acl_length >> 8;
+    framing[5] = slot.length;
+    framing[6] = slot.length >> 8;
+    framing[7] = L2CAP_CID_ATT;
+    framing[8] = L2CAP_CID_ATT >> 8;
+    framing_size = ACL_FRAMING_SIZE;
+    original = framing_size + slot.length;
+    std::copy_n(slot.data, slot.included, framing + framing_size);
+  } else {
+    // the event code is the first byte of the data, then the parameter length
+    framing[0] = H4_EVENT;
+    framing[1] = slot.data[0];
+    framing[2] = slot.length - 1;
+    framing_size = EVENT_FRAMING_SIZE;
+    original = framing_size + slot.length - 1;
+    std::copy_n(slot.data + 1, slot.included - 1, framing + framing_size);
+  }
+  size_t included = original - (slot.length - slot.included);
+  uint32_t flags = (slot.direction == Direction::RECEIVED ? FLAG_RECEIVED : 0) |
+                   (slot.h4_type == H4_EVENT ? FLAG_COMMAND_EVENT : 0);
+  encode_record_header(out, {.original_length = uint32_t(original),
+                             .included_length = uint32_t(included),
+                             .flags = flags,
+                             .cumulative_drops = 0,
+                             .timestamp_us = EPOCH_OFFSET_US + slot.time_us});
+  return RECORD_HEADER_SIZE + included;
+}
+
+size_t export_file(const writer_fn &write) {
+  std::lock_guard<std::mutex> lock(slots_mutex);
+  uint8_t buffer[RECORD_HEADER_SIZE + ACL_FRAMING_SIZE + SNAPLEN];
+  encode_file_header(buffer);
+  write({buffer, FILE_HEADER_SIZE});
+  size_t count = std::min(next, RECORDS);
+  for (size_t i = next - count; i < next; i++) {
+    write({buffer, frame(slots[i % RECORDS], buffer)});
+  }
+  return count;
+}
+
+esp_err_t save(std::string_view partition_label) {
+  const esp_partition_t *partition =
+      esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, std::string(partition_label).c_str());
+  if (!partition) {
+    logger.error("No '{}' partition to save the capture to", partition_label);
+    return ESP_ERR_NOT_FOUND;
+  }
+  bool was_capturing = capturing.exchange(false);
+  // the file's size, so only what it needs (and the end marker after it) is erased
+  size_t file_size = 0;
+  export_file([&](std::span<const uint8_t> chunk) { file_size += chunk.size(); });
+  size_t erase_size = std::min<size_t>(partition->size, (file_size + 4 + partition->erase_size - 1) /
+                                                            partition->erase_size * partition->erase_size);
+  esp_err_t err = esp_partition_erase_range(partition, 0, erase_size);
+  size_t offset = 0;
+  size_t records = 0;
+  bool full = false;
+  if (err == ESP_OK) {
+    records = export_file([&](std::span<const uint8_t> chunk) {
+      // the newest records are left out if the partition is too small
+      full = full || offset + chunk.size() > partition->size;
+      if (err == ESP_OK && !full) {
+        err = esp_partition_write(partition, offset, chunk.data(), chunk.size());
+        offset += chunk.size();
+      }
+    });
+  }
+  capturing = was_capturing;
+  if (err != ESP_OK) {
+    logger.error("Saving the capture to '{}' failed: {:#x}", partition_label, err);
+    return err;
+  }
+  if (full) {
+    logger.warn("The capture is larger than '{}', only its first {} bytes were saved", partition_label, offset);
+  }
+  logger.info("Saved {} records ({} bytes) to '{}'", records, offset, partition_label);
+  return ESP_OK;
+}
+
+} // namespace btsnoop
+
+#endif
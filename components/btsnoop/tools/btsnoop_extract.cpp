@@ -0,0 +1,249 @@
+// Host-side extractor / summarizer of btsnoop captures.
+//
+// Build (from the repository root):
+//   g++ -std=c++20 -I components/btsnoop/include
+//       components/btsnoop/tools/btsnoop_extract.cpp -o btsnoop_extract
+//
+// Usage:
+//   btsnoop_extract [-o capture.btsnoop] [--summary] capture
+//
+// The input is either a dump of the capture partition, e.g.
+//
+//   parttool.py read_partition --partition-name btsnoop --output btsnoop.bin
+//
+// which ends where the erased flash starts, or a btsnoop file (written by
+// the host simulator, or a host's own log such as Android's
+// btsnoop_hci.log, which also has the discovery the device's capture
+// can't see). -o writes the valid records as a btsnoop file for Wireshark.
+// --summary prints, per connection, the ATT PDUs by opcode, how long each
+// request waited for its response, how long the client took to send its
+// next request, and the cadence of the notifications of each handle.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "btsnoop_format.hpp"
+
+using namespace btsnoop::format;
+
+struct Packet {
+  RecordHeader header;
+  const uint8_t *data; ///< H4 framed, included_length bytes
+};
+
+[[noreturn]] static void fail(const std::string &message) {
+  std::cerr << "error: " << message << "\n";
+  std::exit(1);
+}
+
+static std::vector<uint8_t> read_file(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    fail("could not open '" + path + "'");
+  }
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/// The records up to the end of the capture (erased flash, the end of the
+/// file or a record which does not fit)
+static std::vector<Packet> parse(const std::vector<uint8_t> &bytes, size_t &end) {
+  if (bytes.size() < FILE_HEADER_SIZE || !decode_file_header(bytes.data())) {
+    fail("not a btsnoop capture of H4 packets");
+  }
+  std::vector<Packet> packets;
+  size_t offset = FILE_HEADER_SIZE;
+  while (offset + RECORD_HEADER_SIZE <= bytes.size()) {
+    auto header = decode_record_header(bytes.data() + offset);
+    if (header.original_length == END_OF_CAPTURE) {
+      break;
+    }
+    if (header.included_length > header.original_length ||
+        offset + RECORD_HEADER_SIZE + header.included_length > bytes.size()) {
+      std::cerr << "warning: record " << packets.size() << " at offset " << offset
+                << " is corrupt, the capture ends before it\n";
+      break;
+    }
+    packets.push_back({header, bytes.data() + offset + RECORD_HEADER_SIZE});
+    offset += RECORD_HEADER_SIZE + header.included_length;
+  }
+  end = offset;
+  return packets;
+}
+
+struct Stats {
+  size_t count{0};
+  double sum_us{0};
+  int64_t max_us{0};
+  std::vector<int64_t> values_us;
+
+  void add(int64_t us) {
+    count++;
+    sum_us += us;
+    max_us = std::max(max_us, us);
+    values_us.push_back(us);
+  }
+  int64_t median() {
+    if (values_us.empty()) {
+      return 0;
+    }
+    std::nth_element(values_us.begin(), values_us.begin() + values_us.size() / 2, values_us.end());
+    return values_us[values_us.size() / 2];
+  }
+  std::string to_string() {
+    char text[96];
+    std::snprintf(text, sizeof(text), "%zu, mean %.0f us, median %lld us, max %lld us", count,
+                  count ? sum_us / count : 0.0, (long long)median(), (long long)max_us);
+    return text;
+  }
+};
+
+struct Connection {
+  uint16_t handle{0};
+  int64_t start_us{0};
+  std::map<std::pair<bool, uint8_t>, size_t> opcodes; ///< (received, opcode) -> count
+  std::map<uint8_t, Stats> response_times;           ///< request opcode -> time to its response
+  Stats next_request;                                 ///< from a response to the host's next request
+  std::map<uint16_t, Stats> notification_intervals;   ///< handle -> time between notifications
+  std::map<uint16_t, int64_t> last_notification_us;
+  int64_t first_notification_us{-1};
+  // the request waiting for its response, and when the last response was sent
+  uint8_t pending_request{0};
+  bool pending_received{false};
+  int64_t pending_since_us{0};
+  int64_t last_response_us{-1};
+};
+
+static void print_connection(Connection &connection) {
+  std::printf("connection %u\n", connection.handle);
+  for (const auto &[key, count] : connection.opcodes) {
+    std::printf("  %-8s %-28s %zu\n", key.first ? "received" : "sent",
+                std::string(att_opcode_name(key.second)).c_str(), count);
+  }
+  for (auto &[opcode, stats] : connection.response_times) {
+    std::printf("  response to %s: %s\n", std::string(att_opcode_name(opcode)).c_str(), stats.to_string().c_str());
+  }
+  if (connection.next_request.count) {
+    std::printf("  next request after a response: %s\n", connection.next_request.to_string().c_str());
+  }
+  if (connection.first_notification_us >= 0) {
+    std::printf("  first notification %.3f ms after connecting\n",
+                (connection.first_notification_us - connection.start_us) / 1000.0);
+  }
+  for (auto &[handle, stats] : connection.notification_intervals) {
+    std::printf("  notifications of handle %u, interval: %s\n", handle, stats.to_string().c_str());
+  }
+}
+
+static void summarize(const std::vector<Packet> &packets) {
+  if (packets.empty()) {
+    std::printf("no packets\n");
+    return;
+  }
+  std::printf("%zu packets over %.3f s\n", packets.size(),
+              (packets.back().header.timestamp_us - packets.front().header.timestamp_us) / 1e6);
+  std::vector<Connection> connections;
+  auto connected = [&](uint16_t handle, int64_t start_us) -> Connection & {
+    connections.emplace_back();
+    connections.back().handle = handle;
+    connections.back().start_us = start_us;
+    return connections.back();
+  };
+  auto connection = [&](uint16_t handle) -> Connection & {
+    for (auto it = connections.rbegin(); it != connections.rend(); it++) {
+      if (it->handle == handle) {
+        return *it;
+      }
+    }
+    // captured mid-connection
+    return connected(handle, packets.front().header.timestamp_us);
+  };
+  for (const auto &packet : packets) {
+    const auto &header = packet.header;
+    const uint8_t *data = packet.data;
+    int64_t now = header.timestamp_us;
+    bool received = header.flags & FLAG_RECEIVED;
+    if (header.included_length >= 7 && data[0] == H4_EVENT && data[1] == HCI_LE_META &&
+        data[3] == HCI_LE_CONNECTION_COMPLETE) {
+      connected(data[5] | (data[6] << 8), now);
+      continue;
+    }
+    if (header.included_length < ACL_FRAMING_SIZE + 1 || data[0] != H4_ACL) {
+      continue;
+    }
+    auto &c = connection((data[1] | (data[2] << 8)) & 0x0fff);
+    uint8_t opcode = data[ACL_FRAMING_SIZE];
+    c.opcodes[{received, opcode}]++;
+    // requests go either way, depending on which side captured
+    if (att_response_opcode(opcode) && opcode != ATT_HANDLE_VALUE_IND) {
+      if (c.last_response_us >= 0) {
+        c.next_request.add(now - c.last_response_us);
+      }
+      c.pending_request = opcode;
+      c.pending_received = received;
+      c.pending_since_us = now;
+    } else if (c.pending_request && received != c.pending_received &&
+               (opcode == att_response_opcode(c.pending_request) || opcode == ATT_ERROR_RSP)) {
+      c.response_times[c.pending_request].add(now - c.pending_since_us);
+      c.pending_request = 0;
+      c.last_response_us = now;
+    } else if (opcode == ATT_HANDLE_VALUE_NTF && header.included_length >= ACL_FRAMING_SIZE + 3) {
+      uint16_t handle = data[ACL_FRAMING_SIZE + 1] | (data[ACL_FRAMING_SIZE + 2] << 8);
+      if (c.first_notification_us < 0) {
+        c.first_notification_us = now;
+      }
+      auto last = c.last_notification_us.find(handle);
+      if (last != c.last_notification_us.end()) {
+        c.notification_intervals[handle].add(now - last->second);
+      }
+      c.last_notification_us[handle] = now;
+    }
+  }
+  for (auto &c : connections) {
+    print_connection(c);
+  }
+}
+
+int main(int argc, char **argv) {
+  bool summary = false;
+  std::string input_path;
+  std::string output_path;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--summary") == 0) {
+      summary = true;
+    } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output_path = argv[++i];
+    } else if (argv[i][0] == '-') {
+      input_path.clear();
+      break;
+    } else {
+      input_path = argv[i];
+    }
+  }
+  if (input_path.empty() || (!summary && output_path.empty())) {
+    std::cerr << "usage: " << argv[0] << " [-o capture.btsnoop] [--summary] capture\n";
+    return 1;
+  }
+  auto bytes = read_file(input_path);
+  size_t end = 0;
+  auto packets = parse(bytes, end);
+  if (!output_path.empty()) {
+    std::ofstream out(output_path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(bytes.data()), end);
+    if (!out) {
+      fail("could not write '" + output_path + "'");
+    }
+    std::cerr << "wrote " << packets.size() << " packets (" << end << " bytes) to " << output_path << "\n";
+  }
+  if (summary) {
+    summarize(packets);
+  }
+  return 0;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <sdkconfig.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "logger.hpp"
+
+// Deferred logging: a call site stores a compact binary record - which call
+// site it is (format string, level, logger) and its raw arguments - in a
+// lock-free ring of the core it runs on, and a low priority task formats and
+// prints the records later. Logging from a hot path (e.g. every input report,
+// or the BTC task's callbacks) then costs a few stores instead of formatting
+// and waiting for the UART, and call sites below CONFIG_DEFERRED_LOG_MIN_LEVEL
+// are not compiled in at all:
+//
+//   static deferred_log::Logger dlogger({.tag = "HID BLE", .level = espp::Logger::Verbosity::DEBUG});
+//   DLOG_DEBUG(dlogger, "Sending notification: attr_handle={}, length={}", handle, length);
+//
+// Arguments are stored by value and must be arithmetic, enums or pointers.
+// Strings are stored as pointers, so only pass ones which outlive the record,
+// e.g. literals or names from a table.
+
+#ifndef CONFIG_DEFERRED_LOG_MIN_LEVEL
+#define CONFIG_DEFERRED_LOG_MIN_LEVEL 0
+#endif
+
+#ifndef CONFIG_DEFERRED_LOG_RING_SIZE
+#define CONFIG_DEFERRED_LOG_RING_SIZE 64
+#endif
+
+#ifndef CONFIG_DEFERRED_LOG_TASK_PRIORITY
+#define CONFIG_DEFERRED_LOG_TASK_PRIORITY 1
+#endif
+
+namespace deferred_log {
+
+using Verbosity = espp::Logger::Verbosity;
+
+/// Maximum number of arguments of a call site
+static constexpr size_t MAX_ARGS = 4;
+
+/// Whether call sites of the level are compiled in
+constexpr bool compiled_in(Verbosity level) { return int(level) >= CONFIG_DEFERRED_LOG_MIN_LEVEL; }
+
+class Logger;
+struct Record;
+
+/// What a call site stores once: everything about the message but the arguments
+struct Site {
+  const Logger *logger;
+  Verbosity level;
+  const char *format;
+  /// formats a record of this site, knowing its argument types
+  std::string (*to_string)(const Record &record);
+};
+
+/// One message, as stored in the ring
+struct Record {
+  const Site *site{nullptr};
+  int64_t time_us{0};
+  std::array<uint64_t, MAX_ARGS> args{};
+};
+
+template <typename T> constexpr bool storable = std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>;
+
+template <typename T> constexpr uint64_t encode(T value) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return std::bit_cast<uint64_t>(double(value));
+  } else if constexpr (std::is_pointer_v<T>) {
+    return reinterpret_cast<uintptr_t>(value);
+  } else if constexpr (std::is_enum_v<T>) {
+    return uint64_t(std::underlying_type_t<T>(value));
+  } else {
+    return uint64_t(value);
+  }
+}
+
+template <typename T> constexpr T decode(uint64_t value) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return T(std::bit_cast<double>(value));
+  } else if constexpr (std::is_pointer_v<T>) {
+    return reinterpret_cast<T>(uintptr_t(value));
+  } else {
+    return T(value);
+  }
+}
+
+// enums are printed as their values
+template <typename T> struct printable {
+  using type = T;
+};
+template <typename T>
+  requires std::is_enum_v<T>
+struct printable<T> {
+  using type = std::underlying_type_t<T>;
+};
+template <typename T> using printable_t = typename printable<T>::type;
+
+template <typename... Args, size_t... I> std::string format_record(const Record &record, std::index_sequence<I...>) {
+  return fmt::format(fmt::runtime(record.site->format), printable_t<Args>(decode<Args>(record.args[I]))...);
+}
+
+template <typename... Args> std::string format_record(const Record &record) {
+  return format_record<Args...>(record, std::index_sequence_for<Args...>{});
+}
+
+/// A call site's Site, with a formatter for its argument types
+template <typename... Args> constexpr Site make_site(const Logger *logger, Verbosity level, const char *format) {
+  static_assert(sizeof...(Args) <= MAX_ARGS, "too many arguments for a deferred log record");
+  static_assert((storable<Args> && ...), "deferred log arguments must be arithmetic, enums or pointers");
+  return {logger, level, format, &format_record<Args...>};
+}
+
+/// Bounded lock-free multi producer / multi consumer queue of records
+/// (Vyukov's), so tasks preempting each other on a core can all write to it
+class Ring {
+public:
+  static constexpr size_t SIZE = CONFIG_DEFERRED_LOG_RING_SIZE;
+  static_assert((SIZE & (SIZE - 1)) == 0, "the ring size must be a power of two");
+
+  Ring();
+  /// false (and the record is counted as dropped) if the ring is full
+  bool push(const Record &record);
+  bool pop(Record &record);
+  /// Records dropped since the last call
+  uint32_t take_dropped() { return dropped_.exchange(0, std::memory_order_relaxed); }
+
+protected:
+  struct Cell {
+    std::atomic<uint32_t> sequence;
+    Record record;
+  };
+  std::array<Cell, SIZE> cells_;
+  std::atomic<uint32_t> enqueue_position_{0};
+  std::atomic<uint32_t> dequeue_position_{0};
+  std::atomic<uint32_t> dropped_{0};
+};
+
+/// The tag and runtime level of a set of call sites, like espp::Logger.
+/// Loggers must outlive the records written with them (e.g. be static).
+class Logger {
+public:
+  struct Config {
+    std::string_view tag;
+    Verbosity level{Verbosity::WARN};
+  };
+
+  explicit Logger(const Config &config) : tag_(config.tag), level_(config.level) {}
+
+  void set_verbosity(Verbosity level) { level_.store(level, std::memory_order_relaxed); }
+  bool enabled(Verbosity level) const { return level_.load(std::memory_order_relaxed) <= level; }
+  std::string_view tag() const { return tag_; }
+
+  /// Store a record, see DLOG_*()
+  template <typename... Args> void write(const Site &site, Args... args) const {
+    if (enabled(site.level)) {
+      write(Record{.site = &site, .time_us = now_us(), .args = {encode(args)...}});
+    }
+  }
+
+protected:
+  static int64_t now_us();
+  static void write(const Record &record);
+
+  std::string tag_;
+  std::atomic<Verbosity> level_;
+};
+
+/// Start the task which prints the records, if it isn't running yet
+void start();
+
+/// Print all records (oldest first) now, from the calling task
+void flush();
+
+} // namespace deferred_log
+
+#define DLOG_AT(logger, level, format, ...)                                                                           \
+  do {                                                                                                                \
+    if constexpr (deferred_log::compiled_in(level)) {                                                                 \
+      [&]<typename... Args>(Args... args) {                                                                           \
+        static constexpr deferred_log::Site site =                                                                    \
+            deferred_log::make_site<std::decay_t<Args>...>(&(logger), level, format);                                 \
+        (logger).write(site, args...);                                                                                \
+      }(__VA_ARGS__);                                                                                                 \
+    }                                                                                                                 \
+  } while (0)
+
+#define DLOG_DEBUG(logger, format, ...) DLOG_AT(logger, deferred_log::Verbosity::DEBUG, format __VA_OPT__(, ) __VA_ARGS__)
+#define DLOG_INFO(logger, format, ...) DLOG_AT(logger, deferred_log::Verbosity::INFO, format __VA_OPT__(, ) __VA_ARGS__)
+#define DLOG_WARN(logger, format, ...) DLOG_AT(logger, deferred_log::Verbosity::WARN, format __VA_OPT__(, ) __VA_ARGS__)
+#define DLOG_ERROR(logger, format, ...) DLOG_AT(logger, deferred_log::Verbosity::ERROR, format __VA_OPT__(, ) __VA_ARGS__)
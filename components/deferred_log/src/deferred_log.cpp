@@ -0,0 +1,128 @@
+#include "deferred_log.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include <esp_timer.h>
+
+#include "task.hpp"
+
+namespace deferred_log {
+
+// one ring per core, so the cores don't contend for the same cache lines
+static std::array<Ring, portNUM_PROCESSORS> rings;
+static std::unique_ptr<espp::Task> task;
+static std::mutex task_mutex;
+// one flush at a time, so the records come out in order
+static std::mutex flush_mutex;
+
+Ring::Ring() {
+  for (size_t i = 0; i < SIZE; i++) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool Ring::push(const Record &record) {
+  uint32_t position = enqueue_position_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell &cell = cells_[position & (SIZE - 1)];
+    int32_t difference = int32_t(cell.sequence.load(std::memory_order_acquire) - position);
+    if (difference == 0) {
+      if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        cell.record = record;
+        cell.sequence.store(position + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (difference < 0) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      position = enqueue_position_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool Ring::pop(Record &record) {
+  uint32_t position = dequeue_position_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell &cell = cells_[position & (SIZE - 1)];
+    int32_t difference = int32_t(cell.sequence.load(std::memory_order_acquire) - (position + 1));
+    if (difference == 0) {
+      if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        record = cell.record;
+        cell.sequence.store(position + SIZE, std::memory_order_release);
+        return true;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      position = dequeue_position_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+int64_t Logger::now_us() { return esp_timer_get_time(); }
+
+void Logger::write(const Record &record) { rings[xPortGetCoreID()].push(record); }
+
+static char level_char(Verbosity level) {
+  switch (level) {
+  case Verbosity::DEBUG:
+    return 'D';
+  case Verbosity::INFO:
+    return 'I';
+  case Verbosity::WARN:
+    return 'W';
+  case Verbosity::ERROR:
+    return 'E';
+  default:
+    return '?';
+  }
+}
+
+void flush() {
+  std::lock_guard<std::mutex> lock(flush_mutex);
+  std::vector<Record> records;
+  uint32_t dropped = 0;
+  for (auto &ring : rings) {
+    Record record;
+    while (ring.pop(record)) {
+      records.push_back(record);
+    }
+    dropped += ring.take_dropped();
+  }
+  // the cores' records interleaved again
+  std::stable_sort(records.begin(), records.end(),
+                   [](const Record &a, const Record &b) { return a.time_us < b.time_us; });
+  for (const auto &record : records) {
+    const auto &site = *record.site;
+    // in integers, a float loses the milliseconds after a few hours up
+    fmt::print("[{}/{}][{}.{:06d}]: {}\n", site.logger->tag(), level_char(site.level), record.time_us / 1000000,
+               record.time_us % 1000000, site.to_string(record));
+  }
+  if (dropped) {
+    fmt::print("[deferred_log/W]: {} records dropped, the rings were full\n", dropped);
+  }
+}
+
+void start() {
+  std::lock_guard<std::mutex> lock(task_mutex);
+  if (task) {
+    return;
+  }
+  task = std::make_unique<espp::Task>(espp::Task::Config{
+      .name = "Deferred Log",
+      .callback = [](auto &m, auto &cv) -> bool {
+        flush();
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait_for(lock, std::chrono::milliseconds(20));
+        return false;
+      },
+      .stack_size_bytes = 4096,
+      .priority = CONFIG_DEFERRED_LOG_TASK_PRIORITY,
+  });
+  task->start();
+}
+
+} // namespace deferred_log
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <cstring>
 
+#include "sdkconfig.h"
+
 #include <esp_bt.h>
 #include <esp_gatt_defs.h>
 #include <esp_gatts_api.h>
@@ -10,38 +13,70 @@
 #include <esp_bt_main.h>
 #include <esp_gatt_common_api.h>
 
-/// Device Information Service Attributes Indexes
-enum
-{
-    DIS_IDX_SVC,
-
-    DIS_IDX_PNP_CHAR,
-    DIS_IDX_PNP_VAL,
+#include "gatt_service_builder.hpp"
 
-    DIS_IDX_MANUFACTURER_NAME_CHAR,
-    DIS_IDX_MANUFACTURER_NAME_VAL,
+/// Device Info PnP ID: vendor ID source (1 byte), vendor ID, product ID and
+/// product version (2 bytes each, little endian)
+static constexpr uint16_t PNP_ID_SIZE = 7;
+extern uint8_t pnp_id[PNP_ID_SIZE];
 
-    DIS_IDX_MODEL_NUMBER_CHAR,
-    DIS_IDX_MODEL_NUMBER_VAL,
+// defaults until the application sets the DIS strings
+#define DIS_DEFAULT_MANUFACTURER_NAME CONFIG_MANUFACTURER_NAME
+#define DIS_DEFAULT_MODEL_NUMBER      "0x045E"
+#define DIS_DEFAULT_SERIAL_NUMBER     "000000000001"
 
-    DIS_IDX_SERIAL_NUMBER_CHAR,
-    DIS_IDX_SERIAL_NUMBER_VAL,
+/// The stack allocates the max length of every attribute value, so the DIS
+/// strings are sized to their configured defaults, but at least
+/// CONFIG_DIS_STRING_MIN_CAPACITY for longer strings which are set at runtime.
+static constexpr uint16_t dis_string_capacity(size_t default_length) {
+  return std::max<size_t>(default_length, CONFIG_DIS_STRING_MIN_CAPACITY);
+}
 
-    DIS_IDX_NB,
-};
-
-extern uint64_t pnp_id;
-static constexpr uint16_t MANUFACTURER_NAME_MAX_LEN = 100;
-extern uint8_t manufacturer_name[MANUFACTURER_NAME_MAX_LEN];
+static constexpr uint16_t MANUFACTURER_NAME_MAX_LEN = dis_string_capacity(sizeof(DIS_DEFAULT_MANUFACTURER_NAME) - 1);
+extern uint8_t manufacturer_name[MANUFACTURER_NAME_MAX_LEN + 1]; // + the default's terminator
 extern uint16_t manufacturer_name_length;
 
-static constexpr uint16_t MODEL_NUMBER_MAX_LEN = 100;
-extern uint8_t model_number[MODEL_NUMBER_MAX_LEN];
+static constexpr uint16_t MODEL_NUMBER_MAX_LEN = dis_string_capacity(sizeof(DIS_DEFAULT_MODEL_NUMBER) - 1);
+extern uint8_t model_number[MODEL_NUMBER_MAX_LEN + 1]; // + the default's terminator
 extern uint16_t model_number_length;
 
-static constexpr uint16_t SERIAL_NUMBER_MAX_LEN = 100;
-extern uint8_t serial_number[SERIAL_NUMBER_MAX_LEN];
+static constexpr uint16_t SERIAL_NUMBER_MAX_LEN = dis_string_capacity(sizeof(DIS_DEFAULT_SERIAL_NUMBER) - 1);
+extern uint8_t serial_number[SERIAL_NUMBER_MAX_LEN + 1]; // + the default's terminator
 extern uint16_t serial_number_length;
 
-extern const esp_gatts_attr_db_t dis_att_db[DIS_IDX_NB];
-extern uint16_t dis_handle_table[DIS_IDX_NB];
+/// Device Info Service Attribute Table
+inline constexpr auto dis_att_db = gatt::service<ESP_GATT_UUID_DEVICE_INFO_SVC>(
+  // PnP ID characteristic, UUID: 0x2A50, Properties: read
+  gatt::characteristic<ESP_GATT_UUID_PNP_ID, gatt::PROP_READ>(
+    ESP_GATT_PERM_READ, gatt::value(pnp_id)),
+  // Manufacturer Name characteristic, UUID: 0x2A29, Properties: read
+  gatt::characteristic<ESP_GATT_UUID_MANU_NAME, gatt::PROP_READ>(
+    ESP_GATT_PERM_READ, gatt::Value{manufacturer_name, MANUFACTURER_NAME_MAX_LEN, sizeof(DIS_DEFAULT_MANUFACTURER_NAME) - 1}),
+  // Model Number characteristic, UUID: 0x2A24, Properties: read
+  gatt::characteristic<ESP_GATT_UUID_MODEL_NUMBER_STR, gatt::PROP_READ>(
+    ESP_GATT_PERM_READ, gatt::Value{model_number, MODEL_NUMBER_MAX_LEN, sizeof(DIS_DEFAULT_MODEL_NUMBER) - 1}),
+  // Serial Number characteristic, UUID: 0x2A25, Properties: read
+  gatt::characteristic<ESP_GATT_UUID_SERIAL_NUMBER_STR, gatt::PROP_READ>(
+    ESP_GATT_PERM_READ, gatt::Value{serial_number, SERIAL_NUMBER_MAX_LEN, sizeof(DIS_DEFAULT_SERIAL_NUMBER) - 1}));
+
+/// Device Information Service Attributes Indexes
+enum
+{
+    DIS_IDX_SVC = 0,
+
+    DIS_IDX_PNP_CHAR = dis_att_db.declaration_index(ESP_GATT_UUID_PNP_ID),
+    DIS_IDX_PNP_VAL = dis_att_db.value_index(ESP_GATT_UUID_PNP_ID),
+
+    DIS_IDX_MANUFACTURER_NAME_CHAR = dis_att_db.declaration_index(ESP_GATT_UUID_MANU_NAME),
+    DIS_IDX_MANUFACTURER_NAME_VAL = dis_att_db.value_index(ESP_GATT_UUID_MANU_NAME),
+
+    DIS_IDX_MODEL_NUMBER_CHAR = dis_att_db.declaration_index(ESP_GATT_UUID_MODEL_NUMBER_STR),
+    DIS_IDX_MODEL_NUMBER_VAL = dis_att_db.value_index(ESP_GATT_UUID_MODEL_NUMBER_STR),
+
+    DIS_IDX_SERIAL_NUMBER_CHAR = dis_att_db.declaration_index(ESP_GATT_UUID_SERIAL_NUMBER_STR),
+    DIS_IDX_SERIAL_NUMBER_VAL = dis_att_db.value_index(ESP_GATT_UUID_SERIAL_NUMBER_STR),
+
+    DIS_IDX_NB = dis_att_db.size(),
+};
+
+extern gatt::HandleTable<dis_att_db> dis_handle_table;
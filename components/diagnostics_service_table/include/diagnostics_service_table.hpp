@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <esp_bt.h>
+#include <esp_gatt_defs.h>
+#include <esp_gatts_api.h>
+#include <esp_bt_defs.h>
+#include <esp_bt_device.h>
+#include <esp_bt_main.h>
+#include <esp_gatt_common_api.h>
+
+#include "gatt_service_builder.hpp"
+
+/// Version of the DiagnosticsCounters layout, bumped whenever it changes
+#define DIAGNOSTICS_COUNTERS_VERSION 1
+
+/// The value of the diagnostics counters characteristic, little endian as
+/// everything else in GATT. Fields are only ever appended (with a new
+/// version), so readers can decode the ones they know about.
+struct __attribute__((packed)) DiagnosticsCounters {
+  uint8_t version;            ///< DIAGNOSTICS_COUNTERS_VERSION
+  int8_t rssi;                ///< of the connection in dBm, 0 if not known yet
+  uint8_t tx_phy;             ///< ESP_BLE_GAP_PHY_1M, _2M or _CODED
+  uint8_t rx_phy;
+  uint32_t uptime_ms;
+  uint32_t reports_sent;      ///< input reports the stack sent
+  uint32_t reports_dropped;   ///< input reports rejected (e.g. congested) or lost at a disconnect
+  uint32_t reports_coalesced; ///< input reports merged into a later one by the application
+  uint32_t congestion_ms;     ///< time the connections have been congested
+  uint16_t conn_interval;     ///< 1.25 ms units
+  uint16_t conn_latency;      ///< connection events
+  uint16_t conn_timeout;      ///< supervision timeout, 10 ms units
+  uint16_t mtu;
+  uint32_t free_heap;         ///< bytes
+  uint32_t min_free_heap;     ///< bytes, since boot
+  uint32_t latency_p50_us;    ///< input report latency, from the API call to its completion
+  uint32_t latency_p99_us;
+  uint32_t latency_max_us;
+};
+
+// an MTU of 55 or more (which hosts usually negotiate) reads them in one go
+static_assert(sizeof(DiagnosticsCounters) == 52, "the counters' layout is part of the service's interface");
+
+/// Diagnostics service, a vendor service: 6e3f0001-5b9c-4a3e-9d2c-1f0a7b4c8e21
+inline constexpr gatt::Uuid DIAG_SERVICE_UUID = std::array<uint8_t, ESP_UUID_LEN_128>{
+    0x6e, 0x3f, 0x00, 0x01, 0x5b, 0x9c, 0x4a, 0x3e, 0x9d, 0x2c, 0x1f, 0x0a, 0x7b, 0x4c, 0x8e, 0x21};
+/// Diagnostics counters characteristic: 6e3f0002-5b9c-4a3e-9d2c-1f0a7b4c8e21
+inline constexpr gatt::Uuid DIAG_COUNTERS_UUID = std::array<uint8_t, ESP_UUID_LEN_128>{
+    0x6e, 0x3f, 0x00, 0x02, 0x5b, 0x9c, 0x4a, 0x3e, 0x9d, 0x2c, 0x1f, 0x0a, 0x7b, 0x4c, 0x8e, 0x21};
+
+/// Diagnostics Service Attribute Table
+inline constexpr auto diag_att_db = gatt::service<DIAG_SERVICE_UUID>(
+  // Diagnostics Counters characteristic, Properties: read. The counters are
+  // gathered when they are read, so the read is answered by the application.
+  gatt::app_response(gatt::characteristic<DIAG_COUNTERS_UUID, gatt::PROP_READ>(
+    ESP_GATT_PERM_READ_ENCRYPTED, gatt::empty(sizeof(DiagnosticsCounters)))));
+
+/// Diagnostics Service Attributes Indexes
+enum
+{
+    DIAG_IDX_SVC = 0,
+
+    DIAG_IDX_COUNTERS_CHAR = diag_att_db.declaration_index(DIAG_COUNTERS_UUID),
+    DIAG_IDX_COUNTERS_VAL = diag_att_db.value_index(DIAG_COUNTERS_UUID),
+
+    DIAG_IDX_NB = diag_att_db.size(),
+};
+
+extern gatt::HandleTable<diag_att_db> diag_handle_table;
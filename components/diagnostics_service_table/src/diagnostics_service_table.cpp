@@ -0,0 +1,3 @@
+#include "diagnostics_service_table.hpp"
+
+gatt::HandleTable<diag_att_db> diag_handle_table;
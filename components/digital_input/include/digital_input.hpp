@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <span>
+
+#include <sdkconfig.h>
+
+// Digital inputs: up to 32 buttons sampled as one word per scan, from a
+// pluggable source (GPIOs, a button matrix, or a stand-in in the host
+// simulator), and debounced all at once, so that a change can be reported
+// as soon as it is certain:
+//
+//   static const int pins[] = {4, 5, 18, 19};
+//   digital_input::Scanner scanner({.source = digital_input::gpio_source(pins)});
+//   ...
+//   // every CONFIG_DIGITAL_INPUT_SCAN_PERIOD_MS
+//   if (scanner.scan()) {
+//     uint32_t buttons = button_map.apply(scanner.pressed());
+//     ... // send a report right away
+//   }
+//
+// Each button has a 2-bit counter, kept bit-sliced across two words (a
+// vertical counter), which counts the samples in a row which disagree with
+// the button's debounced state and is reset by one that agrees. The 4th one
+// in a row flips the state, for all buttons at once in a few word operations.
+
+namespace digital_input {
+
+/// Sample every button: bit i of pressed is input i, 1 while it is pressed,
+/// false if the sample failed
+using Source = std::function<bool(uint32_t &pressed)>;
+
+/// Debounces 32 inputs at once with a vertical counter
+class Debouncer {
+public:
+  /// Samples in a row it takes to change an input's state
+  static constexpr int SAMPLES = 4;
+
+  /// Count a sample in
+  /// @return The inputs whose state changed with it
+  uint32_t update(uint32_t sample) {
+    uint32_t differs = sample ^ state_;
+    // each input's counter is (count1_, count0_), 3 at rest, counting down
+    // while the samples differ and wrapping around to 3 on the 4th
+    count0_ = ~(count0_ & differs);
+    count1_ = count0_ ^ (count1_ & differs);
+    uint32_t changed = differs & count0_ & count1_;
+    state_ ^= changed;
+    return changed;
+  }
+
+  /// The inputs whose last samples disagreed with their state, but not yet
+  /// SAMPLES in a row
+  uint32_t counting() const { return ~(count0_ & count1_); }
+
+  uint32_t state() const { return state_; }
+
+  /// Take the state as it is, with no change under way
+  void reset(uint32_t state = 0) {
+    state_ = state;
+    count0_ = count1_ = ~uint32_t{0};
+  }
+
+protected:
+  uint32_t state_{0};
+  uint32_t count0_{~uint32_t{0}};
+  uint32_t count1_{~uint32_t{0}};
+};
+
+/// Where the inputs go in a report's button bits, e.g. input 2 is the
+/// report's bit 3. Inputs which aren't mapped are left out.
+class ButtonMap {
+public:
+  static constexpr uint8_t UNMAPPED = 0xff;
+
+  /// @param report_bits  the report's bit of each input, in input order
+  constexpr ButtonMap(std::initializer_list<uint8_t> report_bits) {
+    size_t input = 0;
+    for (uint8_t bit : report_bits) {
+      if (input < masks_.size() && bit < 32) {
+        masks_[input] = uint32_t{1} << bit;
+      }
+      input++;
+    }
+  }
+
+  /// The report's button bits of the inputs which are set
+  uint32_t apply(uint32_t inputs) const {
+    uint32_t buttons = 0;
+    for (; inputs; inputs &= inputs - 1) {
+      buttons |= masks_[__builtin_ctz(inputs)];
+    }
+    return buttons;
+  }
+
+protected:
+  std::array<uint32_t, 32> masks_{};
+};
+
+class Scanner {
+public:
+  struct Config {
+    Source source{nullptr};
+  };
+
+  struct Stats {
+    uint32_t scans{0};
+    uint32_t failed_scans{0};
+    uint32_t changes{0}; ///< debounced presses and releases
+    uint32_t bounces{0}; ///< changes under way which a sample called off
+  };
+
+  explicit Scanner(const Config &config);
+
+  /// Sample the inputs and debounce them. Doesn't allocate. Call it from one
+  /// task only, every CONFIG_DIGITAL_INPUT_SCAN_PERIOD_MS.
+  /// @return The inputs whose debounced state changed, to report right away
+  uint32_t scan();
+
+  /// The debounced state, bit i is input i
+  uint32_t pressed() const { return debouncer_.state(); }
+  const Stats &stats() const { return stats_; }
+
+protected:
+  Config config_;
+  Debouncer debouncer_;
+  Stats stats_;
+};
+
+/// A source which reads the GPIOs (pulled up, pressed when low) with one read
+/// of the input registers, pins[i] being input i
+Source gpio_source(std::span<const int> pins);
+
+/// A source which scans a matrix of buttons: each row is driven low in turn
+/// (open drain) and the columns (pulled up) read, the button at row r and
+/// column c being input r * columns.size() + c. At most 32 buttons.
+Source matrix_source(std::span<const int> rows, std::span<const int> columns);
+
+} // namespace digital_input
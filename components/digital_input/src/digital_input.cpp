@@ -0,0 +1,22 @@
+#include "digital_input.hpp"
+
+namespace digital_input {
+
+Scanner::Scanner(const Config &config)
+    : config_(config) {}
+
+uint32_t Scanner::scan() {
+  stats_.scans++;
+  uint32_t sample;
+  if (!config_.source || !config_.source(sample)) {
+    stats_.failed_scans++;
+    return 0;
+  }
+  uint32_t counting = debouncer_.counting();
+  uint32_t changed = debouncer_.update(sample);
+  stats_.changes += __builtin_popcount(changed);
+  stats_.bounces += __builtin_popcount(counting & ~debouncer_.counting() & ~changed);
+  return changed;
+}
+
+} // namespace digital_input
@@ -0,0 +1,95 @@
+#include "digital_input.hpp"
+
+#include <vector>
+
+#include <driver/gpio.h>
+#include <esp_rom_sys.h>
+#include <soc/gpio_reg.h>
+#include <soc/soc_caps.h>
+
+#include "logger.hpp"
+
+namespace digital_input {
+
+static espp::Logger logger({.tag = "digital_input", .level = espp::Logger::Verbosity::INFO});
+
+// the level of every GPIO, in one or two register reads
+static inline uint64_t read_levels() {
+  uint64_t levels = REG_READ(GPIO_IN_REG);
+#if SOC_GPIO_PIN_COUNT > 32
+  levels |= uint64_t(REG_READ(GPIO_IN1_REG)) << 32;
+#endif
+  return levels;
+}
+
+static uint64_t pin_mask(std::span<const int> pins) {
+  uint64_t mask = 0;
+  for (int pin : pins) {
+    mask |= 1ULL << pin;
+  }
+  return mask;
+}
+
+Source gpio_source(std::span<const int> pins) {
+  gpio_config_t config = {
+      .pin_bit_mask = pin_mask(pins),
+      .mode = GPIO_MODE_INPUT,
+      .pull_up_en = GPIO_PULLUP_ENABLE,
+      .pull_down_en = GPIO_PULLDOWN_DISABLE,
+      .intr_type = GPIO_INTR_DISABLE,
+  };
+  if (pins.empty() || pins.size() > 32 || gpio_config(&config) != ESP_OK) {
+    logger.error("Could not set up {} GPIOs as button inputs", pins.size());
+    return nullptr;
+  }
+  return [pins = std::vector<int>(pins.begin(), pins.end())](uint32_t &pressed) {
+    uint64_t levels = ~read_levels();
+    pressed = 0;
+    for (size_t i = 0; i < pins.size(); i++) {
+      pressed |= uint32_t((levels >> pins[i]) & 1) << i;
+    }
+    return true;
+  };
+}
+
+Source matrix_source(std::span<const int> rows, std::span<const int> columns) {
+  gpio_config_t row_config = {
+      .pin_bit_mask = pin_mask(rows),
+      .mode = GPIO_MODE_INPUT_OUTPUT_OD,
+      .pull_up_en = GPIO_PULLUP_DISABLE,
+      .pull_down_en = GPIO_PULLDOWN_DISABLE,
+      .intr_type = GPIO_INTR_DISABLE,
+  };
+  gpio_config_t column_config = {
+      .pin_bit_mask = pin_mask(columns),
+      .mode = GPIO_MODE_INPUT,
+      .pull_up_en = GPIO_PULLUP_ENABLE,
+      .pull_down_en = GPIO_PULLDOWN_DISABLE,
+      .intr_type = GPIO_INTR_DISABLE,
+  };
+  if (rows.empty() || columns.empty() || rows.size() * columns.size() > 32 || gpio_config(&row_config) != ESP_OK ||
+      gpio_config(&column_config) != ESP_OK) {
+    logger.error("Could not set up a {}x{} button matrix", rows.size(), columns.size());
+    return nullptr;
+  }
+  // every row released (high impedance) but the one being read
+  for (int row : rows) {
+    gpio_set_level(gpio_num_t(row), 1);
+  }
+  return [rows = std::vector<int>(rows.begin(), rows.end()),
+          columns = std::vector<int>(columns.begin(), columns.end())](uint32_t &pressed) {
+    pressed = 0;
+    for (size_t r = 0; r < rows.size(); r++) {
+      gpio_set_level(gpio_num_t(rows[r]), 0);
+      esp_rom_delay_us(CONFIG_DIGITAL_INPUT_MATRIX_SETTLE_US);
+      uint64_t levels = ~read_levels();
+      gpio_set_level(gpio_num_t(rows[r]), 1);
+      for (size_t c = 0; c < columns.size(); c++) {
+        pressed |= uint32_t((levels >> columns[c]) & 1) << (r * columns.size() + c);
+      }
+    }
+    return true;
+  };
+}
+
+} // namespace digital_input
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#include <sdkconfig.h>
+
+#include <esp_timer.h>
+
+// Event tracing: timestamped events (slices, instants, async spans and
+// counters) recorded into a preallocated ring of CONFIG_EVENT_TRACE_BUFFER_EVENTS,
+// and exported as Chrome trace event JSON or as a Perfetto protobuf trace, to
+// look at in ui.perfetto.dev or chrome://tracing:
+//
+//   event_trace::start();
+//   {
+//     event_trace::Scope scope("btc", ble_gatts_evt_str(event));
+//     ...
+//   }
+//   event_trace::counter("connection interval", interval);
+//   event_trace::stop();
+//   event_trace::export_chrome_json([](std::string_view chunk) { fmt::print("{}", chunk); });
+//
+// Events are grouped into tracks (e.g. a task) by name. Names and tracks are
+// stored as pointers, so they must outlive the trace (literals or names from
+// a table). When the ring is full the oldest events are overwritten. Without
+// CONFIG_EVENT_TRACE everything here compiles to nothing.
+
+namespace event_trace {
+
+enum class Phase : char {
+  COMPLETE = 'X',    ///< a slice, value is its duration
+  INSTANT = 'i',
+  ASYNC_BEGIN = 'b', ///< value is the id matching it to its ASYNC_END
+  ASYNC_END = 'e',
+  COUNTER = 'C',     ///< value is the counter's new value
+};
+
+struct Event {
+  int64_t time_us{0};
+  int64_t value{0};
+  const char *track{nullptr};
+  const char *name{nullptr};
+  Phase phase{Phase::INSTANT};
+};
+
+/// Receives the exported trace, a chunk at a time
+typedef std::function<void(std::string_view chunk)> writer_fn;
+
+enum class Format {
+  CHROME_JSON,
+  PERFETTO, ///< binary protobuf, base64 encoded when printed to the console
+};
+
+inline int64_t now_us() { return esp_timer_get_time(); }
+
+#if CONFIG_EVENT_TRACE
+
+/// Clear the buffer and start recording
+void start();
+/// Stop recording, so the buffer can be exported
+void stop();
+bool is_recording();
+
+void record(const Event &event);
+
+inline void complete(const char *track, const char *name, int64_t start_us, int64_t end_us) {
+  record({start_us, end_us - start_us, track, name, Phase::COMPLETE});
+}
+inline void instant(const char *track, const char *name) { record({now_us(), 0, track, name, Phase::INSTANT}); }
+inline void async_begin(const char *name, uint32_t id) { record({now_us(), id, name, name, Phase::ASYNC_BEGIN}); }
+inline void async_end(const char *name, uint32_t id) { record({now_us(), id, name, name, Phase::ASYNC_END}); }
+inline void counter(const char *name, int64_t value) { record({now_us(), value, name, name, Phase::COUNTER}); }
+
+/// Records a slice from its construction until it goes out of scope
+class Scope {
+public:
+  Scope(const char *track, const char *name) : track_(track), name_(name), start_us_(now_us()) {}
+  ~Scope() { complete(track_, name_, start_us_, now_us()); }
+
+protected:
+  const char *track_;
+  const char *name_;
+  int64_t start_us_;
+};
+
+/// Number of events in the buffer, and the number overwritten since start()
+size_t size();
+size_t overwritten();
+
+/// Export the recorded events, oldest first. Stops recording.
+/// @return The number of events exported
+size_t export_chrome_json(const writer_fn &write);
+size_t export_perfetto(const writer_fn &write);
+
+/// Export to stdout between "=== event trace (<format>) ===" and
+/// "=== end of event trace ===" lines, the Perfetto trace base64 encoded
+void print(Format format);
+
+#else
+
+inline void start() {}
+inline void stop() {}
+inline bool is_recording() { return false; }
+inline void record(const Event &) {}
+inline void complete(const char *, const char *, int64_t, int64_t) {}
+inline void instant(const char *, const char *) {}
+inline void async_begin(const char *, uint32_t) {}
+inline void async_end(const char *, uint32_t) {}
+inline void counter(const char *, int64_t) {}
+
+class Scope {
+public:
+  Scope(const char *, const char *) {}
+};
+
+inline size_t size() { return 0; }
+inline size_t overwritten() { return 0; }
+inline size_t export_chrome_json(const writer_fn &) { return 0; }
+inline size_t export_perfetto(const writer_fn &) { return 0; }
+inline void print(Format) {}
+
+#endif
+
+} // namespace event_trace
@@ -0,0 +1,401 @@
+#include "event_trace.hpp"
+
+#if CONFIG_EVENT_TRACE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "format.hpp"
+
+namespace event_trace {
+
+static constexpr size_t BUFFER_EVENTS = CONFIG_EVENT_TRACE_BUFFER_EVENTS;
+static_assert((BUFFER_EVENTS & (BUFFER_EVENTS - 1)) == 0, "the event trace buffer size must be a power of two");
+
+static std::array<Event, BUFFER_EVENTS> events;
+// events recorded since start(), the next one goes to next % BUFFER_EVENTS
+static std::atomic<uint32_t> next{0};
+static std::atomic<bool> recording{false};
+
+void start() {
+  recording = false;
+  next = 0;
+  recording = true;
+}
+
+void stop() { recording = false; }
+
+bool is_recording() { return recording.load(std::memory_order_relaxed); }
+
+void record(const Event &event) {
+  if (!recording.load(std::memory_order_relaxed)) {
+    return;
+  }
+  uint32_t index = next.fetch_add(1, std::memory_order_relaxed);
+  events[index & (BUFFER_EVENTS - 1)] = event;
+}
+
+size_t size() { return std::min<size_t>(next.load(), BUFFER_EVENTS); }
+
+size_t overwritten() {
+  size_t recorded = next.load();
+  return recorded > BUFFER_EVENTS ? recorded - BUFFER_EVENTS : 0;
+}
+
+// Stop recording and sort the buffer by time, in place, so the exporters can
+// walk it from the front. Slices starting at the same time are sorted longest
+// first, so enclosing slices come before the ones they enclose.
+static size_t sort_events() {
+  stop();
+  size_t recorded = next.load();
+  size_t count = std::min(recorded, BUFFER_EVENTS);
+  if (recorded > BUFFER_EVENTS) {
+    std::rotate(events.begin(), events.begin() + (recorded & (BUFFER_EVENTS - 1)), events.end());
+  }
+  std::stable_sort(events.begin(), events.begin() + count, [](const Event &a, const Event &b) {
+    if (a.time_us != b.time_us) {
+      return a.time_us < b.time_us;
+    }
+    return a.phase == Phase::COMPLETE && b.phase == Phase::COMPLETE && a.value > b.value;
+  });
+  // the oldest event is the first now, whether or not the buffer wrapped
+  next = count;
+  return count;
+}
+
+// The distinct tracks, in order of first use
+class Tracks {
+public:
+  /// @param added Set to whether this is the track's first use
+  size_t index(const char *track, bool &added) {
+    for (size_t i = 0; i < names_.size(); i++) {
+      if (names_[i] == track || strcmp(names_[i], track) == 0) {
+        added = false;
+        return i;
+      }
+    }
+    names_.push_back(track);
+    added = true;
+    return names_.size() - 1;
+  }
+
+protected:
+  std::vector<const char *> names_;
+};
+
+static std::string json_string(const char *value) {
+  std::string escaped = "\"";
+  for (const char *c = value; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      escaped += '\\';
+    }
+    escaped += *c;
+  }
+  return escaped + "\"";
+}
+
+size_t export_chrome_json(const writer_fn &write) {
+  size_t count = sort_events();
+  Tracks tracks;
+  write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"hid_service\"}}");
+  for (size_t i = 0; i < count; i++) {
+    const auto &event = events[i];
+    bool added;
+    size_t tid = tracks.index(event.track, added) + 1;
+    if (added && event.phase != Phase::COUNTER) {
+      write(fmt::format(",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":{}}}}}",
+                        tid, json_string(event.track)));
+    }
+    std::string line = fmt::format(",\n{{\"name\":{},\"cat\":\"hid\",\"ph\":\"{}\",\"ts\":{},\"pid\":1,\"tid\":{}",
+                                   json_string(event.name), char(event.phase), event.time_us, tid);
+    switch (event.phase) {
+    case Phase::COMPLETE:
+      line += fmt::format(",\"dur\":{}", event.value);
+      break;
+    case Phase::INSTANT:
+      line += ",\"s\":\"t\"";
+      break;
+    case Phase::ASYNC_BEGIN:
+    case Phase::ASYNC_END:
+      line += fmt::format(",\"id\":{}", event.value);
+      break;
+    case Phase::COUNTER:
+      line += fmt::format(",\"args\":{{\"value\":{}}}", event.value);
+      break;
+    }
+    write(line + "}");
+  }
+  write("\n]}\n");
+  return count;
+}
+
+// Just enough of the protobuf wire format for Perfetto's trace.proto: a Trace
+// is a sequence of TracePackets (field 1), each holding a TrackDescriptor or a
+// TrackEvent.
+namespace proto {
+
+enum WireType : uint8_t { VARINT = 0, LENGTH_DELIMITED = 2 };
+
+static void varint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out += char(0x80 | (value & 0x7f));
+    value >>= 7;
+  }
+  out += char(value);
+}
+
+static void tag(std::string &out, uint32_t field, WireType type) { varint(out, (field << 3) | type); }
+
+static void field(std::string &out, uint32_t number, uint64_t value) {
+  tag(out, number, VARINT);
+  varint(out, value);
+}
+
+static void field(std::string &out, uint32_t number, std::string_view bytes) {
+  tag(out, number, LENGTH_DELIMITED);
+  varint(out, bytes.size());
+  out += bytes;
+}
+
+// field numbers of perfetto/protos/perfetto/trace/...
+static constexpr uint32_t TRACE_PACKET = 1;
+static constexpr uint32_t PACKET_TIMESTAMP = 8;
+static constexpr uint32_t PACKET_SEQUENCE_ID = 10;
+static constexpr uint32_t PACKET_TRACK_EVENT = 11;
+static constexpr uint32_t PACKET_TRACK_DESCRIPTOR = 60;
+static constexpr uint32_t DESCRIPTOR_UUID = 1;
+static constexpr uint32_t DESCRIPTOR_NAME = 2;
+static constexpr uint32_t DESCRIPTOR_PARENT_UUID = 5;
+static constexpr uint32_t DESCRIPTOR_COUNTER = 8;
+static constexpr uint32_t EVENT_TYPE = 9;
+static constexpr uint32_t EVENT_TRACK_UUID = 11;
+static constexpr uint32_t EVENT_CATEGORIES = 22;
+static constexpr uint32_t EVENT_NAME = 23;
+static constexpr uint32_t EVENT_COUNTER_VALUE = 30;
+
+enum EventType : uint8_t { SLICE_BEGIN = 1, SLICE_END = 2, INSTANT = 3, COUNTER = 4 };
+
+static constexpr uint32_t SEQUENCE_ID = 1;
+
+} // namespace proto
+
+// Writes TracePackets, giving each track (and each lane of an async track)
+// its own track uuid
+class PerfettoWriter {
+public:
+  explicit PerfettoWriter(const writer_fn &write) : write_(write) {}
+
+  void slice_begin(int64_t time_us, const char *track, const char *name) {
+    event(time_us, track_uuid(track, false), proto::SLICE_BEGIN, name);
+  }
+  void slice_end(int64_t time_us, uint64_t uuid) { event(time_us, uuid, proto::SLICE_END, nullptr); }
+  void instant(int64_t time_us, const char *track, const char *name) {
+    event(time_us, track_uuid(track, false), proto::INSTANT, name);
+  }
+  void counter(int64_t time_us, const char *track, int64_t value) {
+    event(time_us, track_uuid(track, true), proto::COUNTER, nullptr, value);
+  }
+
+  /// Async spans overlap, so each runs on the first lane (a child track of
+  /// the span's track) which is free when it begins
+  void async_begin(int64_t time_us, const char *track, const char *name, int64_t id) {
+    uint64_t parent = track_uuid(track, false);
+    size_t lane = 0;
+    while (std::any_of(open_.begin(), open_.end(), [&](const Span &s) { return s.parent == parent && s.lane == lane; })) {
+      lane++;
+    }
+    uint64_t uuid = parent + lane + 1;
+    if (std::find(described_.begin(), described_.end(), uuid) == described_.end()) {
+      describe(uuid, fmt::format("{} #{}", track, lane + 1), parent, false);
+    }
+    open_.push_back({parent, id, lane});
+    event(time_us, uuid, proto::SLICE_BEGIN, name);
+  }
+  void async_end(int64_t time_us, const char *track, int64_t id) {
+    uint64_t parent = track_uuid(track, false);
+    auto span = std::find_if(open_.begin(), open_.end(), [&](const Span &s) { return s.parent == parent && s.id == id; });
+    if (span == open_.end()) {
+      // its begin was overwritten
+      return;
+    }
+    event(time_us, parent + span->lane + 1, proto::SLICE_END, nullptr);
+    open_.erase(span);
+  }
+
+  uint64_t track_uuid(const char *track, bool counter) {
+    bool added;
+    // leave room between the tracks for their lanes
+    uint64_t uuid = (tracks_.index(track, added) + 1) << 16;
+    if (added) {
+      describe(uuid, track, 0, counter);
+    }
+    return uuid;
+  }
+
+protected:
+  struct Span {
+    uint64_t parent;
+    int64_t id;
+    size_t lane;
+  };
+
+  void describe(uint64_t uuid, std::string_view name, uint64_t parent, bool counter) {
+    std::string descriptor;
+    proto::field(descriptor, proto::DESCRIPTOR_UUID, uuid);
+    proto::field(descriptor, proto::DESCRIPTOR_NAME, name);
+    if (parent) {
+      proto::field(descriptor, proto::DESCRIPTOR_PARENT_UUID, parent);
+    }
+    if (counter) {
+      proto::field(descriptor, proto::DESCRIPTOR_COUNTER, std::string_view{});
+    }
+    std::string packet;
+    proto::field(packet, proto::PACKET_SEQUENCE_ID, proto::SEQUENCE_ID);
+    proto::field(packet, proto::PACKET_TRACK_DESCRIPTOR, descriptor);
+    write_packet(packet);
+    described_.push_back(uuid);
+  }
+
+  void event(int64_t time_us, uint64_t uuid, proto::EventType type, const char *name, int64_t value = 0) {
+    std::string track_event;
+    proto::field(track_event, proto::EVENT_TYPE, type);
+    proto::field(track_event, proto::EVENT_TRACK_UUID, uuid);
+    if (name) {
+      proto::field(track_event, proto::EVENT_CATEGORIES, "hid");
+      proto::field(track_event, proto::EVENT_NAME, name);
+    }
+    if (type == proto::COUNTER) {
+      proto::field(track_event, proto::EVENT_COUNTER_VALUE, uint64_t(value));
+    }
+    std::string packet;
+    proto::field(packet, proto::PACKET_TIMESTAMP, uint64_t(time_us) * 1000);
+    proto::field(packet, proto::PACKET_SEQUENCE_ID, proto::SEQUENCE_ID);
+    proto::field(packet, proto::PACKET_TRACK_EVENT, track_event);
+    write_packet(packet);
+  }
+
+  void write_packet(const std::string &packet) {
+    std::string framed;
+    proto::field(framed, proto::TRACE_PACKET, packet);
+    write_(framed);
+  }
+
+  const writer_fn &write_;
+  Tracks tracks_;
+  std::vector<uint64_t> described_;
+  std::vector<Span> open_;
+};
+
+size_t export_perfetto(const writer_fn &write) {
+  size_t count = sort_events();
+  PerfettoWriter writer(write);
+  // ends of the slices begun so far, latest first so the innermost (last
+  // begun) of the ones ending together ends first
+  struct End {
+    int64_t time_us;
+    uint64_t uuid;
+  };
+  std::vector<End> ends;
+  auto end_slices_until = [&](int64_t time_us) {
+    while (!ends.empty() && ends.back().time_us <= time_us) {
+      writer.slice_end(ends.back().time_us, ends.back().uuid);
+      ends.pop_back();
+    }
+  };
+  for (size_t i = 0; i < count; i++) {
+    const auto &event = events[i];
+    end_slices_until(event.time_us);
+    switch (event.phase) {
+    case Phase::COMPLETE: {
+      writer.slice_begin(event.time_us, event.track, event.name);
+      End end{event.time_us + event.value, writer.track_uuid(event.track, false)};
+      ends.insert(std::upper_bound(ends.begin(), ends.end(), end,
+                                   [](const End &a, const End &b) { return a.time_us > b.time_us; }),
+                  end);
+      break;
+    }
+    case Phase::INSTANT:
+      writer.instant(event.time_us, event.track, event.name);
+      break;
+    case Phase::ASYNC_BEGIN:
+      writer.async_begin(event.time_us, event.track, event.name, event.value);
+      break;
+    case Phase::ASYNC_END:
+      writer.async_end(event.time_us, event.track, event.value);
+      break;
+    case Phase::COUNTER:
+      writer.counter(event.time_us, event.track, event.value);
+      break;
+    }
+  }
+  end_slices_until(INT64_MAX);
+  return count;
+}
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Prints bytes base64 encoded, 76 characters to a line
+class Base64Printer {
+public:
+  void write(std::string_view bytes) {
+    for (uint8_t byte : bytes) {
+      group_[group_size_++] = byte;
+      if (group_size_ == 3) {
+        encode_group();
+      }
+    }
+  }
+
+  void finish() {
+    if (group_size_) {
+      encode_group();
+    }
+    if (!line_.empty()) {
+      fmt::print("{}\n", line_);
+    }
+  }
+
+protected:
+  void encode_group() {
+    uint32_t bits = (group_[0] << 16) | (group_size_ > 1 ? group_[1] << 8 : 0) | (group_size_ > 2 ? group_[2] : 0);
+    for (size_t i = 0; i < 4; i++) {
+      line_ += i <= group_size_ ? base64_alphabet[(bits >> (18 - 6 * i)) & 0x3f] : '=';
+    }
+    group_size_ = 0;
+    if (line_.size() == 76) {
+      fmt::print("{}\n", line_);
+      line_.clear();
+    }
+  }
+
+  std::array<uint8_t, 3> group_{};
+  size_t group_size_{0};
+  std::string line_;
+};
+
+void print(Format format) {
+  size_t dropped = overwritten();
+  switch (format) {
+  case Format::CHROME_JSON:
+    fmt::print("=== event trace (chrome json) ===\n");
+    export_chrome_json([](std::string_view chunk) { fmt::print("{}", chunk); });
+    break;
+  case Format::PERFETTO: {
+    fmt::print("=== event trace (perfetto, base64) ===\n");
+    Base64Printer printer;
+    export_perfetto([&](std::string_view chunk) { printer.write(chunk); });
+    printer.finish();
+    break;
+  }
+  }
+  fmt::print("=== end of event trace ({} events, {} overwritten) ===\n", size(), dropped);
+}
+
+} // namespace event_trace
+
+#endif
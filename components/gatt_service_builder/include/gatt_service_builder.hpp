@@ -0,0 +1,342 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <esp_gatt_defs.h>
+#include <esp_gatts_api.h>
+
+// Declarative builder for ESP-IDF GATT service attribute tables.
+//
+// A service is declared once, as a constexpr list of characteristics (and
+// their descriptors) and included services, e.g.:
+//
+//   inline constexpr auto bas_att_db = gatt::service<ESP_GATT_UUID_BATTERY_SERVICE_SVC>(
+//     gatt::characteristic<ESP_GATT_UUID_BATTERY_LEVEL, gatt::PROP_READ | gatt::PROP_NOTIFY>(
+//       ESP_GATT_PERM_READ, gatt::value(battery_level),
+//       gatt::cccd(ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE)));
+//
+// which produces, at compile time, an esp_gatts_attr_db_t array of exactly the
+// declared size (for esp_ble_gatts_create_attr_tab), constexpr attribute
+// indexes (value_index(), descriptor_index(), ...) and a matching
+// HandleTable type. Every UUID, characteristic property and default value is
+// stored once, in a template parameter object, so nothing is duplicated per
+// table and nothing is computed at runtime.
+//
+// Included services are declared with gatt::include<other_service>(): the
+// include declaration's value is filled in automatically when the included
+// service's HandleTable is updated with its handles, so the included service
+// only has to be created first.
+//
+// NOTE: attribute values must be (arrays of) uint8_t with static storage
+// duration, since a pointer to anything else can't be formed at compile time.
+
+namespace gatt {
+
+// characteristic properties
+static constexpr uint8_t PROP_READ = ESP_GATT_CHAR_PROP_BIT_READ;
+static constexpr uint8_t PROP_WRITE = ESP_GATT_CHAR_PROP_BIT_WRITE;
+static constexpr uint8_t PROP_WRITE_NR = ESP_GATT_CHAR_PROP_BIT_WRITE_NR;
+static constexpr uint8_t PROP_NOTIFY = ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static constexpr uint8_t PROP_INDICATE = ESP_GATT_CHAR_PROP_BIT_INDICATE;
+
+/// characteristic presentation information
+struct prf_char_pres_fmt {
+  /// Unit (The Unit is a UUID)
+  uint16_t unit;
+  /// Description
+  uint16_t description;
+  /// Format
+  uint8_t format;
+  /// Exponent
+  uint8_t exponent;
+  /// Name space
+  uint8_t name_space;
+};
+
+/// A 16-bit or 128-bit UUID, usable as a template parameter
+struct Uuid {
+  uint16_t length{ESP_UUID_LEN_16};
+  uint8_t bytes[ESP_UUID_LEN_128]{}; ///< little endian, as sent over the air
+
+  constexpr Uuid(uint16_t uuid16) : bytes{uint8_t(uuid16 & 0xFF), uint8_t(uuid16 >> 8)} {}
+
+  /// 128-bit UUID, given in the usual (string / big endian) byte order
+  constexpr Uuid(const std::array<uint8_t, ESP_UUID_LEN_128> &uuid128)
+      : length(ESP_UUID_LEN_128) {
+    for (size_t i = 0; i < ESP_UUID_LEN_128; i++) {
+      bytes[i] = uuid128[ESP_UUID_LEN_128 - 1 - i];
+    }
+  }
+
+  constexpr bool operator==(const Uuid &) const = default;
+
+  constexpr bool matches(const uint8_t *uuid_p, uint16_t uuid_length) const {
+    if (uuid_length != length) {
+      return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+      if (uuid_p[i] != bytes[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool matches(const esp_bt_uuid_t &uuid) const {
+    if (length == ESP_UUID_LEN_16) {
+      return uuid.len == ESP_UUID_LEN_16 && uuid.uuid.uuid16 == (bytes[0] | bytes[1] << 8);
+    }
+    return uuid.len == ESP_UUID_LEN_128 && std::equal(bytes, bytes + length, uuid.uuid.uuid128);
+  }
+};
+
+/// The value of an attribute: its (static) storage, maximum and initial length
+struct Value {
+  uint8_t *data{nullptr};
+  uint16_t max_length{0};
+  uint16_t length{0};
+};
+
+constexpr Value value(uint8_t &v) { return {&v, 1, 1}; }
+
+template <size_t N> constexpr Value value(uint8_t (&v)[N], uint16_t length = N) {
+  return {v, N, length};
+}
+
+template <size_t N> constexpr Value value(const uint8_t (&v)[N]) {
+  return {const_cast<uint8_t *>(v), N, N};
+}
+
+/// No initial value, e.g. for values set with esp_ble_gatts_set_attr_value()
+/// once the table is created, or only written by the client
+constexpr Value empty(uint16_t max_length) { return {nullptr, max_length, 0}; }
+
+/// A UUID as an attribute value (e.g. the external report reference)
+template <Uuid UUID> constexpr Value uuid_value() {
+  return {const_cast<uint8_t *>(UUID.bytes), UUID.length, UUID.length};
+}
+
+/// Bytes of attribute value storage the stack allocates for a table (the
+/// max_length of every attribute it responds for), e.g. to report the heap
+/// used per service
+constexpr size_t value_bytes(const esp_gatts_attr_db_t *attributes, size_t count) {
+  size_t bytes = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (attributes[i].attr_control.auto_rsp == ESP_GATT_AUTO_RSP) {
+      bytes += attributes[i].att_desc.max_length;
+    }
+  }
+  return bytes;
+}
+
+/// A fixed number of consecutive attributes
+template <size_t N> struct Attributes {
+  std::array<esp_gatts_attr_db_t, N> attributes{};
+
+  static constexpr size_t size() { return N; }
+};
+
+template <size_t... Ns> constexpr Attributes<(Ns + ... + 0)> concat(const Attributes<Ns> &...parts) {
+  Attributes<(Ns + ... + 0)> result;
+  size_t index = 0;
+  ((std::copy(parts.attributes.begin(), parts.attributes.end(), result.attributes.begin() + index),
+    index += Ns),
+   ...);
+  return result;
+}
+
+namespace detail {
+
+template <Uuid UUID> constexpr uint8_t *uuid_pointer() { return const_cast<uint8_t *>(UUID.bytes); }
+
+template <uint8_t PROPERTIES> inline constexpr uint8_t properties = PROPERTIES;
+
+inline constexpr uint8_t cccd_disabled[2] = {0x00, 0x00};
+
+inline constexpr Uuid primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;       // 0x2800
+inline constexpr Uuid include_service_uuid = ESP_GATT_UUID_INCLUDE_SERVICE;   // 0x2802
+inline constexpr Uuid declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;          // 0x2803
+inline constexpr Uuid cccd_uuid = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;           // 0x2902
+
+template <Uuid UUID> constexpr esp_gatts_attr_db_t attribute(uint16_t perm, Value v) {
+  return {{ESP_GATT_AUTO_RSP},
+          {UUID.length, uuid_pointer<UUID>(), perm, v.max_length, v.length, v.data}};
+}
+
+/// Only ever called (making the expression non-constant, i.e. a compile
+/// error) when a constexpr attribute lookup fails
+inline void attribute_not_found() {}
+
+/// Value of an include declaration (esp_gatts_incl_svc_desc_t), one per
+/// service which can be included
+struct alignas(uint16_t) IncludedServiceValue {
+  uint8_t bytes[sizeof(esp_gatts_incl_svc_desc_t)];
+
+  void set(uint16_t start_handle, uint16_t end_handle) {
+    esp_gatts_incl_svc_desc_t desc = {start_handle, end_handle, uint16_t(bytes[4] | bytes[5] << 8)};
+    std::copy_n(reinterpret_cast<const uint8_t *>(&desc), sizeof(desc), bytes);
+  }
+};
+
+template <const auto &SERVICE>
+inline IncludedServiceValue included_service{{0, 0, 0, 0, SERVICE.uuid.bytes[0], SERVICE.uuid.bytes[1]}};
+
+} // namespace detail
+
+/// Characteristic declaration + value, followed by its descriptors
+template <Uuid UUID, uint8_t PROPERTIES, size_t... Ns>
+constexpr Attributes<2 + (Ns + ... + 0)> characteristic(uint16_t perm, Value v,
+                                                         const Attributes<Ns> &...descriptors) {
+  Attributes<2> declaration;
+  declaration.attributes[0] = detail::attribute<detail::declaration_uuid>(
+      ESP_GATT_PERM_READ,
+      {const_cast<uint8_t *>(&detail::properties<PROPERTIES>), sizeof(uint8_t), sizeof(uint8_t)});
+  declaration.attributes[1] = detail::attribute<UUID>(perm, v);
+  return concat(declaration, descriptors...);
+}
+
+/// Characteristic descriptor
+template <Uuid UUID> constexpr Attributes<1> descriptor(uint16_t perm, Value v) {
+  return {{detail::attribute<UUID>(perm, v)}};
+}
+
+/// Client Characteristic Configuration descriptor, notifications and
+/// indications disabled unless a different default is given
+constexpr Attributes<1> cccd(uint16_t perm, Value v = value(detail::cccd_disabled)) {
+  return {{detail::attribute<detail::cccd_uuid>(perm, v)}};
+}
+
+/// Include declaration for another (16-bit UUID) service built with
+/// gatt::service(), which must be created before this one
+template <const auto &SERVICE> constexpr Attributes<1> include() {
+  static_assert(SERVICE.uuid.length == ESP_UUID_LEN_16, "only 16-bit UUID services can be included");
+  return {{detail::attribute<detail::include_service_uuid>(
+      ESP_GATT_PERM_READ, {detail::included_service<SERVICE>.bytes, sizeof(esp_gatts_incl_svc_desc_t),
+                           sizeof(esp_gatts_incl_svc_desc_t)})}};
+}
+
+/// The same characteristic, but with its value read and written by the
+/// application (ESP_GATTS_READ_EVT / ESP_GATTS_WRITE_EVT with need_rsp, answered
+/// with esp_ble_gatts_send_response) instead of from the stack's copy, e.g.
+/// for values computed when they are read
+template <size_t N> constexpr Attributes<N> app_response(Attributes<N> characteristic) {
+  static_assert(N >= 2, "only a characteristic (declaration and value) can be app responded");
+  characteristic.attributes[1].attr_control.auto_rsp = ESP_GATT_RSP_BY_APP;
+  return characteristic;
+}
+
+/// COUNT copies of the attributes make(i) returns, e.g. one HID Report
+/// characteristic per input report
+template <size_t COUNT, typename F> constexpr auto repeat(F make) {
+  return [&]<size_t... Is>(std::index_sequence<Is...>) {
+    return concat(make(Is)...);
+  }(std::make_index_sequence<COUNT>{});
+}
+
+/// A primary service and its attributes, in the order they were declared
+template <size_t N> struct Service {
+  Uuid uuid;
+  std::array<esp_gatts_attr_db_t, N> attributes{};
+
+  static constexpr size_t size() { return N; }
+
+  const esp_gatts_attr_db_t *data() const { return attributes.data(); }
+
+  /// Bytes of attribute value storage of the whole table
+  constexpr size_t value_bytes() const { return gatt::value_bytes(attributes.data(), N); }
+
+  /// Index of the n-th attribute with the given (attribute type) UUID
+  constexpr size_t index_of(Uuid type, size_t nth = 0) const {
+    for (size_t i = 0; i < N; i++) {
+      if (type.matches(attributes[i].att_desc.uuid_p, attributes[i].att_desc.uuid_length) &&
+          nth-- == 0) {
+        return i;
+      }
+    }
+    detail::attribute_not_found();
+    return N;
+  }
+
+  /// Index of the value of the n-th characteristic with the given UUID
+  constexpr size_t value_index(Uuid characteristic, size_t nth = 0) const {
+    for (size_t i = 1; i < N; i++) {
+      if (is_declaration(i - 1) &&
+          characteristic.matches(attributes[i].att_desc.uuid_p, attributes[i].att_desc.uuid_length) &&
+          nth-- == 0) {
+        return i;
+      }
+    }
+    detail::attribute_not_found();
+    return N;
+  }
+
+  /// Index of the declaration of the n-th characteristic with the given UUID
+  constexpr size_t declaration_index(Uuid characteristic, size_t nth = 0) const {
+    return value_index(characteristic, nth) - 1;
+  }
+
+  /// Index of a descriptor of the n-th characteristic with the given UUID
+  constexpr size_t descriptor_index(Uuid characteristic, Uuid descriptor, size_t nth = 0) const {
+    for (size_t i = value_index(characteristic, nth) + 1; i < N && !is_declaration(i); i++) {
+      if (descriptor.matches(attributes[i].att_desc.uuid_p, attributes[i].att_desc.uuid_length)) {
+        return i;
+      }
+    }
+    detail::attribute_not_found();
+    return N;
+  }
+
+protected:
+  constexpr bool is_declaration(size_t i) const {
+    return detail::declaration_uuid.matches(attributes[i].att_desc.uuid_p,
+                                            attributes[i].att_desc.uuid_length);
+  }
+};
+
+/// Primary service declaration followed by the given attributes
+template <Uuid UUID, size_t... Ns> constexpr Service<1 + (Ns + ... + 0)> service(const Attributes<Ns> &...parts) {
+  Attributes<1> declaration{
+      {detail::attribute<detail::primary_service_uuid>(ESP_GATT_PERM_READ, uuid_value<UUID>())}};
+  return {UUID, concat(declaration, parts...).attributes};
+}
+
+/// Handles assigned to a service's attributes by the stack
+template <const auto &SERVICE> class HandleTable {
+public:
+  static constexpr size_t size() { return SERVICE.size(); }
+
+  uint16_t operator[](size_t index) const { return handles_[index]; }
+
+  uint16_t start_handle() const { return handles_[0]; }
+  uint16_t end_handle() const { return handles_[0] + num_handles_ - 1; }
+  size_t num_handles() const { return num_handles_; }
+
+  /// Store the handles if the event is for (some or all of) this service's
+  /// table, and update the include declarations which refer to this service
+  bool update(const esp_ble_gatts_cb_param_t::gatts_add_attr_tab_evt_param &param) {
+    if (param.status != ESP_GATT_OK || param.num_handle == 0 || param.num_handle > size() ||
+        !SERVICE.uuid.matches(param.svc_uuid)) {
+      return false;
+    }
+    clear();
+    std::copy_n(param.handles, param.num_handle, handles_.begin());
+    num_handles_ = param.num_handle;
+    detail::included_service<SERVICE>.set(start_handle(), end_handle());
+    return true;
+  }
+
+  void clear() {
+    handles_.fill(0);
+    num_handles_ = 0;
+  }
+
+protected:
+  std::array<uint16_t, SERVICE.size()> handles_{};
+  size_t num_handles_{0};
+};
+
+} // namespace gatt
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// Binary bundle of device profiles (report maps, PnP IDs, DIS strings and
+// input report IDs / sizes) which is stored in its own data partition and used in
+// place through a memory mapping, so nothing is parsed or copied at boot.
+//
+// The format is shared by the firmware and the host-side packer / validator
+// (tools/pack_profile_bundle.cpp), so this header only depends on the C++
+// standard library.
+//
+// Layout (all integers little endian, everything 4-byte aligned):
+//
+//   BundleHeader
+//   ProfileRecord[num_profiles]
+//   data: names, strings and report descriptors, referenced by
+//         (offset from the start of the bundle, length)
+//
+// The CRC32 covers everything after the header, up to total_size.
+
+namespace hid::bundle {
+
+static constexpr uint32_t MAGIC = 0x50444948; ///< "HIDP"
+static constexpr uint16_t VERSION = 2;
+
+static constexpr size_t MAX_PROFILES = 16;
+static constexpr size_t MAX_INPUT_REPORTS = 4;
+static constexpr size_t MAX_NAME_LEN = 32;
+static constexpr size_t MAX_STRING_LEN = 100;     ///< largest DIS string capacity
+static constexpr size_t MAX_DESCRIPTOR_LEN = 512; ///< matches the HID report map attribute
+static constexpr size_t MAX_REPORT_LEN = 255;     ///< matches the HID report attribute
+
+struct BundleHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size;  ///< sizeof(BundleHeader)
+  uint16_t record_size;  ///< sizeof(ProfileRecord)
+  uint16_t num_profiles;
+  uint32_t total_size;   ///< header + records + data, in bytes
+  uint32_t crc32;        ///< of bytes [header_size, total_size)
+};
+static_assert(sizeof(BundleHeader) == 20);
+
+/// A string or byte array stored in the data section
+struct Blob {
+  uint32_t offset; ///< from the start of the bundle
+  uint32_t length;
+};
+static_assert(sizeof(Blob) == 8);
+
+struct ProfileRecord {
+  Blob name;
+  Blob report_descriptor;
+  Blob manufacturer_name; ///< may be empty, then the DIS value is left as is
+  Blob model_number;      ///< may be empty, then the DIS value is left as is
+  uint16_t vendor_id;
+  uint16_t product_id;
+  uint16_t product_version;
+  uint16_t appearance;
+  uint8_t num_input_reports;
+  uint8_t input_report_ids[MAX_INPUT_REPORTS];
+  uint8_t reserved[3];
+  uint16_t input_report_sizes[MAX_INPUT_REPORTS]; ///< bytes, excluding the report ID
+};
+static_assert(sizeof(ProfileRecord) == 56);
+
+enum class Error {
+  NONE,
+  TOO_SMALL,
+  BAD_MAGIC,
+  BAD_VERSION,
+  BAD_HEADER_SIZE,
+  BAD_RECORD_SIZE,
+  TOO_MANY_PROFILES,
+  BAD_TOTAL_SIZE,
+  BAD_CRC,
+  BAD_BLOB,
+  BAD_NAME,
+  BAD_STRING,
+  BAD_DESCRIPTOR,
+  BAD_INPUT_REPORTS,
+  DUPLICATE_NAME,
+};
+
+constexpr const char *error_string(Error error) {
+  switch (error) {
+  case Error::NONE: return "ok";
+  case Error::TOO_SMALL: return "bundle is smaller than its header";
+  case Error::BAD_MAGIC: return "bad magic";
+  case Error::BAD_VERSION: return "unsupported version";
+  case Error::BAD_HEADER_SIZE: return "bad header size";
+  case Error::BAD_RECORD_SIZE: return "bad profile record size";
+  case Error::TOO_MANY_PROFILES: return "no profiles, or too many profiles";
+  case Error::BAD_TOTAL_SIZE: return "total size does not fit the records / partition";
+  case Error::BAD_CRC: return "CRC mismatch";
+  case Error::BAD_BLOB: return "data reference out of bounds";
+  case Error::BAD_NAME: return "profile name is empty or too long";
+  case Error::BAD_STRING: return "DIS string is too long";
+  case Error::BAD_DESCRIPTOR: return "report descriptor is empty or too long";
+  case Error::BAD_INPUT_REPORTS: return "no input reports, too many, or a bad report size";
+  case Error::DUPLICATE_NAME: return "duplicate profile name";
+  }
+  return "unknown error";
+}
+
+/// CRC-32 (IEEE 802.3, reflected, as used by zlib / esp_rom_crc32_le)
+constexpr uint32_t crc32(std::span<const uint8_t> data, uint32_t crc = 0) {
+  crc = ~crc;
+  for (auto byte : data) {
+    crc ^= byte;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+/// A validated bundle, which refers to (does not copy) the underlying bytes
+class Bundle {
+public:
+  /// Check the header, CRC and every record of the bundle. The data must be
+  /// 4-byte aligned and outlive the bundle.
+  Error open(std::span<const uint8_t> data) {
+    data_ = {};
+    if (data.size() < sizeof(BundleHeader)) {
+      return Error::TOO_SMALL;
+    }
+    auto h = reinterpret_cast<const BundleHeader *>(data.data());
+    if (h->magic != MAGIC) {
+      return Error::BAD_MAGIC;
+    }
+    if (h->version != VERSION) {
+      return Error::BAD_VERSION;
+    }
+    if (h->header_size != sizeof(BundleHeader)) {
+      return Error::BAD_HEADER_SIZE;
+    }
+    if (h->record_size != sizeof(ProfileRecord)) {
+      return Error::BAD_RECORD_SIZE;
+    }
+    if (h->num_profiles == 0 || h->num_profiles > MAX_PROFILES) {
+      return Error::TOO_MANY_PROFILES;
+    }
+    size_t records_end = sizeof(BundleHeader) + h->num_profiles * sizeof(ProfileRecord);
+    if (h->total_size < records_end || h->total_size > data.size()) {
+      return Error::BAD_TOTAL_SIZE;
+    }
+    if (crc32(data.subspan(sizeof(BundleHeader), h->total_size - sizeof(BundleHeader))) != h->crc32) {
+      return Error::BAD_CRC;
+    }
+    data_ = data.first(h->total_size);
+    for (size_t i = 0; i < h->num_profiles; i++) {
+      auto error = check_record(i, records_end);
+      if (error != Error::NONE) {
+        data_ = {};
+        return error;
+      }
+    }
+    return Error::NONE;
+  }
+
+  bool valid() const { return !data_.empty(); }
+
+  const BundleHeader &header() const { return *reinterpret_cast<const BundleHeader *>(data_.data()); }
+
+  size_t num_profiles() const { return valid() ? header().num_profiles : 0; }
+
+  const ProfileRecord &record(size_t index) const {
+    return reinterpret_cast<const ProfileRecord *>(data_.data() + sizeof(BundleHeader))[index];
+  }
+
+  std::span<const uint8_t> bytes(const Blob &blob) const { return data_.subspan(blob.offset, blob.length); }
+
+  std::string_view string(const Blob &blob) const {
+    auto b = bytes(blob);
+    return std::string_view(reinterpret_cast<const char *>(b.data()), b.size());
+  }
+
+protected:
+  Error check_record(size_t index, size_t data_start) const {
+    auto in_data = [&](const Blob &blob) {
+      return blob.length == 0 ||
+             (blob.offset >= data_start && blob.offset <= data_.size() &&
+              blob.length <= data_.size() - blob.offset);
+    };
+    const auto &r = record(index);
+    if (!in_data(r.name) || !in_data(r.report_descriptor) || !in_data(r.manufacturer_name) ||
+        !in_data(r.model_number)) {
+      return Error::BAD_BLOB;
+    }
+    if (r.name.length == 0 || r.name.length > MAX_NAME_LEN) {
+      return Error::BAD_NAME;
+    }
+    if (r.manufacturer_name.length > MAX_STRING_LEN || r.model_number.length > MAX_STRING_LEN) {
+      return Error::BAD_STRING;
+    }
+    if (r.report_descriptor.length == 0 || r.report_descriptor.length > MAX_DESCRIPTOR_LEN) {
+      return Error::BAD_DESCRIPTOR;
+    }
+    if (r.num_input_reports == 0 || r.num_input_reports > MAX_INPUT_REPORTS) {
+      return Error::BAD_INPUT_REPORTS;
+    }
+    for (size_t i = 0; i < r.num_input_reports; i++) {
+      if (r.input_report_sizes[i] == 0 || r.input_report_sizes[i] > MAX_REPORT_LEN) {
+        return Error::BAD_INPUT_REPORTS;
+      }
+    }
+    for (size_t i = 0; i < index; i++) {
+      if (string(record(i).name) == string(r.name)) {
+        return Error::DUPLICATE_NAME;
+      }
+    }
+    return Error::NONE;
+  }
+
+  std::span<const uint8_t> data_;
+};
+
+} // namespace hid::bundle
@@ -0,0 +1,370 @@
+// Host-side device profile bundle packer / validator.
+//
+// Build (from the repository root):
+//   g++ -std=c++20 -I components/hid_profile_bundle/include
+//       -I components/hid_report_descriptor/include
+//       components/hid_profile_bundle/tools/pack_profile_bundle.cpp
+//       -o pack_profile_bundle
+//
+// Usage:
+//   pack_profile_bundle [--no-minimize] [--partition-size bytes] -o profiles.bin manifest
+//   pack_profile_bundle --validate [--partition-size bytes] profiles.bin
+//
+// The manifest is a text file with one [profile] section per profile:
+//
+//   [profile]
+//   name = mouse
+//   vendor_id = 0x303A
+//   product_id = 0x8102
+//   product_version = 0x0100
+//   appearance = 0x03C2
+//   manufacturer = Espressif
+//   model = 8102
+//   descriptor = 05 01 09 02 a1 01 ...    (hex, may be repeated to append)
+//   descriptor_file = mouse.bin           (.bin is raw, anything else hex text)
+//
+// Report descriptors are minimized (see hid_report_descriptor.hpp) unless
+// --no-minimize is given, and the input report IDs and sizes are derived from
+// them.
+// Relative descriptor_file paths are relative to the manifest.
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hid_profile_bundle.hpp"
+#include "hid_report_descriptor.hpp"
+
+using namespace hid;
+
+struct ManifestProfile {
+  std::string name;
+  uint16_t vendor_id{0};
+  uint16_t product_id{0};
+  uint16_t product_version{0x0100};
+  uint16_t appearance{0x03C0}; // generic HID
+  std::string manufacturer;
+  std::string model;
+  std::vector<uint8_t> descriptor;
+  int line{0};
+};
+
+[[noreturn]] static void fail(const std::string &message) {
+  std::cerr << "error: " << message << "\n";
+  std::exit(1);
+}
+
+static std::string trim(const std::string &s) {
+  auto begin = s.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  auto end = s.find_last_not_of(" \t\r\n");
+  return s.substr(begin, end - begin + 1);
+}
+
+static std::string read_file(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    fail("could not open '" + path + "'");
+  }
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static std::vector<uint8_t> parse_hex_text(const std::string &text) {
+  // split on anything which can't be part of a hex byte
+  std::string cleaned;
+  for (char c : text) {
+    cleaned += std::isxdigit(static_cast<unsigned char>(c)) || c == 'x' || c == 'X' ? c : ' ';
+  }
+  std::vector<uint8_t> bytes;
+  std::string token;
+  std::istringstream stream(cleaned);
+  while (stream >> token) {
+    if (token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X')) {
+      token = token.substr(2);
+    }
+    if (token.empty() || token.size() > 2) {
+      fail("invalid byte '" + token + "'");
+    }
+    bytes.push_back(static_cast<uint8_t>(std::strtoul(token.c_str(), nullptr, 16)));
+  }
+  return bytes;
+}
+
+static uint16_t parse_u16(const std::string &value, int line) {
+  char *end = nullptr;
+  unsigned long v = std::strtoul(value.c_str(), &end, 0);
+  if (value.empty() || *end != '\0' || v > 0xFFFF) {
+    fail("line " + std::to_string(line) + ": invalid 16-bit value '" + value + "'");
+  }
+  return static_cast<uint16_t>(v);
+}
+
+static std::vector<ManifestProfile> parse_manifest(const std::string &path) {
+  std::string dir;
+  auto slash = path.find_last_of('/');
+  if (slash != std::string::npos) {
+    dir = path.substr(0, slash + 1);
+  }
+  std::vector<ManifestProfile> profiles;
+  std::istringstream stream(read_file(path));
+  std::string raw;
+  int line = 0;
+  while (std::getline(stream, raw)) {
+    line++;
+    auto text = trim(raw.substr(0, raw.find('#')));
+    if (text.empty()) {
+      continue;
+    }
+    if (text == "[profile]") {
+      profiles.push_back({});
+      profiles.back().line = line;
+      continue;
+    }
+    auto eq = text.find('=');
+    if (eq == std::string::npos || profiles.empty()) {
+      fail("line " + std::to_string(line) + ": expected '[profile]' or 'key = value'");
+    }
+    auto key = trim(text.substr(0, eq));
+    auto value = trim(text.substr(eq + 1));
+    auto &p = profiles.back();
+    if (key == "name") {
+      p.name = value;
+    } else if (key == "vendor_id") {
+      p.vendor_id = parse_u16(value, line);
+    } else if (key == "product_id") {
+      p.product_id = parse_u16(value, line);
+    } else if (key == "product_version") {
+      p.product_version = parse_u16(value, line);
+    } else if (key == "appearance") {
+      p.appearance = parse_u16(value, line);
+    } else if (key == "manufacturer") {
+      p.manufacturer = value;
+    } else if (key == "model") {
+      p.model = value;
+    } else if (key == "descriptor") {
+      auto bytes = parse_hex_text(value);
+      p.descriptor.insert(p.descriptor.end(), bytes.begin(), bytes.end());
+    } else if (key == "descriptor_file") {
+      auto file_path = value[0] == '/' ? value : dir + value;
+      auto contents = read_file(file_path);
+      auto bytes = file_path.ends_with(".bin") ? std::vector<uint8_t>(contents.begin(), contents.end())
+                                               : parse_hex_text(contents);
+      p.descriptor.insert(p.descriptor.end(), bytes.begin(), bytes.end());
+    } else {
+      fail("line " + std::to_string(line) + ": unknown key '" + key + "'");
+    }
+  }
+  return profiles;
+}
+
+/// Checks which need the descriptor parser, so the firmware doesn't do them
+static bool check_descriptor(const std::string &name, std::span<const uint8_t> descriptor,
+                             std::span<const uint8_t> input_report_ids,
+                             std::span<const uint16_t> input_report_sizes) {
+  auto layout = descriptor::parse_layout(descriptor);
+  if (!layout.valid) {
+    std::cerr << "profile '" << name << "': report descriptor could not be parsed\n";
+    return false;
+  }
+  auto ids = descriptor::report_ids<descriptor::MAX_REPORTS>(descriptor);
+  if (ids.count != input_report_ids.size() ||
+      !std::equal(input_report_ids.begin(), input_report_ids.end(), ids.ids.begin())) {
+    std::cerr << "profile '" << name << "': input report IDs do not match the report descriptor\n";
+    return false;
+  }
+  if (!std::equal(input_report_sizes.begin(), input_report_sizes.end(), ids.bytes.begin())) {
+    std::cerr << "profile '" << name << "': input report sizes do not match the report descriptor\n";
+    return false;
+  }
+  return true;
+}
+
+static void print_bundle(const bundle::Bundle &b) {
+  std::printf("%zu profiles, %u bytes, crc32 %08x\n", b.num_profiles(), b.header().total_size,
+              b.header().crc32);
+  for (size_t i = 0; i < b.num_profiles(); i++) {
+    const auto &r = b.record(i);
+    auto name = b.string(r.name);
+    std::printf("  %-24.*s vid %04x pid %04x ver %04x appearance %04x, %3u byte report map, "
+                "input reports",
+                static_cast<int>(name.size()), name.data(), r.vendor_id, r.product_id,
+                r.product_version, r.appearance, r.report_descriptor.length);
+    for (size_t j = 0; j < r.num_input_reports; j++) {
+      std::printf(" %u (%u bytes)", r.input_report_ids[j], r.input_report_sizes[j]);
+    }
+    std::printf("\n");
+  }
+}
+
+static int validate(const std::string &path, size_t partition_size) {
+  auto contents = read_file(path);
+  if (partition_size && contents.size() > partition_size) {
+    fail("bundle is " + std::to_string(contents.size()) + " bytes, partition is only " +
+         std::to_string(partition_size));
+  }
+  // copy into aligned storage, as the firmware sees it through the mmap
+  std::vector<uint32_t> storage((contents.size() + 3) / 4);
+  std::memcpy(storage.data(), contents.data(), contents.size());
+  bundle::Bundle b;
+  auto error = b.open({reinterpret_cast<const uint8_t *>(storage.data()), contents.size()});
+  if (error != bundle::Error::NONE) {
+    fail(std::string("invalid bundle: ") + bundle::error_string(error));
+  }
+  bool ok = true;
+  for (size_t i = 0; i < b.num_profiles(); i++) {
+    const auto &r = b.record(i);
+    ok &= check_descriptor(std::string(b.string(r.name)), b.bytes(r.report_descriptor),
+                           {r.input_report_ids, r.num_input_reports},
+                           {r.input_report_sizes, r.num_input_reports});
+  }
+  print_bundle(b);
+  std::printf("%s\n", ok ? "bundle is valid" : "bundle is INVALID");
+  return ok ? 0 : 1;
+}
+
+class Packer {
+public:
+  uint32_t add(std::span<const uint8_t> bytes) {
+    uint32_t offset = data_.size();
+    data_.insert(data_.end(), bytes.begin(), bytes.end());
+    data_.resize((data_.size() + 3) & ~size_t(3));
+    return offset;
+  }
+
+  bundle::Blob add(const std::string &s) {
+    if (s.empty()) {
+      return {0, 0};
+    }
+    return {base_ + add({reinterpret_cast<const uint8_t *>(s.data()), s.size()}),
+            static_cast<uint32_t>(s.size())};
+  }
+
+  bundle::Blob add_bytes(std::span<const uint8_t> bytes) {
+    return {base_ + add(bytes), static_cast<uint32_t>(bytes.size())};
+  }
+
+  void set_base(uint32_t base) { base_ = base; }
+  const std::vector<uint8_t> &data() const { return data_; }
+
+protected:
+  uint32_t base_{0};
+  std::vector<uint8_t> data_;
+};
+
+static int pack(const std::string &manifest_path, const std::string &output_path, bool minimize,
+                size_t partition_size) {
+  auto profiles = parse_manifest(manifest_path);
+  if (profiles.empty() || profiles.size() > bundle::MAX_PROFILES) {
+    fail("manifest must have between 1 and " + std::to_string(bundle::MAX_PROFILES) + " profiles");
+  }
+
+  std::vector<bundle::ProfileRecord> records(profiles.size());
+  Packer packer;
+  packer.set_base(sizeof(bundle::BundleHeader) + records.size() * sizeof(bundle::ProfileRecord));
+  for (size_t i = 0; i < profiles.size(); i++) {
+    auto &p = profiles[i];
+    auto where = "profile '" + p.name + "' (line " + std::to_string(p.line) + ")";
+    if (p.descriptor.empty()) {
+      fail(where + ": no report descriptor");
+    }
+    auto layout = descriptor::parse_layout(p.descriptor);
+    if (!layout.valid) {
+      fail(where + ": report descriptor could not be parsed");
+    }
+    std::vector<uint8_t> descriptor = p.descriptor;
+    if (minimize) {
+      std::vector<uint8_t> minimized(p.descriptor.size());
+      minimized.resize(descriptor::minimize(p.descriptor, minimized));
+      if (!descriptor::same_layout(p.descriptor, minimized)) {
+        fail(where + ": layout mismatch after minimization");
+      }
+      descriptor = minimized;
+    }
+    auto ids = descriptor::report_ids<descriptor::MAX_REPORTS>(descriptor);
+    if (ids.count == 0 || ids.count > bundle::MAX_INPUT_REPORTS) {
+      fail(where + ": report descriptor has " + std::to_string(ids.count) +
+           " input reports, between 1 and " + std::to_string(bundle::MAX_INPUT_REPORTS) +
+           " are supported");
+    }
+
+    auto &r = records[i];
+    r.name = packer.add(p.name);
+    r.report_descriptor = packer.add_bytes(descriptor);
+    r.manufacturer_name = packer.add(p.manufacturer);
+    r.model_number = packer.add(p.model);
+    r.vendor_id = p.vendor_id;
+    r.product_id = p.product_id;
+    r.product_version = p.product_version;
+    r.appearance = p.appearance;
+    r.num_input_reports = ids.count;
+    std::copy(ids.ids.begin(), ids.ids.begin() + ids.count, r.input_report_ids);
+    std::copy(ids.bytes.begin(), ids.bytes.begin() + ids.count, r.input_report_sizes);
+    std::printf("%s: %zu -> %zu byte report map\n", p.name.c_str(), p.descriptor.size(),
+                descriptor.size());
+  }
+
+  std::vector<uint8_t> body(records.size() * sizeof(bundle::ProfileRecord));
+  std::memcpy(body.data(), records.data(), body.size());
+  body.insert(body.end(), packer.data().begin(), packer.data().end());
+
+  bundle::BundleHeader header{};
+  header.magic = bundle::MAGIC;
+  header.version = bundle::VERSION;
+  header.header_size = sizeof(bundle::BundleHeader);
+  header.record_size = sizeof(bundle::ProfileRecord);
+  header.num_profiles = records.size();
+  header.total_size = sizeof(header) + body.size();
+  header.crc32 = bundle::crc32(body);
+
+  std::ofstream file(output_path, std::ios::binary);
+  if (!file) {
+    fail("could not open '" + output_path + "'");
+  }
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(body.data()), body.size());
+  file.close();
+
+  // check what was written the same way the firmware will
+  return validate(output_path, partition_size);
+}
+
+int main(int argc, char **argv) {
+  bool do_validate = false;
+  bool minimize = true;
+  size_t partition_size = 0;
+  std::string input_path;
+  std::string output_path;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--validate") == 0) {
+      do_validate = true;
+    } else if (std::strcmp(argv[i], "--no-minimize") == 0) {
+      minimize = false;
+    } else if (std::strcmp(argv[i], "--partition-size") == 0 && i + 1 < argc) {
+      partition_size = std::strtoul(argv[++i], nullptr, 0);
+    } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output_path = argv[++i];
+    } else if (argv[i][0] == '-') {
+      input_path.clear();
+      break;
+    } else {
+      input_path = argv[i];
+    }
+  }
+  if (input_path.empty() || (!do_validate && output_path.empty())) {
+    std::cerr << "usage: " << argv[0]
+              << " [--no-minimize] [--partition-size bytes] -o profiles.bin manifest\n"
+              << "       " << argv[0] << " --validate [--partition-size bytes] profiles.bin\n";
+    return 1;
+  }
+  return do_validate ? validate(input_path, partition_size)
+                     : pack(input_path, output_path, minimize, partition_size);
+}
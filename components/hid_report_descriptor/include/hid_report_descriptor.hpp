@@ -0,0 +1,695 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// HID report descriptor tools which can be evaluated at compile time (in
+// constexpr / static_assert) or used at runtime from host-side tools:
+//
+// - an item parser for short items
+// - a report layout extractor (fields, bit offsets, usages, per-report sizes)
+// - a minimizer which removes redundant global items, picks the shortest item
+//   encoding and merges adjacent padding, and which only returns the smaller
+//   descriptor if its parsed layout is identical to the original.
+//
+// see: https://www.usb.org/sites/default/files/hid1_11.pdf (section 6.2.2)
+
+namespace hid::descriptor {
+
+/// Short item type (bType)
+enum class ItemType : uint8_t {
+  MAIN = 0,
+  GLOBAL = 1,
+  LOCAL = 2,
+  RESERVED = 3,
+};
+
+// main item tags
+static constexpr uint8_t TAG_INPUT = 0x8;
+static constexpr uint8_t TAG_OUTPUT = 0x9;
+static constexpr uint8_t TAG_COLLECTION = 0xA;
+static constexpr uint8_t TAG_FEATURE = 0xB;
+static constexpr uint8_t TAG_END_COLLECTION = 0xC;
+
+// global item tags
+static constexpr uint8_t TAG_USAGE_PAGE = 0x0;
+static constexpr uint8_t TAG_LOGICAL_MINIMUM = 0x1;
+static constexpr uint8_t TAG_LOGICAL_MAXIMUM = 0x2;
+static constexpr uint8_t TAG_PHYSICAL_MINIMUM = 0x3;
+static constexpr uint8_t TAG_PHYSICAL_MAXIMUM = 0x4;
+static constexpr uint8_t TAG_UNIT_EXPONENT = 0x5;
+static constexpr uint8_t TAG_UNIT = 0x6;
+static constexpr uint8_t TAG_REPORT_SIZE = 0x7;
+static constexpr uint8_t TAG_REPORT_ID = 0x8;
+static constexpr uint8_t TAG_REPORT_COUNT = 0x9;
+static constexpr uint8_t TAG_PUSH = 0xA;
+static constexpr uint8_t TAG_POP = 0xB;
+static constexpr uint8_t NUM_GLOBALS = 10; ///< globals tracked in GlobalState
+
+// local item tags
+static constexpr uint8_t TAG_USAGE = 0x0;
+static constexpr uint8_t TAG_USAGE_MINIMUM = 0x1;
+static constexpr uint8_t TAG_USAGE_MAXIMUM = 0x2;
+
+static constexpr uint8_t LONG_ITEM_PREFIX = 0xFE;
+static constexpr uint32_t FLAG_CONSTANT = (1 << 0); ///< Input/Output/Feature data bit 0
+
+static constexpr size_t MAX_LAYOUT_ENTRIES = 64; ///< main items per descriptor
+static constexpr size_t MAX_FIELD_USAGES = 16;   ///< usages per main item
+static constexpr size_t MAX_LOCAL_ITEMS = 24;    ///< local items per main item
+static constexpr size_t MAX_REPORTS = 16;        ///< distinct (type, report id) pairs
+
+/// A parsed short item
+struct Item {
+  uint8_t tag{0};
+  ItemType type{ItemType::MAIN};
+  uint8_t data_size{0}; ///< 0, 1, 2, or 4 bytes
+  uint32_t data{0};     ///< little endian data, zero extended
+  size_t length{0};     ///< prefix + data bytes
+
+  constexpr int32_t signed_data() const {
+    switch (data_size) {
+    case 1:
+      return static_cast<int8_t>(data);
+    case 2:
+      return static_cast<int16_t>(data);
+    default:
+      return static_cast<int32_t>(data);
+    }
+  }
+};
+
+/// Parse the short item at offset. Returns false for long items and for
+/// truncated data.
+constexpr bool parse_item(std::span<const uint8_t> bytes, size_t offset, Item &item) {
+  if (offset >= bytes.size() || bytes[offset] == LONG_ITEM_PREFIX) {
+    return false;
+  }
+  uint8_t prefix = bytes[offset];
+  uint8_t size_code = prefix & 0x03;
+  uint8_t data_size = size_code == 3 ? 4 : size_code;
+  if (offset + 1 + data_size > bytes.size()) {
+    return false;
+  }
+  uint32_t data = 0;
+  for (size_t i = 0; i < data_size; i++) {
+    data |= static_cast<uint32_t>(bytes[offset + 1 + i]) << (8 * i);
+  }
+  item.tag = prefix >> 4;
+  item.type = static_cast<ItemType>((prefix >> 2) & 0x03);
+  item.data_size = data_size;
+  item.data = data;
+  item.length = 1 + data_size;
+  return true;
+}
+
+/// Global item state in effect for a main item
+struct GlobalState {
+  uint32_t usage_page{0};
+  int32_t logical_minimum{0};
+  int32_t logical_maximum{0};
+  int32_t physical_minimum{0};
+  int32_t physical_maximum{0};
+  uint32_t unit_exponent{0};
+  uint32_t unit{0};
+  uint32_t report_size{0};
+  uint32_t report_id{0};
+  uint32_t report_count{0};
+
+  constexpr bool operator==(const GlobalState &) const = default;
+
+  /// Store the value of a global item, returns false for push / pop and
+  /// reserved tags.
+  constexpr bool set(const Item &item) {
+    switch (item.tag) {
+    case TAG_USAGE_PAGE: usage_page = item.data; return true;
+    case TAG_LOGICAL_MINIMUM: logical_minimum = item.signed_data(); return true;
+    case TAG_LOGICAL_MAXIMUM: logical_maximum = item.signed_data(); return true;
+    case TAG_PHYSICAL_MINIMUM: physical_minimum = item.signed_data(); return true;
+    case TAG_PHYSICAL_MAXIMUM: physical_maximum = item.signed_data(); return true;
+    case TAG_UNIT_EXPONENT: unit_exponent = item.data; return true;
+    case TAG_UNIT: unit = item.data; return true;
+    case TAG_REPORT_SIZE: report_size = item.data; return true;
+    case TAG_REPORT_ID: report_id = item.data; return true;
+    case TAG_REPORT_COUNT: report_count = item.data; return true;
+    default: return false;
+    }
+  }
+
+  /// Raw (two's complement for the signed items) value of a global by tag
+  constexpr uint32_t get(uint8_t tag) const {
+    switch (tag) {
+    case TAG_USAGE_PAGE: return usage_page;
+    case TAG_LOGICAL_MINIMUM: return static_cast<uint32_t>(logical_minimum);
+    case TAG_LOGICAL_MAXIMUM: return static_cast<uint32_t>(logical_maximum);
+    case TAG_PHYSICAL_MINIMUM: return static_cast<uint32_t>(physical_minimum);
+    case TAG_PHYSICAL_MAXIMUM: return static_cast<uint32_t>(physical_maximum);
+    case TAG_UNIT_EXPONENT: return unit_exponent;
+    case TAG_UNIT: return unit;
+    case TAG_REPORT_SIZE: return report_size;
+    case TAG_REPORT_ID: return report_id;
+    case TAG_REPORT_COUNT: return report_count;
+    default: return 0;
+    }
+  }
+
+  static constexpr bool is_signed(uint8_t tag) {
+    return tag >= TAG_LOGICAL_MINIMUM && tag <= TAG_PHYSICAL_MAXIMUM;
+  }
+};
+
+/// Kind of main item in a layout
+enum class EntryKind : uint8_t {
+  INPUT,
+  OUTPUT,
+  FEATURE,
+  COLLECTION,
+  END_COLLECTION,
+};
+
+/// One main item of the descriptor, with everything a host parser would
+/// derive from it
+struct LayoutEntry {
+  EntryKind kind{EntryKind::INPUT};
+  uint32_t flags{0};      ///< input/output/feature flags or collection type
+  uint8_t report_id{0};
+  uint32_t bit_offset{0}; ///< offset within the report (excluding report id)
+  uint32_t bit_size{0};   ///< report size * report count
+  GlobalState globals{};
+  std::array<uint32_t, MAX_FIELD_USAGES> usages{}; ///< extended (page << 16 | id)
+  size_t num_usages{0};
+  uint32_t usage_minimum{0};
+  uint32_t usage_maximum{0};
+
+  constexpr bool is_field() const {
+    return kind == EntryKind::INPUT || kind == EntryKind::OUTPUT || kind == EntryKind::FEATURE;
+  }
+
+  constexpr bool is_padding() const { return is_field() && (flags & FLAG_CONSTANT); }
+
+  /// True if a host would interpret both entries identically. Padding only
+  /// has a position and a size, its logical range / usages are meaningless,
+  /// and collections do not belong to a report.
+  constexpr bool equivalent(const LayoutEntry &other) const {
+    if (kind != other.kind) {
+      return false;
+    }
+    if (kind == EntryKind::END_COLLECTION) {
+      return true;
+    }
+    if (is_field()) {
+      if (report_id != other.report_id || is_padding() != other.is_padding() ||
+          bit_offset != other.bit_offset || bit_size != other.bit_size) {
+        return false;
+      }
+      if (is_padding()) {
+        return true;
+      }
+      if (globals.logical_minimum != other.globals.logical_minimum ||
+          globals.logical_maximum != other.globals.logical_maximum ||
+          globals.physical_minimum != other.globals.physical_minimum ||
+          globals.physical_maximum != other.globals.physical_maximum ||
+          globals.unit_exponent != other.globals.unit_exponent ||
+          globals.unit != other.globals.unit ||
+          globals.report_size != other.globals.report_size ||
+          globals.report_count != other.globals.report_count) {
+        return false;
+      }
+    }
+    if (flags != other.flags || num_usages != other.num_usages ||
+        usage_minimum != other.usage_minimum || usage_maximum != other.usage_maximum) {
+      return false;
+    }
+    for (size_t i = 0; i < num_usages; i++) {
+      if (usages[i] != other.usages[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/// The parsed layout of every report in a descriptor
+struct Layout {
+  std::array<LayoutEntry, MAX_LAYOUT_ENTRIES> entries{};
+  size_t num_entries{0};
+  bool valid{false};
+
+  /// Size in bits of the report of the given kind and id
+  constexpr uint32_t report_bits(EntryKind kind, uint8_t report_id) const {
+    uint32_t bits = 0;
+    for (size_t i = 0; i < num_entries; i++) {
+      if (entries[i].kind == kind && entries[i].report_id == report_id) {
+        bits += entries[i].bit_size;
+      }
+    }
+    return bits;
+  }
+
+  /// Size in bytes of the report value (which does not include the report id)
+  constexpr size_t report_bytes(EntryKind kind, uint8_t report_id) const {
+    return (report_bits(kind, report_id) + 7) / 8;
+  }
+
+  /// Size in bytes of the largest report of the given kind
+  constexpr size_t max_report_bytes(EntryKind kind) const {
+    size_t max_bytes = 0;
+    for (size_t i = 0; i < num_entries; i++) {
+      if (entries[i].kind == kind) {
+        size_t bytes = report_bytes(kind, entries[i].report_id);
+        max_bytes = bytes > max_bytes ? bytes : max_bytes;
+      }
+    }
+    return max_bytes;
+  }
+
+  /// Merge adjacent padding of the same report, since a host cannot tell the
+  /// difference between one 8 bit pad and two 4 bit pads.
+  constexpr void merge_padding() {
+    size_t out = 0;
+    for (size_t i = 0; i < num_entries; i++) {
+      if (out > 0 && entries[i].is_padding() && entries[out - 1].is_padding() &&
+          entries[i].kind == entries[out - 1].kind &&
+          entries[i].report_id == entries[out - 1].report_id) {
+        entries[out - 1].bit_size += entries[i].bit_size;
+        continue;
+      }
+      entries[out++] = entries[i];
+    }
+    num_entries = out;
+  }
+
+  constexpr bool equivalent(const Layout &other) const {
+    if (!valid || !other.valid || num_entries != other.num_entries) {
+      return false;
+    }
+    for (size_t i = 0; i < num_entries; i++) {
+      if (!entries[i].equivalent(other.entries[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/// Resolve a usage / usage min / usage max local item into an extended usage
+constexpr uint32_t extended_usage(const Item &item, uint32_t usage_page) {
+  return item.data_size == 4 ? item.data : ((usage_page << 16) | item.data);
+}
+
+/// Parse the layout of a descriptor. The returned layout is not valid if the
+/// descriptor uses items this parser does not model (long items, push / pop,
+/// a usage page change between a usage and its main item) or exceeds the
+/// fixed capacities above.
+constexpr Layout parse_layout(std::span<const uint8_t> bytes) {
+  Layout layout;
+  GlobalState globals;
+  LayoutEntry pending; // locals collected for the next main item
+  bool have_locals = false;
+  struct ReportOffset {
+    EntryKind kind;
+    uint32_t report_id;
+    uint32_t bits;
+  };
+  std::array<ReportOffset, MAX_REPORTS> offsets{};
+  size_t num_offsets = 0;
+
+  size_t offset = 0;
+  while (offset < bytes.size()) {
+    Item item;
+    if (!parse_item(bytes, offset, item)) {
+      return layout;
+    }
+    offset += item.length;
+    switch (item.type) {
+    case ItemType::GLOBAL:
+      // the usage page of a pending usage is ambiguous (hosts disagree on
+      // whether it is resolved at the usage or at the main item)
+      if (item.tag == TAG_USAGE_PAGE && have_locals) {
+        return layout;
+      }
+      if (!globals.set(item) || globals.report_id > 0xFF) {
+        return layout;
+      }
+      break;
+    case ItemType::LOCAL:
+      have_locals = true;
+      if (item.tag == TAG_USAGE) {
+        if (pending.num_usages >= MAX_FIELD_USAGES) {
+          return layout;
+        }
+        pending.usages[pending.num_usages++] = extended_usage(item, globals.usage_page);
+      } else if (item.tag == TAG_USAGE_MINIMUM) {
+        pending.usage_minimum = extended_usage(item, globals.usage_page);
+      } else if (item.tag == TAG_USAGE_MAXIMUM) {
+        pending.usage_maximum = extended_usage(item, globals.usage_page);
+      }
+      break;
+    case ItemType::MAIN: {
+      if (layout.num_entries >= MAX_LAYOUT_ENTRIES) {
+        return layout;
+      }
+      LayoutEntry entry = pending;
+      entry.flags = item.data;
+      entry.report_id = static_cast<uint8_t>(globals.report_id);
+      entry.globals = globals;
+      switch (item.tag) {
+      case TAG_INPUT: entry.kind = EntryKind::INPUT; break;
+      case TAG_OUTPUT: entry.kind = EntryKind::OUTPUT; break;
+      case TAG_FEATURE: entry.kind = EntryKind::FEATURE; break;
+      case TAG_COLLECTION: entry.kind = EntryKind::COLLECTION; break;
+      case TAG_END_COLLECTION: entry.kind = EntryKind::END_COLLECTION; break;
+      default: return layout;
+      }
+      if (entry.is_field()) {
+        size_t index = 0;
+        while (index < num_offsets && !(offsets[index].kind == entry.kind &&
+                                        offsets[index].report_id == globals.report_id)) {
+          index++;
+        }
+        if (index == num_offsets) {
+          if (num_offsets >= MAX_REPORTS) {
+            return layout;
+          }
+          offsets[num_offsets++] = {entry.kind, globals.report_id, 0};
+        }
+        entry.bit_offset = offsets[index].bits;
+        entry.bit_size = globals.report_size * globals.report_count;
+        offsets[index].bits += entry.bit_size;
+      }
+      layout.entries[layout.num_entries++] = entry;
+      pending = LayoutEntry{};
+      have_locals = false;
+      break;
+    }
+    default:
+      return layout;
+    }
+  }
+  layout.merge_padding();
+  layout.valid = true;
+  return layout;
+}
+
+/// Report IDs of one kind of report, in the order they first appear
+template <size_t MAX_IDS> struct ReportIds {
+  std::array<uint8_t, MAX_IDS> ids{};
+  std::array<uint16_t, MAX_IDS> bytes{}; ///< size of each report, excluding the report id
+  size_t count{0};
+};
+
+/// Collect the IDs and sizes of every report of the given kind (e.g. to
+/// create one exactly sized HID Report characteristic per input report)
+template <size_t MAX_IDS>
+constexpr ReportIds<MAX_IDS> report_ids(std::span<const uint8_t> bytes,
+                                        EntryKind kind = EntryKind::INPUT) {
+  ReportIds<MAX_IDS> result;
+  auto layout = parse_layout(bytes);
+  for (size_t i = 0; i < layout.num_entries; i++) {
+    const auto &entry = layout.entries[i];
+    if (entry.kind != kind) {
+      continue;
+    }
+    bool seen = false;
+    for (size_t j = 0; j < result.count; j++) {
+      seen = seen || result.ids[j] == entry.report_id;
+    }
+    if (!seen && result.count < MAX_IDS) {
+      result.ids[result.count] = entry.report_id;
+      result.bytes[result.count] = layout.report_bytes(kind, entry.report_id);
+      result.count++;
+    }
+  }
+  return result;
+}
+
+/// The ID of the first report of the given kind with a field of the given
+/// extended usage (page << 16 | id), e.g. the battery strength input report,
+/// or -1 if there is none
+constexpr int report_id_of(std::span<const uint8_t> bytes, uint32_t usage,
+                           EntryKind kind = EntryKind::INPUT) {
+  auto layout = parse_layout(bytes);
+  for (size_t i = 0; i < layout.num_entries; i++) {
+    const auto &entry = layout.entries[i];
+    if (entry.kind != kind || entry.is_padding()) {
+      continue;
+    }
+    for (size_t j = 0; j < entry.num_usages; j++) {
+      if (entry.usages[j] == usage) {
+        return entry.report_id;
+      }
+    }
+    if (entry.usage_maximum && entry.usage_minimum <= usage && usage <= entry.usage_maximum) {
+      return entry.report_id;
+    }
+  }
+  return -1;
+}
+
+/// True if both descriptors parse and describe identical reports
+constexpr bool same_layout(std::span<const uint8_t> a, std::span<const uint8_t> b) {
+  return parse_layout(a).equivalent(parse_layout(b));
+}
+
+namespace detail {
+
+/// Bounded output buffer which records overflow instead of writing past the end
+struct Writer {
+  std::span<uint8_t> out;
+  size_t size{0};
+  bool overflow{false};
+
+  constexpr void put(uint8_t byte) {
+    if (size < out.size()) {
+      out[size++] = byte;
+    } else {
+      overflow = true;
+    }
+  }
+
+  /// Write an item with the shortest encoding which preserves its value.
+  /// Items which were encoded without data stay that way, everything else
+  /// keeps at least one data byte since some hosts mishandle empty items.
+  constexpr void put_item(uint8_t tag, ItemType type, uint32_t data, bool is_signed,
+                          uint8_t original_size) {
+    uint8_t data_size = 4;
+    if (original_size == 0 && data == 0) {
+      data_size = 0;
+    } else if (is_signed) {
+      int32_t value = static_cast<int32_t>(data);
+      if (value >= -128 && value <= 127) {
+        data_size = 1;
+      } else if (value >= -32768 && value <= 32767) {
+        data_size = 2;
+      }
+    } else if (data <= 0xFF) {
+      data_size = 1;
+    } else if (data <= 0xFFFF) {
+      data_size = 2;
+    }
+    uint8_t size_code = data_size == 4 ? 3 : data_size;
+    put(static_cast<uint8_t>((tag << 4) | (static_cast<uint8_t>(type) << 2) | size_code));
+    for (size_t i = 0; i < data_size; i++) {
+      put(static_cast<uint8_t>(data >> (8 * i)));
+    }
+  }
+};
+
+/// A main item together with the global state and local items it consumes
+struct MainRecord {
+  Item main{};
+  GlobalState globals{};
+  uint16_t defined{0}; ///< bit per global tag which has been set so far
+  std::array<Item, MAX_LOCAL_ITEMS> locals{};
+  size_t num_locals{0};
+
+  constexpr bool is_padding() const {
+    return (main.tag == TAG_INPUT || main.tag == TAG_OUTPUT || main.tag == TAG_FEATURE) &&
+           (main.data & FLAG_CONSTANT);
+  }
+
+  constexpr bool needs_usage_page() const {
+    for (size_t i = 0; i < num_locals; i++) {
+      const auto &local = locals[i];
+      bool is_usage = local.tag == TAG_USAGE || local.tag == TAG_USAGE_MINIMUM ||
+                      local.tag == TAG_USAGE_MAXIMUM;
+      if (is_usage && local.data_size != 4) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Bit mask of the global tags which affect how a host parses this item
+  constexpr uint16_t relevant_globals() const {
+    uint16_t page = needs_usage_page() ? (1 << TAG_USAGE_PAGE) : 0;
+    switch (main.tag) {
+    case TAG_INPUT:
+    case TAG_OUTPUT:
+    case TAG_FEATURE:
+      if (is_padding()) {
+        return (1 << TAG_REPORT_SIZE) | (1 << TAG_REPORT_ID) | (1 << TAG_REPORT_COUNT);
+      }
+      return (((1 << NUM_GLOBALS) - 1) & ~(1 << TAG_USAGE_PAGE)) | page;
+    case TAG_COLLECTION:
+      return page;
+    default:
+      return 0;
+    }
+  }
+};
+
+} // namespace detail
+
+/// Minimize a descriptor into out, returning the number of bytes written (0
+/// if out is too small). If the descriptor cannot be minimized safely (it
+/// uses items the layout parser does not model, or the result would parse
+/// differently) the original descriptor is copied unchanged.
+///
+/// @note This keeps a few kB of working state on the stack, it is meant for
+///       constant evaluation and host-side tools rather than device runtime.
+constexpr size_t minimize(std::span<const uint8_t> in, std::span<uint8_t> out) {
+  auto copy_original = [&]() -> size_t {
+    if (out.size() < in.size()) {
+      return 0;
+    }
+    for (size_t i = 0; i < in.size(); i++) {
+      out[i] = in[i];
+    }
+    return in.size();
+  };
+
+  if (!parse_layout(in).valid) {
+    return copy_original();
+  }
+
+  // collect every main item with the state it consumes
+  std::array<detail::MainRecord, MAX_LAYOUT_ENTRIES> records{};
+  size_t num_records = 0;
+  detail::MainRecord current;
+  size_t offset = 0;
+  while (offset < in.size()) {
+    Item item;
+    parse_item(in, offset, item);
+    offset += item.length;
+    if (item.type == ItemType::GLOBAL) {
+      current.globals.set(item);
+      current.defined |= (1 << item.tag);
+    } else if (item.type == ItemType::LOCAL) {
+      if (current.num_locals >= MAX_LOCAL_ITEMS) {
+        return copy_original();
+      }
+      current.locals[current.num_locals++] = item;
+    } else {
+      current.main = item;
+      records[num_records++] = current;
+      current.num_locals = 0;
+    }
+  }
+
+  detail::Writer writer{out};
+  GlobalState emitted;
+  uint16_t emitted_defined = 0;
+  for (size_t i = 0; i < num_records; i++) {
+    const auto &record = records[i];
+    GlobalState wanted = record.globals;
+
+    // merge a run of adjacent padding into one item, as long as it stays
+    // within a size every host accepts
+    size_t last = i;
+    if (record.is_padding()) {
+      uint32_t bits = wanted.report_size * wanted.report_count;
+      while (last + 1 < num_records) {
+        const auto &next = records[last + 1];
+        uint32_t next_bits = next.globals.report_size * next.globals.report_count;
+        if (!next.is_padding() || next.main.tag != record.main.tag || next.num_locals != 0 ||
+            next.globals.report_id != wanted.report_id || bits + next_bits > 32) {
+          break;
+        }
+        bits += next_bits;
+        last++;
+      }
+      if (last != i) {
+        wanted.report_size = bits;
+        wanted.report_count = 1;
+      }
+    }
+
+    // only emit the globals which this item depends on and which differ
+    // from what a host has already seen
+    uint16_t relevant = record.relevant_globals() & record.defined;
+    for (uint8_t tag : {TAG_REPORT_ID, TAG_USAGE_PAGE, TAG_LOGICAL_MINIMUM, TAG_LOGICAL_MAXIMUM,
+                        TAG_PHYSICAL_MINIMUM, TAG_PHYSICAL_MAXIMUM, TAG_UNIT_EXPONENT, TAG_UNIT,
+                        TAG_REPORT_SIZE, TAG_REPORT_COUNT}) {
+      uint16_t bit = 1 << tag;
+      if (!(relevant & bit)) {
+        continue;
+      }
+      if ((emitted_defined & bit) && emitted.get(tag) == wanted.get(tag)) {
+        continue;
+      }
+      Item global;
+      global.tag = tag;
+      global.type = ItemType::GLOBAL;
+      global.data = wanted.get(tag);
+      global.data_size = 4;
+      emitted.set(global);
+      emitted_defined |= bit;
+      writer.put_item(tag, ItemType::GLOBAL, wanted.get(tag), GlobalState::is_signed(tag), 1);
+    }
+
+    for (size_t l = 0; l < record.num_locals; l++) {
+      const auto &local = record.locals[l];
+      bool is_usage = local.tag == TAG_USAGE || local.tag == TAG_USAGE_MINIMUM ||
+                      local.tag == TAG_USAGE_MAXIMUM;
+      if (is_usage && local.data_size == 4) {
+        // extended usages carry their page in the upper 16 bits
+        writer.put(static_cast<uint8_t>((local.tag << 4) | (2 << 2) | 3));
+        for (size_t b = 0; b < 4; b++) {
+          writer.put(static_cast<uint8_t>(local.data >> (8 * b)));
+        }
+      } else {
+        writer.put_item(local.tag, ItemType::LOCAL, local.data, false, local.data_size);
+      }
+    }
+
+    writer.put_item(record.main.tag, ItemType::MAIN, record.main.data, false,
+                    record.main.data_size);
+    i = last;
+  }
+
+  if (writer.overflow || writer.size > in.size() ||
+      !same_layout(in, std::span<const uint8_t>(out.data(), writer.size))) {
+    return copy_original();
+  }
+  return writer.size;
+}
+
+/// A minimized descriptor with the same capacity as its source
+template <size_t N> struct MinimizedDescriptor {
+  std::array<uint8_t, N> data{};
+  size_t size{0};
+
+  constexpr std::span<const uint8_t> bytes() const { return {data.data(), size}; }
+  constexpr size_t bytes_saved() const { return N - size; }
+};
+
+/// Minimize a descriptor at compile time, e.g.
+///   static constexpr auto descriptor = hid::descriptor::minimize(xb::report_descriptor);
+///   static_assert(hid::descriptor::same_layout(xb::report_descriptor, descriptor.bytes()));
+template <size_t N> constexpr MinimizedDescriptor<N> minimize(const uint8_t (&descriptor)[N]) {
+  MinimizedDescriptor<N> result;
+  result.size = minimize(std::span<const uint8_t>(descriptor, N), std::span<uint8_t>(result.data));
+  return result;
+}
+
+template <size_t N>
+constexpr MinimizedDescriptor<N> minimize(const std::array<uint8_t, N> &descriptor) {
+  MinimizedDescriptor<N> result;
+  result.size = minimize(std::span<const uint8_t>(descriptor), std::span<uint8_t>(result.data));
+  return result;
+}
+
+} // namespace hid::descriptor
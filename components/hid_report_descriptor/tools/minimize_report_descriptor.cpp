@@ -0,0 +1,155 @@
+// Host-side HID report descriptor minimizer.
+//
+// Build (from the repository root):
+//   g++ -std=c++20 -I components/hid_report_descriptor/include
+//       components/hid_report_descriptor/tools/minimize_report_descriptor.cpp
+//       -o minimize_report_descriptor
+//
+// Usage:
+//   minimize_report_descriptor [--binary] [-o output.bin] [input]
+//
+// The input (a file, or stdin if not given) is either raw descriptor bytes
+// (--binary) or text containing hex bytes such as "05 01 09 05" or
+// "0x05, 0x01, 0x09, 0x05". The minimized descriptor is printed as a C array,
+// along with the parsed report layout and the number of bytes saved.
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hid_report_descriptor.hpp"
+
+using namespace hid::descriptor;
+
+static const char *kind_str(EntryKind kind) {
+  switch (kind) {
+  case EntryKind::INPUT:
+    return "Input";
+  case EntryKind::OUTPUT:
+    return "Output";
+  case EntryKind::FEATURE:
+    return "Feature";
+  case EntryKind::COLLECTION:
+    return "Collection";
+  case EntryKind::END_COLLECTION:
+    return "End Collection";
+  }
+  return "?";
+}
+
+static std::vector<uint8_t> parse_hex_text(const std::string &text) {
+  // split on anything which can't be part of a hex byte
+  std::string cleaned;
+  for (char c : text) {
+    cleaned += std::isxdigit(static_cast<unsigned char>(c)) || c == 'x' || c == 'X' ? c : ' ';
+  }
+  std::vector<uint8_t> bytes;
+  std::string token;
+  std::istringstream stream(cleaned);
+  while (stream >> token) {
+    if (token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X')) {
+      token = token.substr(2);
+    }
+    if (token.empty() || token.size() > 2) {
+      std::cerr << "invalid byte '" << token << "'\n";
+      std::exit(1);
+    }
+    bytes.push_back(static_cast<uint8_t>(std::strtoul(token.c_str(), nullptr, 16)));
+  }
+  return bytes;
+}
+
+static void print_layout(const char *name, const Layout &layout) {
+  std::printf("%s layout (%s):\n", name, layout.valid ? "valid" : "INVALID");
+  for (size_t i = 0; i < layout.num_entries; i++) {
+    const auto &entry = layout.entries[i];
+    if (entry.is_field()) {
+      std::printf("  %-8s id %3u bits [%4u, %4u) %s", kind_str(entry.kind), entry.report_id,
+                  entry.bit_offset, entry.bit_offset + entry.bit_size,
+                  entry.is_padding() ? "padding" : "");
+      if (!entry.is_padding()) {
+        std::printf("size %u count %u logical [%d, %d]", entry.globals.report_size,
+                    entry.globals.report_count, entry.globals.logical_minimum,
+                    entry.globals.logical_maximum);
+      }
+    } else {
+      std::printf("  %s", kind_str(entry.kind));
+    }
+    for (size_t u = 0; u < entry.num_usages; u++) {
+      std::printf(" usage %#x", entry.usages[u]);
+    }
+    if (entry.usage_minimum || entry.usage_maximum) {
+      std::printf(" usages [%#x, %#x]", entry.usage_minimum, entry.usage_maximum);
+    }
+    std::printf("\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  bool binary = false;
+  const char *input_path = nullptr;
+  const char *output_path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--binary") == 0) {
+      binary = true;
+    } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output_path = argv[++i];
+    } else if (argv[i][0] == '-') {
+      std::cerr << "usage: " << argv[0] << " [--binary] [-o output.bin] [input]\n";
+      return 1;
+    } else {
+      input_path = argv[i];
+    }
+  }
+
+  std::string contents;
+  if (input_path) {
+    std::ifstream file(input_path, std::ios::binary);
+    if (!file) {
+      std::cerr << "could not open '" << input_path << "'\n";
+      return 1;
+    }
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  } else {
+    contents.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+  }
+
+  std::vector<uint8_t> original =
+      binary ? std::vector<uint8_t>(contents.begin(), contents.end()) : parse_hex_text(contents);
+  std::vector<uint8_t> minimized(original.size());
+  size_t size = minimize(original, minimized);
+  minimized.resize(size);
+
+  auto original_layout = parse_layout(original);
+  auto minimized_layout = parse_layout(minimized);
+  print_layout("original", original_layout);
+  print_layout("minimized", minimized_layout);
+
+  if (!original_layout.valid) {
+    std::cerr << "descriptor uses items which cannot be minimized safely, left unchanged\n";
+  } else if (!original_layout.equivalent(minimized_layout)) {
+    std::cerr << "layout mismatch after minimization\n";
+    return 1;
+  }
+
+  std::printf("\nstatic constexpr uint8_t report_descriptor[] = {");
+  for (size_t i = 0; i < minimized.size(); i++) {
+    std::printf("%s0x%02X,", i % 12 == 0 ? "\n  " : " ", minimized[i]);
+  }
+  std::printf("\n};\n\n");
+  std::printf("layout verified identical: %zu -> %zu bytes (%zu bytes saved)\n", original.size(),
+              minimized.size(), original.size() - minimized.size());
+
+  if (output_path) {
+    std::ofstream file(output_path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(minimized.data()), minimized.size());
+  }
+  return 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <esp_bt_defs.h>
+#include <esp_gatt_defs.h>
+
+/// Number of connections whose timelines are kept, the oldest is dropped
+#define HID_CONNECTION_TIMELINE_SESSIONS 8
+
+/// The steps of a connection, in the order they usually happen
+enum class ConnectionMilestone : uint8_t {
+  CONNECTED,      ///< ESP_GATTS_CONNECT_EVT
+  MTU_EXCHANGED,  ///< ESP_GATTS_MTU_EVT
+  PARAMS_UPDATED, ///< ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT, with the interval we asked for
+  ENCRYPTED,      ///< ESP_GAP_BLE_AUTH_CMPL_EVT (pairing, or re-encryption with a bond)
+  SUBSCRIBED,     ///< first input report CCCD enabled (hosts with a bond may skip it)
+  FIRST_REPORT,   ///< first input report completed by the stack
+  DISCONNECTED,   ///< ESP_GATTS_DISCONNECT_EVT
+  COUNT
+};
+
+constexpr const char *connection_milestone_name(ConnectionMilestone milestone) {
+  switch (milestone) {
+  case ConnectionMilestone::CONNECTED:
+    return "connected";
+  case ConnectionMilestone::MTU_EXCHANGED:
+    return "mtu exchanged";
+  case ConnectionMilestone::PARAMS_UPDATED:
+    return "params updated";
+  case ConnectionMilestone::ENCRYPTED:
+    return "encrypted";
+  case ConnectionMilestone::SUBSCRIBED:
+    return "subscribed";
+  case ConnectionMilestone::FIRST_REPORT:
+    return "first report";
+  case ConnectionMilestone::DISCONNECTED:
+    return "disconnected";
+  default:
+    return "unknown";
+  }
+}
+
+/// When each milestone of one connection was reached, relative to the
+/// connection, along with what was negotiated
+struct ConnectionSession {
+  static constexpr int64_t NOT_REACHED = -1;
+
+  uint32_t id{0};                 ///< counts up from 1 with every connection
+  esp_bd_addr_t peer_address{};
+  bool bonded{false};             ///< the host had a bond when it connected
+  int64_t connect_us{0};          ///< esp_timer_get_time() at the connection
+  std::array<int64_t, size_t(ConnectionMilestone::COUNT)> milestone_us{}; ///< since connect_us, or NOT_REACHED
+  uint16_t mtu{ESP_GATT_DEF_BLE_MTU_SIZE};
+  uint16_t interval{0};           ///< connection interval, 1.25 ms units
+  uint16_t latency{0};            ///< peripheral latency, connection events
+  uint16_t timeout{0};            ///< supervision timeout, 10 ms units
+  uint8_t auth_fail_reason{0};    ///< of the last failed authentication, 0 if none failed
+  uint16_t disconnect_reason{0};
+
+  bool reached(ConnectionMilestone milestone) const { return at(milestone) != NOT_REACHED; }
+  int64_t at(ConnectionMilestone milestone) const { return milestone_us[size_t(milestone)]; }
+  int64_t time_to_encrypted() const { return at(ConnectionMilestone::ENCRYPTED); }
+  int64_t time_to_subscribed() const { return at(ConnectionMilestone::SUBSCRIBED); }
+  int64_t time_to_first_report() const { return at(ConnectionMilestone::FIRST_REPORT); }
+};
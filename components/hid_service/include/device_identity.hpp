@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/// What the device tells a host about itself: its GAP device name and the
+/// Device Information Service's PnP ID and strings. hid_service_set_identity()
+/// checks and applies all of it at once: before the attribute tables are
+/// created they are simply created with it, afterwards the values which
+/// changed are set in one batch once the stack has the tables.
+struct DeviceIdentity {
+  std::string_view device_name;       ///< left as is if empty, at most CONFIG_BT_MAX_DEVICE_NAME_LEN bytes
+  uint16_t vendor_id{0};              ///< USB-IF assigned, the PnP ID is left as is if 0
+  uint16_t product_id{0};
+  uint16_t product_version{0};
+  std::string_view manufacturer_name; ///< left as is if empty, at most MANUFACTURER_NAME_MAX_LEN bytes
+  std::string_view model_number;      ///< left as is if empty, at most MODEL_NUMBER_MAX_LEN bytes
+  std::string_view serial_number;     ///< left as is if empty, at most SERIAL_NUMBER_MAX_LEN bytes
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#include "hid_service_table.hpp"
+
+/// The maximum number of profiles which can be registered
+#define HID_MAX_DEVICE_PROFILES 16
+
+/// A device identity which can be switched at runtime: the report map and the
+/// input reports it describes, the PnP ID and the GAP appearance, along with
+/// optional handlers so the application can follow profile / report state.
+struct DeviceProfile {
+  std::string_view name;                   ///< Unique name, used to look the profile up
+  const uint8_t *report_descriptor{nullptr}; ///< HID report map, must outlive the profile
+  size_t report_descriptor_len{0};
+  uint16_t vendor_id{0};
+  uint16_t product_id{0};
+  uint16_t product_version{0};
+  uint16_t appearance{0};                  ///< GAP appearance, e.g. ESP_BLE_APPEARANCE_HID_GAMEPAD
+  std::string_view manufacturer_name;      ///< DIS manufacturer name, left as is if empty
+  std::string_view model_number;           ///< DIS model number, left as is if empty
+  uint8_t input_report_ids[HID_MAX_INPUT_REPORTS]{}; ///< One HID Report characteristic each
+  uint16_t input_report_sizes[HID_MAX_INPUT_REPORTS]{}; ///< Bytes, excluding the report ID
+  size_t num_input_reports{0};
+  /// Input report with the battery strength (one byte, 0-255), which
+  /// hid_service_set_battery_level() feeds, -1 if there is none
+  int battery_report_id{-1};
+  /// Called once the profile is active: the HID table is rebuilt, started
+  /// and (if connected) the host has been told the service changed
+  std::function<void(const DeviceProfile &profile)> on_activate{nullptr};
+  /// Called when the host enables / disables notifications of an input report
+  std::function<void(uint8_t report_id, bool enabled)> on_report_subscription{nullptr};
+};
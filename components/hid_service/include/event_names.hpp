@@ -1,5 +1,7 @@
 #pragma once
 
+#include <sdkconfig.h>
+
 #include "esp_gap_ble_api.h"
 #include "esp_gatts_api.h"
 
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include <esp_gatts_api.h>
+
+#include "device_profile.hpp"
+#include "gatt_service_builder.hpp"
+#include "hid_service_table.hpp"
+
+/// The maximum number of HID services in the GATT database, the default
+/// device's included
+#define HID_MAX_DEVICES 4
+
+/// One HID service of the GATT database, e.g. a gamepad, and a keyboard next
+/// to it: it owns its table, its handles and its active profile. The Battery,
+/// Device Information and Diagnostics services, the connection and the report
+/// latency are the device's as a whole, i.e. shared by all of them.
+///
+///   static HidDevice keyboard;
+///   keyboard.switch_profile(hid_service_find_profile("keyboard"));
+///   hid_service_add_device(keyboard);
+///   ...
+///   keyboard.send_input_report(1, report, sizeof(report));
+///
+/// The hid_service_* functions act on the default device (see
+/// hid_service_default_device()), which is always the first HID service.
+class HidDevice {
+public:
+  HidDevice() = default;
+
+  HidDevice(const HidDevice &) = delete;
+  HidDevice &operator=(const HidDevice &) = delete;
+
+  /// Switch to a registered profile: the HID service is rebuilt for it (and
+  /// the host told to rediscover it) if it has been created already
+  bool switch_profile(size_t index);
+  int active_profile() const { return active_profile_; }
+
+  /// Set the report map, keeping the table's size
+  void set_report_descriptor(const uint8_t *descriptor, size_t descriptor_len);
+
+  void send_input_report(uint8_t report_id, const uint8_t *report, size_t report_len);
+  /// Send the active report map's first input report
+  void send_input_report(const uint8_t *report, size_t report_len);
+  /// The interface, connection and attribute handle an input report is notified with
+  /// @return false if not connected or the report is not in the active report map
+  bool get_input_report_handle(uint8_t report_id, esp_gatt_if_t &gatts_if, uint16_t &conn_id,
+                               uint16_t &attr_handle) const;
+
+  /// True once its table has been created and started, false while it is being
+  /// rebuilt for a profile switch
+  bool is_started() const { return started_; }
+  const HidServiceTable &table() const { return table_; }
+  const gatt::HandleTable<hid_gatt_db> &handles() const { return handles_; }
+
+  // called by hid_service's event handlers, in the BTC task
+
+  /// Ask the stack to create the table for the active profile. Call with
+  /// devices_mutex held.
+  void create_table(esp_gatt_if_t gatts_if);
+  /// Call with devices_mutex held
+  /// @return true if the table which was created is this device's
+  bool on_table_created(const esp_ble_gatts_cb_param_t::gatts_add_attr_tab_evt_param &param);
+  bool on_started(esp_gatt_if_t gatts_if, uint16_t service_handle);
+  /// Call with devices_mutex held
+  bool on_deleted(uint16_t service_handle);
+  /// @return true if it was the configuration of one of its input reports
+  bool on_write(const esp_ble_gatts_cb_param_t::gatts_write_evt_param &write);
+  /// Set the report map's value again, for a host which just connected
+  void publish_report_map();
+  /// Keep the battery strength report's value current, and notify it if sent
+  void publish_battery_strength(uint8_t strength, bool send);
+
+protected:
+  /// Index of the active profile's battery strength report, if it has one
+  bool battery_report_index(size_t &index) const;
+  /// Call with table_mutex_ held
+  void send_input_report_locked(uint8_t report_id, const uint8_t *report, size_t report_len, int64_t enqueue_us);
+
+  HidServiceTable table_;
+  gatt::HandleTable<hid_gatt_db> handles_;
+  int active_profile_{-1};
+  /// Held by the application's tasks while they look up a report in the table
+  /// and send it, and while a profile switch rewrites the table. The BTC task
+  /// never takes it: a send holds it while it posts to the BTC task's queue.
+  /// The handles only change while started_ is false, which the lock orders
+  /// with the sends.
+  mutable std::mutex table_mutex_;
+  std::atomic<bool> started_{false};
+  std::atomic<bool> switching_{false};
+  int64_t switch_start_us_{0};
+  /// The attributes of the table asked for last, which its event has
+  size_t requested_attributes_{0};
+  /// The profile was switched after the table was asked for, but before it
+  /// started: it is deleted once it is created (or started) and then created
+  /// again. Written with devices_mutex held.
+  std::atomic<bool> stale_{false};
+};
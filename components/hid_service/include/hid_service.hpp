@@ -1,9 +1,13 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <mutex>
 #include <string>
+#include <vector>
 
+#include <esp_app_desc.h>
 #include <esp_bt.h>
 #include <esp_gap_bt_api.h>
 #include <esp_gap_ble_api.h>
@@ -12,7 +16,10 @@
 #include <esp_bt_device.h>
 #include <esp_bt_main.h>
 #include <esp_gatt_common_api.h>
+#include <esp_partition.h>
 #include <esp_random.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
 
 #include "freertos/FreeRTOS.h"
@@ -23,19 +30,106 @@
 #include "task.hpp"
 #include "timer.hpp"
 
+#include "alloc_audit.hpp"
 #include "battery_service_table.hpp"
+#include "btsnoop.hpp"
+#include "device_identity.hpp"
 #include "device_information_service_table.hpp"
+#include "diagnostics_service_table.hpp"
 #include "hid_service_table.hpp"
+#include "hid_device.hpp"
+#include "device_profile.hpp"
+#include "hid_profile_bundle.hpp"
+#include "telemetry.hpp"
+#include "telemetry_service_table.hpp"
+#include "connection_timeline.hpp"
+#include "deferred_log.hpp"
 #include "event_names.hpp"
+#include "event_trace.hpp"
+#include "power_save.hpp"
+#include "report_latency.hpp"
 
 bool hid_service_is_connected();
 esp_bd_addr_t *hid_service_get_peer_address();
 void hid_service_init(std::string_view device_name_string_view);
+/// Initialize with the device identity, which the attribute tables are created
+/// with. Strings which are too long are truncated.
+void hid_service_init(const DeviceIdentity &identity);
+/// Set the device identity at once, or nothing of it if some string is too
+/// long (ESP_ERR_INVALID_SIZE). Once the attribute tables exist, only the
+/// values which changed are set. The setters below set single fields of it
+/// (truncating strings which are too long).
+esp_err_t hid_service_set_identity(const DeviceIdentity &identity);
 void hid_service_set_device_name(std::string_view device_name_string_view);
 void hid_service_set_report_descriptor(uint8_t* report_descriptor, size_t report_descriptor_len);
 void hid_service_send_input_report(const uint8_t* report, size_t report_len);
+void hid_service_send_input_report(uint8_t report_id, const uint8_t* report, size_t report_len);
+/// Publish the battery level (in percent) through the Battery Service and the
+/// active profile's battery strength report. Repeating the level sends nothing.
 void hid_service_set_battery_level(const uint8_t level);
 void hid_service_set_pnp_id(const uint16_t vendor_id, const uint16_t product_id, const uint16_t product_version);
 void hid_service_set_manufacturer_name(std::string_view manufacturer_name_string_view);
 void hid_service_set_model_number(std::string_view model_number_string_view);
 void hid_service_set_serial_number(std::string_view serial_number_string_view);
+void hid_service_set_log_level(espp::Logger::Verbosity level);
+espp::Logger::Verbosity hid_service_get_log_level();
+/// The interface, connection and attribute handle an input report is notified
+/// with, for tools which call the stack directly (e.g. benchmarks).
+/// @return false if not connected or the report is not in the active report map
+bool hid_service_get_input_report_handle(uint8_t report_id, esp_gatt_if_t &gatts_if, uint16_t &conn_id,
+                                         uint16_t &attr_handle);
+
+/// The device the other hid_service_* functions act on, the first HID service
+HidDevice &hid_service_default_device();
+/// Add another HID service to the GATT database, which is created right away
+/// (and the host told) if the database has been created already
+/// @return false if there are HID_MAX_DEVICES already
+bool hid_service_add_device(HidDevice &device);
+size_t hid_service_get_num_devices();
+HidDevice *hid_service_get_device(size_t index);
+
+int hid_service_register_profile(const DeviceProfile &profile);
+size_t hid_service_get_num_profiles();
+const DeviceProfile *hid_service_get_profile(size_t index);
+int hid_service_find_profile(std::string_view name);
+int hid_service_get_active_profile();
+bool hid_service_switch_profile(size_t index);
+int hid_service_load_profile_bundle(std::string_view partition_label);
+
+/// Latency histograms and counts of the input reports sent since boot (or
+/// the last reset), see report_latency.hpp
+const ReportLatency &hid_service_get_report_latency();
+void hid_service_reset_report_latency();
+/// Log the report latency histograms, along with the firmware version
+void hid_service_dump_report_latency();
+/// Count input reports which the application merged into a later report
+/// instead of sending them (e.g. while the connection is congested)
+void hid_service_add_coalesced_reports(uint32_t count);
+
+/// The performance counters which the diagnostics service (if enabled with
+/// CONFIG_DIAGNOSTICS_SERVICE) reads as, see diagnostics_service_table.hpp
+DiagnosticsCounters hid_service_get_diagnostics();
+
+#if CONFIG_TELEMETRY_SERVICE
+/// Queue a telemetry sample (of at most 255 bytes) of a stream (below
+/// CONFIG_TELEMETRY_STREAMS), to be packed with others into a frame of the
+/// telemetry service. Frames go out as the host grants credits for them and
+/// no input report is waiting, see telemetry.hpp.
+/// @return false if it was dropped, e.g. because the queue is full
+bool hid_service_send_telemetry(uint8_t stream, const uint8_t *data, size_t length);
+/// Send the samples queued so far without waiting for their frame to fill up
+void hid_service_flush_telemetry();
+TelemetryStats hid_service_get_telemetry_stats();
+void hid_service_reset_telemetry_stats();
+#endif
+
+/// The current connection's interval, in 1.25 ms units, e.g. to batch
+/// samples into one report per connection event
+/// @return 0 if not connected
+uint16_t hid_service_get_connection_interval();
+
+/// Timelines of the last HID_CONNECTION_TIMELINE_SESSIONS connections (the
+/// current one included), oldest first, see connection_timeline.hpp
+std::vector<ConnectionSession> hid_service_get_connection_timeline();
+/// Log the connection timelines
+void hid_service_dump_connection_timeline();
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// Number of input reports whose completion can be waited for at once, more
+/// are sent without being timed
+#define HID_REPORT_LATENCY_MAX_IN_FLIGHT 32
+
+/// Latencies in microseconds, counted in fixed, power of two sized buckets:
+/// bucket 0 holds 0 us, bucket i holds [2^(i-1), 2^i) us and the last one
+/// everything longer (over 4 seconds). Can be added to from one task while
+/// being read from others.
+class LatencyHistogram {
+public:
+  static constexpr size_t NUM_BUCKETS = 24;
+
+  void add(uint32_t us) {
+    size_t bucket = us ? 32 - __builtin_clz(us) : 0;
+    buckets_[bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1].fetch_add(1, std::memory_order_relaxed);
+    uint32_t max = max_.load(std::memory_order_relaxed);
+    while (us > max && !max_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+  }
+
+  void reset() {
+    for (auto &bucket : buckets_) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+  uint32_t count() const {
+    uint32_t total = 0;
+    for (const auto &bucket : buckets_) {
+      total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  uint32_t bucket(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+  /// Smallest latency of the bucket, in microseconds
+  static constexpr uint32_t bucket_start_us(size_t index) { return index ? 1u << (index - 1) : 0; }
+
+  /// The latency which the given fraction (e.g. 0.99) of the samples do not
+  /// exceed, as the upper end of its bucket (but no more than the maximum)
+  uint32_t percentile(float fraction) const {
+    uint32_t total = count();
+    if (total == 0) {
+      return 0;
+    }
+    uint32_t rank = fraction * total;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS - 1; i++) {
+      seen += bucket(i);
+      if (seen > rank) {
+        uint32_t end = bucket_start_us(i + 1) - 1;
+        return end < max() ? end : max();
+      }
+    }
+    return max();
+  }
+
+  uint32_t max() const { return max_.load(std::memory_order_relaxed); }
+
+protected:
+  std::array<std::atomic<uint32_t>, NUM_BUCKETS> buckets_{};
+  std::atomic<uint32_t> max_{0};
+};
+
+/// Latency of the input reports sent by the hid service, each of which is
+/// timestamped when hid_service_send_input_report() is called, when the stack
+/// has accepted it and when the stack reports it done (ESP_GATTS_CONF_EVT).
+/// Reports sent after an input woke the chip from light sleep are timed from
+/// the wake too (see power_save.hpp).
+struct ReportLatency {
+  LatencyHistogram send_call;    ///< from the API call until the stack accepted the report
+  LatencyHistogram stack;        ///< from the stack accepting it until its completion
+  LatencyHistogram total;        ///< from the API call until its completion
+  LatencyHistogram wake_to_send; ///< from an input waking the chip until the API call
+  std::atomic<uint32_t> sent{0};      ///< reports handed to the stack
+  std::atomic<uint32_t> completed{0}; ///< reports the stack completed successfully
+  std::atomic<uint32_t> failed{0};    ///< reports the stack rejected or completed with an error (e.g. congested)
+  std::atomic<uint32_t> lost{0};      ///< reports still in flight at a disconnect
+  std::atomic<uint32_t> untracked{0}; ///< reports sent while HID_REPORT_LATENCY_MAX_IN_FLIGHT were in flight
+  std::atomic<uint32_t> coalesced{0}; ///< reports the application merged into a later one instead of sending them
+  std::atomic<uint32_t> wake_over_budget{0}; ///< of wake_to_send, over CONFIG_POWER_SAVE_WAKE_LATENCY_BUDGET_US
+
+  void reset() {
+    send_call.reset();
+    stack.reset();
+    total.reset();
+    wake_to_send.reset();
+    sent = 0;
+    completed = 0;
+    failed = 0;
+    lost = 0;
+    untracked = 0;
+    coalesced = 0;
+    wake_over_budget = 0;
+  }
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <sdkconfig.h>
+
+#include "telemetry_service_table.hpp"
+
+#if CONFIG_TELEMETRY_SERVICE
+
+/// Samples of one telemetry stream, since boot (or the last reset)
+struct TelemetryStreamStats {
+  uint32_t samples{0};  ///< queued
+  uint32_t bytes{0};    ///< of the samples queued, without their headers
+  uint32_t dropped{0};  ///< samples which did not fit in the queue (or in a frame)
+  int64_t first_us{0};  ///< when its first sample was queued, 0 if none was
+  int64_t last_us{0};
+
+  /// Throughput between the first and the last sample queued
+  uint32_t bytes_per_second() const {
+    return last_us > first_us ? uint32_t(uint64_t(bytes) * 1000000 / (last_us - first_us)) : 0;
+  }
+};
+
+struct TelemetryStats {
+  uint32_t frames_sent{0};      ///< handed to the stack
+  uint32_t frame_bytes_sent{0}; ///< headers included
+  uint32_t frames_failed{0};    ///< rejected by the stack, lost at a disconnect or dropped unsent
+  uint32_t credits_granted{0};
+  uint32_t credit_waits{0};     ///< times a frame was ready, but the host had granted no credit
+  uint32_t input_waits{0};      ///< times a frame was ready, but held back for input reports
+  std::array<TelemetryStreamStats, CONFIG_TELEMETRY_STREAMS> streams{};
+};
+
+/// Packs telemetry samples into frames (see telemetry_service_table.hpp) in a
+/// fixed ring of CONFIG_TELEMETRY_QUEUE_FRAMES frames: samples are appended to
+/// the open frame, which is closed once the next sample doesn't fit in it (or
+/// when close() is called) and then waits at the front for sending. Not
+/// synchronized, hid_service locks around it.
+class TelemetryPacker {
+public:
+  static constexpr size_t NUM_FRAMES = CONFIG_TELEMETRY_QUEUE_FRAMES;
+
+  /// Frames opened from now on are at most this long (the notification
+  /// payload of the MTU), but no longer than TELEMETRY_MAX_FRAME_LEN
+  void set_frame_len(size_t length) {
+    frame_len_ = std::clamp<size_t>(length, MIN_FRAME_LEN, TELEMETRY_MAX_FRAME_LEN);
+  }
+  size_t frame_len() const { return frame_len_; }
+
+  /// Append a sample to the open frame, opening a new one if it doesn't fit
+  /// @return false (counted as dropped) if the stream is unknown, the sample
+  ///         is longer than a frame can hold or all frames are waiting
+  bool push(uint8_t stream, const uint8_t *data, size_t length, int64_t now_us, TelemetryStats &stats) {
+    if (stream >= stats.streams.size()) {
+      return false;
+    }
+    auto &stream_stats = stats.streams[stream];
+    size_t needed = sizeof(TelemetrySampleHeader) + length;
+    if (length > UINT8_MAX || sizeof(TelemetryFrameHeader) + needed > frame_len_) {
+      stream_stats.dropped++;
+      return false;
+    }
+    if (open_len_ && open_len_ + needed > open_capacity_) {
+      close();
+    }
+    if (!open_len_) {
+      if (count_ == NUM_FRAMES) {
+        stream_stats.dropped++;
+        return false;
+      }
+      open_len_ = sizeof(TelemetryFrameHeader);
+      open_capacity_ = frame_len_;
+      open_since_us_ = now_us;
+    }
+    auto &frame = frames_[(head_ + count_) % NUM_FRAMES];
+    TelemetrySampleHeader header{.stream = stream, .length = uint8_t(length)};
+    memcpy(frame.data.data() + open_len_, &header, sizeof(header));
+    memcpy(frame.data.data() + open_len_ + sizeof(header), data, length);
+    open_len_ += needed;
+    frame.num_samples++;
+    if (!stream_stats.first_us) {
+      stream_stats.first_us = now_us;
+    }
+    stream_stats.last_us = now_us;
+    stream_stats.samples++;
+    stream_stats.bytes += length;
+    return true;
+  }
+
+  /// Close the open frame, if it holds samples, so it can be sent
+  void close() {
+    if (!open_len_) {
+      return;
+    }
+    auto &frame = frames_[(head_ + count_) % NUM_FRAMES];
+    TelemetryFrameHeader header{.version = TELEMETRY_FRAME_VERSION, .num_samples = frame.num_samples,
+                                .sequence = sequence_++};
+    memcpy(frame.data.data(), &header, sizeof(header));
+    frame.length = open_len_;
+    open_len_ = 0;
+    count_++;
+  }
+
+  /// Close the open frame if its first sample has waited max_age_us or longer
+  void close_if_older(int64_t now_us, int64_t max_age_us) {
+    if (open_len_ && max_age_us > 0 && now_us - open_since_us_ >= max_age_us) {
+      close();
+    }
+  }
+
+  /// When the first sample of the open frame was pushed, -1 if none is open
+  int64_t open_since_us() const { return open_len_ ? open_since_us_ : -1; }
+
+  /// Closed frames, waiting to be sent
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  const uint8_t *front() const { return frames_[head_].data.data(); }
+  size_t front_len() const { return frames_[head_].length; }
+
+  void pop() {
+    if (count_) {
+      frames_[head_].num_samples = 0;
+      head_ = (head_ + 1) % NUM_FRAMES;
+      count_--;
+    }
+  }
+
+  /// Drop every frame, the open one included
+  /// @return The number of frames dropped
+  size_t clear() {
+    size_t dropped = count_ + (open_len_ ? 1 : 0);
+    while (count_) {
+      pop();
+    }
+    frames_[head_].num_samples = 0;
+    open_len_ = 0;
+    return dropped;
+  }
+
+protected:
+  // the payload of the default MTU (23)
+  static constexpr size_t MIN_FRAME_LEN = ESP_GATT_DEF_BLE_MTU_SIZE - 3;
+
+  struct Frame {
+    std::array<uint8_t, TELEMETRY_MAX_FRAME_LEN> data;
+    uint16_t length{0};
+    uint8_t num_samples{0};
+  };
+
+  std::array<Frame, NUM_FRAMES> frames_{};
+  size_t head_{0};
+  size_t count_{0};       ///< closed frames, the open one follows them
+  size_t open_len_{0};    ///< 0 if no frame is open
+  size_t open_capacity_{0};
+  int64_t open_since_us_{0};
+  size_t frame_len_{MIN_FRAME_LEN};
+  uint16_t sequence_{0};
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "event_names.hpp"
 
+#if CONFIG_HID_SERVICE_EVENT_NAMES
+
 #define SIZEOF_ARRAY(a) (sizeof(a) / sizeof(*a))
 
 static const char *ble_gap_evt_names[] = {
@@ -147,3 +149,17 @@ const char *esp_auth_req_to_str(esp_ble_auth_req_t auth_req)
 
    return auth_str;
 }
+
+#else
+
+// without the names the events are only told apart by their numbers
+
+const char *ble_gap_evt_str(uint8_t) { return "GAP_EVT"; }
+
+const char *ble_gatts_evt_str(uint8_t) { return "GATTS_EVT"; }
+
+const char *esp_ble_key_type_str(esp_ble_key_type_t) { return "KEY"; }
+
+const char *esp_auth_req_to_str(esp_ble_auth_req_t) { return "AUTH_REQ"; }
+
+#endif
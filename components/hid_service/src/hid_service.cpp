@@ -1,6 +1,10 @@
 #include "hid_service.hpp"
 
-static espp::Logger logger({.tag = "HID BLE", .level = espp::Logger::Verbosity::DEBUG});
+static espp::Logger::Verbosity log_level = espp::Logger::Verbosity::DEBUG;
+static espp::Logger logger({.tag = "HID BLE", .level = log_level});
+// for the messages of every report and GATTS event, which are formatted and
+// printed later by the deferred log task instead of in the caller
+static deferred_log::Logger dlogger({.tag = "HID BLE", .level = log_level});
 
 #define PROFILE_NUM                 1
 #define PROFILE_APP_IDX             0
@@ -11,7 +15,6 @@ static espp::Logger logger({.tag = "HID BLE", .level = espp::Logger::Verbosity::
 #define SCAN_RSP_CONFIG_FLAG        (1 << 1)
 
 static uint8_t adv_config_done       = 0;
-static uint16_t hid_handle_table[IDX_HID_NB];
 
 static SemaphoreHandle_t ble_cb_semaphore = NULL;
 #define WAIT_BLE_CB() xSemaphoreTake(ble_cb_semaphore, portMAX_DELAY)
@@ -20,7 +23,102 @@ static SemaphoreHandle_t ble_cb_semaphore = NULL;
 static std::atomic<bool> connected{false};
 static esp_bd_addr_t ble_peer_address;
 
-std::string device_name;
+// the battery level is published through the Battery Service (notified if
+// the host enabled it) and the active profile's battery strength report, and
+// only when it changed. battery_mutex guards the level (battery_level, the
+// Battery Service's value) and the strength: the application's tasks set
+// them and the BTC task reads them as the services start.
+static std::atomic<bool> battery_notify{false};
+static std::mutex battery_mutex;
+static bool battery_level_set = false;
+static uint8_t battery_strength = 0;
+static void update_battery_level_value();
+
+static std::array<DeviceProfile, HID_MAX_DEVICE_PROFILES> profiles;
+static size_t num_profiles = 0;
+
+// the HID services, the default device's first. Devices are only ever added,
+// and their tables are created one at a time, after the services they include
+// (see create_next_hid_table()), since the stack's event doesn't say which
+// device a table is for.
+static HidDevice default_device;
+static std::array<HidDevice *, HID_MAX_DEVICES> devices{&default_device};
+static std::atomic<size_t> num_devices{1};
+static std::mutex devices_mutex;
+static HidDevice *creating_device = nullptr;
+static bool included_tables_created = false;
+static void create_next_hid_table(esp_gatt_if_t gatts_if);
+
+// input reports which have been sent, until the stack completes them (see
+// report_latency.hpp)
+struct ReportInFlight {
+  uint32_t sequence{0};
+  uint16_t handle{0};
+  uint16_t length{0};
+  uint8_t head[4]{}; // to tell reports of the same characteristic apart
+  int64_t enqueue_us{0};
+  int64_t handoff_us{0};
+  bool used{false};
+};
+static ReportLatency report_latency;
+static std::array<ReportInFlight, HID_REPORT_LATENCY_MAX_IN_FLIGHT> reports_in_flight;
+static std::mutex reports_in_flight_mutex;
+static uint32_t report_sequence = 0;
+
+// the last connections, see connection_timeline.hpp
+static std::array<ConnectionSession, HID_CONNECTION_TIMELINE_SESSIONS> sessions;
+static uint32_t num_sessions = 0;
+static std::mutex sessions_mutex;
+
+// the link's quality and congestion, for the diagnostics service
+static std::atomic<int8_t> peer_rssi{0};
+static std::atomic<uint8_t> tx_phy{ESP_BLE_GAP_PHY_1M};
+static std::atomic<uint8_t> rx_phy{ESP_BLE_GAP_PHY_1M};
+static std::atomic<int64_t> congested_since_us{0}; // 0 while not congested
+static std::atomic<int64_t> congestion_us{0};
+// the counters a (long) read of the diagnostics characteristic is answered
+// from, gathered by its first part so that the parts are consistent
+static DiagnosticsCounters diagnostics_snapshot{};
+
+#if CONFIG_TELEMETRY_SERVICE
+// the telemetry service's frames (see telemetry.hpp) are notified only while
+// the host has granted credits, the link isn't congested and no input report
+// is waiting for the stack, CONFIG_TELEMETRY_MAX_IN_FLIGHT at a time
+static TelemetryPacker telemetry_packer;
+static TelemetryStats telemetry_stats;
+static std::mutex telemetry_mutex;
+static bool telemetry_notify = false;
+static uint32_t telemetry_credits = 0;
+static size_t telemetry_in_flight = 0;
+// one-shot, armed while a frame is open so that it is closed and sent once
+// its first sample is CONFIG_TELEMETRY_FRAME_MAX_AGE_MS old, traffic or not
+static esp_timer_handle_t telemetry_age_timer = nullptr;
+static bool telemetry_age_timer_armed = false;
+static void send_telemetry_frames();
+static void telemetry_write(const esp_ble_gatts_cb_param_t::gatts_write_evt_param &write);
+static void telemetry_completed(const esp_ble_gatts_cb_param_t::gatts_conf_evt_param &conf);
+static void telemetry_disconnected();
+#endif
+
+// the stack's maximum, though only a short name fits in the advertising data
+static constexpr size_t DEVICE_NAME_MAX_LEN = CONFIG_BT_MAX_DEVICE_NAME_LEN;
+static char device_name[DEVICE_NAME_MAX_LEN + 1] = CONFIG_DEVICE_NAME;
+
+// the device identity (see device_identity.hpp): the DIS buffers are the
+// values its table is created with, so until that has been requested they are
+// just filled in, afterwards the values which changed are set in one batch
+// once the stack has created the table
+enum : uint8_t {
+  IDENTITY_PNP_ID = 1 << 0,
+  IDENTITY_MANUFACTURER_NAME = 1 << 1,
+  IDENTITY_MODEL_NUMBER = 1 << 2,
+  IDENTITY_SERIAL_NUMBER = 1 << 3,
+};
+static std::mutex identity_mutex;
+static bool dis_table_requested = false;
+static uint8_t identity_pending = 0; // IDENTITY_* set before the table was created
+static void set_identity_values(uint8_t values);
+static std::string_view truncate_identity_string(std::string_view name, std::string_view value, size_t capacity);
 
 static uint8_t service_uuid[16] = {
   // This is the HID service UUID: 00001812-0000-1000-8000-00805f9b34fb
@@ -86,38 +184,323 @@ static struct gatts_profile_inst hid_profile_tab[PROFILE_NUM] = {
   },
 };
 
+/// The session of the current connection, call with sessions_mutex held
+static ConnectionSession *current_session() {
+  if (num_sessions == 0) {
+    return nullptr;
+  }
+  auto &session = sessions[(num_sessions - 1) % sessions.size()];
+  return session.reached(ConnectionMilestone::DISCONNECTED) ? nullptr : &session;
+}
+
+static void session_started(const esp_bd_addr_t peer_address, bool bonded, const esp_gatt_conn_params_t &params) {
+  std::lock_guard<std::mutex> lock(sessions_mutex);
+  auto &session = sessions[num_sessions++ % sessions.size()];
+  session = {.id = num_sessions, .bonded = bonded, .connect_us = esp_timer_get_time(),
+             .interval = params.interval, .latency = params.latency, .timeout = params.timeout};
+  memcpy(session.peer_address, peer_address, ESP_BD_ADDR_LEN);
+  session.milestone_us.fill(ConnectionSession::NOT_REACHED);
+  session.milestone_us[size_t(ConnectionMilestone::CONNECTED)] = 0;
+}
+
+/// Record when the current connection first reached the milestone, and
+/// update what was negotiated with it
+static void session_milestone(ConnectionMilestone milestone,
+                              std::function<void(ConnectionSession &session)> update = nullptr) {
+  int64_t now = esp_timer_get_time();
+  std::lock_guard<std::mutex> lock(sessions_mutex);
+  auto session = current_session();
+  if (!session) {
+    return;
+  }
+  if (update) {
+    update(*session);
+  }
+  if (!session->reached(milestone)) {
+    session->milestone_us[size_t(milestone)] = now - session->connect_us;
+  }
+}
+
+/// Start tracking a report which is about to be handed to the stack.
+/// @return Its sequence number, 0 if too many reports are in flight
+static uint32_t track_report(uint16_t handle, const uint8_t *data, size_t length, int64_t enqueue_us) {
+  std::lock_guard<std::mutex> lock(reports_in_flight_mutex);
+  for (auto &report : reports_in_flight) {
+    if (!report.used) {
+      report_sequence = report_sequence + 1 ? report_sequence + 1 : 1;
+      report = {.sequence = report_sequence, .handle = handle, .length = (uint16_t)length,
+                .enqueue_us = enqueue_us, .used = true};
+      std::copy_n(data, std::min(length, sizeof(report.head)), report.head);
+      event_trace::async_begin("input report", report.sequence);
+      power_save::report_started();
+      return report.sequence;
+    }
+  }
+  report_latency.untracked++;
+  return 0;
+}
+
+/// The stack has accepted (or rejected) a report. Its completion may already
+/// have been handled, since that is up to the BTC task.
+static void report_handed_off(uint32_t sequence, int64_t enqueue_us, esp_err_t result) {
+  int64_t now = esp_timer_get_time();
+  std::lock_guard<std::mutex> lock(reports_in_flight_mutex);
+  for (auto &report : reports_in_flight) {
+    if (report.used && report.sequence == sequence) {
+      report.handoff_us = now;
+      report.used = result == ESP_OK;
+      if (!report.used) {
+        power_save::report_finished();
+      }
+    }
+  }
+  if (result != ESP_OK) {
+    report_latency.failed++;
+    if (sequence) {
+      event_trace::async_end("input report", sequence);
+    }
+    return;
+  }
+  report_latency.sent++;
+  report_latency.send_call.add(now - enqueue_us);
+}
+
+/// The stack is done with a notification (ESP_GATTS_CONF_EVT), which is
+/// matched to the oldest report in flight with the same characteristic and
+/// contents. Completions arrive in order, except that rejected (e.g.
+/// congested) reports may complete ahead of the ones queued before them.
+static void report_completed(const esp_ble_gatts_cb_param_t::gatts_conf_evt_param &conf) {
+  int64_t now = esp_timer_get_time();
+  std::lock_guard<std::mutex> lock(reports_in_flight_mutex);
+  ReportInFlight *oldest = nullptr;
+  ReportInFlight *oldest_same = nullptr;
+  for (auto &report : reports_in_flight) {
+    if (!report.used || report.handle != conf.handle) {
+      continue;
+    }
+    auto older = [&](ReportInFlight *other) { return !other || int32_t(report.sequence - other->sequence) < 0; };
+    if (older(oldest)) {
+      oldest = &report;
+    }
+    bool same = conf.value && conf.len == report.length &&
+                std::equal(report.head, report.head + std::min<size_t>(report.length, sizeof(report.head)), conf.value);
+    if (same && older(oldest_same)) {
+      oldest_same = &report;
+    }
+  }
+  auto report = oldest_same ? oldest_same : oldest;
+  if (!report) {
+    // e.g. the battery level
+    return;
+  }
+  report->used = false;
+  power_save::report_finished();
+  event_trace::async_end("input report", report->sequence);
+  if (conf.status != ESP_GATT_OK) {
+    report_latency.failed++;
+    return;
+  }
+  // the BTC task may have completed it before the sender saw it accepted
+  int64_t handoff_us = report->handoff_us ? report->handoff_us : now;
+  report_latency.completed++;
+  session_milestone(ConnectionMilestone::FIRST_REPORT);
+  report_latency.stack.add(now - handoff_us);
+  report_latency.total.add(now - report->enqueue_us);
+}
+
+/// Reports in flight at a disconnect will never complete
+static void reports_lost() {
+  std::lock_guard<std::mutex> lock(reports_in_flight_mutex);
+  for (auto &report : reports_in_flight) {
+    if (report.used) {
+      report.used = false;
+      power_save::report_finished();
+      report_latency.lost++;
+      event_trace::async_end("input report", report.sequence);
+    }
+  }
+}
+
+/// Whether input reports have been handed to the stack which it hasn't
+/// completed yet
+static bool reports_waiting() {
+  std::lock_guard<std::mutex> lock(reports_in_flight_mutex);
+  return std::any_of(reports_in_flight.begin(), reports_in_flight.end(),
+                     [](const ReportInFlight &report) { return report.used; });
+}
+
+/// The first report sent after an input woke the chip from light sleep
+/// measures the wake penalty, which is kept under the budget by not light
+/// sleeping for the rest of the connection once it is over
+static void measure_wake_latency(int64_t enqueue_us) {
+  int64_t wake_us = power_save::take_input_wake_us();
+  if (!wake_us) {
+    return;
+  }
+  uint32_t latency_us = enqueue_us > wake_us ? enqueue_us - wake_us : 0;
+  report_latency.wake_to_send.add(latency_us);
+  if (CONFIG_POWER_SAVE_WAKE_LATENCY_BUDGET_US && latency_us > CONFIG_POWER_SAVE_WAKE_LATENCY_BUDGET_US) {
+    report_latency.wake_over_budget++;
+    if (power_save::light_sleep_allowed()) {
+      DLOG_WARN(dlogger, "Input report sent {} us after waking, over the {} us budget: no light sleep until disconnected",
+                latency_us, CONFIG_POWER_SAVE_WAKE_LATENCY_BUDGET_US);
+      power_save::set_light_sleep_allowed(false);
+    }
+  }
+}
+
+/// MTU of the current connection, for the capture of the reads the stack answers
+static uint16_t current_mtu() {
+  std::lock_guard<std::mutex> lock(sessions_mutex);
+  auto session = current_session();
+  return session ? session->mtu : ESP_GATT_DEF_BLE_MTU_SIZE;
+}
+
+/// Count the time the connection spends congested (ESP_GATTS_CONGEST_EVT),
+/// until it is uncongested or disconnected
+static void set_congested(bool congested) {
+  int64_t now = esp_timer_get_time();
+  int64_t since = congested_since_us.exchange(congested ? now : 0);
+  if (since) {
+    congestion_us += now - since;
+  }
+}
+
+/// Answer a read of the diagnostics counters, and ask for the RSSI, which the
+/// next read returns
+static void read_diagnostics(esp_gatt_if_t gatts_if, const esp_ble_gatts_cb_param_t::gatts_read_evt_param &read) {
+  if (read.offset == 0) {
+    diagnostics_snapshot = hid_service_get_diagnostics();
+  }
+  esp_gatt_rsp_t rsp = {};
+  rsp.attr_value.handle = read.handle;
+  rsp.attr_value.offset = read.offset;
+  esp_gatt_status_t status = ESP_GATT_OK;
+  if (read.offset > sizeof(diagnostics_snapshot)) {
+    status = ESP_GATT_INVALID_OFFSET;
+  } else {
+    rsp.attr_value.len = std::min<size_t>(sizeof(diagnostics_snapshot) - read.offset, current_mtu() - 1);
+    std::copy_n(reinterpret_cast<const uint8_t *>(&diagnostics_snapshot) + read.offset, rsp.attr_value.len,
+                rsp.attr_value.value);
+  }
+  alloc_audit::exempt(esp_ble_gatts_send_response, gatts_if, read.conn_id, read.trans_id, status, &rsp);
+  if (status == ESP_GATT_OK) {
+    btsnoop::att(read.conn_id, btsnoop::Direction::SENT,
+                 read.is_long ? btsnoop::format::ATT_READ_BLOB_RSP : btsnoop::format::ATT_READ_RSP, {},
+                 {rsp.attr_value.value, rsp.attr_value.len});
+  } else {
+    btsnoop::att(read.conn_id, btsnoop::Direction::SENT, btsnoop::format::ATT_ERROR_RSP,
+                 std::array<uint8_t, 4>{uint8_t(read.is_long ? btsnoop::format::ATT_READ_BLOB_REQ
+                                                             : btsnoop::format::ATT_READ_REQ),
+                                        uint8_t(read.handle), uint8_t(read.handle >> 8), uint8_t(status)});
+  }
+  alloc_audit::exempt(esp_ble_gap_read_rssi, const_cast<uint8_t *>(read.bda));
+}
+
+/// Capture the ATT PDUs (and HCI events) a GATTS event stands for, see btsnoop.hpp.
+/// Requests the stack answers itself (discovery, reads of auto response
+/// attributes) don't reach us, so only the responses we can reconstruct are
+/// captured.
+static void snoop_gatts_event(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t *param) {
+  using namespace btsnoop::format;
+  using btsnoop::Direction;
+  using btsnoop::le16;
+  if (!btsnoop::is_capturing()) {
+    return;
+  }
+  switch (event) {
+  case ESP_GATTS_READ_EVT: {
+    const auto &read = param->read;
+    uint8_t response = read.is_long ? ATT_READ_BLOB_RSP : ATT_READ_RSP;
+    if (read.is_long) {
+      btsnoop::att(read.conn_id, Direction::RECEIVED, ATT_READ_BLOB_REQ, le16(read.handle, read.offset));
+    } else {
+      btsnoop::att(read.conn_id, Direction::RECEIVED, ATT_READ_REQ, le16(read.handle));
+    }
+    uint16_t length = 0;
+    const uint8_t *value = nullptr;
+    if (!read.need_rsp && esp_ble_gatts_get_attr_value(read.handle, &length, &value) == ESP_GATT_OK && value) {
+      size_t offset = std::min<size_t>(read.offset, length);
+      size_t sent = std::min<size_t>(length - offset, current_mtu() - 1);
+      btsnoop::att(read.conn_id, Direction::SENT, response, {}, {value + offset, sent});
+    }
+    break;
+  }
+  case ESP_GATTS_WRITE_EVT: {
+    const auto &write = param->write;
+    std::span<const uint8_t> value(write.value, write.len);
+    if (write.is_prep) {
+      btsnoop::att(write.conn_id, Direction::RECEIVED, ATT_PREPARE_WRITE_REQ, le16(write.handle, write.offset), value);
+    } else {
+      btsnoop::att(write.conn_id, Direction::RECEIVED, write.need_rsp ? ATT_WRITE_REQ : ATT_WRITE_CMD,
+                   le16(write.handle), value);
+    }
+    break;
+  }
+  case ESP_GATTS_EXEC_WRITE_EVT:
+    btsnoop::att(param->exec_write.conn_id, Direction::RECEIVED, ATT_EXECUTE_WRITE_REQ,
+                 std::array<uint8_t, 1>{param->exec_write.exec_write_flag});
+    break;
+  case ESP_GATTS_MTU_EVT:
+    // the event only has the negotiated MTU, so both sides appear to offer it
+    btsnoop::att(param->mtu.conn_id, Direction::RECEIVED, ATT_EXCHANGE_MTU_REQ, le16(param->mtu.mtu));
+    btsnoop::att(param->mtu.conn_id, Direction::SENT, ATT_EXCHANGE_MTU_RSP, le16(param->mtu.mtu));
+    break;
+  case ESP_GATTS_CONNECT_EVT: {
+    const auto &connect = param->connect;
+    std::array<uint8_t, 19> params{HCI_LE_CONNECTION_COMPLETE, 0 /* success */, uint8_t(connect.conn_id),
+                                   uint8_t(connect.conn_id >> 8), 1 /* peripheral */, uint8_t(connect.ble_addr_type)};
+    // the address is little endian on the wire
+    std::reverse_copy(connect.remote_bda, connect.remote_bda + ESP_BD_ADDR_LEN, params.begin() + 6);
+    auto timing = le16(connect.conn_params.interval, connect.conn_params.latency, connect.conn_params.timeout);
+    std::copy(timing.begin(), timing.end(), params.begin() + 12);
+    btsnoop::hci_event(HCI_LE_META, params);
+    break;
+  }
+  case ESP_GATTS_DISCONNECT_EVT: {
+    auto handle = le16(param->disconnect.conn_id);
+    btsnoop::hci_event(HCI_DISCONNECTION_COMPLETE, std::array<uint8_t, 4>{0 /* success */, handle[0], handle[1],
+                                                                          uint8_t(param->disconnect.reason)});
+    break;
+  }
+  default:
+    break;
+  }
+}
+
 static bool is_bonded(esp_bd_addr_t bd_addr) {
-  int dev_num = esp_ble_get_bond_device_num();
-  esp_ble_bond_dev_t *dev_list =
-    static_cast<esp_ble_bond_dev_t *>(malloc(sizeof(esp_ble_bond_dev_t) * dev_num));
+  // only called from the BTC task; static, so that a connection doesn't
+  // allocate the list
+  static esp_ble_bond_dev_t dev_list[CONFIG_BT_SMP_MAX_BONDS];
+  int dev_num = CONFIG_BT_SMP_MAX_BONDS;
   esp_ble_get_bond_device_list(&dev_num, dev_list);
   for (int i = 0; i < dev_num; i++) {
     if (memcmp(dev_list[i].bd_addr, bd_addr, ESP_BD_ADDR_LEN) == 0) {
-      free(dev_list);
       return true;
     }
   }
-  free(dev_list);
   return false;
 }
 
 static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
 {
+  event_trace::Scope trace_scope("btc", ble_gap_evt_str(event));
+  alloc_audit::Scope alloc_scope(ble_gap_evt_str(event));
   switch (event) {
     /*
      * SCAN
      * */
   case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT: {
-    logger.debug("BLE GAP EVENT SCAN_PARAM_SET_COMPLETE");
+    DLOG_DEBUG(dlogger, "BLE GAP EVENT SCAN_PARAM_SET_COMPLETE");
     SEND_BLE_CB();
     break;
   }
   case ESP_GAP_BLE_SCAN_RESULT_EVT: {
-    logger.debug("BLE GAP EVENT SCAN_RESULT");
+    DLOG_DEBUG(dlogger, "BLE GAP EVENT SCAN_RESULT");
     break;
   }
   case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT: {
-    logger.debug("BLE GAP EVENT SCAN CANCELED");
+    DLOG_DEBUG(dlogger, "BLE GAP EVENT SCAN CANCELED");
     break;
   }
 
@@ -125,31 +508,31 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
      * ADVERTISEMENT
      * */
   case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
-    logger.debug("BLE GAP ADV_DATA_RAW_SET_COMPLETE");
+    DLOG_DEBUG(dlogger, "BLE GAP ADV_DATA_RAW_SET_COMPLETE");
     adv_config_done &= (~ADV_CONFIG_FLAG);
-    if (adv_config_done == 0){
-      esp_ble_gap_start_advertising(&adv_params);
+    if (adv_config_done == 0 && !connected){
+      alloc_audit::exempt(esp_ble_gap_start_advertising, &adv_params);
     }
     break;
   case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
-    logger.debug("BLE GAP ADV_DATA_SET_COMPLETE");
+    DLOG_DEBUG(dlogger, "BLE GAP ADV_DATA_SET_COMPLETE");
     adv_config_done &= (~ADV_CONFIG_FLAG);
-    if (adv_config_done == 0){
-      esp_ble_gap_start_advertising(&adv_params);
+    if (adv_config_done == 0 && !connected){
+      alloc_audit::exempt(esp_ble_gap_start_advertising, &adv_params);
     }
     break;
   case ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT:
-    logger.debug("BLE GAP SCAN_RSP_DATA_RAW_SET_COMPLETE");
+    DLOG_DEBUG(dlogger, "BLE GAP SCAN_RSP_DATA_RAW_SET_COMPLETE");
     adv_config_done &= (~SCAN_RSP_CONFIG_FLAG);
-    if (adv_config_done == 0){
-      esp_ble_gap_start_advertising(&adv_params);
+    if (adv_config_done == 0 && !connected){
+      alloc_audit::exempt(esp_ble_gap_start_advertising, &adv_params);
     }
     break;
   case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
-    logger.debug("BLE GAP SCAN_RSP_DATA_SET_COMPLETE");
+    DLOG_DEBUG(dlogger, "BLE GAP SCAN_RSP_DATA_SET_COMPLETE");
     adv_config_done &= (~SCAN_RSP_CONFIG_FLAG);
-    if (adv_config_done == 0){
-      esp_ble_gap_start_advertising(&adv_params);
+    if (adv_config_done == 0 && !connected){
+      alloc_audit::exempt(esp_ble_gap_start_advertising, &adv_params);
     }
     break;
   case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
@@ -157,29 +540,29 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
     memset(ble_peer_address, 0, ESP_BD_ADDR_LEN);
     /* advertising start complete event to indicate advertising start successfully or failed */
     if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
-      logger.error("advertising start failed");
+      DLOG_ERROR(dlogger, "advertising start failed");
     }else{
-      logger.info("advertising start successfully");
+      DLOG_INFO(dlogger, "advertising start successfully");
     }
     break;
   case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
     if (param->adv_stop_cmpl.status != ESP_BT_STATUS_SUCCESS) {
-      logger.error("Advertising stop failed");
+      DLOG_ERROR(dlogger, "Advertising stop failed");
     }
     else {
-      logger.info("Stop adv successfully");
+      DLOG_INFO(dlogger, "Stop adv successfully");
     }
     break;
   case ESP_GAP_BLE_ADV_TERMINATED_EVT:
-    logger.debug("BLE GAP ADV_TERMINATED");
+    DLOG_DEBUG(dlogger, "BLE GAP ADV_TERMINATED");
     break;
 
     /*
      * CONNECTION
      * */
   case ESP_GAP_BLE_GET_DEV_NAME_COMPLETE_EVT:
-    logger.debug("BLE GAP GET_DEV_NAME_COMPLETE");
-    // print the name
+    DLOG_DEBUG(dlogger, "BLE GAP GET_DEV_NAME_COMPLETE");
+    // print the name, now: it is gone once the callback returns
     logger.debug("BLE GAP DEVICE NAME: {}", param->get_dev_name_cmpl.name);
     break;
 
@@ -187,17 +570,17 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
      * BOND
      * */
   case ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT:
-    logger.debug("BLE GAP REMOVE_BOND_DEV_COMPLETE");
+    DLOG_DEBUG(dlogger, "BLE GAP REMOVE_BOND_DEV_COMPLETE");
     // log the bond that was removed
     // esp_log_buffer_hex(TAG, param->remove_bond_dev_cmpl.bd_addr, ESP_BD_ADDR_LEN);
     break;
 
   case ESP_GAP_BLE_CLEAR_BOND_DEV_COMPLETE_EVT:
-    logger.debug("BLE GAP CLEAR_BOND_DEV_COMPLETE");
+    DLOG_DEBUG(dlogger, "BLE GAP CLEAR_BOND_DEV_COMPLETE");
     break;
 
   case ESP_GAP_BLE_GET_BOND_DEV_COMPLETE_EVT:
-    logger.debug("BLE GAP GET_BOND_DEV_COMPLETE");
+    DLOG_DEBUG(dlogger, "BLE GAP GET_BOND_DEV_COMPLETE");
     break;
 
     /*
@@ -205,28 +588,36 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
      * */
   case ESP_GAP_BLE_AUTH_CMPL_EVT:
     if (!param->ble_security.auth_cmpl.success) {
-      logger.error("BLE GAP AUTH ERROR: {:#x}", param->ble_security.auth_cmpl.fail_reason);
+      DLOG_ERROR(dlogger, "BLE GAP AUTH ERROR: {:#x}", param->ble_security.auth_cmpl.fail_reason);
+      std::lock_guard<std::mutex> lock(sessions_mutex);
+      if (auto session = current_session()) {
+        session->auth_fail_reason = param->ble_security.auth_cmpl.fail_reason;
+      }
     } else {
-      logger.info("BLE GAP AUTH SUCCESS");
+      DLOG_INFO(dlogger, "BLE GAP AUTH SUCCESS");
+      session_milestone(ConnectionMilestone::ENCRYPTED);
       // save the connected state
       connected = true;
       // save the address of the peer device
       memcpy(ble_peer_address, param->ble_security.auth_cmpl.bd_addr, ESP_BD_ADDR_LEN);
-      // send the report map
-      esp_ble_gatts_set_attr_value(hid_handle_table[IDX_CHAR_VAL_HID_REPORT_MAP], report_descriptor_len, report_descriptor);
+      // send the report maps
+      for (size_t i = 0; i < num_devices; i++) {
+        devices[i]->publish_report_map();
+      }
     }
     break;
 
   case ESP_GAP_BLE_KEY_EVT: // shows the ble key info share with peer device to the user.
-    logger.debug("BLE GAP KEY type = {}",
-                esp_ble_key_type_str(param->ble_security.ble_key.key_type));
+    DLOG_DEBUG(dlogger, "BLE GAP KEY type = {} ({})",
+               esp_ble_key_type_str(param->ble_security.ble_key.key_type),
+               (int)param->ble_security.ble_key.key_type);
     break;
 
   case ESP_GAP_BLE_PASSKEY_NOTIF_EVT: { // ESP_IO_CAP_OUT
     int received_passkey = (int)param->ble_security.key_notif.passkey;
     // The app will receive this evt when the IO has Output capability and the peer device IO
     // has Input capability. Show the passkey number to the user to input it in the peer device.
-    logger.debug("BLE GAP PASSKEY_NOTIF passkey: {}", received_passkey);
+    DLOG_DEBUG(dlogger, "BLE GAP PASSKEY_NOTIF passkey: {}", received_passkey);
   }
     break;
 
@@ -235,65 +626,106 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
     // The app will receive this event when the IO has DisplayYesNO capability and the peer
     // device IO also has DisplayYesNo capability. show the passkey number to the user to
     // confirm it with the number displayed by peer device.
-    logger.debug("BLE GAP NC_REQ passkey: {}", received_passkey);
-    esp_ble_confirm_reply(param->ble_security.ble_req.bd_addr, true);
+    DLOG_DEBUG(dlogger, "BLE GAP NC_REQ passkey: {}", received_passkey);
+    alloc_audit::exempt(esp_ble_confirm_reply, param->ble_security.ble_req.bd_addr, true);
   }
     break;
 
   case ESP_GAP_BLE_PASSKEY_REQ_EVT: // ESP_IO_CAP_IN
     // The app will receive this evt when the IO has Input capability and the peer device IO has
     // Output capability. See the passkey number on the peer device and send it back.
-    logger.debug("BLE GAP PASSKEY_REQ");
+    DLOG_DEBUG(dlogger, "BLE GAP PASSKEY_REQ");
     // TODO: uncomment below and set the passkey
     // esp_ble_passkey_reply(param->ble_security.key_notif.bd_addr, true, PASSKEY);
     break;
 
   case ESP_GAP_BLE_OOB_REQ_EVT:
     // OOB request event
-    logger.warn("BLE GAP OOB_REQ not implemented");
+    DLOG_WARN(dlogger, "BLE GAP OOB_REQ not implemented");
     break;
 
   case ESP_GAP_BLE_SC_OOB_REQ_EVT:
     // secure connection oob request event
-    logger.warn("BLE GAP SC_OOB_REQ not implemented");
+    DLOG_WARN(dlogger, "BLE GAP SC_OOB_REQ not implemented");
     break;
 
   case ESP_GAP_BLE_SC_CR_LOC_OOB_EVT:
     // secure connection create oob data complete event
-    logger.warn("BLE GAP SC_CR_LOC_OOB not implemented");
+    DLOG_WARN(dlogger, "BLE GAP SC_CR_LOC_OOB not implemented");
     break;
 
   case ESP_GAP_BLE_SEC_REQ_EVT:
-    logger.debug("BLE GAP SEC_REQ");
+    DLOG_DEBUG(dlogger, "BLE GAP SEC_REQ");
 
     // Send the positive(true) security response to the peer device to accept the security
     // request. If not accept the security request, should send the security response with
     // negative(false) accept value.
-    esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
+    alloc_audit::exempt(esp_ble_gap_security_rsp, param->ble_security.ble_req.bd_addr, true);
     break;
 
   case ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT:
-    logger.debug("BLE GAP PHY_UPDATE_COMPLETE");
+    DLOG_DEBUG(dlogger, "BLE GAP PHY_UPDATE_COMPLETE, tx phy {}, rx phy {}", (int)param->phy_update.tx_phy,
+               (int)param->phy_update.rx_phy);
+    if (param->phy_update.status == ESP_BT_STATUS_SUCCESS) {
+      tx_phy = param->phy_update.tx_phy;
+      rx_phy = param->phy_update.rx_phy;
+    }
+    break;
+
+  case ESP_GAP_BLE_READ_PHY_COMPLETE_EVT:
+    DLOG_DEBUG(dlogger, "BLE GAP READ_PHY_COMPLETE, tx phy {}, rx phy {}", (int)param->read_phy.tx_phy,
+               (int)param->read_phy.rx_phy);
+    if (param->read_phy.status == ESP_BT_STATUS_SUCCESS) {
+      tx_phy = param->read_phy.tx_phy;
+      rx_phy = param->read_phy.rx_phy;
+    }
+    break;
+
+  case ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT:
+    DLOG_DEBUG(dlogger, "BLE GAP READ_RSSI_COMPLETE, rssi {} dBm", (int)param->read_rssi_cmpl.rssi);
+    if (param->read_rssi_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+      peer_rssi = param->read_rssi_cmpl.rssi;
+    }
     break;
 
   case ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT:
     if (param->local_privacy_cmpl.status != ESP_BT_STATUS_SUCCESS){
-      logger.error("config local privacy failed, error status = {:#x}", (int)param->local_privacy_cmpl.status);
+      DLOG_ERROR(dlogger, "config local privacy failed, error status = {:#x}", (int)param->local_privacy_cmpl.status);
       break;
     }
     break;
 
   case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
-    logger.debug("update connection params status = {}, min_int = {}, max_int = {},conn_int = {},latency = {}, timeout = {}",
-                (int)param->update_conn_params.status,
-                (int)param->update_conn_params.min_int,
-                (int)param->update_conn_params.max_int,
-                (int)param->update_conn_params.conn_int,
-                (int)param->update_conn_params.latency,
-                (int)param->update_conn_params.timeout);
+    DLOG_DEBUG(dlogger, "update connection params status = {}, min_int = {}, max_int = {}",
+               (int)param->update_conn_params.status,
+               (int)param->update_conn_params.min_int,
+               (int)param->update_conn_params.max_int);
+    DLOG_DEBUG(dlogger, "                          conn_int = {}, latency = {}, timeout = {}",
+               (int)param->update_conn_params.conn_int,
+               (int)param->update_conn_params.latency,
+               (int)param->update_conn_params.timeout);
+    if (param->update_conn_params.status == ESP_BT_STATUS_SUCCESS) {
+      uint16_t interval = param->update_conn_params.conn_int;
+      uint16_t latency = param->update_conn_params.latency;
+      uint16_t timeout = param->update_conn_params.timeout;
+      event_trace::counter("connection interval", interval);
+      if (btsnoop::is_capturing()) {
+        auto timing = btsnoop::le16(hid_profile_tab[PROFILE_APP_IDX].conn_id, interval,
+                                    param->update_conn_params.latency, param->update_conn_params.timeout);
+        std::array<uint8_t, 10> params{btsnoop::format::HCI_LE_CONNECTION_UPDATE_COMPLETE, 0 /* success */};
+        std::copy(timing.begin(), timing.end(), params.begin() + 2);
+        btsnoop::hci_event(btsnoop::format::HCI_LE_META, params);
+      }
+      session_milestone(ConnectionMilestone::PARAMS_UPDATED,
+                        [interval, latency, timeout](ConnectionSession &session) {
+                          session.interval = interval;
+                          session.latency = latency;
+                          session.timeout = timeout;
+                        });
+    }
     break;
   default:
-    logger.warn("UNHANDLED BLE GAP EVENT: {}", ble_gap_evt_str(event));
+    DLOG_WARN(dlogger, "UNHANDLED BLE GAP EVENT: {} ({})", ble_gap_evt_str(event), (int)event);
     break;
   }
 }
@@ -301,89 +733,140 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
 static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
 {
   uint64_t peer_address = 0;
-  logger.debug("gatts_profile_event_handler: event = {}, gatts_if = {}",
-               ble_gatts_evt_str(event),
-               (int)gatts_if);
+  event_trace::Scope trace_scope("btc", ble_gatts_evt_str(event));
+  alloc_audit::Scope alloc_scope(ble_gatts_evt_str(event));
+  snoop_gatts_event(event, param);
+  DLOG_DEBUG(dlogger, "gatts_profile_event_handler: event = {} ({}), gatts_if = {}",
+             ble_gatts_evt_str(event),
+             (int)event,
+             (int)gatts_if);
   switch (event) {
   case ESP_GATTS_REG_EVT:
-    logger.debug("ESP_GATTS_REG_EVT");
-    esp_ble_gap_set_device_name(CONFIG_DEVICE_NAME);
-    esp_ble_gap_config_adv_data(&adv_config);
-    esp_ble_gap_config_adv_data(&scan_rsp_config);
-    esp_ble_gatts_create_attr_tab(bas_att_db, gatts_if, BAS_IDX_NB, 0);
+    DLOG_DEBUG(dlogger, "ESP_GATTS_REG_EVT");
+    {
+      std::lock_guard<std::mutex> lock(identity_mutex);
+      alloc_audit::exempt(esp_ble_gap_set_device_name, device_name);
+    }
+    alloc_audit::exempt(esp_ble_gap_config_adv_data, &adv_config);
+    alloc_audit::exempt(esp_ble_gap_config_adv_data, &scan_rsp_config);
+    alloc_audit::exempt(esp_ble_gatts_create_attr_tab, bas_att_db.data(), gatts_if, bas_att_db.size(), 0);
     break;
   case ESP_GATTS_READ_EVT:
     for (int i = 0; i < 6; i++) {
       peer_address += ((uint64_t)param->read.bda[i]) << (i * 8);
     }
-    logger.debug("ESP_GATTS_READ_EVT, peer_address: {:#x}", peer_address);
+    DLOG_DEBUG(dlogger, "ESP_GATTS_READ_EVT, peer_address: {:#x}", peer_address);
     {
       auto handle_id = param->read.handle;
-      logger.debug("                          handle: {}, offset: {}, need_rsp: {}", handle_id, param->read.offset, param->read.need_rsp);
+      DLOG_DEBUG(dlogger, "                          handle: {}, offset: {}, need_rsp: {}", handle_id, param->read.offset, param->read.need_rsp);
+    }
+    if (param->read.need_rsp && param->read.handle == diag_handle_table[DIAG_IDX_COUNTERS_VAL]) {
+      read_diagnostics(gatts_if, param->read);
     }
-    // TODO: write output/response?
     break;
   case ESP_GATTS_WRITE_EVT:
     for (int i = 0; i < 6; i++) {
       peer_address += ((uint64_t)param->write.bda[i]) << (i * 8);
     }
-    logger.debug("ESP_GATTS_WRITE_EVT, peer_address: {:#x}", peer_address);
-    logger.debug("                           handle: {}, value len: {}", param->write.handle, param->write.len);
+    DLOG_DEBUG(dlogger, "ESP_GATTS_WRITE_EVT, peer_address: {:#x}", peer_address);
+    DLOG_DEBUG(dlogger, "                           handle: {}, value len: {}", param->write.handle, param->write.len);
     if (!param->write.is_prep){
-      bool is_cfg_handle =
-        hid_handle_table[IDX_CHAR_CFG_HID_REPORT] == param->write.handle;
-
-      if (is_cfg_handle && param->write.len == 2){
-        logger.debug("Configuration of {}",
-                     param->write.handle == hid_handle_table[IDX_CHAR_CFG_HID_REPORT]
-                     ? "IDX_CHAR_CFG_HID_REPORT"
-                     : "UNKNOWN CFG HANDLE");
-        uint16_t descr_value = param->write.value[1]<<8 | param->write.value[0];
-        if (descr_value == 0x0001) {
-          logger.info("notify enable");
-        } else if (descr_value == 0x0002) {
-          logger.info("indicate enable");
-        } else if (descr_value == 0x0000) {
-          logger.info("notify/indicate disable ");
-        } else {
-          logger.error("unknown descr value");
-        }
+      // the configuration of one of the devices' input reports?
+      bool is_cfg_handle = false;
+      for (size_t i = 0; i < num_devices && !is_cfg_handle; i++) {
+        is_cfg_handle = devices[i]->on_write(param->write);
+      }
+
+      if (is_cfg_handle) {
+        // handled by the device
+      } else if (param->write.handle == bas_handle_table[BAS_IDX_BATT_LVL_NTF_CFG] && param->write.len == 2) {
+        battery_notify = param->write.value[0] & 0x01;
+        DLOG_INFO(dlogger, "battery level notifications {}", battery_notify ? "enabled" : "disabled");
+#if CONFIG_TELEMETRY_SERVICE
+      } else if (param->write.handle == telemetry_handle_table[TELEMETRY_IDX_DATA_NTF_CFG] ||
+                 param->write.handle == telemetry_handle_table[TELEMETRY_IDX_CREDITS_VAL]) {
+        telemetry_write(param->write);
+#endif
       } else {
         // TODO: handle other writes?
       }
       /* send response when param->write.need_rsp is true*/
       if (param->write.need_rsp){
-        logger.info("send response");
-        esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, ESP_GATT_OK, NULL);
+        DLOG_INFO(dlogger, "send response");
+        alloc_audit::exempt(esp_ble_gatts_send_response, gatts_if, param->write.conn_id, param->write.trans_id, ESP_GATT_OK, nullptr);
+        btsnoop::att(param->write.conn_id, btsnoop::Direction::SENT, btsnoop::format::ATT_WRITE_RSP, {});
       }
     }else{
       /* handle prepare write */
-      logger.warn("ESP_GATTS_PREP_WRITE_EVT not implemented");
+      DLOG_WARN(dlogger, "ESP_GATTS_PREP_WRITE_EVT not implemented");
     }
     break;
   case ESP_GATTS_EXEC_WRITE_EVT:
-    logger.warn("ESP_GATTS_EXEC_WRITE_EVT not implemented");
+    DLOG_WARN(dlogger, "ESP_GATTS_EXEC_WRITE_EVT not implemented");
     break;
   case ESP_GATTS_SET_ATTR_VAL_EVT:
-    logger.debug("ESP_GATTS_SET_ATTR_VAL_EVT, attr_handle {}, srvc_handle {}, status {}",
-                (int)param->set_attr_val.attr_handle,
-                (int)param->set_attr_val.srvc_handle,
-                (int)param->set_attr_val.status);
+    DLOG_DEBUG(dlogger, "ESP_GATTS_SET_ATTR_VAL_EVT, attr_handle {}, srvc_handle {}, status {}",
+               (int)param->set_attr_val.attr_handle,
+               (int)param->set_attr_val.srvc_handle,
+               (int)param->set_attr_val.status);
     break;
   case ESP_GATTS_MTU_EVT:
-    logger.debug("ESP_GATTS_MTU_EVT, MTU {}", (int)param->mtu.mtu);
+    DLOG_DEBUG(dlogger, "ESP_GATTS_MTU_EVT, MTU {}", (int)param->mtu.mtu);
+    event_trace::counter("mtu", param->mtu.mtu);
+    session_milestone(ConnectionMilestone::MTU_EXCHANGED,
+                      [mtu = param->mtu.mtu](ConnectionSession &session) { session.mtu = mtu; });
+#if CONFIG_TELEMETRY_SERVICE
+    {
+      std::lock_guard<std::mutex> lock(telemetry_mutex);
+      telemetry_packer.set_frame_len(param->mtu.mtu - 3);
+    }
+#endif
     break;
   case ESP_GATTS_CONF_EVT:
-    logger.debug("ESP_GATTS_CONF_EVT, status = {}, attr_handle {}", (int)param->conf.status, (int)param->conf.handle);
+    DLOG_DEBUG(dlogger, "ESP_GATTS_CONF_EVT, status = {}, attr_handle {}", (int)param->conf.status, (int)param->conf.handle);
+    report_completed(param->conf);
+#if CONFIG_TELEMETRY_SERVICE
+    // a completed input report or frame may let the next frame go
+    telemetry_completed(param->conf);
+#endif
 
     break;
   case ESP_GATTS_START_EVT:
-    logger.debug("SERVICE_START_EVT, status {}, service_handle {}", (int)param->start.status, (int)param->start.service_handle);
+    DLOG_DEBUG(dlogger, "SERVICE_START_EVT, status {}, service_handle {}", (int)param->start.status, (int)param->start.service_handle);
+    for (size_t i = 0; i < num_devices && param->start.status == ESP_GATT_OK; i++) {
+      if (devices[i]->on_started(gatts_if, param->start.service_handle)) {
+        update_battery_level_value();
+        break;
+      }
+    }
+    break;
+  case ESP_GATTS_DELETE_EVT:
+    DLOG_DEBUG(dlogger, "ESP_GATTS_DELETE_EVT, status {}, service_handle {}", (int)param->del.status, (int)param->del.service_handle);
+    if (param->del.status == ESP_GATT_OK) {
+      std::lock_guard<std::mutex> lock(devices_mutex);
+      for (size_t i = 0; i < num_devices; i++) {
+        if (devices[i]->on_deleted(param->del.service_handle)) {
+          // recreate the HID service table for the new profile
+          create_next_hid_table(gatts_if);
+          break;
+        }
+      }
+    }
     break;
   case ESP_GATTS_CONNECT_EVT: {
-    logger.debug("ESP_GATTS_CONNECT_EVT, conn_id = {}", (int)param->connect.conn_id);
+    DLOG_DEBUG(dlogger, "ESP_GATTS_CONNECT_EVT, conn_id = {}", (int)param->connect.conn_id);
     // update the connection id to each profile table
     hid_profile_tab[PROFILE_APP_IDX].conn_id = param->connect.conn_id;
+    session_started(param->connect.remote_bda, is_bonded(param->connect.remote_bda), param->connect.conn_params);
+    event_trace::counter("connection interval", param->connect.conn_params.interval);
+    peer_rssi = 0;
+    tx_phy = ESP_BLE_GAP_PHY_1M;
+    rx_phy = ESP_BLE_GAP_PHY_1M;
+    alloc_audit::exempt(esp_ble_gap_read_rssi, param->connect.remote_bda);
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    // without BLE 5 features the connection stays on the 1M PHY
+    alloc_audit::exempt(esp_ble_gap_read_phy, param->connect.remote_bda);
+#endif
     esp_ble_conn_update_params_t conn_params = {0};
     memcpy(conn_params.bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
     /* For the iOS system, please refer to Apple official documents about the BLE connection parameters restrictions. */
@@ -393,66 +876,119 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
     conn_params.timeout = 400;    // timeout = 400*10ms = 4000ms
 
     //start sent the update connection parameters to the peer device.
-    esp_ble_gap_update_conn_params(&conn_params);
+    alloc_audit::exempt(esp_ble_gap_update_conn_params, &conn_params);
 
     // only if the device is bonded, send the report map
     if (is_bonded(param->connect.remote_bda)) {
-      logger.info("Device is already bonded, sending report map");
+      DLOG_INFO(dlogger, "Device is already bonded, sending report map");
       // save the connected state
       connected = true;
       memcpy(ble_peer_address, param->connect.remote_bda, ESP_BD_ADDR_LEN);
 
-      // send the report map
-      esp_ble_gatts_set_attr_value(hid_handle_table[IDX_CHAR_VAL_HID_REPORT_MAP], report_descriptor_len, report_descriptor);
+      // send the report maps
+      for (size_t i = 0; i < num_devices; i++) {
+        devices[i]->publish_report_map();
+      }
     }
   }
     break;
   case ESP_GATTS_DISCONNECT_EVT:
-    logger.debug("ESP_GATTS_DISCONNECT_EVT, reason = {:#x}", (int)param->disconnect.reason);
+    DLOG_DEBUG(dlogger, "ESP_GATTS_DISCONNECT_EVT, reason = {:#x}", (int)param->disconnect.reason);
     connected = false;
-    esp_ble_gap_start_advertising(&adv_params);
+    reports_lost();
+    power_save::set_light_sleep_allowed(true);
+    set_congested(false);
+#if CONFIG_TELEMETRY_SERVICE
+    telemetry_disconnected();
+#endif
+    session_milestone(ConnectionMilestone::DISCONNECTED,
+                      [reason = param->disconnect.reason](ConnectionSession &session) { session.disconnect_reason = reason; });
+    alloc_audit::exempt(esp_ble_gap_start_advertising, &adv_params);
     break;
   case ESP_GATTS_CREAT_ATTR_TAB_EVT:{
-    if (param->add_attr_tab.num_handle == BAS_IDX_NB &&
-        param->add_attr_tab.svc_uuid.uuid.uuid16 == ESP_GATT_UUID_BATTERY_SERVICE_SVC &&
-        param->add_attr_tab.status == ESP_GATT_OK) {
-      logger.info("create battery attribute table successfully, the number handle = {}", (int)param->add_attr_tab.num_handle);
-      memcpy(bas_handle_table, param->add_attr_tab.handles, sizeof(bas_handle_table));
-      auto start_handle = param->add_attr_tab.handles[BAS_IDX_SVC];
-      hid_service_table_set_included_battery_service_handles(start_handle,
-                                                             start_handle + BAS_IDX_NB - 1);
-      esp_ble_gatts_create_attr_tab(dis_att_db, gatts_if, DIS_IDX_NB, 0);
-    }
-    if (param->add_attr_tab.num_handle == DIS_IDX_NB &&
-        param->add_attr_tab.svc_uuid.uuid.uuid16 == ESP_GATT_UUID_DEVICE_INFO_SVC &&
-        param->add_attr_tab.status == ESP_GATT_OK) {
-      logger.info("create device information attribute table successfully, the number handle = {}", (int)param->add_attr_tab.num_handle);
-      memcpy(dis_handle_table, param->add_attr_tab.handles, sizeof(dis_handle_table));
-      auto start_handle = param->add_attr_tab.handles[DIS_IDX_SVC];
-      hid_service_table_set_included_dev_info_service_handles(start_handle,
-                                                              start_handle + DIS_IDX_NB - 1);
-      esp_ble_gatts_create_attr_tab(hid_gatt_db, gatts_if, IDX_HID_NB, 0);
-    }
-    if (param->add_attr_tab.num_handle == IDX_HID_NB &&
-        param->add_attr_tab.status == ESP_GATT_OK) {
-      logger.info("create hid attribute table successfully, the number handle = {}", (int)param->add_attr_tab.num_handle);
-      memcpy(hid_handle_table, param->add_attr_tab.handles, sizeof(hid_handle_table));
-      esp_ble_gatts_start_service(hid_handle_table[IDX_SVC_HID]);
+    // NOTE: updating a handle table also fills in the include declarations
+    // which refer to that service, so the services are created in order
+    if (param->add_attr_tab.num_handle == bas_att_db.size() &&
+        bas_handle_table.update(param->add_attr_tab)) {
+      DLOG_INFO(dlogger, "create battery attribute table successfully, the number handle = {}", (int)param->add_attr_tab.num_handle);
+      DLOG_INFO(dlogger, "battery attribute values: {} bytes", bas_att_db.value_bytes());
+      // the table is created with the identity set until now
+      std::lock_guard<std::mutex> lock(identity_mutex);
+      alloc_audit::exempt(esp_ble_gatts_create_attr_tab, dis_att_db.data(), gatts_if, dis_att_db.size(), 0);
+      dis_table_requested = true;
+    }
+    if (param->add_attr_tab.num_handle == dis_att_db.size() &&
+        dis_handle_table.update(param->add_attr_tab)) {
+      DLOG_INFO(dlogger, "create device information attribute table successfully, the number handle = {}", (int)param->add_attr_tab.num_handle);
+      DLOG_INFO(dlogger, "device information attribute values: {} bytes", dis_att_db.value_bytes());
+      {
+        std::lock_guard<std::mutex> lock(identity_mutex);
+        set_identity_values(identity_pending);
+        identity_pending = 0;
+      }
+#if CONFIG_DIAGNOSTICS_SERVICE
+      alloc_audit::exempt(esp_ble_gatts_create_attr_tab, diag_att_db.data(), gatts_if, diag_att_db.size(), 0);
+#elif CONFIG_TELEMETRY_SERVICE
+      alloc_audit::exempt(esp_ble_gatts_create_attr_tab, telemetry_att_db.data(), gatts_if, telemetry_att_db.size(), 0);
+#else
+      std::lock_guard<std::mutex> lock(devices_mutex);
+      included_tables_created = true;
+      create_next_hid_table(gatts_if);
+#endif
+    }
+#if CONFIG_DIAGNOSTICS_SERVICE
+    if (param->add_attr_tab.num_handle == diag_att_db.size() &&
+        diag_handle_table.update(param->add_attr_tab)) {
+      DLOG_INFO(dlogger, "create diagnostics attribute table successfully, the number handle = {}", (int)param->add_attr_tab.num_handle);
+      DLOG_INFO(dlogger, "diagnostics attribute values: {} bytes", diag_att_db.value_bytes());
+#if CONFIG_TELEMETRY_SERVICE
+      alloc_audit::exempt(esp_ble_gatts_create_attr_tab, telemetry_att_db.data(), gatts_if, telemetry_att_db.size(), 0);
+#else
+      std::lock_guard<std::mutex> lock(devices_mutex);
+      included_tables_created = true;
+      create_next_hid_table(gatts_if);
+#endif
+    }
+#endif
+#if CONFIG_TELEMETRY_SERVICE
+    if (param->add_attr_tab.num_handle == telemetry_att_db.size() &&
+        telemetry_handle_table.update(param->add_attr_tab)) {
+      DLOG_INFO(dlogger, "create telemetry attribute table successfully, the number handle = {}", (int)param->add_attr_tab.num_handle);
+      DLOG_INFO(dlogger, "telemetry attribute values: {} bytes", telemetry_att_db.value_bytes());
+      std::lock_guard<std::mutex> lock(devices_mutex);
+      included_tables_created = true;
+      create_next_hid_table(gatts_if);
+    }
+#endif
+    std::lock_guard<std::mutex> lock(devices_mutex);
+    if (creating_device && creating_device->on_table_created(param->add_attr_tab)) {
+      creating_device = nullptr;
+      create_next_hid_table(gatts_if);
+    } else if (param->add_attr_tab.status == ESP_GATT_OK) {
+      alloc_audit::exempt(esp_ble_gatts_start_service, param->add_attr_tab.handles[0]);
     } else {
-      esp_ble_gatts_start_service(param->add_attr_tab.handles[0]);
+      DLOG_ERROR(dlogger, "create attribute table failed, error code = {:#x}", (int)param->add_attr_tab.status);
+      // the HID services are created last, so it was the device's
+      creating_device = nullptr;
     }
     break;
   }
+  case ESP_GATTS_CONGEST_EVT:
+    set_congested(param->congest.congested);
+#if CONFIG_TELEMETRY_SERVICE
+    if (!param->congest.congested) {
+      send_telemetry_frames();
+    }
+#endif
+    break;
   case ESP_GATTS_STOP_EVT:
   case ESP_GATTS_OPEN_EVT:
   case ESP_GATTS_CANCEL_OPEN_EVT:
   case ESP_GATTS_CLOSE_EVT:
   case ESP_GATTS_LISTEN_EVT:
-  case ESP_GATTS_CONGEST_EVT:
   case ESP_GATTS_UNREG_EVT:
-  case ESP_GATTS_DELETE_EVT:
   default:
-    logger.debug("gatts_event_handler: unhandled event {}", (int)event);
+    DLOG_DEBUG(dlogger, "gatts_event_handler: unhandled event {}", (int)event);
     break;
   }
 }
@@ -465,9 +1001,9 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
     if (param->reg.status == ESP_GATT_OK) {
       hid_profile_tab[PROFILE_APP_IDX].gatts_if = gatts_if;
     } else {
-      logger.error("reg app failed, app_id {:04x}, status {}",
-                   (int)param->reg.app_id,
-                   (int)param->reg.status);
+      DLOG_ERROR(dlogger, "reg app failed, app_id {:04x}, status {}",
+                 (int)param->reg.app_id,
+                 (int)param->reg.status);
       return;
     }
   }
@@ -485,18 +1021,439 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
 }
 
 
-static void send_indicate(uint8_t* data, size_t length, uint16_t handle, bool indicate=false) {
-  if (!connected) {
+/// Keep the battery level the stack answers reads with current
+static void update_battery_level_value() {
+  if (bas_handle_table[BAS_IDX_BATT_LVL_VAL]) {
+    uint8_t level;
+    {
+      std::lock_guard<std::mutex> lock(battery_mutex);
+      level = battery_level;
+    }
+    // the stack copies the value
+    alloc_audit::exempt(esp_ble_gatts_set_attr_value, bas_handle_table[BAS_IDX_BATT_LVL_VAL], 1, &level);
+  }
+}
+
+/// Request the table of the first device which has none, once the services
+/// it includes exist and no other device's table is being created. Call with
+/// devices_mutex held.
+static void create_next_hid_table(esp_gatt_if_t gatts_if) {
+  if (!included_tables_created || creating_device || gatts_if == ESP_GATT_IF_NONE) {
     return;
   }
+  for (size_t i = 0; i < num_devices; i++) {
+    auto device = devices[i];
+    if (!device->handles()[IDX_SVC_HID]) {
+      creating_device = device;
+      device->create_table(gatts_if);
+      return;
+    }
+  }
+}
+
+static esp_err_t send_indicate(uint8_t* data, size_t length, uint16_t handle, bool indicate=false) {
+  if (!connected) {
+    return ESP_ERR_INVALID_STATE;
+  }
   uint16_t gatts_if = hid_profile_tab[PROFILE_APP_IDX].gatts_if;
   uint16_t conn_id = hid_profile_tab[PROFILE_APP_IDX].conn_id;
-  logger.debug("Sending notification: gatts_if={}, conn_id={}, attr_handle={}, length={}",
-               gatts_if, conn_id, handle, length);
-  esp_err_t ret = esp_ble_gatts_send_indicate(gatts_if, conn_id, handle, length, data, indicate);
+  DLOG_DEBUG(dlogger, "Sending notification: gatts_if={}, conn_id={}, attr_handle={}, length={}",
+             gatts_if, conn_id, handle, length);
+  btsnoop::att(conn_id, btsnoop::Direction::SENT,
+               indicate ? btsnoop::format::ATT_HANDLE_VALUE_IND : btsnoop::format::ATT_HANDLE_VALUE_NTF,
+               btsnoop::le16(handle), {data, length});
+  esp_err_t ret = alloc_audit::exempt(esp_ble_gatts_send_indicate, gatts_if, conn_id, handle, length, data, indicate);
   if (ret) {
-    logger.error("esp_ble_gatts_send_indicate failed: {:#x}", ret);
+    DLOG_ERROR(dlogger, "esp_ble_gatts_send_indicate failed: {:#x}", ret);
   }
+  return ret;
+}
+
+#if CONFIG_TELEMETRY_SERVICE
+/// Hand the telemetry frames which may go to the stack, a frame whose first
+/// sample waited CONFIG_TELEMETRY_FRAME_MAX_AGE_MS included
+static void send_telemetry_frames() {
+  static constexpr int64_t max_age_us = CONFIG_TELEMETRY_FRAME_MAX_AGE_MS * 1000;
+  std::lock_guard<std::mutex> lock(telemetry_mutex);
+  int64_t now_us = esp_timer_get_time();
+  telemetry_packer.close_if_older(now_us, max_age_us);
+  // the frame opened since (or still open) is due when its first sample is old
+  // enough. A timer armed for an earlier frame just gets here sooner.
+  int64_t open_since_us = telemetry_packer.open_since_us();
+  if (telemetry_age_timer && open_since_us >= 0 && !telemetry_age_timer_armed) {
+    int64_t due_in_us = std::max<int64_t>(open_since_us + max_age_us - now_us, 0);
+    telemetry_age_timer_armed = esp_timer_start_once(telemetry_age_timer, due_in_us) == ESP_OK;
+  }
+  while (!telemetry_packer.empty() && connected && telemetry_notify && !congested_since_us &&
+         telemetry_in_flight < CONFIG_TELEMETRY_MAX_IN_FLIGHT) {
+    if (!telemetry_credits) {
+      telemetry_stats.credit_waits++;
+      return;
+    }
+    // input reports go first: one handed to the stack after this frame waits
+    // for at most CONFIG_TELEMETRY_MAX_IN_FLIGHT frames
+    if (reports_waiting()) {
+      telemetry_stats.input_waits++;
+      return;
+    }
+    size_t length = telemetry_packer.front_len();
+    // the stack copies the value, so the frame can be reused right away
+    if (send_indicate(const_cast<uint8_t *>(telemetry_packer.front()), length,
+                      telemetry_handle_table[TELEMETRY_IDX_DATA_VAL]) != ESP_OK) {
+      return;
+    }
+    telemetry_packer.pop();
+    telemetry_credits--;
+    telemetry_in_flight++;
+    telemetry_stats.frames_sent++;
+    telemetry_stats.frame_bytes_sent += length;
+  }
+}
+
+static void telemetry_age_timer_expired(void *) {
+  {
+    std::lock_guard<std::mutex> lock(telemetry_mutex);
+    telemetry_age_timer_armed = false;
+  }
+  send_telemetry_frames();
+}
+
+/// The host (un)subscribed to the frames or granted credits for them
+static void telemetry_write(const esp_ble_gatts_cb_param_t::gatts_write_evt_param &write) {
+  if (write.len != 2) {
+    return;
+  }
+  uint16_t value = write.value[0] | write.value[1] << 8;
+  {
+    std::lock_guard<std::mutex> lock(telemetry_mutex);
+    if (write.handle == telemetry_handle_table[TELEMETRY_IDX_DATA_NTF_CFG]) {
+      telemetry_notify = value & 0x01;
+      // credits are granted for a subscription
+      telemetry_credits = 0;
+      DLOG_INFO(dlogger, "telemetry notifications {}", telemetry_notify ? "enabled" : "disabled");
+    } else {
+      telemetry_credits = std::min<uint32_t>(telemetry_credits + value, UINT16_MAX);
+      telemetry_stats.credits_granted += value;
+      DLOG_DEBUG(dlogger, "telemetry credits +{}: {}", value, telemetry_credits);
+    }
+  }
+  send_telemetry_frames();
+}
+
+static void telemetry_completed(const esp_ble_gatts_cb_param_t::gatts_conf_evt_param &conf) {
+  if (conf.handle == telemetry_handle_table[TELEMETRY_IDX_DATA_VAL]) {
+    std::lock_guard<std::mutex> lock(telemetry_mutex);
+    if (telemetry_in_flight) {
+      telemetry_in_flight--;
+    }
+    if (conf.status != ESP_GATT_OK) {
+      telemetry_stats.frames_failed++;
+    }
+  }
+  send_telemetry_frames();
+}
+
+/// Frames in flight are lost and the queued ones stale, the host subscribes
+/// and grants credits again once it reconnects
+static void telemetry_disconnected() {
+  std::lock_guard<std::mutex> lock(telemetry_mutex);
+  telemetry_stats.frames_failed += telemetry_in_flight + telemetry_packer.clear();
+  telemetry_in_flight = 0;
+  telemetry_credits = 0;
+  telemetry_notify = false;
+  telemetry_packer.set_frame_len(ESP_GATT_DEF_BLE_MTU_SIZE - 3);
+}
+#endif
+
+bool HidDevice::battery_report_index(size_t &index) const {
+  if (active_profile_ < 0 || profiles[active_profile_].battery_report_id < 0) {
+    return false;
+  }
+  for (index = 0; index < table_.num_input_reports(); index++) {
+    if (table_.input_report_id(index) == profiles[active_profile_].battery_report_id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void HidDevice::publish_battery_strength(uint8_t strength, bool send) {
+  // sent from the application's tasks, which take the table's lock, set from
+  // the BTC task once the table started (see table_mutex_)
+  std::unique_lock<std::mutex> lock(table_mutex_, std::defer_lock);
+  if (send) {
+    lock.lock();
+  }
+  size_t index;
+  if (!started_ || !battery_report_index(index)) {
+    return;
+  }
+  uint16_t handle = handles_[hid_report_attr_index(index, IDX_CHAR_VAL_HID_REPORT)];
+  uint8_t report_id = table_.input_report_id(index);
+  if (send) {
+    send_input_report_locked(report_id, &strength, 1, esp_timer_get_time());
+    lock.unlock();
+  }
+  // the value the stack answers reads with
+  alloc_audit::exempt(esp_ble_gatts_set_attr_value, handle, 1, &strength);
+}
+
+void HidDevice::publish_report_map() {
+  if (handles_[IDX_CHAR_VAL_HID_REPORT_MAP]) {
+    alloc_audit::exempt(esp_ble_gatts_set_attr_value, handles_[IDX_CHAR_VAL_HID_REPORT_MAP],
+                        table_.report_descriptor_len(), table_.report_descriptor());
+  }
+}
+
+void HidDevice::create_table(esp_gatt_if_t gatts_if) {
+  requested_attributes_ = table_.num_attributes();
+  alloc_audit::exempt(esp_ble_gatts_create_attr_tab, table_.attributes(), gatts_if, requested_attributes_, 0);
+}
+
+bool HidDevice::on_table_created(const esp_ble_gatts_cb_param_t::gatts_add_attr_tab_evt_param &param) {
+  // the table may be a different size by now, after a profile switch
+  if (param.num_handle != requested_attributes_ || !handles_.update(param)) {
+    return false;
+  }
+  if (stale_) {
+    DLOG_INFO(dlogger, "The profile changed while its table was being created, creating it again");
+    alloc_audit::exempt(esp_ble_gatts_delete_service, handles_[IDX_SVC_HID]);
+    return true;
+  }
+  DLOG_INFO(dlogger, "create hid attribute table successfully, the number handle = {}", (int)param.num_handle);
+  auto hid_value_bytes = gatt::value_bytes(table_.attributes(), param.num_handle);
+  DLOG_INFO(dlogger, "hid attribute values: {} bytes ({} bytes at the maximum sizes)", hid_value_bytes,
+            gatt::value_bytes(hid_gatt_db.data(), param.num_handle));
+  size_t total_value_bytes = bas_att_db.value_bytes() + dis_att_db.value_bytes();
+#if CONFIG_DIAGNOSTICS_SERVICE
+  total_value_bytes += diag_att_db.value_bytes();
+#endif
+#if CONFIG_TELEMETRY_SERVICE
+  total_value_bytes += telemetry_att_db.value_bytes();
+#endif
+  for (size_t i = 0; i < num_devices; i++) {
+    if (devices[i]->handles_.num_handles()) {
+      total_value_bytes += gatt::value_bytes(devices[i]->table_.attributes(), devices[i]->handles_.num_handles());
+    }
+  }
+  DLOG_INFO(dlogger, "GATT attribute values: {} bytes in total", total_value_bytes);
+  // the report map may have changed since the table was last created
+  publish_report_map();
+  alloc_audit::exempt(esp_ble_gatts_start_service, handles_[IDX_SVC_HID]);
+  return true;
+}
+
+bool HidDevice::on_started(esp_gatt_if_t gatts_if, uint16_t service_handle) {
+  {
+    // ordered with a profile switch, which checks whether it started
+    std::lock_guard<std::mutex> lock(devices_mutex);
+    if (!handles_[IDX_SVC_HID] || service_handle != handles_[IDX_SVC_HID]) {
+      return false;
+    }
+    if (stale_) {
+      DLOG_INFO(dlogger, "The profile changed while its table was being started, creating it again");
+      alloc_audit::exempt(esp_ble_gatts_delete_service, handles_[IDX_SVC_HID]);
+      return true;
+    }
+    started_ = true;
+  }
+  // the rebuilt table starts with the report map's values
+  uint8_t strength;
+  {
+    std::lock_guard<std::mutex> lock(battery_mutex);
+    strength = battery_strength;
+  }
+  publish_battery_strength(strength, false);
+  // tell the host to rediscover the (rebuilt or added) HID service
+  if (connected) {
+    alloc_audit::exempt(esp_ble_gatts_send_service_change_indication, gatts_if, ble_peer_address);
+  }
+  if (switching_) {
+    switching_ = false;
+    DLOG_INFO(dlogger, "Profile switch completed in {} ms", (esp_timer_get_time() - switch_start_us_) / 1000);
+  }
+  if (active_profile_ >= 0 && profiles[active_profile_].on_activate) {
+    profiles[active_profile_].on_activate(profiles[active_profile_]);
+  }
+  return true;
+}
+
+bool HidDevice::on_deleted(uint16_t service_handle) {
+  if (!handles_[IDX_SVC_HID] || service_handle != handles_[IDX_SVC_HID]) {
+    return false;
+  }
+  handles_.clear();
+  stale_ = false;
+  return true;
+}
+
+bool HidDevice::on_write(const esp_ble_gatts_cb_param_t::gatts_write_evt_param &write) {
+  // find which input report (if any) this is the configuration of
+  size_t report_index = 0;
+  for (; report_index < table_.num_input_reports(); report_index++) {
+    if (handles_[hid_report_attr_index(report_index, IDX_CHAR_CFG_HID_REPORT)] == write.handle) {
+      break;
+    }
+  }
+  if (report_index == table_.num_input_reports() || write.len != 2) {
+    return false;
+  }
+  uint8_t report_id = table_.input_report_id(report_index);
+  DLOG_DEBUG(dlogger, "Configuration of IDX_CHAR_CFG_HID_REPORT, report id {}", report_id);
+  uint16_t descr_value = write.value[1]<<8 | write.value[0];
+  if (descr_value == 0x0001) {
+    DLOG_INFO(dlogger, "notify enable");
+  } else if (descr_value == 0x0002) {
+    DLOG_INFO(dlogger, "indicate enable");
+  } else if (descr_value == 0x0000) {
+    DLOG_INFO(dlogger, "notify/indicate disable ");
+  } else {
+    DLOG_ERROR(dlogger, "unknown descr value");
+  }
+  if (descr_value != 0x0000) {
+    session_milestone(ConnectionMilestone::SUBSCRIBED);
+  }
+  if (active_profile_ >= 0 && profiles[active_profile_].on_report_subscription) {
+    profiles[active_profile_].on_report_subscription(report_id, descr_value != 0x0000);
+  }
+  return true;
+}
+
+void HidDevice::set_report_descriptor(const uint8_t *descriptor, size_t descriptor_len) {
+  logger.info("Setting report descriptor of length {}", descriptor_len);
+  {
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    table_.set_report_descriptor(descriptor, descriptor_len);
+  }
+  // else the table will be created with it
+  if (started_) {
+    publish_report_map();
+  }
+}
+
+void HidDevice::send_input_report(uint8_t report_id, const uint8_t *report, size_t report_len) {
+  int64_t enqueue_us = esp_timer_get_time();
+  std::lock_guard<std::mutex> lock(table_mutex_);
+  send_input_report_locked(report_id, report, report_len, enqueue_us);
+}
+
+void HidDevice::send_input_report(const uint8_t *report, size_t report_len) {
+  int64_t enqueue_us = esp_timer_get_time();
+  std::lock_guard<std::mutex> lock(table_mutex_);
+  send_input_report_locked(table_.input_report_id(0), report, report_len, enqueue_us);
+}
+
+void HidDevice::send_input_report_locked(uint8_t report_id, const uint8_t *report, size_t report_len,
+                                         int64_t enqueue_us) {
+  event_trace::Scope trace_scope("app", "send input report");
+  alloc_audit::Scope alloc_scope("send input report");
+  DLOG_INFO(dlogger, "Sending input report {} of length {}", report_id, report_len);
+  if (!started_) {
+    // the HID service is being rebuilt for a new profile
+    return;
+  }
+  for (size_t i = 0; i < table_.num_input_reports(); i++) {
+    if (table_.input_report_id(i) == report_id) {
+      if (report_len > table_.input_report_size(i)) {
+        DLOG_ERROR(dlogger, "Input report {} is {} bytes, the report map says {}",
+                   report_id, report_len, table_.input_report_size(i));
+        return;
+      }
+      uint16_t handle = handles_[hid_report_attr_index(i, IDX_CHAR_VAL_HID_REPORT)];
+      if (!connected) {
+        return;
+      }
+      measure_wake_latency(enqueue_us);
+      uint32_t sequence = track_report(handle, report, report_len, enqueue_us);
+      report_handed_off(sequence, enqueue_us, send_indicate((uint8_t*)report, report_len, handle));
+      return;
+    }
+  }
+  DLOG_ERROR(dlogger, "Input report {} is not part of the active report map", report_id);
+}
+
+bool HidDevice::get_input_report_handle(uint8_t report_id, esp_gatt_if_t &gatts_if, uint16_t &conn_id,
+                                        uint16_t &attr_handle) const {
+  std::lock_guard<std::mutex> lock(table_mutex_);
+  if (!connected || !started_) {
+    return false;
+  }
+  for (size_t i = 0; i < table_.num_input_reports(); i++) {
+    if (table_.input_report_id(i) == report_id) {
+      gatts_if = hid_profile_tab[PROFILE_APP_IDX].gatts_if;
+      conn_id = hid_profile_tab[PROFILE_APP_IDX].conn_id;
+      attr_handle = handles_[hid_report_attr_index(i, IDX_CHAR_VAL_HID_REPORT)];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HidDevice::switch_profile(size_t index) {
+  if (index >= num_profiles) {
+    logger.error("Cannot switch to profile {}, only {} profiles registered", index, num_profiles);
+    return false;
+  }
+  bool idle = false;
+  if (!switching_.compare_exchange_strong(idle, true)) {
+    logger.warn("Profile switch already in progress");
+    return false;
+  }
+  const auto &profile = profiles[index];
+  logger.info("Switching to profile '{}'", profile.name);
+  switch_start_us_ = esp_timer_get_time();
+
+  // the HID table is rebuilt from these, the other services stay as they
+  // are. No report is sent from here on until the rebuilt table started, so
+  // none is looked up in the new table and sent through the old handles.
+  // devices_mutex orders this with the table's events: a table asked for (or
+  // created, but not started) for the old profile is deleted once its event
+  // arrives, then created again. It is taken second, as the BTC task, which
+  // holds it, may be what a send holding table_mutex_ waits for.
+  bool was_started;
+  bool stale;
+  {
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    std::lock_guard<std::mutex> devices_lock(devices_mutex);
+    was_started = started_.exchange(false);
+    active_profile_ = index;
+    table_.set_report_descriptor(profile.report_descriptor, profile.report_descriptor_len);
+    table_.set_input_reports(profile.input_report_ids, profile.input_report_sizes, profile.num_input_reports);
+    stale = !was_started && (creating_device == this || handles_[IDX_SVC_HID]);
+    stale_ = stale;
+  }
+  bool is_default = this == &default_device;
+  if (is_default) {
+    // the device as a whole is the default device's profile
+    hid_service_set_identity({
+        .vendor_id = profile.vendor_id,
+        .product_id = profile.product_id,
+        .product_version = profile.product_version,
+        .manufacturer_name =
+            truncate_identity_string("Manufacturer name", profile.manufacturer_name, MANUFACTURER_NAME_MAX_LEN),
+        .model_number = truncate_identity_string("Model number", profile.model_number, MODEL_NUMBER_MAX_LEN),
+    });
+    scan_rsp_config.appearance = profile.appearance;
+  }
+
+  if (!was_started && !stale) {
+    // the HID table has not been asked for yet, it will be created (and the
+    // profile activated) once the bluetooth stack registers our app, or the
+    // device is added
+    switching_ = false;
+    return true;
+  }
+
+  if (is_default) {
+    esp_ble_gap_config_local_icon(profile.appearance);
+    adv_config_done |= SCAN_RSP_CONFIG_FLAG;
+    esp_ble_gap_config_adv_data(&scan_rsp_config);
+  }
+  // else its event deletes it
+  if (was_started) {
+    esp_ble_gatts_delete_service(handles_[IDX_SVC_HID]);
+  }
+  return true;
 }
 
 /////////////////BLE///////////////////////
@@ -509,7 +1466,36 @@ bool hid_service_is_connected() {
 esp_bd_addr_t *hid_service_get_peer_address(void) { return &ble_peer_address; }
 
 void hid_service_init(std::string_view device_name_string_view) {
+  hid_service_init(DeviceIdentity{.device_name = device_name_string_view});
+}
+
+void hid_service_init(const DeviceIdentity &identity) {
   logger.info("Initializing BLE");
+  // before the app is registered, so that its tables are created with it. Like
+  // the single field setters, a string which is too long is truncated rather
+  // than dropping the whole identity.
+  DeviceIdentity truncated = identity;
+  truncated.device_name = truncate_identity_string("Device name", identity.device_name, DEVICE_NAME_MAX_LEN);
+  truncated.manufacturer_name =
+      truncate_identity_string("Manufacturer name", identity.manufacturer_name, MANUFACTURER_NAME_MAX_LEN);
+  truncated.model_number = truncate_identity_string("Model number", identity.model_number, MODEL_NUMBER_MAX_LEN);
+  truncated.serial_number = truncate_identity_string("Serial number", identity.serial_number, SERIAL_NUMBER_MAX_LEN);
+  hid_service_set_identity(truncated);
+  deferred_log::start();
+#if CONFIG_TELEMETRY_SERVICE
+  if (CONFIG_TELEMETRY_FRAME_MAX_AGE_MS > 0 && !telemetry_age_timer) {
+    esp_timer_create_args_t timer_args{
+        .callback = telemetry_age_timer_expired,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "telemetry_age",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&timer_args, &telemetry_age_timer) != ESP_OK) {
+      logger.error("Could not create the telemetry frame age timer, frames wait until full or flushed");
+    }
+  }
+#endif
 
   // Set the type of authentication needed
   // esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_MITM_BOND;
@@ -537,78 +1523,480 @@ void hid_service_init(std::string_view device_name_string_view) {
   esp_ble_gatts_register_callback(gatts_event_handler);
   esp_ble_gap_register_callback(gap_event_handler);
   esp_ble_gatts_app_register(ESP_APP_ID);
-
-  hid_service_set_device_name(device_name_string_view);
 }
 
 void hid_service_set_device_name(std::string_view device_name_string_view) {
-    logger.info("Setting device name to '{}'", device_name_string_view);
-    // copy the device name into the device name buffer
-    device_name = device_name_string_view;
-    // and make sure we send it
-    esp_ble_gap_set_device_name(device_name.c_str());
+  hid_service_set_identity({.device_name = truncate_identity_string("Device name", device_name_string_view,
+                                                                    DEVICE_NAME_MAX_LEN)});
 }
 
 void hid_service_set_report_descriptor(uint8_t* descriptor, size_t descriptor_len) {
-  logger.info("Setting report descriptor of length {}", descriptor_len);
-  hid_service_table_set_report_descriptor(descriptor, descriptor_len);
-  esp_ble_gatts_set_attr_value(hid_handle_table[IDX_CHAR_VAL_HID_REPORT_MAP], descriptor_len, descriptor);
+  default_device.set_report_descriptor(descriptor, descriptor_len);
 }
 
 void hid_service_send_input_report(const uint8_t* report, size_t report_len) {
-  logger.info("Sending input report of length {}", report_len);
-  send_indicate((uint8_t*)report, report_len, hid_handle_table[IDX_CHAR_VAL_HID_REPORT]);
+  default_device.send_input_report(report, report_len);
+}
+
+void hid_service_send_input_report(uint8_t report_id, const uint8_t* report, size_t report_len) {
+  default_device.send_input_report(report_id, report, report_len);
+}
+
+HidDevice &hid_service_default_device() { return default_device; }
+
+bool hid_service_add_device(HidDevice &device) {
+  std::lock_guard<std::mutex> lock(devices_mutex);
+  size_t count = num_devices;
+  if (std::find(devices.begin(), devices.begin() + count, &device) != devices.begin() + count) {
+    logger.warn("The device has already been added");
+    return false;
+  }
+  if (count >= HID_MAX_DEVICES) {
+    logger.error("Cannot add a device, already have {} devices (HID_MAX_DEVICES)", count);
+    return false;
+  }
+  devices[count] = &device;
+  num_devices = count + 1;
+  // its table is created now, or after the tables which are being created
+  create_next_hid_table(hid_profile_tab[PROFILE_APP_IDX].gatts_if);
+  return true;
+}
+
+size_t hid_service_get_num_devices() { return num_devices; }
+
+HidDevice *hid_service_get_device(size_t index) { return index < num_devices ? devices[index] : nullptr; }
+
+void hid_service_set_log_level(espp::Logger::Verbosity level) {
+  log_level = level;
+  logger.set_verbosity(level);
+  dlogger.set_verbosity(level);
+}
+
+espp::Logger::Verbosity hid_service_get_log_level() { return log_level; }
+
+bool hid_service_get_input_report_handle(uint8_t report_id, esp_gatt_if_t &gatts_if, uint16_t &conn_id,
+                                         uint16_t &attr_handle) {
+  return default_device.get_input_report_handle(report_id, gatts_if, conn_id, attr_handle);
+}
+
+const ReportLatency &hid_service_get_report_latency() { return report_latency; }
+
+void hid_service_reset_report_latency() { report_latency.reset(); }
+
+void hid_service_dump_report_latency() {
+  auto app = esp_app_get_description();
+  std::string elf_sha256;
+  for (size_t i = 0; i < 8; i++) {
+    elf_sha256 += fmt::format("{:02x}", app->app_elf_sha256[i]);
+  }
+  logger.info("Report latency of {} {} ({}): {} sent, {} completed, {} failed, {} lost, {} untracked, {} coalesced",
+              app->project_name, app->version, elf_sha256, report_latency.sent.load(),
+              report_latency.completed.load(), report_latency.failed.load(), report_latency.lost.load(),
+              report_latency.untracked.load(), report_latency.coalesced.load());
+  if (report_latency.wake_to_send.count()) {
+    logger.info("  {} woken by an input, {} over the {} us budget", report_latency.wake_to_send.count(),
+                report_latency.wake_over_budget.load(), CONFIG_POWER_SAVE_WAKE_LATENCY_BUDGET_US);
+  }
+  const std::pair<const char*, const LatencyHistogram*> histograms[] = {
+    {"send call", &report_latency.send_call},
+    {"stack", &report_latency.stack},
+    {"total", &report_latency.total},
+    {"wake to send", &report_latency.wake_to_send},
+  };
+  for (auto [name, histogram] : histograms) {
+    logger.info("  {}: p50 {} us, p99 {} us, max {} us", name, histogram->percentile(0.5f),
+                histogram->percentile(0.99f), histogram->max());
+    for (size_t i = 0; i < LatencyHistogram::NUM_BUCKETS; i++) {
+      if (histogram->bucket(i)) {
+        logger.info("    >= {} us: {}", LatencyHistogram::bucket_start_us(i), histogram->bucket(i));
+      }
+    }
+  }
+}
+
+void hid_service_add_coalesced_reports(uint32_t count) { report_latency.coalesced += count; }
+
+DiagnosticsCounters hid_service_get_diagnostics() {
+  DiagnosticsCounters counters = {
+      .version = DIAGNOSTICS_COUNTERS_VERSION,
+      .rssi = peer_rssi,
+      .tx_phy = tx_phy,
+      .rx_phy = rx_phy,
+      .uptime_ms = uint32_t(esp_timer_get_time() / 1000),
+      .reports_sent = report_latency.completed,
+      .reports_dropped = report_latency.failed + report_latency.lost,
+      .reports_coalesced = report_latency.coalesced,
+      .mtu = ESP_GATT_DEF_BLE_MTU_SIZE,
+      .free_heap = esp_get_free_heap_size(),
+      .min_free_heap = esp_get_minimum_free_heap_size(),
+      .latency_p50_us = report_latency.total.percentile(0.5f),
+      .latency_p99_us = report_latency.total.percentile(0.99f),
+      .latency_max_us = report_latency.total.max(),
+  };
+  int64_t congested_us = congestion_us;
+  if (int64_t since = congested_since_us) {
+    congested_us += esp_timer_get_time() - since;
+  }
+  counters.congestion_ms = uint32_t(congested_us / 1000);
+  std::lock_guard<std::mutex> lock(sessions_mutex);
+  if (auto session = current_session()) {
+    counters.conn_interval = session->interval;
+    counters.conn_latency = session->latency;
+    counters.conn_timeout = session->timeout;
+    counters.mtu = session->mtu;
+  }
+  return counters;
+}
+
+#if CONFIG_TELEMETRY_SERVICE
+bool hid_service_send_telemetry(uint8_t stream, const uint8_t *data, size_t length) {
+  bool queued = false;
+  {
+    std::lock_guard<std::mutex> lock(telemetry_mutex);
+    // nobody to send it to
+    if (!telemetry_notify) {
+      if (stream < telemetry_stats.streams.size()) {
+        telemetry_stats.streams[stream].dropped++;
+      }
+      return false;
+    }
+    queued = telemetry_packer.push(stream, data, length, esp_timer_get_time(), telemetry_stats);
+  }
+  send_telemetry_frames();
+  return queued;
+}
+
+void hid_service_flush_telemetry() {
+  {
+    std::lock_guard<std::mutex> lock(telemetry_mutex);
+    telemetry_packer.close();
+  }
+  send_telemetry_frames();
+}
+
+TelemetryStats hid_service_get_telemetry_stats() {
+  std::lock_guard<std::mutex> lock(telemetry_mutex);
+  return telemetry_stats;
+}
+
+void hid_service_reset_telemetry_stats() {
+  std::lock_guard<std::mutex> lock(telemetry_mutex);
+  telemetry_stats = {};
+}
+#endif
+
+uint16_t hid_service_get_connection_interval() {
+  std::lock_guard<std::mutex> lock(sessions_mutex);
+  auto session = current_session();
+  return session ? session->interval : 0;
+}
+
+std::vector<ConnectionSession> hid_service_get_connection_timeline() {
+  std::lock_guard<std::mutex> lock(sessions_mutex);
+  std::vector<ConnectionSession> timeline;
+  for (uint32_t i = num_sessions > sessions.size() ? num_sessions - sessions.size() : 0; i < num_sessions; i++) {
+    timeline.push_back(sessions[i % sessions.size()]);
+  }
+  return timeline;
+}
+
+void hid_service_dump_connection_timeline() {
+  auto ms = [](int64_t us) {
+    return us == ConnectionSession::NOT_REACHED ? std::string("-") : fmt::format("{:.1f} ms", us / 1000.0f);
+  };
+  for (const auto &session : hid_service_get_connection_timeline()) {
+    const auto &a = session.peer_address;
+    logger.info("Connection {} to {:02x}:{:02x}:{:02x}:{:02x}:{:02x}:{:02x} ({}): encrypted after {}, subscribed "
+                "after {}, first report after {}, mtu {}, interval {:.2f} ms",
+                session.id, a[0], a[1], a[2], a[3], a[4], a[5], session.bonded ? "bonded" : "new",
+                ms(session.time_to_encrypted()), ms(session.time_to_subscribed()),
+                ms(session.time_to_first_report()), session.mtu, session.interval * 1.25f);
+    for (size_t i = 0; i < session.milestone_us.size(); i++) {
+      if (session.milestone_us[i] != ConnectionSession::NOT_REACHED) {
+        logger.info("  {:>10}: {}", ms(session.milestone_us[i]), connection_milestone_name(ConnectionMilestone(i)));
+      }
+    }
+    if (session.auth_fail_reason) {
+      logger.info("  authentication failed: {:#x}", session.auth_fail_reason);
+    }
+    if (session.reached(ConnectionMilestone::DISCONNECTED)) {
+      logger.info("  disconnect reason: {:#x}", session.disconnect_reason);
+    }
+  }
 }
 
 void hid_service_set_battery_level(const uint8_t level) {
-  logger.info("Setting battery level to {}%", level);
-  battery_level = level;
-  send_indicate(&battery_level, sizeof(battery_level), bas_handle_table[BAS_IDX_BATT_LVL_VAL]);
+  uint8_t percent = std::min<uint8_t>(level, 100);
+  uint8_t strength;
+  {
+    // not held while publishing, which posts to the BTC task, which takes it
+    std::lock_guard<std::mutex> lock(battery_mutex);
+    if (battery_level_set && percent == battery_level) {
+      return;
+    }
+    battery_level_set = true;
+    battery_level = percent;
+    // the battery strength report's logical range is 0-255
+    battery_strength = strength = (percent * 255 + 50) / 100;
+  }
+  DLOG_INFO(dlogger, "Setting battery level to {}%", percent);
+  update_battery_level_value();
+  if (battery_notify) {
+    send_indicate(&percent, sizeof(percent), bas_handle_table[BAS_IDX_BATT_LVL_VAL]);
+  }
+  for (size_t i = 0; i < num_devices; i++) {
+    devices[i]->publish_battery_strength(strength, true);
+  }
+}
+
+/// Whether an identity string fits in its buffer, which is sized at build time
+static bool identity_string_fits(std::string_view name, std::string_view value, size_t capacity) {
+  if (value.size() > capacity) {
+    logger.error("{} '{}' is longer than {} bytes", name, value, capacity);
+    return false;
+  }
+  return true;
+}
+
+static std::string_view truncate_identity_string(std::string_view name, std::string_view value, size_t capacity) {
+  if (value.size() > capacity) {
+    logger.warn("{} '{}' is longer than {} bytes, truncating it", name, value, capacity);
+    value = value.substr(0, capacity);
+  }
+  return value;
+}
+
+/// Copy a DIS string into its buffer if it is set and differs from it
+static bool copy_dis_string(std::string_view value, uint8_t *buffer, uint16_t &length) {
+  if (value.empty() || value == std::string_view((const char *)buffer, length)) {
+    return false;
+  }
+  std::copy(value.begin(), value.end(), buffer);
+  length = value.size();
+  return true;
+}
+
+/// Set the DIS attributes' values from their buffers, identity_mutex must be held
+static void set_identity_values(uint8_t values) {
+  if (values & IDENTITY_PNP_ID) {
+    alloc_audit::exempt(esp_ble_gatts_set_attr_value, dis_handle_table[DIS_IDX_PNP_VAL], PNP_ID_SIZE, pnp_id);
+  }
+  if (values & IDENTITY_MANUFACTURER_NAME) {
+    alloc_audit::exempt(esp_ble_gatts_set_attr_value, dis_handle_table[DIS_IDX_MANUFACTURER_NAME_VAL],
+                        manufacturer_name_length, manufacturer_name);
+  }
+  if (values & IDENTITY_MODEL_NUMBER) {
+    alloc_audit::exempt(esp_ble_gatts_set_attr_value, dis_handle_table[DIS_IDX_MODEL_NUMBER_VAL],
+                        model_number_length, model_number);
+  }
+  if (values & IDENTITY_SERIAL_NUMBER) {
+    alloc_audit::exempt(esp_ble_gatts_set_attr_value, dis_handle_table[DIS_IDX_SERIAL_NUMBER_VAL],
+                        serial_number_length, serial_number);
+  }
+}
+
+/// The DIS strings which the table is created with as they are now
+static uint8_t created_with_values() {
+  auto created_length = [](size_t index) { return dis_att_db.data()[index].att_desc.length; };
+  uint8_t values = 0;
+  if (manufacturer_name_length == created_length(DIS_IDX_MANUFACTURER_NAME_VAL)) {
+    values |= IDENTITY_MANUFACTURER_NAME;
+  }
+  if (model_number_length == created_length(DIS_IDX_MODEL_NUMBER_VAL)) {
+    values |= IDENTITY_MODEL_NUMBER;
+  }
+  if (serial_number_length == created_length(DIS_IDX_SERIAL_NUMBER_VAL)) {
+    values |= IDENTITY_SERIAL_NUMBER;
+  }
+  return values;
+}
+
+esp_err_t hid_service_set_identity(const DeviceIdentity &identity) {
+  // check all of it first, so that either all of it or nothing is applied
+  bool fits = identity_string_fits("Device name", identity.device_name, DEVICE_NAME_MAX_LEN);
+  fits &= identity_string_fits("Manufacturer name", identity.manufacturer_name, MANUFACTURER_NAME_MAX_LEN);
+  fits &= identity_string_fits("Model number", identity.model_number, MODEL_NUMBER_MAX_LEN);
+  fits &= identity_string_fits("Serial number", identity.serial_number, SERIAL_NUMBER_MAX_LEN);
+  if (!fits) {
+    logger.error("Not setting the device identity (CONFIG_BT_MAX_DEVICE_NAME_LEN, CONFIG_DIS_STRING_MIN_CAPACITY)");
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  std::lock_guard<std::mutex> lock(identity_mutex);
+  uint8_t changed = 0;
+  if (identity.vendor_id) {
+    // format of pnp:
+    // 0xVVVVPPPPIIIISS
+    // VVVV: product version
+    // PPPP: product id
+    // IIII: vendor id
+    // SS: vendor id source
+    uint64_t pnp = 0x02; // vendor id source
+    pnp |= (uint64_t)identity.vendor_id << 8;
+    pnp |= (uint64_t)identity.product_id << 24;
+    pnp |= (uint64_t)identity.product_version << 40;
+    // little endian
+    uint8_t value[PNP_ID_SIZE];
+    for (size_t i = 0; i < PNP_ID_SIZE; i++) {
+      value[i] = (pnp >> (8 * i)) & 0xFF;
+    }
+    if (!std::equal(value, value + PNP_ID_SIZE, pnp_id)) {
+      logger.info("Setting PNP ID to {:#x} (vendor_id={:#x}, product_id={:#x}, product_version={:#x})", pnp,
+                  identity.vendor_id, identity.product_id, identity.product_version);
+      std::copy(value, value + PNP_ID_SIZE, pnp_id);
+      changed |= IDENTITY_PNP_ID;
+    }
+  }
+  if (copy_dis_string(identity.manufacturer_name, manufacturer_name, manufacturer_name_length)) {
+    logger.info("Setting manufacturer name to '{}'", identity.manufacturer_name);
+    changed |= IDENTITY_MANUFACTURER_NAME;
+  }
+  if (copy_dis_string(identity.model_number, model_number, model_number_length)) {
+    logger.info("Setting model number to '{}'", identity.model_number);
+    changed |= IDENTITY_MODEL_NUMBER;
+  }
+  if (copy_dis_string(identity.serial_number, serial_number, serial_number_length)) {
+    logger.info("Setting serial number to '{}'", identity.serial_number);
+    changed |= IDENTITY_SERIAL_NUMBER;
+  }
+  if (!identity.device_name.empty() && identity.device_name != device_name) {
+    logger.info("Setting device name to '{}'", identity.device_name);
+    *std::copy(identity.device_name.begin(), identity.device_name.end(), device_name) = '\0';
+    esp_ble_gap_set_device_name(device_name);
+  }
+
+  if (!dis_table_requested) {
+    // the table will be created with them, though with the lengths of the
+    // defaults, so strings of other lengths are set once it exists
+    identity_pending |= changed & ~IDENTITY_PNP_ID & ~created_with_values();
+  } else if (!dis_handle_table[DIS_IDX_SVC]) {
+    identity_pending |= changed;
+  } else {
+    set_identity_values(changed);
+  }
+  return ESP_OK;
 }
 
 void hid_service_set_pnp_id(const uint16_t vendor_id, const uint16_t product_id, const uint16_t product_version) {
-  // format of pnp:
-  // 0xVVVVPPPPIIIISS
-  // VVVV: product version
-  // PPPP: product id
-  // IIII: vendor id
-  // SS: vendor id source
-  uint64_t pnp = 0x02; // vendor id source
-  pnp |= (uint64_t)vendor_id << 8;
-  pnp |= (uint64_t)product_id << 24;
-  pnp |= (uint64_t)product_version << 40;
-  logger.info("Building PnP from vendor_id={:#x}, product_id={:#x}, product_version={:#x}",
-              vendor_id, product_id, product_version);
-  logger.info("Setting PNP ID to {:#x}", pnp);
-  // now actually set the variable
-  pnp_id = pnp;
-  // and make sure we send it
-  esp_ble_gatts_set_attr_value(dis_handle_table[DIS_IDX_PNP_VAL], 7, (uint8_t*)&pnp_id);
+  hid_service_set_identity({.vendor_id = vendor_id, .product_id = product_id, .product_version = product_version});
 }
 
 void hid_service_set_manufacturer_name(std::string_view manufacturer_name_string_view) {
-  logger.info("Setting manufacturer name to '{}'", manufacturer_name_string_view);
-  // copy the manufacturer name into the manufacturer name buffer
-  std::copy(manufacturer_name_string_view.begin(), manufacturer_name_string_view.end(), manufacturer_name);
-  manufacturer_name_length = manufacturer_name_string_view.size();
-  // and make sure we send it
-  esp_ble_gatts_set_attr_value(dis_handle_table[DIS_IDX_MANUFACTURER_NAME_VAL], manufacturer_name_length, manufacturer_name);
+  hid_service_set_identity({.manufacturer_name = truncate_identity_string(
+                                "Manufacturer name", manufacturer_name_string_view, MANUFACTURER_NAME_MAX_LEN)});
 }
 
 void hid_service_set_model_number(std::string_view model_number_string_view) {
-  logger.info("Setting model number to '{}'", model_number_string_view);
-  // copy the model number into the model number buffer
-  std::copy(model_number_string_view.begin(), model_number_string_view.end(), model_number);
-  model_number_length = model_number_string_view.size();
-  // and make sure we send it
-  esp_ble_gatts_set_attr_value(dis_handle_table[DIS_IDX_MODEL_NUMBER_VAL], model_number_length, model_number);
+  hid_service_set_identity({.model_number = truncate_identity_string("Model number", model_number_string_view,
+                                                                     MODEL_NUMBER_MAX_LEN)});
 }
 
 void hid_service_set_serial_number(std::string_view serial_number_string_view) {
-  logger.info("Setting serial number to '{}'", serial_number_string_view);
-  // copy the serial number into the serial number buffer
-  std::copy(serial_number_string_view.begin(), serial_number_string_view.end(), serial_number);
-  serial_number_length = serial_number_string_view.size();
-  // and make sure we send it
-  esp_ble_gatts_set_attr_value(dis_handle_table[DIS_IDX_SERIAL_NUMBER_VAL], serial_number_length, serial_number);
+  hid_service_set_identity({.serial_number = truncate_identity_string("Serial number", serial_number_string_view,
+                                                                      SERIAL_NUMBER_MAX_LEN)});
+}
+
+int hid_service_register_profile(const DeviceProfile &profile) {
+  if (num_profiles >= HID_MAX_DEVICE_PROFILES) {
+    logger.error("Cannot register profile '{}', already have {} profiles", profile.name, num_profiles);
+    return -1;
+  }
+  if (profile.num_input_reports == 0 || profile.num_input_reports > HID_MAX_INPUT_REPORTS) {
+    logger.error("Cannot register profile '{}', it has {} input reports (max {})",
+                 profile.name, profile.num_input_reports, HID_MAX_INPUT_REPORTS);
+    return -1;
+  }
+  logger.info("Registering profile '{}'", profile.name);
+  profiles[num_profiles] = profile;
+  return num_profiles++;
+}
+
+size_t hid_service_get_num_profiles() {
+  return num_profiles;
+}
+
+const DeviceProfile *hid_service_get_profile(size_t index) {
+  return index < num_profiles ? &profiles[index] : nullptr;
+}
+
+int hid_service_find_profile(std::string_view name) {
+  for (size_t i = 0; i < num_profiles; i++) {
+    if (profiles[i].name == name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int hid_service_get_active_profile() {
+  return default_device.active_profile();
+}
+
+bool hid_service_switch_profile(size_t index) {
+  return default_device.switch_profile(index);
+}
+
+static_assert(hid::bundle::MAX_INPUT_REPORTS <= HID_MAX_INPUT_REPORTS,
+              "bundle profiles must fit in the HID service table");
+
+int hid_service_load_profile_bundle(std::string_view partition_label) {
+  // the bundle is used in place, so the mapping (and the bundle which refers
+  // to it) are kept for as long as the profiles are registered
+  static hid::bundle::Bundle bundle;
+  static esp_partition_mmap_handle_t mmap_handle;
+  if (bundle.valid()) {
+    logger.error("A profile bundle has already been loaded");
+    return -1;
+  }
+
+  auto start_us = esp_timer_get_time();
+  std::string label(partition_label);
+  auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label.c_str());
+  if (!partition) {
+    logger.warn("No '{}' partition, not loading a profile bundle", label);
+    return -1;
+  }
+  const void *mapped = nullptr;
+  auto err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &mapped, &mmap_handle);
+  if (err != ESP_OK) {
+    logger.error("Could not mmap the '{}' partition: {}", label, esp_err_to_name(err));
+    return -1;
+  }
+  auto error = bundle.open({static_cast<const uint8_t*>(mapped), partition->size});
+  if (error != hid::bundle::Error::NONE) {
+    logger.warn("No valid profile bundle in the '{}' partition: {}", label, hid::bundle::error_string(error));
+    esp_partition_munmap(mmap_handle);
+    return -1;
+  }
+
+  int num_registered = 0;
+  for (size_t i = 0; i < bundle.num_profiles(); i++) {
+    const auto &record = bundle.record(i);
+    DeviceProfile profile;
+    profile.name = bundle.string(record.name);
+    profile.report_descriptor = bundle.bytes(record.report_descriptor).data();
+    profile.report_descriptor_len = record.report_descriptor.length;
+    profile.vendor_id = record.vendor_id;
+    profile.product_id = record.product_id;
+    profile.product_version = record.product_version;
+    profile.appearance = record.appearance;
+    profile.manufacturer_name = bundle.string(record.manufacturer_name);
+    profile.model_number = bundle.string(record.model_number);
+    std::copy(record.input_report_ids, record.input_report_ids + record.num_input_reports,
+              profile.input_report_ids);
+    std::copy(record.input_report_sizes, record.input_report_sizes + record.num_input_reports,
+              profile.input_report_sizes);
+    profile.num_input_reports = record.num_input_reports;
+    if (hid_service_find_profile(profile.name) >= 0) {
+      logger.warn("Profile '{}' is already registered, skipping it", profile.name);
+      continue;
+    }
+    if (hid_service_register_profile(profile) >= 0) {
+      num_registered++;
+    }
+  }
+  logger.info("Loaded {} of {} profiles from the '{}' partition ({} bytes) in {} us",
+              num_registered, bundle.num_profiles(), label, bundle.header().total_size,
+              esp_timer_get_time() - start_us);
+  return num_registered;
 }
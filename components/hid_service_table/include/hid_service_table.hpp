@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <string>
 
 #include <esp_bt.h>
@@ -11,49 +12,152 @@
 #include <esp_bt_main.h>
 #include <esp_gatt_common_api.h>
 
+#include "battery_service_table.hpp"
+#include "device_information_service_table.hpp"
+#include "gatt_service_builder.hpp"
+
+/// The maximum number of input reports (report IDs) exposed by the HID
+/// service, each one gets its own HID Report characteristic.
+#define HID_MAX_INPUT_REPORTS 4
+
+/// The number of attributes of each HID Report characteristic
+#define HID_REPORT_NB_ATTRS 4
+
+/* The largest supported characteristic values. The stack allocates max length
+ * bytes for every value, so the table which is created is sized to the active
+ * report map and its input reports instead (see HidServiceTable).
+ */
+#define HID_REPORT_MAX_LEN          255
+#define HID_REPORT_MAP_MAX_LEN      512
+
+#define HID_FLAGS_REMOTE_WAKE           0x01      // RemoteWake
+#define HID_FLAGS_NORMALLY_CONNECTABLE  0x02      // NormallyConnectable
+#define HID_FLAGS                                           \
+  (HID_FLAGS_REMOTE_WAKE | HID_FLAGS_NORMALLY_CONNECTABLE)
+
+inline constexpr uint8_t hid_info[] = {
+  0x11, 0x01,             // bcdHID (USB HID version 1.11)
+  0x00,                   // bCountryCode
+  HID_FLAGS               // Flags
+};
+inline constexpr uint8_t hid_protocol_mode[] = {0x01}; // 0x01 = report mode, 0x00 = boot mode
+// LSb corresponds to notifications (1 if enabled, 0 if disabled), next bit
+// (bit 1) corresponds to indications - 1 if enabled, 0 if disabled
+inline constexpr uint8_t hid_report_notify_ccc[] = {0x01, 0x00};
+
+/// Report reference (report ID, report type) of each input report, as
+/// hid_gatt_db declares them (HidServiceTable has its own)
+extern uint8_t hid_report_ref[HID_MAX_INPUT_REPORTS][2];
+
+/// HID Service Attribute Table
+inline constexpr auto hid_gatt_db = gatt::service<ESP_GATT_UUID_HID_SVC>(
+  // Included Battery Service, UUID: 0x180F
+  gatt::include<bas_att_db>(),
+  // Included Device Information Service, UUID: 0x180A
+  gatt::include<dis_att_db>(),
+  // HID Information characteristic, UUID: 0x2A4A, Properties: read
+  gatt::characteristic<ESP_GATT_UUID_HID_INFORMATION, gatt::PROP_READ>(
+    ESP_GATT_PERM_READ, gatt::value(hid_info)),
+  // HID Control Point characteristic, UUID: 0x2A4C, Properties: write without response
+  gatt::characteristic<ESP_GATT_UUID_HID_CONTROL_POINT, gatt::PROP_WRITE_NR>(
+    ESP_GATT_PERM_WRITE, gatt::empty(sizeof(uint8_t))),
+  // HID Report Map characteristic, UUID: 0x2A4B, Properties: read. The value
+  // is set once the table is created, see HidServiceTable::set_report_descriptor()
+  gatt::characteristic<ESP_GATT_UUID_HID_REPORT_MAP, gatt::PROP_READ>(
+    ESP_GATT_PERM_READ | ESP_GATT_PERM_READ_ENCRYPTED, gatt::empty(HID_REPORT_MAP_MAX_LEN),
+    gatt::descriptor<ESP_GATT_UUID_EXT_RPT_REF_DESCR>(
+      ESP_GATT_PERM_READ, gatt::uuid_value<ESP_GATT_UUID_BATTERY_LEVEL>())),
+  // HID Protocol Mode characteristic, UUID: 0x2A4E, Properties: read, write without response
+  gatt::characteristic<ESP_GATT_UUID_HID_PROTO_MODE, gatt::PROP_READ | gatt::PROP_WRITE_NR>(
+    ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, gatt::value(hid_protocol_mode)),
+  // HID Report characteristic, UUID: 0x2A4D, Properties: read, notify
+  // NOTE: these must be the last attributes in the table. There is one per
+  // input report, and only the ones for the configured input reports are
+  // created (see HidServiceTable::num_attributes()).
+  gatt::repeat<HID_MAX_INPUT_REPORTS>([](size_t i) {
+    return gatt::characteristic<ESP_GATT_UUID_HID_REPORT, gatt::PROP_READ | gatt::PROP_NOTIFY>(
+      ESP_GATT_PERM_READ | ESP_GATT_PERM_READ_ENCRYPTED, gatt::empty(HID_REPORT_MAX_LEN),
+      gatt::cccd(ESP_GATT_PERM_WRITE | ESP_GATT_PERM_WRITE_ENCRYPTED, gatt::value(hid_report_notify_ccc)),
+      gatt::descriptor<ESP_GATT_UUID_RPT_REF_DESCR>(ESP_GATT_PERM_READ, gatt::value(hid_report_ref[i])));
+  }));
+
 /* Attributes State Machine */
 enum
   {
     // HID Service, UUID: 0x1812
-    IDX_SVC_HID,
+    IDX_SVC_HID = 0,
 
     // Included Service Battery Service, UUID: 0x180F
-    IDX_HID_INCL_BAT_SVC,
+    IDX_HID_INCL_BAT_SVC = hid_gatt_db.index_of(ESP_GATT_UUID_INCLUDE_SERVICE, 0),
 
     // Included Service Device Information Service, UUID: 0x180A
-    IDX_HID_INCL_DIS_SVC,
+    IDX_HID_INCL_DIS_SVC = hid_gatt_db.index_of(ESP_GATT_UUID_INCLUDE_SERVICE, 1),
 
-    // HID Information characteristic, UUID: 0x2A4A, Properties: read
-    IDX_CHAR_HID_INFO,
-    IDX_CHAR_VAL_HID_INFO,
+    IDX_CHAR_HID_INFO = hid_gatt_db.declaration_index(ESP_GATT_UUID_HID_INFORMATION),
+    IDX_CHAR_VAL_HID_INFO = hid_gatt_db.value_index(ESP_GATT_UUID_HID_INFORMATION),
 
-    // HID Control Point characteristic, UUID: 0x2A4C, Properties: write without response
-    IDX_CHAR_HID_CONTROL_POINT,
-    IDX_CHAR_VAL_HID_CONTROL_POINT,
+    IDX_CHAR_HID_CONTROL_POINT = hid_gatt_db.declaration_index(ESP_GATT_UUID_HID_CONTROL_POINT),
+    IDX_CHAR_VAL_HID_CONTROL_POINT = hid_gatt_db.value_index(ESP_GATT_UUID_HID_CONTROL_POINT),
 
-    // HID Report Map characteristic, UUID: 0x2A4B, Properties: read
-    IDX_CHAR_HID_REPORT_MAP,
-    IDX_CHAR_VAL_HID_REPORT_MAP,
-    IDX_CHAR_EXT_HID_REPORT_MAP,
+    IDX_CHAR_HID_REPORT_MAP = hid_gatt_db.declaration_index(ESP_GATT_UUID_HID_REPORT_MAP),
+    IDX_CHAR_VAL_HID_REPORT_MAP = hid_gatt_db.value_index(ESP_GATT_UUID_HID_REPORT_MAP),
+    IDX_CHAR_EXT_HID_REPORT_MAP = hid_gatt_db.descriptor_index(ESP_GATT_UUID_HID_REPORT_MAP,
+                                                               ESP_GATT_UUID_EXT_RPT_REF_DESCR),
 
-    // HID Protocol Mode characteristic, UUID: 0x2A4E, Properties: read, write without response
-    IDX_CHAR_HID_PROTOCOL_MODE,
-    IDX_CHAR_VAL_HID_PROTOCOL_MODE,
+    IDX_CHAR_HID_PROTOCOL_MODE = hid_gatt_db.declaration_index(ESP_GATT_UUID_HID_PROTO_MODE),
+    IDX_CHAR_VAL_HID_PROTOCOL_MODE = hid_gatt_db.value_index(ESP_GATT_UUID_HID_PROTO_MODE),
 
-    // HID Report characteristic, UUID: 0x2A4D, Properties: read, notify
-    IDX_CHAR_HID_REPORT,
-    IDX_CHAR_VAL_HID_REPORT,
-    IDX_CHAR_CFG_HID_REPORT,
-    IDX_CHAR_REP_HID_REPORT,
+    // the HID Report characteristic of the first input report, see
+    // hid_report_attr_index() for the others
+    IDX_CHAR_HID_REPORT = hid_gatt_db.declaration_index(ESP_GATT_UUID_HID_REPORT),
+    IDX_CHAR_VAL_HID_REPORT = hid_gatt_db.value_index(ESP_GATT_UUID_HID_REPORT),
+    IDX_CHAR_CFG_HID_REPORT = hid_gatt_db.descriptor_index(ESP_GATT_UUID_HID_REPORT,
+                                                           ESP_GATT_UUID_CHAR_CLIENT_CONFIG),
+    IDX_CHAR_REP_HID_REPORT = hid_gatt_db.descriptor_index(ESP_GATT_UUID_HID_REPORT,
+                                                           ESP_GATT_UUID_RPT_REF_DESCR),
 
-    IDX_HID_NB,
+    IDX_HID_NB = hid_gatt_db.size(),
   };
 
+static_assert(hid_gatt_db.value_index(ESP_GATT_UUID_HID_REPORT, 1) - IDX_CHAR_VAL_HID_REPORT == HID_REPORT_NB_ATTRS,
+              "HID_REPORT_NB_ATTRS must match the HID Report characteristic");
+static_assert(IDX_CHAR_HID_REPORT + HID_MAX_INPUT_REPORTS * HID_REPORT_NB_ATTRS == IDX_HID_NB,
+              "the HID Report characteristics must be the last attributes");
+
+/// Index of an attribute (one of IDX_CHAR_*_HID_REPORT) of the HID Report
+/// characteristic for the input report at report_index.
+static constexpr int hid_report_attr_index(size_t report_index, int attr) {
+  return attr + static_cast<int>(report_index) * HID_REPORT_NB_ATTRS;
+}
+
+/// The HID service table which is actually created: hid_gatt_db with the
+/// report map and input report values sized to a profile, and its own report
+/// references, so that several HID services can be created from it.
+class HidServiceTable {
+public:
+  HidServiceTable();
+
+  HidServiceTable(const HidServiceTable &) = delete;
+  HidServiceTable &operator=(const HidServiceTable &) = delete;
+
+  void set_report_descriptor(const uint8_t *descriptor, size_t len);
+  void set_input_reports(const uint8_t *report_ids, const uint16_t *report_sizes, size_t num_reports);
 
-extern uint8_t *report_descriptor;
-extern size_t report_descriptor_len;
-extern const esp_gatts_attr_db_t hid_gatt_db[IDX_HID_NB];
+  const uint8_t *report_descriptor() const { return report_descriptor_; }
+  size_t report_descriptor_len() const { return report_descriptor_len_; }
+  size_t num_input_reports() const { return num_input_reports_; }
+  uint8_t input_report_id(size_t report_index) const { return report_ref_[report_index][0]; }
+  uint16_t input_report_size(size_t report_index) const {
+    return attributes_[hid_report_attr_index(report_index, IDX_CHAR_VAL_HID_REPORT)].att_desc.max_length;
+  }
+  /// Only the HID Report characteristics of the configured input reports are created
+  uint16_t num_attributes() const { return IDX_CHAR_HID_REPORT + num_input_reports_ * HID_REPORT_NB_ATTRS; }
+  const esp_gatts_attr_db_t *attributes() const { return attributes_.data(); }
 
-void hid_service_table_set_report_descriptor(uint8_t *descriptor, size_t len);
-void hid_service_table_set_included_battery_service_handles(uint16_t start_handle, uint16_t end_handle);
-void hid_service_table_set_included_dev_info_service_handles(uint16_t start_handle, uint16_t end_handle);
+protected:
+  std::array<esp_gatts_attr_db_t, IDX_HID_NB> attributes_;
+  uint8_t report_ref_[HID_MAX_INPUT_REPORTS][2];
+  size_t num_input_reports_{1};
+  const uint8_t *report_descriptor_{nullptr};
+  size_t report_descriptor_len_{0};
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include <sdkconfig.h>
+
+// Input bridge: input reports from a PC or another MCU, framed over a byte
+// stream (a UART, or a pipe in the host simulator), sent to the host as soon
+// as they arrive:
+//
+//   input_bridge::Bridge bridge({
+//       .read = input_bridge::uart_transport(1, 921600, 16, 17, 1024, 2),
+//       .send = [](uint8_t report_id, const uint8_t *report, size_t length) {
+//         hid_service_send_input_report(report_id, report, length);
+//       },
+//       .on_coalesced = hid_service_add_coalesced_reports,
+//   });
+//   ...
+//   bridge.poll(10); // in a task of its own, over and over
+//
+// A frame is a FrameHeader, its payload (the report, as the active report
+// map has it) and the CRC-16/CCITT-FALSE of everything but the sync bytes,
+// little endian. The frames are parsed where they were read to; a bad CRC or
+// a length over MAX_PAYLOAD_LEN drops the first sync byte, and the parser
+// looks for the next one. Of the frames a read brings in, only the latest of
+// each report is sent (the others are coalesced), so a backlog costs no air
+// time. tools/bridge_send.py sends frames from a PC.
+
+namespace input_bridge {
+
+static constexpr uint8_t SYNC_0 = 0xA5;
+static constexpr uint8_t SYNC_1 = 0x5A;
+/// The longest report a frame carries
+static constexpr size_t MAX_PAYLOAD_LEN = 64;
+
+struct __attribute__((packed)) FrameHeader {
+  uint8_t sync[2];   ///< SYNC_0, SYNC_1
+  uint8_t report_id;
+  uint8_t length;    ///< of the payload
+  uint16_t sequence; ///< counted up by the sender, so the frames lost on the line are known
+};
+
+static constexpr size_t CRC_LEN = sizeof(uint16_t);
+static constexpr size_t MAX_FRAME_LEN = sizeof(FrameHeader) + MAX_PAYLOAD_LEN + CRC_LEN;
+
+/// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xffff)
+uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc = 0xffff);
+
+/// Frame a report, for a sender
+/// @param out  at least MAX_FRAME_LEN bytes
+/// @return The frame's length, 0 if the report is longer than MAX_PAYLOAD_LEN
+size_t encode(uint8_t report_id, uint16_t sequence, std::span<const uint8_t> report, uint8_t *out);
+
+/// A frame, its payload where it was parsed
+struct Frame {
+  uint8_t report_id;
+  uint16_t sequence;
+  std::span<const uint8_t> payload;
+};
+
+class Parser {
+public:
+  struct Stats {
+    uint32_t frames{0};
+    uint32_t crc_errors{0};
+    uint32_t too_long{0};      ///< frames whose length was over MAX_PAYLOAD_LEN
+    uint32_t bytes_skipped{0}; ///< looking for a frame's start
+  };
+
+  /// Parse the frames in data, in place, calling on_frame(const Frame &) for
+  /// each one, whose payload is a part of data
+  /// @return The bytes consumed: the rest starts a frame which isn't complete
+  ///         yet, to be passed again with the bytes which follow it
+  template <typename F> size_t parse(std::span<const uint8_t> data, F &&on_frame) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+      if (data[offset] != SYNC_0 || (offset + 1 < data.size() && data[offset + 1] != SYNC_1)) {
+        offset++;
+        stats_.bytes_skipped++;
+        continue;
+      }
+      if (data.size() - offset < sizeof(FrameHeader)) {
+        break;
+      }
+      FrameHeader header;
+      memcpy(&header, &data[offset], sizeof(header));
+      if (header.length > MAX_PAYLOAD_LEN) {
+        stats_.too_long++;
+        offset++;
+        stats_.bytes_skipped++;
+        continue;
+      }
+      size_t frame_len = sizeof(FrameHeader) + header.length + CRC_LEN;
+      if (data.size() - offset < frame_len) {
+        break;
+      }
+      const uint8_t *frame = &data[offset];
+      uint16_t crc = frame[frame_len - 2] | (frame[frame_len - 1] << 8);
+      if (crc != crc16(frame + 2, frame_len - 2 - CRC_LEN)) {
+        stats_.crc_errors++;
+        offset++;
+        stats_.bytes_skipped++;
+        continue;
+      }
+      stats_.frames++;
+      on_frame(Frame{.report_id = header.report_id,
+                     .sequence = header.sequence,
+                     .payload = data.subspan(offset + sizeof(FrameHeader), header.length)});
+      offset += frame_len;
+    }
+    return offset;
+  }
+
+  const Stats &stats() const { return stats_; }
+
+protected:
+  Stats stats_;
+};
+
+/// Times in microseconds, counted in power of two sized buckets: bucket 0
+/// holds 0 us, bucket i holds [2^(i-1), 2^i) us and the last one everything
+/// longer. Added to from one task.
+class Histogram {
+public:
+  static constexpr size_t NUM_BUCKETS = 24;
+
+  void add(uint32_t us);
+  uint32_t count() const { return count_; }
+  uint32_t max() const { return max_; }
+
+  /// The time which the given fraction (e.g. 0.99) of the samples do not
+  /// exceed, as the upper end of its bucket (but no more than the maximum)
+  uint32_t percentile(float fraction) const;
+
+protected:
+  std::array<uint32_t, NUM_BUCKETS> buckets_{};
+  uint32_t count_{0};
+  uint32_t max_{0};
+};
+
+class Bridge {
+public:
+  /// Read what has arrived into buffer, waiting at most timeout_ms for the
+  /// first byte
+  /// @return The bytes read, 0 if none came, < 0 on an error
+  using Read = std::function<int(uint8_t *buffer, size_t size, uint32_t timeout_ms)>;
+  /// Send an input report, e.g. with hid_service_send_input_report()
+  using Send = std::function<void(uint8_t report_id, const uint8_t *report, size_t length)>;
+  /// Frames a read brought in which a later one of the same report replaced,
+  /// e.g. for hid_service_add_coalesced_reports()
+  using OnCoalesced = std::function<void(uint32_t count)>;
+
+  /// Distinct reports coalesced at once, further ones are sent as they are
+  static constexpr size_t MAX_REPORTS = 8;
+
+  struct Config {
+    Read read{nullptr};
+    Send send{nullptr};
+    OnCoalesced on_coalesced{nullptr}; ///< may be nullptr, Stats::coalesced counts them either way
+    size_t buffer_size{1024};          ///< at least 2 * MAX_FRAME_LEN
+  };
+
+  struct Stats {
+    uint32_t reads{0};       ///< which brought bytes in
+    uint32_t read_errors{0};
+    uint32_t missed{0};      ///< frames the sequence numbers skipped, lost on the line
+    uint32_t coalesced{0};   ///< frames a later one of the same report replaced
+    uint32_t sent{0};
+    Histogram read_to_send; ///< from a read returning a frame until its report is sent
+  };
+
+  explicit Bridge(const Config &config);
+
+  /// Read what has arrived (waiting up to timeout_ms for it), parse it and
+  /// send the latest report of each report ID in it. Doesn't allocate. Call
+  /// it from one task only.
+  /// @return The reports sent
+  size_t poll(uint32_t timeout_ms);
+
+  const Parser::Stats &framing_stats() const { return parser_.stats(); }
+  const Stats &stats() const { return stats_; }
+
+protected:
+  void note_sequence(uint16_t sequence);
+
+  Config config_;
+  Parser parser_;
+  Stats stats_;
+  std::vector<uint8_t> buffer_;
+  size_t buffered_{0}; ///< the start of an incomplete frame, from the last read
+  std::array<Frame, MAX_REPORTS> latest_{};
+  bool sequenced_{false};
+  uint16_t next_sequence_{0};
+};
+
+/// A source of the bridge which reads a UART through the UART driver (with a
+/// ring buffer of rx_buffer_size bytes), 8N1, -1 keeping a pin as it is. The
+/// UART hands over what it received after rx_timeout_symbols of idle line.
+Bridge::Read uart_transport(int port, int baud_rate, int rx_gpio, int tx_gpio, size_t rx_buffer_size,
+                            int rx_timeout_symbols);
+
+} // namespace input_bridge
@@ -0,0 +1,124 @@
+#include "input_bridge.hpp"
+
+#include <algorithm>
+
+#include <esp_timer.h>
+
+namespace input_bridge {
+
+uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc) {
+  for (size_t i = 0; i < length; i++) {
+    crc ^= uint16_t(data[i]) << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+size_t encode(uint8_t report_id, uint16_t sequence, std::span<const uint8_t> report, uint8_t *out) {
+  if (report.size() > MAX_PAYLOAD_LEN) {
+    return 0;
+  }
+  FrameHeader header{.sync = {SYNC_0, SYNC_1},
+                     .report_id = report_id,
+                     .length = uint8_t(report.size()),
+                     .sequence = sequence};
+  memcpy(out, &header, sizeof(header));
+  memcpy(out + sizeof(header), report.data(), report.size());
+  size_t length = sizeof(header) + report.size();
+  uint16_t crc = crc16(out + 2, length - 2);
+  out[length++] = crc & 0xff;
+  out[length++] = crc >> 8;
+  return length;
+}
+
+void Histogram::add(uint32_t us) {
+  size_t bucket = us ? 32 - __builtin_clz(us) : 0;
+  buckets_[std::min(bucket, NUM_BUCKETS - 1)]++;
+  count_++;
+  max_ = std::max(max_, us);
+}
+
+uint32_t Histogram::percentile(float fraction) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  uint32_t rank = fraction * count_;
+  uint32_t seen = 0;
+  for (size_t i = 0; i < NUM_BUCKETS - 1; i++) {
+    seen += buckets_[i];
+    if (seen > rank) {
+      // the upper end of bucket i, which starts at 2^(i-1)
+      uint32_t end = (1u << i) - 1;
+      return std::min(end, max_);
+    }
+  }
+  return max_;
+}
+
+Bridge::Bridge(const Config &config)
+    : config_(config)
+    , buffer_(std::max(config.buffer_size, 2 * MAX_FRAME_LEN)) {}
+
+size_t Bridge::poll(uint32_t timeout_ms) {
+  if (!config_.read || !config_.send) {
+    return 0;
+  }
+  int count = config_.read(buffer_.data() + buffered_, buffer_.size() - buffered_, timeout_ms);
+  if (count < 0) {
+    stats_.read_errors++;
+    return 0;
+  }
+  if (count == 0) {
+    return 0;
+  }
+  int64_t read_us = esp_timer_get_time();
+  stats_.reads++;
+  size_t available = buffered_ + count;
+
+  // the latest frame of each report, the others are coalesced
+  uint32_t coalesced = stats_.coalesced;
+  size_t num_latest = 0;
+  size_t sent = 0;
+  auto send = [&](const Frame &frame) {
+    config_.send(frame.report_id, frame.payload.data(), frame.payload.size());
+    stats_.read_to_send.add(uint32_t(esp_timer_get_time() - read_us));
+    stats_.sent++;
+    sent++;
+  };
+  size_t consumed = parser_.parse(std::span<const uint8_t>(buffer_.data(), available), [&](const Frame &frame) {
+    note_sequence(frame.sequence);
+    auto end = latest_.begin() + num_latest;
+    auto latest = std::find_if(latest_.begin(), end, [&](const Frame &f) { return f.report_id == frame.report_id; });
+    if (latest != end) {
+      *latest = frame;
+      stats_.coalesced++;
+    } else if (num_latest < latest_.size()) {
+      latest_[num_latest++] = frame;
+    } else {
+      send(frame);
+    }
+  });
+  for (size_t i = 0; i < num_latest; i++) {
+    send(latest_[i]);
+  }
+  if (stats_.coalesced != coalesced && config_.on_coalesced) {
+    config_.on_coalesced(stats_.coalesced - coalesced);
+  }
+
+  // keep the start of an incomplete frame for the next read
+  buffered_ = available - consumed;
+  memmove(buffer_.data(), buffer_.data() + consumed, buffered_);
+  return sent;
+}
+
+void Bridge::note_sequence(uint16_t sequence) {
+  if (sequenced_ && sequence != next_sequence_) {
+    stats_.missed += uint16_t(sequence - next_sequence_);
+  }
+  sequenced_ = true;
+  next_sequence_ = sequence + 1;
+}
+
+} // namespace input_bridge
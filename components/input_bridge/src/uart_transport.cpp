@@ -0,0 +1,57 @@
+#include "input_bridge.hpp"
+
+#include <algorithm>
+
+#include <driver/uart.h>
+#include <freertos/FreeRTOS.h>
+
+#include "logger.hpp"
+
+namespace input_bridge {
+
+static espp::Logger logger({.tag = "input_bridge", .level = espp::Logger::Verbosity::INFO});
+
+Bridge::Read uart_transport(int port, int baud_rate, int rx_gpio, int tx_gpio, size_t rx_buffer_size,
+                            int rx_timeout_symbols) {
+  uart_port_t uart = uart_port_t(port);
+  uart_config_t config = {
+      .baud_rate = baud_rate,
+      .data_bits = UART_DATA_8_BITS,
+      .parity = UART_PARITY_DISABLE,
+      .stop_bits = UART_STOP_BITS_1,
+      .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+      .source_clk = UART_SCLK_DEFAULT,
+  };
+  esp_err_t err = uart_driver_install(uart, rx_buffer_size, 0, 0, nullptr, 0);
+  if (err == ESP_OK) {
+    err = uart_param_config(uart, &config);
+  }
+  if (err == ESP_OK) {
+    err = uart_set_pin(uart, tx_gpio >= 0 ? tx_gpio : UART_PIN_NO_CHANGE, rx_gpio >= 0 ? rx_gpio : UART_PIN_NO_CHANGE,
+                       UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+  }
+  if (err == ESP_OK) {
+    // hand over a burst once the line goes idle, not only once the FIFO fills
+    err = uart_set_rx_timeout(uart, rx_timeout_symbols);
+  }
+  if (err != ESP_OK) {
+    logger.error("Could not set up UART{} for the input bridge: {}", port, esp_err_to_name(err));
+    return nullptr;
+  }
+  return [uart](uint8_t *buffer, size_t size, uint32_t timeout_ms) -> int {
+    // wait for the first byte, then take whatever else is there already
+    int count = uart_read_bytes(uart, buffer, 1, pdMS_TO_TICKS(timeout_ms));
+    if (count <= 0) {
+      return count;
+    }
+    size_t buffered = 0;
+    uart_get_buffered_data_len(uart, &buffered);
+    if (buffered && size > 1) {
+      int more = uart_read_bytes(uart, buffer + 1, std::min(buffered, size - 1), 0);
+      count += more > 0 ? more : 0;
+    }
+    return count;
+  };
+}
+
+} // namespace input_bridge
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sdkconfig.h>
+
+// Input conditioning: turns a frame of raw axis readings (ADC counts of the
+// sticks and triggers) into calibrated, filtered and shaped values, before
+// they are built into a report:
+//
+//   static const auto curve = input_conditioning::Curve::power(2.0f);
+//   input_conditioning::Pipeline pipeline({
+//       .axes = {{.raw_min = 90, .raw_center = 2010, .raw_max = 4000, .curve = &curve}, // left stick x
+//                {.raw_min = 70, .raw_center = 2060, .raw_max = 4020, .curve = &curve}, // left stick y
+//                {.raw_min = 0, .raw_center = 0, .raw_max = 1023, .deadzone = 500}},    // trigger
+//       .sticks = {{.x = 0, .y = 1, .deadzone = 3000}},
+//       .filter = input_conditioning::Filter::ONE_EURO,
+//   });
+//   ...
+//   int16_t raw[3], conditioned[3];
+//   pipeline.process(raw, conditioned, esp_timer_get_time());
+//
+// Each frame goes through the stages in turn, each over all axes at once:
+// calibration, filtering, the radial deadzones of the sticks, then each
+// axis' own deadzones and response curve. The axes are kept in vectors of
+// LANES 16-bit values, and with CONFIG_INPUT_CONDITIONING_PIE the
+// calibration and the IIR filter are the ESP32-S3's vector instructions,
+// which do the same math as the scalar kernels.
+
+namespace input_conditioning {
+
+/// The axes are processed in vectors of this many 16-bit values (128 bits)
+static constexpr size_t LANES = 8;
+static constexpr size_t MAX_AXES = (CONFIG_INPUT_CONDITIONING_MAX_AXES + LANES - 1) / LANES * LANES;
+
+/// Conditioned values are in [-FULL_SCALE, FULL_SCALE], or [0, FULL_SCALE]
+/// for an axis centered at its minimum (a trigger)
+static constexpr int16_t FULL_SCALE = 32767;
+
+/// A response curve: the output at evenly spaced inputs from 0 to
+/// FULL_SCALE, interpolated linearly in between. It maps the magnitude, the
+/// sign is kept.
+struct Curve {
+  static constexpr int SEGMENT_SHIFT = 10;
+  static constexpr size_t POINTS = (FULL_SCALE >> SEGMENT_SHIFT) + 2;
+
+  std::array<int16_t, POINTS> points{};
+
+  /// |x|^exponent, e.g. 2 for finer control near the center
+  static Curve power(float exponent);
+
+  int16_t apply(int16_t magnitude) const;
+};
+
+/// The calibration and shaping of one axis
+struct Axis {
+  int16_t raw_min{0};
+  int16_t raw_center{2048}; ///< raw_min for an axis which only goes one way
+  int16_t raw_max{4095};
+  uint16_t deadzone{0};       ///< magnitudes up to this are 0, the rest is stretched over the full range
+  uint16_t outer_deadzone{0}; ///< magnitudes within this of FULL_SCALE are FULL_SCALE
+  const Curve *curve{nullptr}; ///< nullptr for a linear response
+};
+
+/// Two axes of a stick, which is centered as long as the length of (x, y) is
+/// within its deadzone. Unlike a deadzone on each axis, this doesn't snap the
+/// stick to the axes.
+struct Stick {
+  uint8_t x;
+  uint8_t y;
+  uint16_t deadzone;
+};
+
+enum class Filter : uint8_t {
+  NONE,
+  IIR,      ///< a one pole low pass: y += alpha * (x - y)
+  ONE_EURO, ///< a low pass whose cutoff rises with the speed: smooth at rest, with little lag when moving
+};
+
+/// The kernels of the calibration and the IIR filter
+enum class Kernels : uint8_t {
+  SCALAR,
+  PIE, ///< the ESP32-S3's vector instructions (CONFIG_INPUT_CONDITIONING_PIE)
+};
+
+#if CONFIG_INPUT_CONDITIONING_PIE
+static constexpr Kernels DEFAULT_KERNELS = Kernels::PIE;
+#else
+static constexpr Kernels DEFAULT_KERNELS = Kernels::SCALAR;
+#endif
+
+class Pipeline {
+public:
+  struct Config {
+    std::vector<Axis> axes;     ///< at most MAX_AXES
+    std::vector<Stick> sticks;
+    Filter filter{Filter::NONE};
+    uint16_t iir_alpha{16384};  ///< of 32768
+    // one-euro filter, in FULL_SCALE per second
+    float min_cutoff_hz{1.0f};
+    float beta{0.5f};
+    float derivative_cutoff_hz{1.0f};
+    Kernels kernels{DEFAULT_KERNELS}; ///< SCALAR if PIE is not built in
+  };
+
+  explicit Pipeline(const Config &config);
+
+  /// Condition a frame: raw holds a reading of every axis, in the order of
+  /// Config::axes, out gets their conditioned values. Doesn't allocate. Call
+  /// it from one task only.
+  /// @param now_us  when the readings were taken, for the one-euro filter
+  void process(const int16_t *raw, int16_t *out, int64_t now_us);
+
+  /// Forget the filters' state, e.g. after the inputs were idle: the next
+  /// frame is taken as it is
+  void reset();
+
+  size_t num_axes() const { return num_axes_; }
+  Kernels kernels() const { return kernels_; }
+
+protected:
+  // the calibration of a vector of axes, laid out for the kernels
+  struct alignas(16) Calibration {
+    int16_t center[LANES];
+    int16_t low[LANES];  ///< raw_min - raw_center, the lowest offset from the center
+    int16_t high[LANES]; ///< raw_max - raw_center
+    int16_t gain_below[LANES]; ///< of the offsets below the center, << gain_shift_
+    int16_t gain_above[LANES];
+  };
+
+  static constexpr size_t VECTORS = MAX_AXES / LANES;
+
+  void calibrate();
+  void filter(int64_t now_us);
+  void shape(int16_t *out);
+
+  Config config_;
+  size_t num_axes_;
+  size_t vectors_; ///< in use
+  Kernels kernels_;
+  uint32_t gain_shift_{0};
+  std::array<Calibration, VECTORS> calibration_{};
+  alignas(16) std::array<int16_t, MAX_AXES> raw_{};
+  alignas(16) std::array<int16_t, MAX_AXES> calibrated_{};
+  alignas(16) std::array<int16_t, MAX_AXES> filtered_{}; ///< the IIR filter's state
+  alignas(16) std::array<int16_t, LANES> alpha_{};
+  std::array<float, MAX_AXES> euro_value_{};
+  std::array<float, MAX_AXES> euro_speed_{};
+  int64_t last_us_{0};
+  bool primed_{false};
+};
+
+} // namespace input_conditioning
@@ -0,0 +1,185 @@
+#include "input_conditioning.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if CONFIG_INPUT_CONDITIONING_PIE
+// input_conditioning_pie.S, over whole vectors of 16-byte aligned lanes
+extern "C" void input_conditioning_calibrate_pie(const int16_t *raw, const void *calibration, int16_t *out,
+                                                 size_t vectors, uint32_t gain_shift);
+extern "C" void input_conditioning_iir_pie(const int16_t *in, int16_t *state, const int16_t *alpha, size_t vectors);
+#endif
+
+namespace input_conditioning {
+
+static int16_t saturate(int32_t value) { return int16_t(std::clamp<int32_t>(value, INT16_MIN, INT16_MAX)); }
+
+Curve Curve::power(float exponent) {
+  Curve curve;
+  for (size_t i = 0; i < POINTS; i++) {
+    float x = std::min<float>(i << SEGMENT_SHIFT, FULL_SCALE) / FULL_SCALE;
+    curve.points[i] = int16_t(std::lround(FULL_SCALE * std::pow(x, exponent)));
+  }
+  return curve;
+}
+
+int16_t Curve::apply(int16_t magnitude) const {
+  // the last segment is a count short of the others, so it wouldn't get there
+  if (magnitude >= FULL_SCALE) {
+    return points[POINTS - 1];
+  }
+  size_t index = magnitude >> SEGMENT_SHIFT;
+  int32_t fraction = magnitude & ((1 << SEGMENT_SHIFT) - 1);
+  return int16_t(points[index] + (((points[index + 1] - points[index]) * fraction) >> SEGMENT_SHIFT));
+}
+
+Pipeline::Pipeline(const Config &config)
+    : config_(config)
+    , num_axes_(std::min(config.axes.size(), MAX_AXES))
+    , vectors_((num_axes_ + LANES - 1) / LANES)
+    , kernels_(config.kernels == Kernels::PIE && DEFAULT_KERNELS == Kernels::PIE ? Kernels::PIE : Kernels::SCALAR) {
+  // the gains are 16 bits with as many fraction bits as the narrowest range
+  // leaves room for, so that even a gain for it doesn't overflow
+  int32_t narrowest = FULL_SCALE;
+  for (size_t i = 0; i < num_axes_; i++) {
+    const auto &axis = config_.axes[i];
+    for (int32_t range : {axis.raw_center - axis.raw_min, axis.raw_max - axis.raw_center}) {
+      if (range > 0) {
+        narrowest = std::min(narrowest, range);
+      }
+    }
+  }
+  while (gain_shift_ < 15 && (2 << gain_shift_) <= narrowest) {
+    gain_shift_++;
+  }
+  for (size_t i = 0; i < num_axes_; i++) {
+    const auto &axis = config_.axes[i];
+    auto &calibration = calibration_[i / LANES];
+    size_t lane = i % LANES;
+    int32_t below = std::max(axis.raw_center - axis.raw_min, 0);
+    int32_t above = std::max(axis.raw_max - axis.raw_center, 0);
+    calibration.center[lane] = axis.raw_center;
+    calibration.low[lane] = saturate(-below);
+    calibration.high[lane] = saturate(above);
+    calibration.gain_below[lane] = below ? saturate((int32_t(FULL_SCALE) << gain_shift_) / below) : 0;
+    calibration.gain_above[lane] = above ? saturate((int32_t(FULL_SCALE) << gain_shift_) / above) : 0;
+  }
+  alpha_.fill(int16_t(std::min<uint16_t>(config_.iir_alpha, INT16_MAX)));
+}
+
+void Pipeline::process(const int16_t *raw, int16_t *out, int64_t now_us) {
+  std::copy_n(raw, num_axes_, raw_.begin());
+  calibrate();
+  filter(now_us);
+  shape(out);
+}
+
+void Pipeline::reset() { primed_ = false; }
+
+void Pipeline::calibrate() {
+#if CONFIG_INPUT_CONDITIONING_PIE
+  if (kernels_ == Kernels::PIE) {
+    input_conditioning_calibrate_pie(raw_.data(), calibration_.data(), calibrated_.data(), vectors_, gain_shift_);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < vectors_ * LANES; i++) {
+    const auto &calibration = calibration_[i / LANES];
+    size_t lane = i % LANES;
+    int32_t offset = std::clamp<int32_t>(saturate(raw_[i] - calibration.center[lane]), calibration.low[lane],
+                                         calibration.high[lane]);
+    int32_t below = (std::min(offset, 0) * calibration.gain_below[lane]) >> gain_shift_;
+    int32_t above = (std::max(offset, 0) * calibration.gain_above[lane]) >> gain_shift_;
+    calibrated_[i] = saturate(below + above);
+  }
+}
+
+void Pipeline::filter(int64_t now_us) {
+  switch (config_.filter) {
+  case Filter::NONE:
+    filtered_ = calibrated_;
+    break;
+  case Filter::IIR:
+    if (!primed_) {
+      filtered_ = calibrated_;
+      break;
+    }
+#if CONFIG_INPUT_CONDITIONING_PIE
+    if (kernels_ == Kernels::PIE) {
+      input_conditioning_iir_pie(calibrated_.data(), filtered_.data(), alpha_.data(), vectors_);
+      break;
+    }
+#endif
+    for (size_t i = 0; i < vectors_ * LANES; i++) {
+      int32_t step = (saturate(calibrated_[i] - filtered_[i]) * alpha_[i % LANES]) >> 15;
+      filtered_[i] = saturate(filtered_[i] + step);
+    }
+    break;
+  case Filter::ONE_EURO: {
+    // Casiez et al., "1 € Filter: A Simple Speed-based Low-pass Filter for
+    // Noisy Input in Interactive Systems", CHI 2012
+    float dt = (now_us - last_us_) / 1e6f;
+    if (!primed_ || dt <= 0) {
+      for (size_t i = 0; i < num_axes_; i++) {
+        euro_value_[i] = calibrated_[i];
+        euro_speed_[i] = 0;
+      }
+    } else {
+      auto smoothing = [dt](float cutoff_hz) { return 1 / (1 + 1 / (2 * float(M_PI) * cutoff_hz * dt)); };
+      float speed_alpha = smoothing(config_.derivative_cutoff_hz);
+      for (size_t i = 0; i < num_axes_; i++) {
+        float speed = (calibrated_[i] - euro_value_[i]) / dt / FULL_SCALE;
+        euro_speed_[i] += speed_alpha * (speed - euro_speed_[i]);
+        float alpha = smoothing(config_.min_cutoff_hz + config_.beta * std::fabs(euro_speed_[i]));
+        euro_value_[i] += alpha * (calibrated_[i] - euro_value_[i]);
+      }
+    }
+    for (size_t i = 0; i < num_axes_; i++) {
+      filtered_[i] = saturate(std::lround(euro_value_[i]));
+    }
+    break;
+  }
+  }
+  last_us_ = now_us;
+  primed_ = true;
+}
+
+void Pipeline::shape(int16_t *out) {
+  std::copy_n(filtered_.begin(), num_axes_, out);
+  for (const auto &stick : config_.sticks) {
+    if (stick.x >= num_axes_ || stick.y >= num_axes_) {
+      continue;
+    }
+    float x = out[stick.x], y = out[stick.y];
+    float length = std::hypot(x, y);
+    if (length <= stick.deadzone) {
+      out[stick.x] = out[stick.y] = 0;
+      continue;
+    }
+    // the rest of the way out is stretched over the full range
+    float stretched = std::min<float>(length - stick.deadzone, FULL_SCALE - stick.deadzone) * FULL_SCALE /
+                      (FULL_SCALE - stick.deadzone);
+    out[stick.x] = saturate(std::lround(x * stretched / length));
+    out[stick.y] = saturate(std::lround(y * stretched / length));
+  }
+  for (size_t i = 0; i < num_axes_; i++) {
+    const auto &axis = config_.axes[i];
+    int32_t magnitude = std::min<int32_t>(std::abs(out[i]), FULL_SCALE);
+    int32_t inner = std::min<int32_t>(axis.deadzone, FULL_SCALE - 1);
+    int32_t outer = std::max<int32_t>(FULL_SCALE - axis.outer_deadzone, inner + 1);
+    if (magnitude <= inner) {
+      magnitude = 0;
+    } else if (magnitude >= outer) {
+      magnitude = FULL_SCALE;
+    } else {
+      magnitude = (magnitude - inner) * FULL_SCALE / (outer - inner);
+    }
+    if (axis.curve) {
+      magnitude = axis.curve->apply(magnitude);
+    }
+    out[i] = int16_t(out[i] < 0 ? -magnitude : magnitude);
+  }
+}
+
+} // namespace input_conditioning
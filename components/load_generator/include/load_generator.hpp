@@ -0,0 +1,255 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Load generator: input reports sent on a schedule, either replayed from a
+// recorded trace or from a synthetic pattern (a rate, optionally in bursts),
+// measuring how well the report path keeps up with it:
+//
+//   load_generator::Pattern pattern({.report_id = 1, .report = report, .rate_hz = 1000, .count = 10000});
+//   load_generator::Generator generator({
+//       .send = [](uint8_t report_id, const uint8_t *report, size_t length) {
+//         hid_service_send_input_report(report_id, report, length);
+//       },
+//       .queue_depth = []() -> size_t {
+//         const auto &latency = hid_service_get_report_latency();
+//         return latency.sent - latency.completed - latency.failed - latency.lost;
+//       },
+//   });
+//   hid_service_reset_report_latency();
+//   auto &stats = generator.run(pattern.source(), pattern.duration_us());
+//   const auto &latency = hid_service_get_report_latency();
+//   fmt::print("{}\n", load_generator::result_json("pattern", stats, {
+//       .dropped = latency.failed + latency.lost,
+//       .completed = latency.completed,
+//       .latency_p50_us = latency.total.percentile(0.5f),
+//       .latency_p99_us = latency.total.percentile(0.99f),
+//       .latency_max_us = latency.total.max(),
+//   }));
+//
+// The schedule only depends on the source, so a run can be repeated exactly,
+// on target as well as in the host simulator (whose clock is the simulated
+// link's, making its runs deterministic).
+//
+// A trace (all integers little endian) is a TraceHeader and num_records
+// records, each a RecordHeader followed by its report. Records are in time
+// order. Traces are built with TraceWriter, tools/input_trace.py (from CSV
+// or a pattern) or recorded by the simulator, and are replayed in place,
+// e.g. from a memory mapped data partition (see map_trace()).
+
+namespace load_generator {
+
+static constexpr uint32_t TRACE_MAGIC = 0x54444948; ///< "HIDT"
+static constexpr uint16_t TRACE_VERSION = 1;
+/// The longest report a trace holds, matching the HID report attribute
+static constexpr size_t MAX_REPORT_LEN = 255;
+
+struct TraceHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size; ///< sizeof(TraceHeader)
+  uint32_t num_records;
+  uint32_t duration_us; ///< from the start until the trace ends, at or after its last record
+  uint32_t total_size;  ///< header and records, in bytes
+};
+static_assert(sizeof(TraceHeader) == 20);
+
+struct __attribute__((packed)) RecordHeader {
+  uint32_t time_us; ///< from the start of the trace
+  uint8_t report_id;
+  uint8_t length; ///< of the report which follows
+};
+static_assert(sizeof(RecordHeader) == 6);
+
+/// A report to send, and when
+struct Event {
+  int64_t time_us; ///< from the start of the run
+  uint8_t report_id;
+  std::span<const uint8_t> report;
+};
+
+/// The events of a run, in time order: fills in the next one
+/// @return false once there are no more
+using Source = std::function<bool(Event &event)>;
+
+/// Reads a trace in place
+class TraceReader {
+public:
+  /// Check a trace's header and records
+  /// @return false if it isn't a valid trace, which then has no records
+  bool open(std::span<const uint8_t> data);
+
+  size_t size() const { return num_records_; }
+  int64_t duration_us() const { return duration_us_; }
+
+  /// The next record, its report where it is in the trace
+  bool next(Event &event);
+  /// Start over from the first record
+  void rewind() { offset_ = sizeof(TraceHeader); }
+
+  /// The trace as a source (which refers to this reader)
+  Source source() {
+    return [this](Event &event) { return next(event); };
+  }
+
+protected:
+  std::span<const uint8_t> data_;
+  size_t offset_{sizeof(TraceHeader)};
+  size_t num_records_{0};
+  int64_t duration_us_{0};
+};
+
+/// Builds a trace in memory, e.g. recording reports as they are sent
+class TraceWriter {
+public:
+  TraceWriter();
+
+  /// Add a record, at or after the previous one
+  /// @return false if the report is too long or the time goes backwards
+  bool add(uint32_t time_us, uint8_t report_id, std::span<const uint8_t> report);
+  size_t size() const { return num_records_; }
+
+  /// The trace, ending at duration_us (at least the last record's time)
+  const std::vector<uint8_t> &finish(uint32_t duration_us);
+
+protected:
+  std::vector<uint8_t> data_;
+  size_t num_records_{0};
+  uint32_t last_time_us_{0};
+};
+
+/// A synthetic load: count reports at rate_hz, burst of them at a time
+/// (every burst / rate_hz seconds, so the rate is the same on average).
+/// Byte 0 of the report counts up from the template's.
+class Pattern {
+public:
+  struct Config {
+    uint8_t report_id{0};
+    std::vector<uint8_t> report; ///< the template, at least 1 byte
+    uint32_t rate_hz{1000};
+    uint32_t count{1000};
+    uint32_t burst{1}; ///< reports sent back to back
+  };
+
+  explicit Pattern(const Config &config);
+
+  int64_t duration_us() const;
+  bool next(Event &event);
+  void rewind();
+
+  Source source() {
+    return [this](Event &event) { return next(event); };
+  }
+
+protected:
+  Config config_;
+  std::vector<uint8_t> report_;
+  uint32_t index_{0};
+};
+
+/// Times in microseconds, counted in power of two sized buckets: bucket 0
+/// holds 0 us, bucket i holds [2^(i-1), 2^i) us and the last one everything
+/// longer. Added to from one task.
+class Histogram {
+public:
+  static constexpr size_t NUM_BUCKETS = 24;
+
+  void add(uint32_t us);
+  void reset();
+  uint32_t count() const { return count_; }
+  uint32_t max() const { return max_; }
+
+  /// The time which the given fraction (e.g. 0.99) of the samples do not
+  /// exceed, as the upper end of its bucket (but no more than the maximum)
+  uint32_t percentile(float fraction) const;
+
+protected:
+  std::array<uint32_t, NUM_BUCKETS> buckets_{};
+  uint32_t count_{0};
+  uint32_t max_{0};
+};
+
+class Generator {
+public:
+  /// Send an input report, e.g. with hid_service_send_input_report()
+  using Send = std::function<void(uint8_t report_id, const uint8_t *report, size_t length)>;
+
+  struct Config {
+    Send send{nullptr};
+    /// Reports sent but not done yet (queued in the stack or in flight), may
+    /// be nullptr
+    std::function<size_t()> queue_depth{nullptr};
+    /// Skip (shed) a report while the queue is this deep, as an application
+    /// would rather than have the stack reject it. 0 never sheds.
+    size_t queue_limit{0};
+    /// The time in microseconds, esp_timer_get_time() by default
+    std::function<int64_t()> now_us{nullptr};
+    /// Wait until now_us() reaches the given time. By default it sleeps,
+    /// then spins through the last two milliseconds, which a sleep (in
+    /// FreeRTOS ticks) can't hit.
+    std::function<void(int64_t us)> wait_until{nullptr};
+  };
+
+  struct Stats {
+    uint32_t scheduled{0}; ///< reports the source had
+    uint32_t sent{0};
+    uint32_t shed{0}; ///< skipped at queue_limit
+    uint32_t max_queue_depth{0};
+    uint64_t queue_depth_sum{0}; ///< sampled before each report
+    int64_t duration_us{0};      ///< of the schedule
+    int64_t elapsed_us{0};       ///< from the start until the last report was sent, or the schedule ended
+    Histogram lateness;          ///< of each report sent, behind its schedule
+
+    /// Reports per second the source asked for
+    float offered_hz() const { return duration_us ? scheduled * 1e6f / duration_us : 0; }
+    /// Reports per second sent, over the schedule or as long as they took
+    float achieved_hz() const { return elapsed_us ? sent * 1e6f / elapsed_us : 0; }
+    float mean_queue_depth() const { return scheduled ? float(queue_depth_sum) / scheduled : 0; }
+  };
+
+  explicit Generator(const Config &config);
+
+  /// Send the source's reports on its schedule, starting now. Doesn't
+  /// allocate. Resets the stats first.
+  /// @param duration_us  of the schedule (e.g. the trace's), at least the
+  ///                     last event's time
+  const Stats &run(const Source &source, int64_t duration_us);
+
+  /// Change Config::queue_limit, between runs
+  void set_queue_limit(size_t queue_limit) { config_.queue_limit = queue_limit; }
+
+  const Stats &stats() const { return stats_; }
+
+protected:
+  void reset_stats();
+
+  Config config_;
+  Stats stats_;
+};
+
+/// What became of the reports sent during a run, as the report path (e.g. the
+/// hid service's ReportLatency, reset before the run) counted them
+struct Delivery {
+  uint32_t dropped{0};   ///< by the stack
+  uint32_t completed{0}; ///< confirmed by the stack
+  uint32_t latency_p50_us{0};
+  uint32_t latency_p99_us{0};
+  uint32_t latency_max_us{0};
+};
+
+/// The run as a single line of JSON, along with its reports' delivery, e.g.
+/// {"load":"pattern","offered_hz":1000.0,"achieved_hz":998.2,"sent":10000,"dropped":0,...}
+std::string result_json(std::string_view name, const Generator::Stats &stats, const Delivery &delivery);
+
+/// Memory map a data partition holding a trace and open it
+/// @return false if there is no such partition or no valid trace in it
+bool map_trace(std::string_view partition_label, TraceReader &reader);
+
+} // namespace load_generator
@@ -0,0 +1,221 @@
+#include "load_generator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <esp_timer.h>
+
+#include "format.hpp"
+
+namespace load_generator {
+
+bool TraceReader::open(std::span<const uint8_t> data) {
+  data_ = {};
+  num_records_ = 0;
+  duration_us_ = 0;
+  rewind();
+  TraceHeader header;
+  if (data.size() < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != TRACE_MAGIC || header.version != TRACE_VERSION || header.header_size != sizeof(header) ||
+      header.total_size < sizeof(header) || header.total_size > data.size()) {
+    return false;
+  }
+  // every record in bounds and in time order, so next() needn't check
+  size_t offset = sizeof(header);
+  uint32_t last_time_us = 0;
+  for (uint32_t i = 0; i < header.num_records; i++) {
+    RecordHeader record;
+    if (header.total_size - offset < sizeof(record)) {
+      return false;
+    }
+    memcpy(&record, &data[offset], sizeof(record));
+    offset += sizeof(record);
+    if (header.total_size - offset < record.length || record.time_us < last_time_us) {
+      return false;
+    }
+    offset += record.length;
+    last_time_us = record.time_us;
+  }
+  if (offset != header.total_size || header.duration_us < last_time_us) {
+    return false;
+  }
+  data_ = data.first(header.total_size);
+  num_records_ = header.num_records;
+  duration_us_ = header.duration_us;
+  return true;
+}
+
+bool TraceReader::next(Event &event) {
+  if (data_.size() - offset_ < sizeof(RecordHeader) || offset_ >= data_.size()) {
+    return false;
+  }
+  RecordHeader record;
+  memcpy(&record, &data_[offset_], sizeof(record));
+  offset_ += sizeof(record);
+  event = {.time_us = record.time_us, .report_id = record.report_id, .report = data_.subspan(offset_, record.length)};
+  offset_ += record.length;
+  return true;
+}
+
+TraceWriter::TraceWriter()
+    : data_(sizeof(TraceHeader)) {}
+
+bool TraceWriter::add(uint32_t time_us, uint8_t report_id, std::span<const uint8_t> report) {
+  if (report.size() > MAX_REPORT_LEN || time_us < last_time_us_) {
+    return false;
+  }
+  RecordHeader record{.time_us = time_us, .report_id = report_id, .length = uint8_t(report.size())};
+  auto bytes = reinterpret_cast<const uint8_t *>(&record);
+  data_.insert(data_.end(), bytes, bytes + sizeof(record));
+  data_.insert(data_.end(), report.begin(), report.end());
+  num_records_++;
+  last_time_us_ = time_us;
+  return true;
+}
+
+const std::vector<uint8_t> &TraceWriter::finish(uint32_t duration_us) {
+  TraceHeader header{
+      .magic = TRACE_MAGIC,
+      .version = TRACE_VERSION,
+      .header_size = sizeof(TraceHeader),
+      .num_records = uint32_t(num_records_),
+      .duration_us = std::max(duration_us, last_time_us_),
+      .total_size = uint32_t(data_.size()),
+  };
+  memcpy(data_.data(), &header, sizeof(header));
+  return data_;
+}
+
+Pattern::Pattern(const Config &config)
+    : config_(config)
+    , report_(config.report.empty() ? std::vector<uint8_t>(1) : config.report) {
+  config_.rate_hz = std::max(config_.rate_hz, uint32_t{1});
+  config_.burst = std::max(config_.burst, uint32_t{1});
+}
+
+int64_t Pattern::duration_us() const { return int64_t(config_.count) * 1000000 / config_.rate_hz; }
+
+bool Pattern::next(Event &event) {
+  if (index_ >= config_.count) {
+    return false;
+  }
+  // each burst starts where the reports in it would have been due at the rate
+  uint32_t burst_start = index_ - index_ % config_.burst;
+  report_[0] = uint8_t((config_.report.empty() ? 0 : config_.report[0]) + index_);
+  event = {.time_us = int64_t(burst_start) * 1000000 / config_.rate_hz,
+           .report_id = config_.report_id,
+           .report = report_};
+  index_++;
+  return true;
+}
+
+void Pattern::rewind() { index_ = 0; }
+
+void Histogram::add(uint32_t us) {
+  size_t bucket = us ? 32 - __builtin_clz(us) : 0;
+  buckets_[std::min(bucket, NUM_BUCKETS - 1)]++;
+  count_++;
+  max_ = std::max(max_, us);
+}
+
+void Histogram::reset() {
+  buckets_.fill(0);
+  count_ = 0;
+  max_ = 0;
+}
+
+uint32_t Histogram::percentile(float fraction) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  uint32_t rank = fraction * count_;
+  uint32_t seen = 0;
+  for (size_t i = 0; i < NUM_BUCKETS - 1; i++) {
+    seen += buckets_[i];
+    if (seen > rank) {
+      // the upper end of bucket i, which starts at 2^(i-1)
+      uint32_t end = (1u << i) - 1;
+      return std::min(end, max_);
+    }
+  }
+  return max_;
+}
+
+static void sleep_then_spin(int64_t until_us) {
+  static constexpr int64_t SPIN_US = 2000;
+  int64_t now_us = esp_timer_get_time();
+  if (until_us - now_us > SPIN_US) {
+    std::this_thread::sleep_for(std::chrono::microseconds(until_us - now_us - SPIN_US));
+  }
+  while (esp_timer_get_time() < until_us) {
+  }
+}
+
+Generator::Generator(const Config &config)
+    : config_(config) {
+  if (!config_.now_us) {
+    config_.now_us = esp_timer_get_time;
+  }
+  if (!config_.wait_until) {
+    config_.wait_until = sleep_then_spin;
+  }
+}
+
+void Generator::reset_stats() {
+  stats_.scheduled = 0;
+  stats_.sent = 0;
+  stats_.shed = 0;
+  stats_.max_queue_depth = 0;
+  stats_.queue_depth_sum = 0;
+  stats_.duration_us = 0;
+  stats_.elapsed_us = 0;
+  stats_.lateness.reset();
+}
+
+const Generator::Stats &Generator::run(const Source &source, int64_t duration_us) {
+  reset_stats();
+  stats_.duration_us = duration_us;
+  if (!source || !config_.send) {
+    return stats_;
+  }
+  int64_t start_us = config_.now_us();
+  Event event;
+  while (source(event)) {
+    stats_.scheduled++;
+    int64_t due_us = start_us + event.time_us;
+    if (config_.now_us() < due_us) {
+      config_.wait_until(due_us);
+    }
+    size_t depth = config_.queue_depth ? config_.queue_depth() : 0;
+    stats_.max_queue_depth = std::max(stats_.max_queue_depth, uint32_t(depth));
+    stats_.queue_depth_sum += depth;
+    if (config_.queue_limit && depth >= config_.queue_limit) {
+      stats_.shed++;
+      continue;
+    }
+    config_.send(event.report_id, event.report.data(), event.report.size());
+    stats_.sent++;
+    stats_.lateness.add(uint32_t(std::max(config_.now_us() - due_us, int64_t{0})));
+  }
+  // a run which kept up took as long as its schedule
+  stats_.elapsed_us = std::max(config_.now_us() - start_us, duration_us);
+  return stats_;
+}
+
+std::string result_json(std::string_view name, const Generator::Stats &stats, const Delivery &delivery) {
+  return fmt::format("{{\"load\":\"{}\",\"offered_hz\":{:.1f},\"achieved_hz\":{:.1f},\"scheduled\":{},\"sent\":{},"
+                     "\"shed\":{},\"dropped\":{},\"completed\":{},\"queue_max\":{},\"queue_mean\":{:.2f},"
+                     "\"late_p50_us\":{},\"late_p99_us\":{},\"late_max_us\":{},\"latency_p50_us\":{},"
+                     "\"latency_p99_us\":{},\"latency_max_us\":{}}}",
+                     name, stats.offered_hz(), stats.achieved_hz(), stats.scheduled, stats.sent, stats.shed,
+                     delivery.dropped, delivery.completed, stats.max_queue_depth, stats.mean_queue_depth(),
+                     stats.lateness.percentile(0.5f), stats.lateness.percentile(0.99f), stats.lateness.max(),
+                     delivery.latency_p50_us, delivery.latency_p99_us, delivery.latency_max_us);
+}
+
+} // namespace load_generator
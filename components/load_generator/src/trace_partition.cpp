@@ -0,0 +1,38 @@
+#include "load_generator.hpp"
+
+#include <string>
+
+#include <esp_partition.h>
+
+#include "logger.hpp"
+
+namespace load_generator {
+
+static espp::Logger logger({.tag = "load_generator", .level = espp::Logger::Verbosity::INFO});
+
+bool map_trace(std::string_view partition_label, TraceReader &reader) {
+  // the trace is replayed in place, so the mapping is kept for good
+  std::string label(partition_label);
+  auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label.c_str());
+  if (!partition) {
+    logger.warn("No '{}' partition, no trace to replay", label);
+    return false;
+  }
+  const void *mapped = nullptr;
+  esp_partition_mmap_handle_t mmap_handle;
+  auto err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &mapped, &mmap_handle);
+  if (err != ESP_OK) {
+    logger.error("Could not mmap the '{}' partition: {}", label, esp_err_to_name(err));
+    return false;
+  }
+  if (!reader.open({static_cast<const uint8_t *>(mapped), partition->size})) {
+    logger.warn("No valid input trace in the '{}' partition", label);
+    esp_partition_munmap(mmap_handle);
+    return false;
+  }
+  logger.info("Mapped an input trace of {} reports over {} ms from the '{}' partition", reader.size(),
+              reader.duration_us() / 1000, label);
+  return true;
+}
+
+} // namespace load_generator
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <esp_err.h>
+#include <sdkconfig.h>
+
+#ifndef CONFIG_POWER_SAVE_WAKE_LATENCY_BUDGET_US
+#define CONFIG_POWER_SAVE_WAKE_LATENCY_BUDGET_US 0
+#endif
+
+// Power save: dynamic frequency scaling and automatic light sleep while the
+// link is idle (CONFIG_POWER_SAVE). The chip only stays awake and at full
+// speed while input reports are in flight, which hid_service tells it:
+//
+//   power_save::init();                        // early in app_main()
+//   power_save::add_wake_gpio(GPIO_NUM_0, 0);  // wake on a button press
+//   ...
+//   power_save::report_started();              // a report was handed to the stack
+//   power_save::report_finished();             // and the stack is done with it
+//
+// Waking up costs latency: the time from an input waking the chip until its
+// report is sent is measured by hid_service (take_input_wake_us()) and kept
+// under CONFIG_POWER_SAVE_WAKE_LATENCY_BUDGET_US by blocking light sleep
+// (set_light_sleep_allowed()) for the rest of a connection once it is over.
+// Without CONFIG_POWER_SAVE everything here compiles to nothing.
+
+namespace power_save {
+
+#if CONFIG_POWER_SAVE
+
+/// Configure DFS (and light sleep) and create the locks
+esp_err_t init();
+
+/// Wake from light sleep while the GPIO is at the level (and pull it to the
+/// other one)
+esp_err_t add_wake_gpio(int gpio, int level);
+
+/// Hold the chip awake and at full speed, once per report in flight. Can be
+/// called from any task.
+void report_started();
+void report_finished();
+/// Reports holding the locks
+size_t reports_in_flight();
+
+/// When an input (GPIO) last woke the chip from light sleep, on the
+/// esp_timer clock, and forget it: 0 if none did since the last call
+int64_t take_input_wake_us();
+
+/// Block light sleep (e.g. while over the latency budget), or allow it again
+/// once no report is in flight
+void set_light_sleep_allowed(bool allowed);
+bool light_sleep_allowed();
+
+#else
+
+inline esp_err_t init() { return ESP_OK; }
+inline esp_err_t add_wake_gpio(int, int) { return ESP_ERR_NOT_SUPPORTED; }
+inline void report_started() {}
+inline void report_finished() {}
+inline size_t reports_in_flight() { return 0; }
+inline int64_t take_input_wake_us() { return 0; }
+inline void set_light_sleep_allowed(bool) {}
+inline bool light_sleep_allowed() { return false; }
+
+#endif
+
+} // namespace power_save
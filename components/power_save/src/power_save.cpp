@@ -0,0 +1,128 @@
+#include "power_save.hpp"
+
+#if CONFIG_POWER_SAVE
+
+#include <atomic>
+
+#include <driver/gpio.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+
+#include "logger.hpp"
+
+namespace power_save {
+
+static espp::Logger logger({.tag = "power_save", .level = espp::Logger::Verbosity::INFO});
+
+#if CONFIG_POWER_SAVE_LIGHT_SLEEP
+static constexpr bool LIGHT_SLEEP = true;
+#else
+static constexpr bool LIGHT_SLEEP = false;
+#endif
+
+static esp_pm_lock_handle_t reports_cpu_lock = nullptr;
+static esp_pm_lock_handle_t reports_sleep_lock = nullptr;
+static esp_pm_lock_handle_t budget_lock = nullptr;
+static std::atomic<size_t> in_flight{0};
+static std::atomic<bool> blocked{false};
+static std::atomic<int64_t> input_wake_us{0};
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+// called by the idle task on its way out of light sleep, with the scheduler
+// stopped: only note the time. Any other wake forgets an input's, which was
+// not followed by a report before the chip slept again.
+static esp_err_t light_sleep_exited(int64_t, void *) {
+  bool input = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO;
+  input_wake_us.store(input ? esp_timer_get_time() : 0, std::memory_order_relaxed);
+  return ESP_OK;
+}
+#endif
+
+esp_err_t init() {
+  esp_pm_config_t config = {
+      .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+      .min_freq_mhz = CONFIG_POWER_SAVE_MIN_FREQ_MHZ,
+      .light_sleep_enable = LIGHT_SLEEP,
+  };
+  esp_err_t err = esp_pm_configure(&config);
+  if (err != ESP_OK) {
+    logger.error("Could not configure power management: {}", esp_err_to_name(err));
+    return err;
+  }
+  if ((err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "hid_reports", &reports_cpu_lock)) != ESP_OK ||
+      (err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "hid_reports", &reports_sleep_lock)) != ESP_OK ||
+      (err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "wake_budget", &budget_lock)) != ESP_OK) {
+    logger.error("Could not create the power management locks: {}", esp_err_to_name(err));
+    return err;
+  }
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+  esp_pm_sleep_cbs_register_config_t callbacks = {};
+  callbacks.exit_cb = light_sleep_exited;
+  esp_pm_light_sleep_register_cbs(&callbacks);
+#endif
+  logger.info("DFS {}-{} MHz, light sleep {}", config.min_freq_mhz, config.max_freq_mhz,
+              config.light_sleep_enable ? "on" : "off");
+  return ESP_OK;
+}
+
+esp_err_t add_wake_gpio(int gpio, int level) {
+  gpio_config_t config = {
+      .pin_bit_mask = 1ULL << gpio,
+      .mode = GPIO_MODE_INPUT,
+      .pull_up_en = level ? GPIO_PULLUP_DISABLE : GPIO_PULLUP_ENABLE,
+      .pull_down_en = level ? GPIO_PULLDOWN_ENABLE : GPIO_PULLDOWN_DISABLE,
+      .intr_type = GPIO_INTR_DISABLE,
+  };
+  esp_err_t err = gpio_config(&config);
+  if (err == ESP_OK) {
+    err = gpio_wakeup_enable(gpio_num_t(gpio), level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+  }
+  if (err == ESP_OK) {
+    err = esp_sleep_enable_gpio_wakeup();
+  }
+  if (err != ESP_OK) {
+    logger.error("Could not wake on GPIO {}: {}", gpio, esp_err_to_name(err));
+  }
+  return err;
+}
+
+void report_started() {
+  if (!reports_cpu_lock) {
+    return;
+  }
+  // the locks count their acquisitions, so each report holds them once
+  esp_pm_lock_acquire(reports_cpu_lock);
+  esp_pm_lock_acquire(reports_sleep_lock);
+  in_flight.fetch_add(1, std::memory_order_relaxed);
+}
+
+void report_finished() {
+  if (!reports_cpu_lock) {
+    return;
+  }
+  in_flight.fetch_sub(1, std::memory_order_relaxed);
+  esp_pm_lock_release(reports_sleep_lock);
+  esp_pm_lock_release(reports_cpu_lock);
+}
+
+size_t reports_in_flight() { return in_flight.load(std::memory_order_relaxed); }
+
+int64_t take_input_wake_us() { return input_wake_us.exchange(0, std::memory_order_relaxed); }
+
+void set_light_sleep_allowed(bool allowed) {
+  if (!budget_lock || blocked.exchange(!allowed) == !allowed) {
+    return;
+  }
+  if (allowed) {
+    esp_pm_lock_release(budget_lock);
+  } else {
+    esp_pm_lock_acquire(budget_lock);
+  }
+}
+
+bool light_sleep_allowed() { return LIGHT_SLEEP && !blocked; }
+
+} // namespace power_save
+
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <esp_bt.h>
+#include <esp_gatt_defs.h>
+#include <esp_gatts_api.h>
+#include <esp_bt_defs.h>
+#include <esp_bt_device.h>
+#include <esp_bt_main.h>
+#include <esp_gatt_common_api.h>
+
+#include "gatt_service_builder.hpp"
+
+/// Version of the telemetry frame layout, bumped whenever it changes
+#define TELEMETRY_FRAME_VERSION 1
+
+/// The longest frame: the notification payload of the largest MTU which fits
+/// in one LE data channel PDU (251 bytes, less the L2CAP and ATT headers)
+#define TELEMETRY_MAX_FRAME_LEN 244
+
+/// A notification of the telemetry data characteristic is a frame: this
+/// header, then num_samples samples back to back, each a
+/// TelemetrySampleHeader and its length of bytes. Little endian as everything
+/// else in GATT.
+struct __attribute__((packed)) TelemetryFrameHeader {
+  uint8_t version;     ///< TELEMETRY_FRAME_VERSION
+  uint8_t num_samples;
+  uint16_t sequence;   ///< of the frame, so the host can tell it missed some
+};
+
+struct __attribute__((packed)) TelemetrySampleHeader {
+  uint8_t stream;
+  uint8_t length;      ///< of the sample's bytes, which follow
+};
+
+static_assert(sizeof(TelemetryFrameHeader) == 4 && sizeof(TelemetrySampleHeader) == 2,
+              "the frame layout is part of the service's interface");
+
+/// Telemetry service, a vendor service: 6e3f0101-5b9c-4a3e-9d2c-1f0a7b4c8e21
+inline constexpr gatt::Uuid TELEMETRY_SERVICE_UUID = std::array<uint8_t, ESP_UUID_LEN_128>{
+    0x6e, 0x3f, 0x01, 0x01, 0x5b, 0x9c, 0x4a, 0x3e, 0x9d, 0x2c, 0x1f, 0x0a, 0x7b, 0x4c, 0x8e, 0x21};
+/// Telemetry data characteristic: 6e3f0102-5b9c-4a3e-9d2c-1f0a7b4c8e21
+inline constexpr gatt::Uuid TELEMETRY_DATA_UUID = std::array<uint8_t, ESP_UUID_LEN_128>{
+    0x6e, 0x3f, 0x01, 0x02, 0x5b, 0x9c, 0x4a, 0x3e, 0x9d, 0x2c, 0x1f, 0x0a, 0x7b, 0x4c, 0x8e, 0x21};
+/// Telemetry credits characteristic: 6e3f0103-5b9c-4a3e-9d2c-1f0a7b4c8e21
+inline constexpr gatt::Uuid TELEMETRY_CREDITS_UUID = std::array<uint8_t, ESP_UUID_LEN_128>{
+    0x6e, 0x3f, 0x01, 0x03, 0x5b, 0x9c, 0x4a, 0x3e, 0x9d, 0x2c, 0x1f, 0x0a, 0x7b, 0x4c, 0x8e, 0x21};
+
+/// Telemetry Service Attribute Table
+inline constexpr auto telemetry_att_db = gatt::service<TELEMETRY_SERVICE_UUID>(
+  // Telemetry Data characteristic, Properties: notify. Frames are only ever
+  // notified, the stack keeps no value for them.
+  gatt::app_response(gatt::characteristic<TELEMETRY_DATA_UUID, gatt::PROP_NOTIFY>(
+    ESP_GATT_PERM_READ_ENCRYPTED, gatt::empty(TELEMETRY_MAX_FRAME_LEN),
+    gatt::cccd(ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE_ENCRYPTED))),
+  // Telemetry Credits characteristic, Properties: write, write without
+  // response. The host writes the number of further frames (uint16) it can
+  // take, the device sends no frame it has no credit for.
+  gatt::app_response(gatt::characteristic<TELEMETRY_CREDITS_UUID, gatt::PROP_WRITE | gatt::PROP_WRITE_NR>(
+    ESP_GATT_PERM_WRITE_ENCRYPTED, gatt::empty(sizeof(uint16_t)))));
+
+/// Telemetry Service Attributes Indexes
+enum
+{
+    TELEMETRY_IDX_SVC = 0,
+
+    TELEMETRY_IDX_DATA_CHAR = telemetry_att_db.declaration_index(TELEMETRY_DATA_UUID),
+    TELEMETRY_IDX_DATA_VAL = telemetry_att_db.value_index(TELEMETRY_DATA_UUID),
+    TELEMETRY_IDX_DATA_NTF_CFG = telemetry_att_db.descriptor_index(TELEMETRY_DATA_UUID,
+                                                                   ESP_GATT_UUID_CHAR_CLIENT_CONFIG),
+
+    TELEMETRY_IDX_CREDITS_CHAR = telemetry_att_db.declaration_index(TELEMETRY_CREDITS_UUID),
+    TELEMETRY_IDX_CREDITS_VAL = telemetry_att_db.value_index(TELEMETRY_CREDITS_UUID),
+
+    TELEMETRY_IDX_NB = telemetry_att_db.size(),
+};
+
+extern gatt::HandleTable<telemetry_att_db> telemetry_handle_table;
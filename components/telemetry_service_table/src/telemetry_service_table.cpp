@@ -0,0 +1,3 @@
+#include "telemetry_service_table.hpp"
+
+gatt::HandleTable<telemetry_att_db> telemetry_handle_table;
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+
+namespace host {
+
+/// Check the scalar kernels of input_conditioning::Pipeline stage by stage
+/// (calibration, IIR and one-euro filters, radial and axis deadzones,
+/// response curves) against values worked out by hand, including raw
+/// readings outside their axis' range and axes whose range is zero wide.
+/// Each mismatch is printed to out.
+/// @return The number of checks which failed
+size_t check_input_conditioning(FILE *out);
+
+} // namespace host
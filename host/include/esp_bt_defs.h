@@ -0,0 +1,50 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_bt_defs.h (the subset this project uses)
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#define ESP_BD_ADDR_LEN 6
+typedef uint8_t esp_bd_addr_t[ESP_BD_ADDR_LEN];
+#define ESP_UUID_LEN_16 2
+#define ESP_UUID_LEN_32 4
+#define ESP_UUID_LEN_128 16
+typedef struct {
+  uint16_t len;
+  union { uint16_t uuid16; uint32_t uuid32; uint8_t uuid128[ESP_UUID_LEN_128]; } uuid;
+} __attribute__((packed)) esp_bt_uuid_t;
+typedef enum { ESP_BT_STATUS_SUCCESS = 0, ESP_BT_STATUS_FAIL } esp_bt_status_t;
+typedef uint8_t esp_ble_key_type_t;
+#define ESP_LE_KEY_NONE 0
+#define ESP_LE_KEY_PENC (1<<0)
+#define ESP_LE_KEY_PID (1<<1)
+#define ESP_LE_KEY_PCSRK (1<<2)
+#define ESP_LE_KEY_PLK (1<<3)
+#define ESP_LE_KEY_LLK (ESP_LE_KEY_PLK<<4)
+#define ESP_LE_KEY_LENC (ESP_LE_KEY_PENC<<4)
+#define ESP_LE_KEY_LID (ESP_LE_KEY_PID<<4)
+#define ESP_LE_KEY_LCSRK (ESP_LE_KEY_PCSRK<<4)
+typedef uint8_t esp_ble_auth_req_t;
+#define ESP_LE_AUTH_NO_BOND 0x00
+#define ESP_LE_AUTH_BOND 0x01
+#define ESP_LE_AUTH_REQ_MITM (1<<2)
+#define ESP_LE_AUTH_REQ_BOND_MITM (ESP_LE_AUTH_BOND|ESP_LE_AUTH_REQ_MITM)
+#define ESP_LE_AUTH_REQ_SC_ONLY (1<<3)
+#define ESP_LE_AUTH_REQ_SC_BOND (ESP_LE_AUTH_BOND|ESP_LE_AUTH_REQ_SC_ONLY)
+#define ESP_LE_AUTH_REQ_SC_MITM (ESP_LE_AUTH_REQ_MITM|ESP_LE_AUTH_REQ_SC_ONLY)
+#define ESP_LE_AUTH_REQ_SC_MITM_BOND (ESP_LE_AUTH_REQ_MITM|ESP_LE_AUTH_REQ_SC_ONLY|ESP_LE_AUTH_BOND)
+typedef uint8_t esp_ble_io_cap_t;
+#define ESP_IO_CAP_OUT 0
+#define ESP_IO_CAP_IO 1
+#define ESP_IO_CAP_IN 2
+#define ESP_IO_CAP_NONE 3
+#define ESP_IO_CAP_KBDISP 4
+#define ESP_BLE_OOB_DISABLE 0
+#define ESP_BLE_OOB_ENABLE 1
+#define ESP_BLE_ONLY_ACCEPT_SPECIFIED_AUTH_DISABLE 0
+#define ESP_BLE_ONLY_ACCEPT_SPECIFIED_AUTH_ENABLE 1
+#define ESP_BLE_ENC_KEY_MASK (1<<0)
+#define ESP_BLE_ID_KEY_MASK (1<<1)
+typedef enum { BLE_ADDR_TYPE_PUBLIC = 0, BLE_ADDR_TYPE_RANDOM, BLE_ADDR_TYPE_RPA_PUBLIC, BLE_ADDR_TYPE_RPA_RANDOM } esp_ble_addr_type_t;
+typedef enum { ESP_BT_DEVICE_TYPE_BREDR = 1, ESP_BT_DEVICE_TYPE_BLE = 2, ESP_BT_DEVICE_TYPE_DUMO = 3 } esp_bt_dev_type_t;
@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_bt_device.h (the subset this project uses)
+
+#include "esp_bt_defs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+const uint8_t *esp_bt_dev_get_address(void);
+#ifdef __cplusplus
+}
+#endif
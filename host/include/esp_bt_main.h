@@ -0,0 +1,13 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_bt_main.h (the subset this project uses)
+
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+esp_err_t esp_bluedroid_init(void);
+esp_err_t esp_bluedroid_enable(void);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,122 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_gap_ble_api.h (the subset this project uses)
+
+#include "esp_bt_defs.h"
+typedef enum {
+  ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT = 0, ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT, ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT,
+  ESP_GAP_BLE_SCAN_RESULT_EVT, ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT, ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT,
+  ESP_GAP_BLE_ADV_START_COMPLETE_EVT, ESP_GAP_BLE_SCAN_START_COMPLETE_EVT, ESP_GAP_BLE_AUTH_CMPL_EVT, ESP_GAP_BLE_KEY_EVT,
+  ESP_GAP_BLE_SEC_REQ_EVT, ESP_GAP_BLE_PASSKEY_NOTIF_EVT, ESP_GAP_BLE_PASSKEY_REQ_EVT, ESP_GAP_BLE_OOB_REQ_EVT,
+  ESP_GAP_BLE_LOCAL_IR_EVT, ESP_GAP_BLE_LOCAL_ER_EVT, ESP_GAP_BLE_NC_REQ_EVT, ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT,
+  ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT, ESP_GAP_BLE_SET_STATIC_RAND_ADDR_EVT, ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT,
+  ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT, ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT, ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT,
+  ESP_GAP_BLE_CLEAR_BOND_DEV_COMPLETE_EVT, ESP_GAP_BLE_GET_BOND_DEV_COMPLETE_EVT, ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT,
+  ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT, ESP_GAP_BLE_UPDATE_DUPLICATE_EXCEPTIONAL_LIST_COMPLETE_EVT,
+  ESP_GAP_BLE_SET_CHANNELS_EVT, ESP_GAP_BLE_READ_PHY_COMPLETE_EVT, ESP_GAP_BLE_SET_PREFERRED_DEFAULT_PHY_COMPLETE_EVT,
+  ESP_GAP_BLE_SET_PREFERRED_PHY_COMPLETE_EVT, ESP_GAP_BLE_EXT_ADV_SET_RAND_ADDR_COMPLETE_EVT,
+  ESP_GAP_BLE_EXT_ADV_SET_PARAMS_COMPLETE_EVT, ESP_GAP_BLE_EXT_ADV_DATA_SET_COMPLETE_EVT,
+  ESP_GAP_BLE_EXT_SCAN_RSP_DATA_SET_COMPLETE_EVT, ESP_GAP_BLE_EXT_ADV_START_COMPLETE_EVT,
+  ESP_GAP_BLE_EXT_ADV_STOP_COMPLETE_EVT, ESP_GAP_BLE_EXT_ADV_SET_REMOVE_COMPLETE_EVT,
+  ESP_GAP_BLE_EXT_ADV_SET_CLEAR_COMPLETE_EVT, ESP_GAP_BLE_PERIODIC_ADV_SET_PARAMS_COMPLETE_EVT,
+  ESP_GAP_BLE_PERIODIC_ADV_DATA_SET_COMPLETE_EVT, ESP_GAP_BLE_PERIODIC_ADV_START_COMPLETE_EVT,
+  ESP_GAP_BLE_PERIODIC_ADV_STOP_COMPLETE_EVT, ESP_GAP_BLE_PERIODIC_ADV_CREATE_SYNC_COMPLETE_EVT,
+  ESP_GAP_BLE_PERIODIC_ADV_SYNC_CANCEL_COMPLETE_EVT, ESP_GAP_BLE_PERIODIC_ADV_SYNC_TERMINATE_COMPLETE_EVT,
+  ESP_GAP_BLE_PERIODIC_ADV_ADD_DEV_COMPLETE_EVT, ESP_GAP_BLE_PERIODIC_ADV_REMOVE_DEV_COMPLETE_EVT,
+  ESP_GAP_BLE_PERIODIC_ADV_CLEAR_DEV_COMPLETE_EVT, ESP_GAP_BLE_SET_EXT_SCAN_PARAMS_COMPLETE_EVT,
+  ESP_GAP_BLE_EXT_SCAN_START_COMPLETE_EVT, ESP_GAP_BLE_EXT_SCAN_STOP_COMPLETE_EVT,
+  ESP_GAP_BLE_PREFER_EXT_CONN_PARAMS_SET_COMPLETE_EVT, ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT,
+  ESP_GAP_BLE_EXT_ADV_REPORT_EVT, ESP_GAP_BLE_SCAN_TIMEOUT_EVT, ESP_GAP_BLE_ADV_TERMINATED_EVT,
+  ESP_GAP_BLE_SCAN_REQ_RECEIVED_EVT, ESP_GAP_BLE_CHANNEL_SELECT_ALGORITHM_EVT,
+  ESP_GAP_BLE_PERIODIC_ADV_REPORT_EVT, ESP_GAP_BLE_PERIODIC_ADV_SYNC_LOST_EVT,
+  ESP_GAP_BLE_PERIODIC_ADV_SYNC_ESTAB_EVT, ESP_GAP_BLE_SC_OOB_REQ_EVT, ESP_GAP_BLE_SC_CR_LOC_OOB_EVT,
+  ESP_GAP_BLE_GET_DEV_NAME_COMPLETE_EVT, ESP_GAP_BLE_EVT_MAX,
+} esp_gap_ble_cb_event_t;
+#define ESP_BLE_APPEARANCE_UNKNOWN 0x0000
+#define ESP_BLE_APPEARANCE_GENERIC_HID 0x03C0
+#define ESP_BLE_APPEARANCE_HID_KEYBOARD 0x03C1
+#define ESP_BLE_APPEARANCE_HID_MOUSE 0x03C2
+#define ESP_BLE_APPEARANCE_HID_JOYSTICK 0x03C3
+#define ESP_BLE_APPEARANCE_HID_GAMEPAD 0x03C4
+#define ESP_BLE_APPEARANCE_GENERIC_REMOTE 0x0180
+#define ESP_BLE_ADV_FLAG_LIMIT_DISC (0x01 << 0)
+#define ESP_BLE_ADV_FLAG_GEN_DISC (0x01 << 1)
+#define ESP_BLE_ADV_FLAG_BREDR_NOT_SPT (0x01 << 2)
+typedef enum { ADV_TYPE_IND = 0x00, ADV_TYPE_DIRECT_IND_HIGH = 0x01, ADV_TYPE_SCAN_IND = 0x02, ADV_TYPE_NONCONN_IND = 0x03, ADV_TYPE_DIRECT_IND_LOW = 0x04 } esp_ble_adv_type_t;
+typedef enum { ADV_CHNL_37 = 0x01, ADV_CHNL_38 = 0x02, ADV_CHNL_39 = 0x04, ADV_CHNL_ALL = 0x07 } esp_ble_adv_channel_t;
+typedef enum { ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY = 0x00, ADV_FILTER_ALLOW_SCAN_WLST_CON_ANY, ADV_FILTER_ALLOW_SCAN_ANY_CON_WLST, ADV_FILTER_ALLOW_SCAN_WLST_CON_WLST } esp_ble_adv_filter_t;
+typedef struct {
+  bool set_scan_rsp; bool include_name; bool include_txpower; int min_interval; int max_interval; int appearance;
+  uint16_t manufacturer_len; uint8_t *p_manufacturer_data; uint16_t service_data_len; uint8_t *p_service_data;
+  uint16_t service_uuid_len; uint8_t *p_service_uuid; uint8_t flag;
+} esp_ble_adv_data_t;
+typedef struct {
+  uint16_t adv_int_min; uint16_t adv_int_max; esp_ble_adv_type_t adv_type; esp_ble_addr_type_t own_addr_type;
+  esp_bd_addr_t peer_addr; esp_ble_addr_type_t peer_addr_type; esp_ble_adv_channel_t channel_map; esp_ble_adv_filter_t adv_filter_policy;
+} esp_ble_adv_params_t;
+typedef struct { esp_bd_addr_t bda; uint16_t min_int; uint16_t max_int; uint16_t latency; uint16_t timeout; } esp_ble_conn_update_params_t;
+typedef enum {
+  ESP_BLE_SM_PASSKEY = 0, ESP_BLE_SM_AUTHEN_REQ_MODE, ESP_BLE_SM_IOCAP_MODE, ESP_BLE_SM_SET_INIT_KEY, ESP_BLE_SM_SET_RSP_KEY,
+  ESP_BLE_SM_MAX_KEY_SIZE, ESP_BLE_SM_MIN_KEY_SIZE, ESP_BLE_SM_SET_STATIC_PASSKEY, ESP_BLE_SM_CLEAR_STATIC_PASSKEY,
+  ESP_BLE_SM_ONLY_ACCEPT_SPECIFIED_SEC_AUTH, ESP_BLE_SM_OOB_SUPPORT, ESP_BLE_APP_ENC_KEY_SIZE, ESP_BLE_SM_MAX_PARAM,
+} esp_ble_sm_param_t;
+typedef struct { uint8_t ir[16]; uint8_t irk[16]; uint8_t dhk[16]; } esp_ble_local_id_keys_t;
+typedef struct { uint8_t pltk[16]; } esp_ble_bond_key_info_t;
+typedef struct { esp_bd_addr_t bd_addr; esp_ble_bond_key_info_t bond_key; esp_ble_addr_type_t bd_addr_type; } esp_ble_bond_dev_t;
+typedef struct { esp_bd_addr_t bd_addr; uint32_t passkey; } esp_ble_sec_key_notif_t;
+typedef struct { esp_bd_addr_t bd_addr; } esp_ble_sec_req_t;
+typedef struct { esp_bd_addr_t bd_addr; esp_ble_key_type_t key_type; } esp_ble_key_t;
+typedef struct {
+  esp_bd_addr_t bd_addr; bool key_present; uint8_t key[16]; uint8_t key_type; bool success; uint8_t fail_reason;
+  esp_ble_addr_type_t addr_type; esp_bt_dev_type_t dev_type; esp_ble_auth_req_t auth_mode;
+} esp_ble_auth_cmpl_t;
+typedef union {
+  esp_ble_sec_key_notif_t key_notif; esp_ble_sec_req_t ble_req; esp_ble_key_t ble_key; esp_ble_local_id_keys_t ble_id_keys; esp_ble_auth_cmpl_t auth_cmpl;
+} esp_ble_sec_t;
+typedef uint8_t esp_ble_gap_phy_t;
+#define ESP_BLE_GAP_PHY_1M 1
+#define ESP_BLE_GAP_PHY_2M 2
+#define ESP_BLE_GAP_PHY_CODED 3
+typedef union {
+  struct ble_adv_data_cmpl_evt_param { esp_bt_status_t status; } adv_data_cmpl;
+  struct ble_scan_rsp_data_cmpl_evt_param { esp_bt_status_t status; } scan_rsp_data_cmpl;
+  struct ble_adv_data_raw_cmpl_evt_param { esp_bt_status_t status; } adv_data_raw_cmpl;
+  struct ble_scan_rsp_data_raw_cmpl_evt_param { esp_bt_status_t status; } scan_rsp_data_raw_cmpl;
+  struct ble_adv_start_cmpl_evt_param { esp_bt_status_t status; } adv_start_cmpl;
+  esp_ble_sec_t ble_security;
+  struct ble_adv_stop_cmpl_evt_param { esp_bt_status_t status; } adv_stop_cmpl;
+  struct ble_update_conn_params_evt_param { esp_bt_status_t status; esp_bd_addr_t bda; uint16_t min_int; uint16_t max_int; uint16_t latency; uint16_t conn_int; uint16_t timeout; } update_conn_params;
+  struct ble_pkt_data_length_cmpl_evt_param { esp_bt_status_t status; struct { uint16_t rx_len; uint16_t tx_len; } params; } pkt_data_length_cmpl;
+  struct ble_local_privacy_cmpl_evt_param { esp_bt_status_t status; } local_privacy_cmpl;
+  struct ble_remove_bond_dev_cmpl_evt_param { esp_bt_status_t status; esp_bd_addr_t bd_addr; } remove_bond_dev_cmpl;
+  struct ble_clear_bond_dev_cmpl_evt_param { esp_bt_status_t status; } clear_bond_dev_cmpl;
+  struct ble_get_bond_dev_cmpl_evt_param { esp_bt_status_t status; uint8_t dev_num; esp_ble_bond_dev_t *bond_dev; } get_bond_dev_cmpl;
+  struct ble_read_rssi_cmpl_evt_param { esp_bt_status_t status; int8_t rssi; esp_bd_addr_t remote_addr; } read_rssi_cmpl;
+  struct ble_read_phy_cmpl_evt_param { esp_bt_status_t status; esp_bd_addr_t bda; esp_ble_gap_phy_t tx_phy; esp_ble_gap_phy_t rx_phy; } read_phy;
+  struct ble_phy_update_cmpl_evt_param { esp_bt_status_t status; esp_bd_addr_t bda; esp_ble_gap_phy_t tx_phy; esp_ble_gap_phy_t rx_phy; } phy_update;
+  struct ble_get_dev_name_cmpl_evt_param { esp_bt_status_t status; char *name; } get_dev_name_cmpl;
+} esp_ble_gap_cb_param_t;
+typedef void (*esp_gap_ble_cb_t)(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+#ifdef __cplusplus
+extern "C" {
+#endif
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback);
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t *adv_data);
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params);
+esp_err_t esp_ble_gap_stop_advertising(void);
+esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t *params);
+esp_err_t esp_ble_gap_set_device_name(const char *name);
+esp_err_t esp_ble_gap_config_local_icon(uint32_t icon);
+esp_err_t esp_ble_gap_set_security_param(esp_ble_sm_param_t param_type, void *value, uint8_t len);
+esp_err_t esp_ble_gap_security_rsp(esp_bd_addr_t bd_addr, bool accept);
+esp_err_t esp_ble_confirm_reply(esp_bd_addr_t bd_addr, bool accept);
+esp_err_t esp_ble_passkey_reply(esp_bd_addr_t bd_addr, bool accept, uint32_t passkey);
+int esp_ble_get_bond_device_num(void);
+esp_err_t esp_ble_get_bond_device_list(int *dev_num, esp_ble_bond_dev_t *dev_list);
+esp_err_t esp_ble_remove_bond_device(esp_bd_addr_t bd_addr);
+esp_err_t esp_ble_gap_read_rssi(esp_bd_addr_t remote_addr);
+esp_err_t esp_ble_gap_read_phy(esp_bd_addr_t bd_addr);
+esp_err_t esp_ble_gap_disconnect(esp_bd_addr_t remote_device);
+#ifdef __cplusplus
+}
+#endif
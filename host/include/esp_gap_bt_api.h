@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_gap_bt_api.h (the subset this project uses)
+
+#include "esp_bt_defs.h"
@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_gatt_common_api.h (the subset this project uses)
+
+#include "esp_gatt_defs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu);
+#ifdef __cplusplus
+}
+#endif
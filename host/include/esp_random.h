@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_random.h (the subset this project uses)
+
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+uint32_t esp_random(void);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_system.h (the subset this project uses)
+
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+#ifdef __cplusplus
+}
+#endif
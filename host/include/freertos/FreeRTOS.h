@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's freertos/FreeRTOS.h (the subset this project uses)
+
+#include <stdint.h>
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portNUM_PROCESSORS 1
+static inline BaseType_t xPortGetCoreID(void) { return 0; }
@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's freertos/semphr.h (the subset this project uses)
+
+#include "freertos/FreeRTOS.h"
+typedef struct QueueDefinition *SemaphoreHandle_t;
+#ifdef __cplusplus
+extern "C" {
+#endif
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+#ifdef __cplusplus
+}
+#endif
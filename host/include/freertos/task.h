@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's freertos/task.h (the subset this project uses)
+
+#include "freertos/FreeRTOS.h"
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+namespace host {
+
+/// When the stack's events are delivered while booting
+enum class StartOrder {
+  AFTER_APP_MAIN, ///< only once app_main() is done
+  INTERLEAVED,    ///< after each step, as when the BTC task gets to them first
+  /// until the HID table has been requested, so that the profile switch
+  /// lands before the table's event, as when loading the bundle takes a while
+  SWITCH_DURING_TABLE,
+};
+
+/// Boot like app_main() does (stack, hid service, DIS strings, device
+/// profiles, profile bundle), then deliver the stack's events until the HID
+/// service has started
+/// @return The number of events it took after app_main() for the HID service to start
+size_t start_app(StartOrder order = StartOrder::AFTER_APP_MAIN);
+
+/// True if the HID service's attribute table has been created and started
+bool hid_service_running();
+
+/// True if the HID service's attribute table exists (requested), started or not
+bool hid_service_table_requested();
+
+} // namespace host
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <esp_bt_defs.h>
+#include <esp_gatt_defs.h>
+
+// Host (Linux) stand-in for the Bluedroid stack. The esp_ble_gatts_* /
+// esp_ble_gap_* functions declared by the ESP-IDF headers in this directory
+// are implemented (src/bluedroid.cpp) on top of an in-memory attribute
+// database, and this is the other end of it: what a central on the far side
+// of the radio would see and do, used by the VirtualCentral.
+//
+// Like Bluedroid, API calls only queue their events, and the events are
+// delivered to the registered callbacks by process_events() (the BTC task on
+// target), so the application sees them in the same order and never from
+// inside its own API call. Notifications are queued per connection and only
+// leave the stack in run_connection_events(), a few per connection event, so
+// throughput depends on the connection interval as it does over the air.
+//
+// Handles are assigned like Bluedroid does: the GATT service (with Service
+// Changed) and the GAP service (device name, appearance) come first, and the
+// attribute tables the application creates are allocated from handle 40 on,
+// first fit, so a deleted and recreated service can move.
+
+namespace host::bluedroid {
+
+/// An attribute of the database, with the stack's own copy of its value
+struct Attribute {
+  uint16_t handle{0};
+  uint16_t service_handle{0};
+  esp_bt_uuid_t uuid{};
+  uint16_t perm{0};
+  bool auto_rsp{true};
+  uint16_t max_length{0};
+  std::vector<uint8_t> value;
+};
+
+struct Service {
+  esp_bt_uuid_t uuid{};
+  uint16_t start_handle{0};
+  uint16_t end_handle{0};
+  esp_gatt_if_t gatts_if{ESP_GATT_IF_NONE};
+  bool started{false};
+};
+
+struct LinkConfig {
+  size_t tx_queue_size{20};    ///< notifications buffered per connection, more are dropped
+  size_t packets_per_event{6}; ///< notifications sent per connection event
+};
+
+/// The connected central's side of the link
+struct Peer {
+  /// A notification or indication has been received
+  std::function<void(uint16_t handle, std::span<const uint8_t> value, bool indication)> on_notification{nullptr};
+  /// The peripheral requested new connection parameters, return the
+  /// interval (1.25 ms units) to use
+  std::function<uint16_t(uint16_t min_interval, uint16_t max_interval)> on_connection_update{nullptr};
+};
+
+struct Stats {
+  size_t events_dispatched{0};
+  size_t attr_tables_created{0};
+  size_t attr_tables_failed{0};
+  size_t services_started{0};
+  size_t attr_values_set{0};
+  size_t attr_values_failed{0};     ///< unknown handle or too long
+  size_t notifications_queued{0};
+  size_t notifications_delivered{0};
+  size_t notifications_dropped{0};   ///< the connection's tx queue was full
+  size_t notifications_truncated{0}; ///< longer than MTU - 3 bytes
+  size_t service_changed_indications{0};
+  size_t connection_events{0};
+  size_t att_requests{0};
+};
+
+/// Forget every registration, service, connection and bond
+void reset();
+
+/// Deliver the queued events to the GAP / GATTS callbacks, including any
+/// queued while doing so, up to max_events. Returns the number delivered.
+size_t process_events(size_t max_events = SIZE_MAX);
+
+LinkConfig &link_config();
+const Stats &stats();
+
+/// All services, ordered by handle. Only started ones are visible to the central.
+std::vector<Service> services();
+/// The attribute with the given handle, valid until the database changes
+const Attribute *find_attribute(uint16_t handle);
+std::string_view device_name();
+uint16_t appearance();
+bool is_advertising();
+
+/// Connect to the device, which must be advertising
+bool connect(const esp_bd_addr_t address, const Peer &peer);
+void disconnect(esp_gatt_conn_reason_t reason = ESP_GATT_CONN_TERMINATE_PEER_USER);
+bool is_connected();
+/// Pair (just works) and bond, or re-encrypt the link with an existing bond
+void encrypt();
+bool is_encrypted();
+/// Exchange MTU, returns the MTU of the connection
+uint16_t exchange_mtu(uint16_t client_mtu);
+/// The connection interval in 1.25 ms units
+uint16_t connection_interval();
+
+/// ATT Find Information: handles and types of visible attributes in the
+/// range, as many as fit in one response
+std::vector<std::pair<uint16_t, esp_bt_uuid_t>> find_information(uint16_t start_handle, uint16_t end_handle);
+/// ATT Read (Blob) Request: up to MTU - 1 bytes of the value from the offset
+esp_gatt_status_t read(uint16_t handle, uint16_t offset, std::vector<uint8_t> &value);
+/// ATT Write Request / Command
+esp_gatt_status_t write(uint16_t handle, std::span<const uint8_t> value, bool with_response = true);
+
+/// Notifications waiting to be sent
+size_t tx_queue_depth();
+/// Run connection events, sending the queued notifications. Returns the
+/// number of notifications sent.
+size_t run_connection_events(size_t count);
+/// Time spent in connection events, according to the connection interval
+int64_t link_time_us();
+
+} // namespace host::bluedroid
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include <esp_pm.h>
+
+// Host stand-ins for the rest of ESP-IDF the components use (timers, random,
+// NVS, partitions, power management and FreeRTOS semaphores), see
+// src/idf.cpp.
+
+namespace host::idf {
+
+/// Back the data partition with the given label by a file, e.g. a profile
+/// bundle made by pack_profile_bundle. Partitions without a file don't exist,
+/// unless a size is given: then a missing file is created (erased) on first
+/// use. Erases and writes go through to the file.
+void set_partition_file(const std::string &label, const std::string &path, size_t size = 0);
+
+/// Run the callbacks of the esp_timers which are due, as the esp_timer task
+/// would. Timers don't fire on their own, so runs stay repeatable.
+/// @return the number of callbacks run
+size_t run_timers();
+
+/// Light sleep and wake up again, as the idle task would, calling the light
+/// sleep exit callback: woken by an input (a GPIO wake source) if there is
+/// one, by a timer otherwise. False, without sleeping, if light sleep is not
+/// enabled or a ESP_PM_NO_LIGHT_SLEEP lock is held.
+bool light_sleep(bool input);
+/// Light sleeps so far
+size_t light_sleeps();
+
+/// Acquisitions held of the locks of the type
+size_t lock_count(esp_pm_lock_type_t type);
+/// The CPU frequency the locks held allow
+int cpu_freq_mhz();
+
+} // namespace host::idf
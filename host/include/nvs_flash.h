@@ -0,0 +1,13 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's nvs_flash.h (the subset this project uses)
+
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+// Host build configuration: the Kconfig defaults of main/ and the components
+
+#define CONFIG_DEVICE_NAME "Xbox Elite Wireless Controller"
+#define CONFIG_MANUFACTURER_NAME "Microsoft Corporation"
+#define CONFIG_VENDOR_ID 0x045E
+#define CONFIG_PRODUCT_ID 0x02FD
+#define CONFIG_PRODUCT_VERSION 0x0100
+#define CONFIG_DEVICE_PROFILE_GAMEPAD 1
+#define CONFIG_PROFILE_SWITCH_PERIOD_SECONDS 0
+#define CONFIG_PROFILE_BUNDLE_DEFAULT_PROFILE ""
+#define CONFIG_BUTTON_GPIOS ""
+#define CONFIG_DIS_STRING_MIN_CAPACITY 32
+#define CONFIG_DEFERRED_LOG_MIN_LEVEL 0
+#define CONFIG_DEFERRED_LOG_RING_SIZE 64
+#define CONFIG_DEFERRED_LOG_TASK_PRIORITY 1
+#define CONFIG_BT_SMP_MAX_BONDS 15
+// the ESP-IDF default, not sdkconfig.defaults' 128, so that the simulator
+// sees a name which is too long for a build with the default
+#define CONFIG_BT_MAX_DEVICE_NAME_LEN 32
+#define CONFIG_HID_SERVICE_EVENT_NAMES 1
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 160
+#define CONFIG_BATTERY_FILTER_SHIFT 3
+#define CONFIG_BATTERY_HYSTERESIS_PERCENT 2
+#define CONFIG_BATTERY_MIN_PUBLISH_INTERVAL_SECONDS 60
+#define CONFIG_BATTERY_CRITICAL_PERCENT 5
+#define CONFIG_INPUT_CONDITIONING_MAX_AXES 8
+#define CONFIG_DIGITAL_INPUT_SCAN_PERIOD_MS 1
+#define CONFIG_DIGITAL_INPUT_MATRIX_SETTLE_US 5
+// not the Kconfig defaults, so the simulator can export traces and captures,
+// read the diagnostics, stream telemetry, audit allocations and sleep
+#define CONFIG_EVENT_TRACE 1
+#define CONFIG_EVENT_TRACE_BUFFER_EVENTS 4096
+#define CONFIG_BTSNOOP_CAPTURE 1
+#define CONFIG_BTSNOOP_RECORDS 1024
+#define CONFIG_BTSNOOP_SNAPLEN 64
+#define CONFIG_DIAGNOSTICS_SERVICE 1
+#define CONFIG_TELEMETRY_SERVICE 1
+#define CONFIG_TELEMETRY_STREAMS 4
+#define CONFIG_TELEMETRY_QUEUE_FRAMES 8
+#define CONFIG_TELEMETRY_MAX_IN_FLIGHT 2
+#define CONFIG_TELEMETRY_FRAME_MAX_AGE_MS 20
+#define CONFIG_ALLOC_AUDIT 1
+#define CONFIG_ALLOC_AUDIT_SITES 64
+#define CONFIG_POWER_SAVE 1
+#define CONFIG_INPUT_WAKE_GPIO 0
+#define CONFIG_POWER_SAVE_MIN_FREQ_MHZ 40
+#define CONFIG_POWER_SAVE_LIGHT_SLEEP 1
+#define CONFIG_POWER_SAVE_WAKE_LATENCY_BUDGET_US 5000
+#define CONFIG_PM_LIGHT_SLEEP_CALLBACKS 1
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "gatt_service_builder.hpp"
+#include "host_bluedroid.hpp"
+
+namespace host {
+
+/// A central (e.g. a phone or PC) connected to the host Bluedroid stand-in:
+/// it discovers the database with ATT requests, reads the report map,
+/// subscribes to input reports and counts the notifications it receives.
+class VirtualCentral {
+public:
+  struct Config {
+    std::array<uint8_t, ESP_BD_ADDR_LEN> address{0xC0, 0xFF, 0xEE, 0x00, 0x00, 0x01};
+    uint16_t mtu{247};
+    uint16_t min_interval{6}; ///< fastest connection interval it accepts (1.25 ms units)
+  };
+
+  struct Characteristic {
+    esp_bt_uuid_t uuid{};
+    uint8_t properties{0};
+    uint16_t declaration_handle{0};
+    uint16_t value_handle{0};
+    uint16_t end_handle{0};
+    uint16_t cccd_handle{0};
+    uint8_t report_id{0};   ///< from the report reference, if it is a HID report
+    uint8_t report_type{0}; ///< 1 = input, 2 = output, 3 = feature
+  };
+
+  struct DiscoveredService {
+    esp_bt_uuid_t uuid{};
+    uint16_t start_handle{0};
+    uint16_t end_handle{0};
+    std::vector<uint16_t> included_services; ///< start handles
+    std::vector<Characteristic> characteristics;
+  };
+
+  struct Counters {
+    size_t notifications{0};
+    size_t notification_bytes{0};
+    size_t unsubscribed_notifications{0}; ///< on a handle it did not subscribe to
+    size_t out_of_order{0};               ///< report whose first byte isn't the previous one's + 1
+    size_t service_changed{0};
+    size_t att_round_trips{0};
+    std::map<uint8_t, size_t> reports; ///< notifications per input report ID
+    size_t battery_notifications{0};   ///< of the Battery Service's battery level
+    int battery_level{-1};             ///< the last one notified
+    int battery_strength{-1};          ///< the last HID battery strength report
+    size_t telemetry_frames{0};
+    size_t telemetry_samples{0};
+    size_t telemetry_bytes{0};         ///< of the samples, without headers
+    size_t telemetry_lost{0};          ///< frames missing from the sequence
+    size_t telemetry_malformed{0};     ///< frames which don't parse
+  };
+
+  explicit VirtualCentral(const Config &config);
+
+  bool connect();
+  void disconnect();
+  /// Pair and bond, or re-encrypt with the existing bond
+  void pair();
+  uint16_t exchange_mtu();
+  uint16_t mtu() const { return mtu_; }
+
+  /// Discover every service, characteristic and descriptor, reading the
+  /// report references. Subscriptions are forgotten. Also enables service
+  /// changed indications, like hosts do.
+  bool discover();
+  const std::vector<DiscoveredService> &services() const { return services_; }
+  const DiscoveredService *find_service(uint16_t uuid16) const;
+  /// The HID input reports which were discovered
+  std::vector<const Characteristic *> input_reports() const;
+
+  /// Read a whole value, with as many read blob requests as it takes
+  esp_gatt_status_t read(uint16_t handle, std::vector<uint8_t> &value);
+  /// Read the report map, and find the battery strength report in it
+  esp_gatt_status_t read_report_map(std::vector<uint8_t> &report_map);
+  /// Enable notifications of an input report, or of all of them if report_id is 0
+  bool subscribe(uint8_t report_id = 0);
+  /// Enable notifications of the Battery Service's battery level
+  bool subscribe_battery_level();
+  /// The Battery Service's battery level characteristic, if discovered
+  const Characteristic *battery_level() const;
+  /// Enable notifications of the telemetry service's frames, which come only
+  /// once credits have been granted for them
+  bool subscribe_telemetry();
+  /// Grant credits for that many further telemetry frames
+  bool grant_telemetry_credits(uint16_t credits, bool with_response = true);
+  /// A characteristic of a service with a 128-bit UUID, e.g. a vendor one
+  const Characteristic *find_characteristic(const gatt::Uuid &service_uuid,
+                                            const gatt::Uuid &characteristic_uuid) const;
+
+  /// Set whenever a service changed indication arrives, until the next discover()
+  bool needs_discovery() const { return needs_discovery_; }
+
+  const Counters &counters() const { return counters_; }
+  void reset_counters() { counters_ = {}; }
+
+protected:
+  void on_notification(uint16_t handle, std::span<const uint8_t> value, bool indication);
+  uint16_t on_connection_update(uint16_t min_interval, uint16_t max_interval);
+  esp_gatt_status_t read_once(uint16_t handle, uint16_t offset, std::vector<uint8_t> &value);
+  void on_telemetry_frame(std::span<const uint8_t> frame);
+
+  Config config_;
+  uint16_t mtu_{ESP_GATT_DEF_BLE_MTU_SIZE};
+  std::vector<DiscoveredService> services_;
+  std::map<uint16_t, uint8_t> subscribed_; ///< value handle -> report ID
+  std::map<uint16_t, uint8_t> last_value_; ///< value handle -> first byte
+  uint16_t service_changed_handle_{0};
+  uint16_t battery_level_handle_{0};
+  int battery_report_id_{-1};
+  uint16_t telemetry_handle_{0};
+  int telemetry_sequence_{-1}; ///< the next frame's expected sequence, -1 if not known
+  bool needs_discovery_{false};
+  Counters counters_;
+};
+
+} // namespace host
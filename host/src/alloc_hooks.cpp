@@ -0,0 +1,43 @@
+// The simulator's allocator hook for the allocation audit (see
+// alloc_audit.hpp): malloc and operator new are replaced with ones which
+// record the allocation and its caller, then call glibc's allocator. Linked
+// into the simulator only, the other tools keep the usual allocator.
+
+#include <cstdlib>
+#include <new>
+
+#include "alloc_audit.hpp"
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+  alloc_audit::record(size, reinterpret_cast<uintptr_t>(__builtin_return_address(0)));
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  alloc_audit::record(count * size, reinterpret_cast<uintptr_t>(__builtin_return_address(0)));
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  alloc_audit::record(size, reinterpret_cast<uintptr_t>(__builtin_return_address(0)));
+  return __libc_realloc(ptr, size);
+}
+}
+
+// so the caller is the code which used new, rather than libstdc++
+static void *allocate(size_t size, uintptr_t caller) {
+  alloc_audit::record(size, caller);
+  if (void *ptr = __libc_malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new(size_t size) { return allocate(size, reinterpret_cast<uintptr_t>(__builtin_return_address(0))); }
+
+void *operator new[](size_t size) { return allocate(size, reinterpret_cast<uintptr_t>(__builtin_return_address(0))); }
@@ -0,0 +1,75 @@
+#include "host_app.hpp"
+
+#include "hid_service.hpp"
+#include "profiles.hpp"
+
+#include "host_bluedroid.hpp"
+
+namespace host {
+
+bool hid_service_running() {
+  for (const auto &service : bluedroid::services()) {
+    if (service.uuid.len == ESP_UUID_LEN_16 && service.uuid.uuid.uuid16 == ESP_GATT_UUID_HID_SVC) {
+      return service.started;
+    }
+  }
+  return false;
+}
+
+bool hid_service_table_requested() {
+  for (const auto &service : bluedroid::services()) {
+    if (service.uuid.len == ESP_UUID_LEN_16 && service.uuid.uuid.uuid16 == ESP_GATT_UUID_HID_SVC) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t start_app(StartOrder order) {
+  auto step = [&] {
+    if (order == StartOrder::INTERLEAVED) {
+      bluedroid::process_events();
+    } else if (order == StartOrder::SWITCH_DURING_TABLE) {
+      // the stack creates the table when it is asked to, its event waits
+      while (!hid_service_table_requested() && bluedroid::process_events(1)) {
+      }
+    }
+  };
+  // what app_main() does
+  nvs_flash_init();
+  power_save::init();
+  if (CONFIG_INPUT_WAKE_GPIO >= 0) {
+    power_save::add_wake_gpio(CONFIG_INPUT_WAKE_GPIO, 0);
+  }
+  esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT);
+  esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+  esp_bt_controller_init(&bt_cfg);
+  esp_bt_controller_enable(ESP_BT_MODE_BLE);
+  esp_bluedroid_init();
+  esp_bluedroid_enable();
+  std::string model_number = fmt::format("{:04x}", CONFIG_PRODUCT_ID);
+  std::string serial_number = fmt::format("{:010d}", esp_random());
+  hid_service_init(DeviceIdentity{
+      .device_name = CONFIG_DEVICE_NAME,
+      .vendor_id = CONFIG_VENDOR_ID,
+      .product_id = CONFIG_PRODUCT_ID,
+      .product_version = CONFIG_PRODUCT_VERSION,
+      .manufacturer_name = CONFIG_MANUFACTURER_NAME,
+      .model_number = model_number,
+      .serial_number = serial_number,
+  });
+  step();
+  int default_profile = register_device_profiles();
+  hid_service_load_profile_bundle("profiles");
+  hid_service_switch_profile(default_profile);
+
+  // and then the stack, until the HID service is up
+  auto first_event = bluedroid::stats().events_dispatched;
+  while (!hid_service_running() && bluedroid::process_events(1)) {
+  }
+  size_t events = bluedroid::stats().events_dispatched - first_event;
+  bluedroid::process_events();
+  return events;
+}
+
+} // namespace host
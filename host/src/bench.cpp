@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include "hid_service.hpp"
+#include "report_bench.hpp"
+
+#include "host_app.hpp"
+#include "host_bluedroid.hpp"
+#include "virtual_central.hpp"
+
+// hid_report_bench: the input report path benchmarks of main/report_bench.cpp
+// on the host, against the Bluedroid stand-in with a subscribed virtual
+// central, which gets the queued reports between batches (not timed):
+//
+//   hid_report_bench [--iterations <n>] [-o results.jsonl]
+//
+// Prints one line of JSON per stage, to stdout or the given file. The
+// firmware's log is dropped, the stages which log still format and write it.
+
+int main(int argc, char **argv) {
+  BenchmarkConfig config;
+  std::string output_path;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      config.iterations = std::stoul(argv[++i]);
+    } else if (arg == "-o" && i + 1 < argc) {
+      output_path = argv[++i];
+    } else {
+      fmt::print(stderr, "usage: {} [--iterations <n>] [-o <results.jsonl>]\n", argv[0]);
+      return 2;
+    }
+  }
+  FILE *out = output_path.empty() ? fdopen(dup(fileno(stdout)), "w") : std::fopen(output_path.c_str(), "w");
+  if (!out) {
+    fmt::print(stderr, "could not open '{}'\n", output_path);
+    return 2;
+  }
+  std::freopen("/dev/null", "w", stdout);
+
+  host::start_app();
+  host::VirtualCentral central({});
+  central.connect();
+  central.pair();
+  central.exchange_mtu();
+  if (!central.discover() || !central.subscribe()) {
+    fmt::print(stderr, "could not discover and subscribe to the input reports\n");
+    return 1;
+  }
+  host::bluedroid::process_events();
+
+  config.drain = [] {
+    host::bluedroid::process_events();
+    while (host::bluedroid::tx_queue_depth()) {
+      host::bluedroid::run_connection_events(1);
+      host::bluedroid::process_events();
+    }
+  };
+  config.on_result = [&](const BenchmarkResult &result) { fmt::print(out, "{}\n", benchmark_result_json(result)); };
+  auto results = run_report_path_benchmarks(config);
+  std::fclose(out);
+
+  const auto &stats = host::bluedroid::stats();
+  if (stats.notifications_dropped || central.counters().notifications != stats.notifications_delivered) {
+    fmt::print(stderr, "{} reports were dropped, the benchmark measured congestion\n", stats.notifications_dropped);
+    return 1;
+  }
+  return results.empty() ? 1 : 0;
+}
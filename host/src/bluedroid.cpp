@@ -0,0 +1,1163 @@
+#include "host_bluedroid.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <sdkconfig.h>
+
+#include <esp_bt.h>
+#include <esp_bt_device.h>
+#include <esp_bt_main.h>
+#include <esp_gap_ble_api.h>
+#include <esp_gatt_common_api.h>
+#include <esp_gatts_api.h>
+
+namespace host::bluedroid {
+namespace {
+
+constexpr uint16_t GATT_SERVICE_HANDLE = 1;
+constexpr uint16_t SERVICE_CHANGED_VALUE_HANDLE = 3;
+constexpr uint16_t SERVICE_CHANGED_CCCD_HANDLE = 4;
+constexpr uint16_t GAP_SERVICE_HANDLE = 20;
+constexpr uint16_t DEVICE_NAME_VALUE_HANDLE = 22;
+constexpr uint16_t APPEARANCE_VALUE_HANDLE = 24;
+constexpr uint16_t FIRST_APP_HANDLE = 40;
+constexpr uint16_t MAX_ATTRIBUTES_PER_TABLE = 100; // ESP_GATT_ATTR_HANDLE_MAX
+constexpr esp_gatt_if_t FIRST_GATTS_IF = 3;
+constexpr uint16_t INITIAL_CONNECTION_INTERVAL = 24; // 30 ms, a typical central default
+constexpr uint8_t LOCAL_ADDRESS[ESP_BD_ADDR_LEN] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01};
+
+struct Event {
+  bool gap{false};
+  int event{0};
+  esp_gatt_if_t gatts_if{ESP_GATT_IF_NONE};
+  esp_ble_gatts_cb_param_t gatts{};
+  esp_ble_gap_cb_param_t gap_param{};
+  std::vector<uint8_t> data;     // write.value / conf.value point here
+  std::vector<uint16_t> handles; // add_attr_tab.handles points here
+};
+
+struct Notification {
+  uint16_t handle;
+  std::vector<uint8_t> value;
+  bool indication;
+};
+
+struct Connection {
+  bool connected{false};
+  esp_bd_addr_t peer_address{};
+  uint16_t conn_id{0};
+  bool encrypted{false};
+  uint16_t mtu{ESP_GATT_DEF_BLE_MTU_SIZE};
+  uint16_t interval{INITIAL_CONNECTION_INTERVAL};
+  uint16_t latency{0};
+  uint16_t timeout{400};
+  bool congested{false};
+  std::deque<Notification> tx_queue;
+  Peer peer;
+};
+
+struct PendingResponse {
+  uint32_t trans_id{0};
+  bool received{false};
+  esp_gatt_status_t status{ESP_GATT_OK};
+  std::vector<uint8_t> value;
+};
+
+struct State {
+  std::recursive_mutex mutex;
+  bool controller_initialized{false};
+  bool controller_enabled{false};
+  bool bluedroid_initialized{false};
+  bool bluedroid_enabled{false};
+  esp_gatts_cb_t gatts_cb{nullptr};
+  esp_gap_ble_cb_t gap_cb{nullptr};
+  std::vector<uint16_t> apps; // app id, indexed by gatts_if - FIRST_GATTS_IF
+  std::map<uint16_t, Attribute> attributes;
+  std::map<uint16_t, Service> services; // by start handle
+  std::deque<Event> events;
+  std::string device_name;
+  uint16_t appearance{0};
+  uint16_t local_mtu{ESP_GATT_MAX_MTU_SIZE};
+  bool advertising{false};
+  std::vector<esp_ble_bond_dev_t> bonds;
+  Connection connection;
+  uint16_t next_conn_id{0};
+  uint32_t next_trans_id{1};
+  PendingResponse pending;
+  LinkConfig link;
+  Stats stats;
+  int64_t link_time_us{0};
+};
+
+void add_builtin_services(State &s);
+
+State &state() {
+  static State s;
+  static bool initialized = (add_builtin_services(s), true);
+  (void)initialized;
+  return s;
+}
+
+using Lock = std::lock_guard<std::recursive_mutex>;
+
+esp_bt_uuid_t make_uuid(const uint8_t *bytes, uint16_t length) {
+  esp_bt_uuid_t uuid{};
+  uuid.len = length;
+  if (length == ESP_UUID_LEN_16) {
+    uuid.uuid.uuid16 = bytes[0] | bytes[1] << 8;
+  } else if (length == ESP_UUID_LEN_32) {
+    uuid.uuid.uuid32 = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | uint32_t(bytes[3]) << 24;
+  } else {
+    std::memcpy(uuid.uuid.uuid128, bytes, ESP_UUID_LEN_128);
+  }
+  return uuid;
+}
+
+esp_bt_uuid_t make_uuid(uint16_t uuid16) {
+  uint8_t bytes[] = {uint8_t(uuid16 & 0xFF), uint8_t(uuid16 >> 8)};
+  return make_uuid(bytes, sizeof(bytes));
+}
+
+bool is_uuid(const esp_bt_uuid_t &uuid, uint16_t uuid16) {
+  return uuid.len == ESP_UUID_LEN_16 && uuid.uuid.uuid16 == uuid16;
+}
+
+void append_u16(std::vector<uint8_t> &bytes, uint16_t value) {
+  bytes.push_back(value & 0xFF);
+  bytes.push_back(value >> 8);
+}
+
+void append_uuid(std::vector<uint8_t> &bytes, const esp_bt_uuid_t &uuid) {
+  if (uuid.len == ESP_UUID_LEN_16) {
+    append_u16(bytes, uuid.uuid.uuid16);
+  } else {
+    bytes.insert(bytes.end(), uuid.uuid.uuid128, uuid.uuid.uuid128 + ESP_UUID_LEN_128);
+  }
+}
+
+void add_attribute(State &s, uint16_t handle, uint16_t service_handle, uint16_t uuid16, uint16_t perm,
+                   std::vector<uint8_t> value, uint16_t max_length = 0) {
+  Attribute attribute;
+  attribute.handle = handle;
+  attribute.service_handle = service_handle;
+  attribute.uuid = make_uuid(uuid16);
+  attribute.perm = perm;
+  attribute.max_length = std::max<uint16_t>(max_length, value.size());
+  attribute.value = std::move(value);
+  s.attributes[handle] = std::move(attribute);
+}
+
+/// The GATT service (with Service Changed) and GAP service Bluedroid creates itself
+void add_builtin_services(State &s) {
+  add_attribute(s, GATT_SERVICE_HANDLE, GATT_SERVICE_HANDLE, ESP_GATT_UUID_PRI_SERVICE, ESP_GATT_PERM_READ, {0x01, 0x18});
+  add_attribute(s, 2, GATT_SERVICE_HANDLE, ESP_GATT_UUID_CHAR_DECLARE, ESP_GATT_PERM_READ, {ESP_GATT_CHAR_PROP_BIT_INDICATE});
+  add_attribute(s, SERVICE_CHANGED_VALUE_HANDLE, GATT_SERVICE_HANDLE, ESP_GATT_UUID_GATT_SRV_CHGD, 0, {}, 4);
+  add_attribute(s, SERVICE_CHANGED_CCCD_HANDLE, GATT_SERVICE_HANDLE, ESP_GATT_UUID_CHAR_CLIENT_CONFIG,
+                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, {0x00, 0x00});
+  s.services[GATT_SERVICE_HANDLE] = {make_uuid(0x1801), GATT_SERVICE_HANDLE, SERVICE_CHANGED_CCCD_HANDLE,
+                                     ESP_GATT_IF_NONE, true};
+
+  add_attribute(s, GAP_SERVICE_HANDLE, GAP_SERVICE_HANDLE, ESP_GATT_UUID_PRI_SERVICE, ESP_GATT_PERM_READ, {0x00, 0x18});
+  add_attribute(s, 21, GAP_SERVICE_HANDLE, ESP_GATT_UUID_CHAR_DECLARE, ESP_GATT_PERM_READ, {ESP_GATT_CHAR_PROP_BIT_READ});
+  add_attribute(s, DEVICE_NAME_VALUE_HANDLE, GAP_SERVICE_HANDLE, ESP_GATT_UUID_GAP_DEVICE_NAME, ESP_GATT_PERM_READ, {});
+  add_attribute(s, 23, GAP_SERVICE_HANDLE, ESP_GATT_UUID_CHAR_DECLARE, ESP_GATT_PERM_READ, {ESP_GATT_CHAR_PROP_BIT_READ});
+  add_attribute(s, APPEARANCE_VALUE_HANDLE, GAP_SERVICE_HANDLE, 0x2A01, ESP_GATT_PERM_READ, {0x00, 0x00});
+  s.services[GAP_SERVICE_HANDLE] = {make_uuid(0x1800), GAP_SERVICE_HANDLE, APPEARANCE_VALUE_HANDLE,
+                                    ESP_GATT_IF_NONE, true};
+}
+
+const Service *service_of(const Attribute &attribute) {
+  auto &s = state();
+  auto it = s.services.find(attribute.service_handle);
+  return it == s.services.end() ? nullptr : &it->second;
+}
+
+bool is_visible(const Attribute &attribute) {
+  auto service = service_of(attribute);
+  return service && service->started;
+}
+
+void queue_gatts(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, Event ev = {}) {
+  ev.gap = false;
+  ev.event = event;
+  ev.gatts_if = gatts_if;
+  state().events.push_back(std::move(ev));
+}
+
+/// Queue a GATTS event for every registered application
+void queue_gatts_all(esp_gatts_cb_event_t event, const Event &ev) {
+  for (size_t i = 0; i < state().apps.size(); i++) {
+    queue_gatts(event, FIRST_GATTS_IF + i, ev);
+  }
+}
+
+void queue_gap(esp_gap_ble_cb_event_t event, Event ev = {}) {
+  ev.gap = true;
+  ev.event = event;
+  state().events.push_back(std::move(ev));
+}
+
+void queue_conf(esp_gatt_status_t status, uint16_t handle, std::vector<uint8_t> value) {
+  auto &s = state();
+  Event ev;
+  ev.gatts.conf.status = status;
+  ev.gatts.conf.conn_id = s.connection.conn_id;
+  ev.gatts.conf.handle = handle;
+  ev.gatts.conf.len = value.size();
+  ev.data = std::move(value);
+  queue_gatts_all(ESP_GATTS_CONF_EVT, ev);
+}
+
+/// The value as read over the air: declarations are composed by the stack
+std::vector<uint8_t> value_of(const Attribute &attribute) {
+  auto &s = state();
+  if (is_uuid(attribute.uuid, ESP_GATT_UUID_CHAR_DECLARE)) {
+    std::vector<uint8_t> value = {attribute.value.empty() ? uint8_t(0) : attribute.value[0]};
+    append_u16(value, attribute.handle + 1);
+    auto characteristic = s.attributes.find(attribute.handle + 1);
+    if (characteristic != s.attributes.end()) {
+      append_uuid(value, characteristic->second.uuid);
+    }
+    return value;
+  }
+  if (is_uuid(attribute.uuid, ESP_GATT_UUID_INCLUDE_SERVICE) && attribute.value.size() >= 2) {
+    std::vector<uint8_t> value;
+    auto service = s.services.find(attribute.value[0] | attribute.value[1] << 8);
+    if (service != s.services.end()) {
+      append_u16(value, service->second.start_handle);
+      append_u16(value, service->second.end_handle);
+      if (service->second.uuid.len == ESP_UUID_LEN_16) {
+        append_uuid(value, service->second.uuid);
+      }
+    }
+    return value;
+  }
+  if (attribute.handle == DEVICE_NAME_VALUE_HANDLE) {
+    return {s.device_name.begin(), s.device_name.end()};
+  }
+  if (attribute.handle == APPEARANCE_VALUE_HANDLE) {
+    std::vector<uint8_t> value;
+    append_u16(value, s.appearance);
+    return value;
+  }
+  return attribute.value;
+}
+
+esp_gatt_status_t check_permission(const Attribute &attribute, bool write) {
+  auto &s = state();
+  uint16_t allowed = write ? (ESP_GATT_PERM_WRITE | ESP_GATT_PERM_WRITE_ENCRYPTED | ESP_GATT_PERM_WRITE_ENC_MITM)
+                           : (ESP_GATT_PERM_READ | ESP_GATT_PERM_READ_ENCRYPTED | ESP_GATT_PERM_READ_ENC_MITM);
+  uint16_t encrypted = write ? (ESP_GATT_PERM_WRITE_ENCRYPTED | ESP_GATT_PERM_WRITE_ENC_MITM)
+                             : (ESP_GATT_PERM_READ_ENCRYPTED | ESP_GATT_PERM_READ_ENC_MITM);
+  if ((attribute.perm & allowed) == 0) {
+    return write ? ESP_GATT_WRITE_NOT_PERMIT : ESP_GATT_READ_NOT_PERMIT;
+  }
+  if ((attribute.perm & encrypted) && !s.connection.encrypted) {
+    return ESP_GATT_INSUF_AUTHENTICATION;
+  }
+  return ESP_GATT_OK;
+}
+
+/// Wait (by delivering events) for the application's response to a request
+esp_gatt_status_t wait_for_response(uint32_t trans_id, std::vector<uint8_t> *value) {
+  process_events();
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (s.pending.trans_id != trans_id || !s.pending.received) {
+    return ESP_GATT_ERROR;
+  }
+  if (value) {
+    *value = s.pending.value;
+  }
+  return s.pending.status;
+}
+
+/// The first free range of count handles, or 0
+uint16_t allocate_handles(size_t count) {
+  uint32_t start = FIRST_APP_HANDLE;
+  for (const auto &[handle, service] : state().services) {
+    if (service.end_handle < start) {
+      continue;
+    }
+    if (service.start_handle >= start + count) {
+      break;
+    }
+    start = service.end_handle + 1;
+  }
+  return start + count - 1 <= 0xFFFF ? start : 0;
+}
+
+/// Check an attribute table and add it to the database, like
+/// btc_gatts_act_create_attr_tab(). This is stricter than Bluedroid, which
+/// skips the attributes it can't add: the whole table fails instead.
+esp_gatt_status_t add_attr_tab(const esp_gatts_attr_db_t *db, size_t count, Event &ev) {
+  auto &s = state();
+  const auto &first = db[0].att_desc;
+  bool is_service = first.uuid_length == ESP_UUID_LEN_16 && first.uuid_p &&
+                    (is_uuid(make_uuid(first.uuid_p, ESP_UUID_LEN_16), ESP_GATT_UUID_PRI_SERVICE) ||
+                     is_uuid(make_uuid(first.uuid_p, ESP_UUID_LEN_16), ESP_GATT_UUID_SEC_SERVICE));
+  if (!is_service || !first.value ||
+      (first.length != ESP_UUID_LEN_16 && first.length != ESP_UUID_LEN_32 && first.length != ESP_UUID_LEN_128)) {
+    return ESP_GATT_ILLEGAL_PARAMETER;
+  }
+  ev.gatts.add_attr_tab.svc_uuid = make_uuid(first.value, first.length);
+
+  std::vector<Attribute> attributes(count);
+  for (size_t i = 0; i < count; i++) {
+    const auto &desc = db[i].att_desc;
+    if (!desc.uuid_p || (desc.uuid_length != ESP_UUID_LEN_16 && desc.uuid_length != ESP_UUID_LEN_32 &&
+                         desc.uuid_length != ESP_UUID_LEN_128)) {
+      return ESP_GATT_ILLEGAL_PARAMETER;
+    }
+    auto &attribute = attributes[i];
+    attribute.uuid = make_uuid(desc.uuid_p, desc.uuid_length);
+    attribute.perm = desc.perm;
+    attribute.auto_rsp = db[i].attr_control.auto_rsp == ESP_GATT_AUTO_RSP;
+    attribute.max_length = desc.max_length;
+    if (desc.max_length > ESP_GATT_MAX_ATTR_LEN || (attribute.auto_rsp && desc.length > desc.max_length) ||
+        (desc.length && !desc.value)) {
+      return ESP_GATT_INVALID_ATTR_LEN;
+    }
+    if (desc.value) {
+      attribute.value.assign(desc.value, desc.value + desc.length);
+    }
+    bool is_declaration = is_uuid(attribute.uuid, ESP_GATT_UUID_CHAR_DECLARE);
+    if (i > 0 && (is_uuid(attribute.uuid, ESP_GATT_UUID_PRI_SERVICE) ||
+                  is_uuid(attribute.uuid, ESP_GATT_UUID_SEC_SERVICE))) {
+      return ESP_GATT_ILLEGAL_PARAMETER;
+    }
+    if (is_declaration && (attribute.value.size() != 1 || i + 1 == count)) {
+      return ESP_GATT_ILLEGAL_PARAMETER;
+    }
+    if (is_uuid(attribute.uuid, ESP_GATT_UUID_INCLUDE_SERVICE)) {
+      // the included service has to exist already
+      if (attribute.value.size() < sizeof(esp_gatts_incl_svc_desc_t) - 2 ||
+          !s.services.contains(attribute.value[0] | attribute.value[1] << 8)) {
+        return ESP_GATT_INVALID_HANDLE;
+      }
+    }
+  }
+
+  uint16_t start = allocate_handles(count);
+  if (start == 0) {
+    return ESP_GATT_NO_RESOURCES;
+  }
+  for (size_t i = 0; i < count; i++) {
+    attributes[i].handle = start + i;
+    attributes[i].service_handle = start;
+    ev.handles[i] = start + i;
+    s.attributes[start + i] = std::move(attributes[i]);
+  }
+  s.services[start] = {ev.gatts.add_attr_tab.svc_uuid, start, uint16_t(start + count - 1), ev.gatts_if, false};
+  return ESP_GATT_OK;
+}
+
+void remove_service(uint16_t service_handle) {
+  auto &s = state();
+  auto service = s.services.find(service_handle);
+  for (uint32_t h = service->second.start_handle; h <= service->second.end_handle; h++) {
+    s.attributes.erase(h);
+  }
+  s.services.erase(service);
+}
+
+} // namespace
+
+void reset() {
+  auto &s = state();
+  Lock lock(s.mutex);
+  s.controller_initialized = s.controller_enabled = false;
+  s.bluedroid_initialized = s.bluedroid_enabled = false;
+  s.gatts_cb = nullptr;
+  s.gap_cb = nullptr;
+  s.apps.clear();
+  s.attributes.clear();
+  s.services.clear();
+  s.events.clear();
+  s.device_name.clear();
+  s.appearance = 0;
+  s.local_mtu = ESP_GATT_MAX_MTU_SIZE;
+  s.advertising = false;
+  s.bonds.clear();
+  s.connection = {};
+  s.next_conn_id = 0;
+  s.pending = {};
+  s.stats = {};
+  s.link_time_us = 0;
+  add_builtin_services(s);
+}
+
+size_t process_events(size_t max_events) {
+  auto &s = state();
+  size_t count = 0;
+  while (count < max_events) {
+    Event ev;
+    esp_gatts_cb_t gatts_cb;
+    esp_gap_ble_cb_t gap_cb;
+    {
+      Lock lock(s.mutex);
+      if (s.events.empty()) {
+        break;
+      }
+      ev = std::move(s.events.front());
+      s.events.pop_front();
+      s.stats.events_dispatched++;
+      gatts_cb = s.gatts_cb;
+      gap_cb = s.gap_cb;
+    }
+    if (ev.gap) {
+      if (gap_cb) {
+        gap_cb(static_cast<esp_gap_ble_cb_event_t>(ev.event), &ev.gap_param);
+      }
+    } else if (gatts_cb) {
+      if (ev.event == ESP_GATTS_CREAT_ATTR_TAB_EVT) {
+        ev.gatts.add_attr_tab.handles = ev.handles.data();
+      } else if (ev.event == ESP_GATTS_WRITE_EVT) {
+        ev.gatts.write.value = ev.data.data();
+      } else if (ev.event == ESP_GATTS_CONF_EVT) {
+        ev.gatts.conf.value = ev.data.data();
+      }
+      gatts_cb(static_cast<esp_gatts_cb_event_t>(ev.event), ev.gatts_if, &ev.gatts);
+    }
+    count++;
+  }
+  return count;
+}
+
+LinkConfig &link_config() { return state().link; }
+
+const Stats &stats() { return state().stats; }
+
+std::vector<Service> services() {
+  auto &s = state();
+  Lock lock(s.mutex);
+  std::vector<Service> result;
+  for (const auto &[handle, service] : s.services) {
+    result.push_back(service);
+  }
+  return result;
+}
+
+const Attribute *find_attribute(uint16_t handle) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  auto it = s.attributes.find(handle);
+  return it == s.attributes.end() ? nullptr : &it->second;
+}
+
+std::string_view device_name() { return state().device_name; }
+
+uint16_t appearance() { return state().appearance; }
+
+bool is_advertising() { return state().advertising; }
+
+bool connect(const esp_bd_addr_t address, const Peer &peer) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (!s.advertising || s.connection.connected) {
+    return false;
+  }
+  // connectable advertising stops once a central connects
+  s.advertising = false;
+  s.connection = {};
+  s.connection.connected = true;
+  std::memcpy(s.connection.peer_address, address, ESP_BD_ADDR_LEN);
+  s.connection.conn_id = s.next_conn_id++;
+  s.connection.peer = peer;
+
+  Event ev;
+  auto &p = ev.gatts.connect;
+  p.conn_id = s.connection.conn_id;
+  p.link_role = 1; // slave
+  std::memcpy(p.remote_bda, address, ESP_BD_ADDR_LEN);
+  p.conn_params = {s.connection.interval, s.connection.latency, s.connection.timeout};
+  p.ble_addr_type = BLE_ADDR_TYPE_PUBLIC;
+  p.conn_handle = s.connection.conn_id;
+  queue_gatts_all(ESP_GATTS_CONNECT_EVT, ev);
+  return true;
+}
+
+void disconnect(esp_gatt_conn_reason_t reason) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (!s.connection.connected) {
+    return;
+  }
+  Event ev;
+  ev.gatts.disconnect.conn_id = s.connection.conn_id;
+  std::memcpy(ev.gatts.disconnect.remote_bda, s.connection.peer_address, ESP_BD_ADDR_LEN);
+  ev.gatts.disconnect.reason = reason;
+  s.stats.notifications_dropped += s.connection.tx_queue.size();
+  s.connection = {};
+  queue_gatts_all(ESP_GATTS_DISCONNECT_EVT, ev);
+}
+
+bool is_connected() { return state().connection.connected; }
+
+void encrypt() {
+  auto &s = state();
+  Lock lock(s.mutex);
+  auto &c = s.connection;
+  if (!c.connected) {
+    return;
+  }
+  bool bonded = std::any_of(s.bonds.begin(), s.bonds.end(), [&](const esp_ble_bond_dev_t &bond) {
+    return std::memcmp(bond.bd_addr, c.peer_address, ESP_BD_ADDR_LEN) == 0;
+  });
+  if (!bonded) {
+    // just works pairing, distributing the encryption and identity keys
+    for (esp_ble_key_type_t key_type : {ESP_LE_KEY_PENC, ESP_LE_KEY_PID, ESP_LE_KEY_LENC, ESP_LE_KEY_LID}) {
+      Event ev;
+      std::memcpy(ev.gap_param.ble_security.ble_key.bd_addr, c.peer_address, ESP_BD_ADDR_LEN);
+      ev.gap_param.ble_security.ble_key.key_type = key_type;
+      queue_gap(ESP_GAP_BLE_KEY_EVT, ev);
+    }
+    esp_ble_bond_dev_t bond{};
+    std::memcpy(bond.bd_addr, c.peer_address, ESP_BD_ADDR_LEN);
+    bond.bd_addr_type = BLE_ADDR_TYPE_PUBLIC;
+    s.bonds.push_back(bond);
+  }
+  c.encrypted = true;
+  Event ev;
+  auto &auth = ev.gap_param.ble_security.auth_cmpl;
+  std::memcpy(auth.bd_addr, c.peer_address, ESP_BD_ADDR_LEN);
+  auth.key_present = true;
+  auth.key_type = ESP_LE_KEY_LENC;
+  auth.success = true;
+  auth.addr_type = BLE_ADDR_TYPE_PUBLIC;
+  auth.dev_type = ESP_BT_DEVICE_TYPE_BLE;
+  auth.auth_mode = ESP_LE_AUTH_BOND;
+  queue_gap(ESP_GAP_BLE_AUTH_CMPL_EVT, ev);
+}
+
+bool is_encrypted() { return state().connection.encrypted; }
+
+uint16_t exchange_mtu(uint16_t client_mtu) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (!s.connection.connected) {
+    return 0;
+  }
+  s.stats.att_requests++;
+  s.connection.mtu = std::max<uint16_t>(ESP_GATT_DEF_BLE_MTU_SIZE, std::min(client_mtu, s.local_mtu));
+  Event ev;
+  ev.gatts.mtu.conn_id = s.connection.conn_id;
+  ev.gatts.mtu.mtu = s.connection.mtu;
+  queue_gatts_all(ESP_GATTS_MTU_EVT, ev);
+  return s.connection.mtu;
+}
+
+uint16_t connection_interval() { return state().connection.interval; }
+
+std::vector<std::pair<uint16_t, esp_bt_uuid_t>> find_information(uint16_t start_handle, uint16_t end_handle) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  std::vector<std::pair<uint16_t, esp_bt_uuid_t>> result;
+  s.stats.att_requests++;
+  size_t space = s.connection.mtu - 2;
+  for (auto it = s.attributes.lower_bound(start_handle); it != s.attributes.end() && it->first <= end_handle; ++it) {
+    const auto &attribute = it->second;
+    if (!is_visible(attribute)) {
+      continue;
+    }
+    // one response only holds one kind of UUID
+    if (!result.empty() && attribute.uuid.len != result.front().second.len) {
+      break;
+    }
+    size_t entry_size = 2 + attribute.uuid.len;
+    if (entry_size > space) {
+      break;
+    }
+    space -= entry_size;
+    result.emplace_back(attribute.handle, attribute.uuid);
+  }
+  return result;
+}
+
+esp_gatt_status_t read(uint16_t handle, uint16_t offset, std::vector<uint8_t> &value) {
+  auto &s = state();
+  uint32_t trans_id;
+  {
+    Lock lock(s.mutex);
+    s.stats.att_requests++;
+    auto it = s.attributes.find(handle);
+    if (!s.connection.connected || it == s.attributes.end() || !is_visible(it->second)) {
+      return ESP_GATT_INVALID_HANDLE;
+    }
+    const auto &attribute = it->second;
+    if (auto status = check_permission(attribute, false); status != ESP_GATT_OK) {
+      return status;
+    }
+    size_t chunk = s.connection.mtu - 1;
+    if (attribute.auto_rsp) {
+      auto full = value_of(attribute);
+      if (offset > full.size()) {
+        return ESP_GATT_INVALID_OFFSET;
+      }
+      value.assign(full.begin() + offset, full.begin() + std::min(full.size(), offset + chunk));
+      return ESP_GATT_OK;
+    }
+    trans_id = s.next_trans_id++;
+    s.pending = {trans_id};
+    Event ev;
+    auto &p = ev.gatts.read;
+    p.conn_id = s.connection.conn_id;
+    p.trans_id = trans_id;
+    std::memcpy(p.bda, s.connection.peer_address, ESP_BD_ADDR_LEN);
+    p.handle = handle;
+    p.offset = offset;
+    p.is_long = offset > 0;
+    p.need_rsp = true;
+    queue_gatts(ESP_GATTS_READ_EVT, s.services[attribute.service_handle].gatts_if, ev);
+  }
+  return wait_for_response(trans_id, &value);
+}
+
+esp_gatt_status_t write(uint16_t handle, std::span<const uint8_t> value, bool with_response) {
+  auto &s = state();
+  uint32_t trans_id;
+  bool need_rsp;
+  {
+    Lock lock(s.mutex);
+    s.stats.att_requests++;
+    auto it = s.attributes.find(handle);
+    if (!s.connection.connected || it == s.attributes.end() || !is_visible(it->second)) {
+      return ESP_GATT_INVALID_HANDLE;
+    }
+    auto &attribute = it->second;
+    if (auto status = check_permission(attribute, true); status != ESP_GATT_OK) {
+      return status;
+    }
+    if (value.size() > attribute.max_length) {
+      return ESP_GATT_INVALID_ATTR_LEN;
+    }
+    if (attribute.auto_rsp) {
+      attribute.value.assign(value.begin(), value.end());
+    }
+    if (attribute.service_handle == GATT_SERVICE_HANDLE) {
+      // handled by the stack itself
+      return ESP_GATT_OK;
+    }
+    trans_id = s.next_trans_id++;
+    need_rsp = with_response && !attribute.auto_rsp;
+    s.pending = {trans_id};
+    Event ev;
+    auto &p = ev.gatts.write;
+    p.conn_id = s.connection.conn_id;
+    p.trans_id = trans_id;
+    std::memcpy(p.bda, s.connection.peer_address, ESP_BD_ADDR_LEN);
+    p.handle = handle;
+    p.need_rsp = need_rsp;
+    p.len = value.size();
+    ev.data.assign(value.begin(), value.end());
+    queue_gatts(ESP_GATTS_WRITE_EVT, s.services[attribute.service_handle].gatts_if, ev);
+  }
+  if (!need_rsp) {
+    return ESP_GATT_OK;
+  }
+  return wait_for_response(trans_id, nullptr);
+}
+
+size_t tx_queue_depth() {
+  auto &s = state();
+  Lock lock(s.mutex);
+  return s.connection.tx_queue.size();
+}
+
+size_t run_connection_events(size_t count) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  size_t sent = 0;
+  auto &c = s.connection;
+  for (size_t i = 0; i < count && c.connected; i++) {
+    s.stats.connection_events++;
+    s.link_time_us += c.interval * 1250;
+    for (size_t n = 0; n < s.link.packets_per_event && !c.tx_queue.empty(); n++) {
+      auto notification = std::move(c.tx_queue.front());
+      c.tx_queue.pop_front();
+      if (c.peer.on_notification) {
+        c.peer.on_notification(notification.handle, notification.value, notification.indication);
+      }
+      s.stats.notifications_delivered++;
+      sent++;
+      if (notification.handle != SERVICE_CHANGED_VALUE_HANDLE) {
+        queue_conf(ESP_GATT_OK, notification.handle, std::move(notification.value));
+      }
+    }
+    if (c.congested && c.tx_queue.size() <= s.link.tx_queue_size / 2) {
+      c.congested = false;
+      Event ev;
+      ev.gatts.congest.conn_id = c.conn_id;
+      ev.gatts.congest.congested = false;
+      queue_gatts_all(ESP_GATTS_CONGEST_EVT, ev);
+    }
+  }
+  return sent;
+}
+
+int64_t link_time_us() { return state().link_time_us; }
+
+} // namespace host::bluedroid
+
+using namespace host::bluedroid;
+
+extern "C" {
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t) { return ESP_OK; }
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (s.controller_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  s.controller_initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (!s.controller_initialized || s.controller_enabled || mode != ESP_BT_MODE_BLE) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  s.controller_enabled = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_init(void) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (!s.controller_enabled || s.bluedroid_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  s.bluedroid_initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_enable(void) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (!s.bluedroid_initialized || s.bluedroid_enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  s.bluedroid_enabled = true;
+  return ESP_OK;
+}
+
+const uint8_t *esp_bt_dev_get_address(void) { return LOCAL_ADDRESS; }
+
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu) {
+  if (mtu < ESP_GATT_DEF_BLE_MTU_SIZE || mtu > ESP_GATT_MAX_MTU_SIZE) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  auto &s = state();
+  Lock lock(s.mutex);
+  s.local_mtu = mtu;
+  return ESP_OK;
+}
+
+// GATTS
+
+esp_err_t esp_ble_gatts_register_callback(esp_gatts_cb_t callback) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  s.gatts_cb = callback;
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_register(uint16_t app_id) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (!s.bluedroid_enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  s.apps.push_back(app_id);
+  Event ev;
+  ev.gatts.reg.status = ESP_GATT_OK;
+  ev.gatts.reg.app_id = app_id;
+  queue_gatts(ESP_GATTS_REG_EVT, FIRST_GATTS_IF + s.apps.size() - 1, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_unregister(esp_gatt_if_t gatts_if) {
+  Event ev;
+  ev.gatts.reg.status = ESP_GATT_OK;
+  queue_gatts(ESP_GATTS_UNREG_EVT, gatts_if, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_create_attr_tab(const esp_gatts_attr_db_t *gatts_attr_db, esp_gatt_if_t gatts_if,
+                                        uint16_t max_nb_attr, uint8_t srvc_inst_id) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (!s.bluedroid_enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!gatts_attr_db || max_nb_attr == 0 || max_nb_attr > MAX_ATTRIBUTES_PER_TABLE) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  Event ev;
+  ev.gatts_if = gatts_if;
+  ev.handles.assign(max_nb_attr, 0);
+  auto &p = ev.gatts.add_attr_tab;
+  p.svc_inst_id = srvc_inst_id;
+  p.num_handle = max_nb_attr;
+  p.status = add_attr_tab(gatts_attr_db, max_nb_attr, ev);
+  if (p.status == ESP_GATT_OK) {
+    s.stats.attr_tables_created++;
+  } else {
+    std::fill(ev.handles.begin(), ev.handles.end(), 0);
+    s.stats.attr_tables_failed++;
+  }
+  queue_gatts(ESP_GATTS_CREAT_ATTR_TAB_EVT, gatts_if, std::move(ev));
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_delete_service(uint16_t service_handle) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  Event ev;
+  ev.gatts.del.service_handle = service_handle;
+  auto service = s.services.find(service_handle);
+  if (service == s.services.end() || service_handle < FIRST_APP_HANDLE) {
+    ev.gatts.del.status = ESP_GATT_NOT_FOUND;
+    queue_gatts_all(ESP_GATTS_DELETE_EVT, ev);
+    return ESP_OK;
+  }
+  auto gatts_if = service->second.gatts_if;
+  remove_service(service_handle);
+  ev.gatts.del.status = ESP_GATT_OK;
+  queue_gatts(ESP_GATTS_DELETE_EVT, gatts_if, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_start_service(uint16_t service_handle) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  Event ev;
+  ev.gatts.start.service_handle = service_handle;
+  auto service = s.services.find(service_handle);
+  if (service == s.services.end()) {
+    ev.gatts.start.status = ESP_GATT_NOT_FOUND;
+    queue_gatts_all(ESP_GATTS_START_EVT, ev);
+    return ESP_OK;
+  }
+  service->second.started = true;
+  s.stats.services_started++;
+  ev.gatts.start.status = ESP_GATT_OK;
+  queue_gatts(ESP_GATTS_START_EVT, service->second.gatts_if, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_stop_service(uint16_t service_handle) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  Event ev;
+  ev.gatts.stop.service_handle = service_handle;
+  auto service = s.services.find(service_handle);
+  if (service == s.services.end()) {
+    ev.gatts.stop.status = ESP_GATT_NOT_FOUND;
+    queue_gatts_all(ESP_GATTS_STOP_EVT, ev);
+    return ESP_OK;
+  }
+  service->second.started = false;
+  ev.gatts.stop.status = ESP_GATT_OK;
+  queue_gatts(ESP_GATTS_STOP_EVT, service->second.gatts_if, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t, uint16_t conn_id, uint16_t attr_handle, uint16_t value_len,
+                                      uint8_t *value, bool need_confirm) {
+  if (value_len > ESP_GATT_MAX_ATTR_LEN) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (!s.bluedroid_enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  auto &c = s.connection;
+  std::vector<uint8_t> data(value, value + value_len);
+  auto it = s.attributes.find(attr_handle);
+  if (!c.connected || conn_id != c.conn_id || it == s.attributes.end()) {
+    queue_conf(ESP_GATT_ILLEGAL_PARAMETER, attr_handle, std::move(data));
+    return ESP_OK;
+  }
+  if (data.size() > size_t(c.mtu - 3)) {
+    data.resize(c.mtu - 3);
+    s.stats.notifications_truncated++;
+  }
+  if (it->second.auto_rsp && data.size() <= it->second.max_length) {
+    it->second.value = data;
+  }
+  if (c.tx_queue.size() >= s.link.tx_queue_size) {
+    s.stats.notifications_dropped++;
+    queue_conf(ESP_GATT_CONGESTED, attr_handle, std::move(data));
+    return ESP_OK;
+  }
+  c.tx_queue.push_back({attr_handle, std::move(data), need_confirm});
+  s.stats.notifications_queued++;
+  if (!c.congested && c.tx_queue.size() >= s.link.tx_queue_size) {
+    c.congested = true;
+    Event ev;
+    ev.gatts.congest.conn_id = c.conn_id;
+    ev.gatts.congest.congested = true;
+    queue_gatts_all(ESP_GATTS_CONGEST_EVT, ev);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_send_response(esp_gatt_if_t gatts_if, uint16_t, uint32_t trans_id,
+                                      esp_gatt_status_t status, esp_gatt_rsp_t *rsp) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  Event ev;
+  if (trans_id != s.pending.trans_id || s.pending.received) {
+    ev.gatts.rsp.status = ESP_GATT_ILLEGAL_PARAMETER;
+    queue_gatts(ESP_GATTS_RESPONSE_EVT, gatts_if, ev);
+    return ESP_OK;
+  }
+  s.pending.received = true;
+  s.pending.status = status;
+  if (rsp) {
+    s.pending.value.assign(rsp->attr_value.value, rsp->attr_value.value + rsp->attr_value.len);
+    ev.gatts.rsp.handle = rsp->attr_value.handle;
+  }
+  ev.gatts.rsp.status = ESP_GATT_OK;
+  queue_gatts(ESP_GATTS_RESPONSE_EVT, gatts_if, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_set_attr_value(uint16_t attr_handle, uint16_t length, const uint8_t *value) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  Event ev;
+  ev.gatts.set_attr_val.attr_handle = attr_handle;
+  auto it = s.attributes.find(attr_handle);
+  esp_gatt_if_t gatts_if = ESP_GATT_IF_NONE;
+  if (it == s.attributes.end() || attr_handle < FIRST_APP_HANDLE) {
+    ev.gatts.set_attr_val.status = ESP_GATT_INVALID_HANDLE;
+    s.stats.attr_values_failed++;
+  } else if (length > it->second.max_length) {
+    ev.gatts.set_attr_val.status = ESP_GATT_INVALID_ATTR_LEN;
+    s.stats.attr_values_failed++;
+  } else {
+    s.stats.attr_values_set++;
+    it->second.value.assign(value, value + length);
+    ev.gatts.set_attr_val.srvc_handle = it->second.service_handle;
+    ev.gatts.set_attr_val.status = ESP_GATT_OK;
+    gatts_if = s.services[it->second.service_handle].gatts_if;
+  }
+  if (gatts_if == ESP_GATT_IF_NONE) {
+    queue_gatts_all(ESP_GATTS_SET_ATTR_VAL_EVT, ev);
+  } else {
+    queue_gatts(ESP_GATTS_SET_ATTR_VAL_EVT, gatts_if, ev);
+  }
+  return ESP_OK;
+}
+
+esp_gatt_status_t esp_ble_gatts_get_attr_value(uint16_t attr_handle, uint16_t *length, const uint8_t **value) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  auto it = s.attributes.find(attr_handle);
+  if (it == s.attributes.end()) {
+    *length = 0;
+    return ESP_GATT_INVALID_HANDLE;
+  }
+  *length = it->second.value.size();
+  *value = it->second.value.data();
+  return ESP_GATT_OK;
+}
+
+esp_err_t esp_ble_gatts_close(esp_gatt_if_t, uint16_t conn_id) {
+  if (conn_id == state().connection.conn_id) {
+    disconnect(ESP_GATT_CONN_TERMINATE_LOCAL_HOST);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_send_service_change_indication(esp_gatt_if_t gatts_if, esp_bd_addr_t) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  auto &c = s.connection;
+  s.stats.service_changed_indications++;
+  const auto &cccd = s.attributes[SERVICE_CHANGED_CCCD_HANDLE].value;
+  if (c.connected && cccd.size() == 2 && (cccd[0] & 0x02)) {
+    // the whole handle range may have changed
+    c.tx_queue.push_back({SERVICE_CHANGED_VALUE_HANDLE, {0x01, 0x00, 0xFF, 0xFF}, true});
+  }
+  Event ev;
+  ev.gatts.service_change.status = ESP_GATT_OK;
+  queue_gatts(ESP_GATTS_SEND_SERVICE_CHANGE_EVT, gatts_if, ev);
+  return ESP_OK;
+}
+
+// GAP
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  s.gap_cb = callback;
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t *adv_data) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  if (!s.bluedroid_enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  Event ev;
+  if (adv_data->set_scan_rsp) {
+    ev.gap_param.scan_rsp_data_cmpl.status = ESP_BT_STATUS_SUCCESS;
+    queue_gap(ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT, ev);
+  } else {
+    ev.gap_param.adv_data_cmpl.status = ESP_BT_STATUS_SUCCESS;
+    queue_gap(ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT, ev);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  s.advertising = true;
+  Event ev;
+  ev.gap_param.adv_start_cmpl.status = ESP_BT_STATUS_SUCCESS;
+  queue_gap(ESP_GAP_BLE_ADV_START_COMPLETE_EVT, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_stop_advertising(void) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  s.advertising = false;
+  Event ev;
+  ev.gap_param.adv_stop_cmpl.status = ESP_BT_STATUS_SUCCESS;
+  queue_gap(ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t *params) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  auto &c = s.connection;
+  Event ev;
+  auto &p = ev.gap_param.update_conn_params;
+  std::memcpy(p.bda, params->bda, ESP_BD_ADDR_LEN);
+  p.min_int = params->min_int;
+  p.max_int = params->max_int;
+  if (!c.connected || std::memcmp(params->bda, c.peer_address, ESP_BD_ADDR_LEN) != 0) {
+    p.status = ESP_BT_STATUS_FAIL;
+  } else {
+    uint16_t interval = c.peer.on_connection_update ? c.peer.on_connection_update(params->min_int, params->max_int)
+                                                    : params->max_int;
+    c.interval = interval;
+    c.latency = params->latency;
+    c.timeout = params->timeout;
+    p.status = ESP_BT_STATUS_SUCCESS;
+  }
+  p.conn_int = c.interval;
+  p.latency = c.latency;
+  p.timeout = c.timeout;
+  queue_gap(ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_device_name(const char *name) {
+  // as Bluedroid, which keeps it in a buffer of this size
+  if (!name || strlen(name) > CONFIG_BT_MAX_DEVICE_NAME_LEN) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto &s = state();
+  Lock lock(s.mutex);
+  s.device_name = name;
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_local_icon(uint32_t icon) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  s.appearance = icon;
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_security_param(esp_ble_sm_param_t param_type, void *value, uint8_t len) {
+  if (param_type >= ESP_BLE_SM_MAX_PARAM || !value || len == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_security_rsp(esp_bd_addr_t, bool) { return ESP_OK; }
+
+esp_err_t esp_ble_confirm_reply(esp_bd_addr_t, bool) { return ESP_OK; }
+
+esp_err_t esp_ble_passkey_reply(esp_bd_addr_t, bool, uint32_t) { return ESP_OK; }
+
+int esp_ble_get_bond_device_num(void) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  return s.bonds.size();
+}
+
+esp_err_t esp_ble_get_bond_device_list(int *dev_num, esp_ble_bond_dev_t *dev_list) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  *dev_num = std::min<int>(*dev_num, s.bonds.size());
+  std::copy_n(s.bonds.begin(), *dev_num, dev_list);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_remove_bond_device(esp_bd_addr_t bd_addr) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  auto bond = std::find_if(s.bonds.begin(), s.bonds.end(), [&](const esp_ble_bond_dev_t &b) {
+    return std::memcmp(b.bd_addr, bd_addr, ESP_BD_ADDR_LEN) == 0;
+  });
+  Event ev;
+  std::memcpy(ev.gap_param.remove_bond_dev_cmpl.bd_addr, bd_addr, ESP_BD_ADDR_LEN);
+  ev.gap_param.remove_bond_dev_cmpl.status = bond == s.bonds.end() ? ESP_BT_STATUS_FAIL : ESP_BT_STATUS_SUCCESS;
+  if (bond != s.bonds.end()) {
+    s.bonds.erase(bond);
+  }
+  queue_gap(ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_read_rssi(esp_bd_addr_t remote_addr) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  Event ev;
+  auto &p = ev.gap_param.read_rssi_cmpl;
+  std::memcpy(p.remote_addr, remote_addr, ESP_BD_ADDR_LEN);
+  p.status = s.connection.connected ? ESP_BT_STATUS_SUCCESS : ESP_BT_STATUS_FAIL;
+  p.rssi = -50;
+  queue_gap(ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_read_phy(esp_bd_addr_t bd_addr) {
+  auto &s = state();
+  Lock lock(s.mutex);
+  Event ev;
+  auto &p = ev.gap_param.read_phy;
+  std::memcpy(p.bda, bd_addr, ESP_BD_ADDR_LEN);
+  p.status = s.connection.connected ? ESP_BT_STATUS_SUCCESS : ESP_BT_STATUS_FAIL;
+  p.tx_phy = p.rx_phy = ESP_BLE_GAP_PHY_1M;
+  queue_gap(ESP_GAP_BLE_READ_PHY_COMPLETE_EVT, ev);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_disconnect(esp_bd_addr_t) {
+  disconnect(ESP_GATT_CONN_TERMINATE_LOCAL_HOST);
+  return ESP_OK;
+}
+
+} // extern "C"
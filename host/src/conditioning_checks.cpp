@@ -0,0 +1,290 @@
+#include "conditioning_checks.hpp"
+
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "input_conditioning.hpp"
+
+namespace host {
+
+using namespace input_conditioning;
+
+// raw readings from -FULL_SCALE to FULL_SCALE which calibrate to themselves,
+// so that the later stages can be fed exact values
+static constexpr Axis IDENTITY{.raw_min = -FULL_SCALE, .raw_center = 0, .raw_max = FULL_SCALE};
+
+namespace {
+
+struct Checker {
+  FILE *out;
+  size_t checks{0};
+  size_t failed{0};
+
+  void near(std::string_view what, int actual, int expected, int tolerance = 0) {
+    checks++;
+    if (std::abs(actual - expected) > tolerance) {
+      failed++;
+      fmt::print(out, "conditioning: {}: {}, expected {} (+-{})\n", what, actual, expected, tolerance);
+    }
+  }
+
+  void is(std::string_view what, bool holds) {
+    checks++;
+    if (!holds) {
+      failed++;
+      fmt::print(out, "conditioning: {} does not hold\n", what);
+    }
+  }
+};
+
+// a pipeline on the scalar kernels, which processes one frame at a time,
+// 1 ms apart unless told otherwise
+struct Scalar {
+  Pipeline pipeline;
+  int64_t now_us{0};
+
+  explicit Scalar(const Pipeline::Config &config)
+      : pipeline(scalar(config)) {}
+
+  static Pipeline::Config scalar(Pipeline::Config config) {
+    config.kernels = Kernels::SCALAR;
+    return config;
+  }
+
+  std::vector<int16_t> process(std::vector<int16_t> raw, int64_t dt_us = 1000) {
+    std::vector<int16_t> out(raw.size());
+    now_us += dt_us;
+    pipeline.process(raw.data(), out.data(), now_us);
+    return out;
+  }
+
+  int16_t process_one(int16_t raw, int64_t dt_us = 1000) { return process({raw}, dt_us)[0]; }
+};
+
+} // namespace
+
+static void check_calibration(Checker &check) {
+  // the gamepad's stick: the two halves have their own gain
+  Scalar stick({.axes = {{.raw_min = 0, .raw_center = 2048, .raw_max = 4095}}});
+  check.near("stick at its center", stick.process_one(2048), 0);
+  check.near("stick at its minimum", stick.process_one(0), -FULL_SCALE, 2);
+  check.near("stick at its maximum", stick.process_one(4095), FULL_SCALE, 2);
+  check.near("stick half way down", stick.process_one(1024), -FULL_SCALE / 2, 2);
+  check.near("stick half way up", stick.process_one(3072), FULL_SCALE / 2, 16);
+  // readings outside the range are the range's ends, even the int16 extremes
+  check.near("stick below its minimum", stick.process_one(-100), stick.process_one(0));
+  check.near("stick above its maximum", stick.process_one(5000), stick.process_one(4095));
+  check.near("stick at INT16_MIN", stick.process_one(INT16_MIN), stick.process_one(0));
+  check.near("stick at INT16_MAX", stick.process_one(INT16_MAX), stick.process_one(4095));
+
+  // an off-center, lopsided calibration
+  Scalar lopsided({.axes = {{.raw_min = 100, .raw_center = 1000, .raw_max = 4000}}});
+  check.near("lopsided at its center", lopsided.process_one(1000), 0);
+  check.near("lopsided at its minimum", lopsided.process_one(100), -FULL_SCALE, 64);
+  check.near("lopsided at its maximum", lopsided.process_one(4000), FULL_SCALE, 16);
+  check.near("lopsided a third of the way up", lopsided.process_one(2000), FULL_SCALE / 3, 16);
+
+  // a trigger, centered at its minimum, has no range below its center
+  Scalar trigger({.axes = {{.raw_min = 0, .raw_center = 0, .raw_max = 1023}}});
+  check.near("trigger released", trigger.process_one(0), 0);
+  check.near("trigger below its minimum", trigger.process_one(-50), 0);
+  check.near("trigger pulled", trigger.process_one(1023), FULL_SCALE, 32);
+  check.near("trigger past its maximum", trigger.process_one(2000), trigger.process_one(1023));
+
+  // an axis whose range is zero wide is 0 whatever it reads, and leaves the
+  // calibration of the axes next to it alone
+  Scalar flat({.axes = {{.raw_min = 500, .raw_center = 500, .raw_max = 500}, IDENTITY}});
+  for (int16_t raw : {int16_t(INT16_MIN), int16_t(0), int16_t(499), int16_t(500), int16_t(501), int16_t(INT16_MAX)}) {
+    auto out = flat.process({raw, 1234});
+    check.near(fmt::format("zero wide axis at {}", raw), out[0], 0);
+    check.near("axis next to a zero wide one", out[1], 1234);
+  }
+  // as is a range which is inverted (the maximum below the center)
+  Scalar inverted({.axes = {{.raw_min = 600, .raw_center = 500, .raw_max = 400}}});
+  check.near("inverted axis below its center", inverted.process_one(0), 0);
+  check.near("inverted axis above its center", inverted.process_one(1000), 0);
+  // a range one count wide is all or nothing
+  Scalar narrow({.axes = {{.raw_min = 2000, .raw_center = 2001, .raw_max = 2002}}});
+  check.near("narrow axis at its minimum", narrow.process_one(2000), -FULL_SCALE);
+  check.near("narrow axis at its center", narrow.process_one(2001), 0);
+  check.near("narrow axis at its maximum", narrow.process_one(2002), FULL_SCALE);
+  check.near("narrow axis far above it", narrow.process_one(INT16_MAX), FULL_SCALE);
+}
+
+static void check_iir(Checker &check) {
+  // y += alpha * (x - y), with alpha a half
+  Scalar iir({.axes = {IDENTITY, IDENTITY}, .filter = Filter::IIR, .iir_alpha = 16384});
+  auto first = iir.process({1000, -1000});
+  check.near("IIR's first frame", first[0], 1000);
+  check.near("IIR's first frame (negative)", first[1], -1000);
+  auto step = iir.process({9000, -9000});
+  check.near("IIR half way to a step", step[0], 5000);
+  check.near("IIR half way to a step (negative)", step[1], -5000);
+  step = iir.process({9000, -9000});
+  check.near("IIR three quarters of the way to a step", step[0], 7000);
+  check.near("IIR three quarters of the way (negative)", step[1], -7000);
+  for (int i = 0; i < 20; i++) {
+    step = iir.process({9000, -9000});
+  }
+  check.near("IIR settled", step[0], 9000, 1);
+  check.near("IIR settled (negative)", step[1], -9000, 1);
+  // a full scale swing doesn't overflow the difference
+  iir.process({FULL_SCALE, -FULL_SCALE});
+  for (int i = 0; i < 20; i++) {
+    step = iir.process({-FULL_SCALE, FULL_SCALE});
+  }
+  check.near("IIR after a full scale swing", step[0], -FULL_SCALE, 1);
+  check.near("IIR after a full scale swing (negative)", step[1], FULL_SCALE, 1);
+  // after a reset the next frame is taken as it is
+  iir.pipeline.reset();
+  check.near("IIR after a reset", iir.process({1234, 0})[0], 1234);
+
+  Scalar passthrough({.axes = {IDENTITY}, .filter = Filter::IIR, .iir_alpha = 32768});
+  passthrough.process_one(0);
+  check.near("IIR with alpha 1", passthrough.process_one(20000), 20000, 1);
+}
+
+static void check_one_euro(Checker &check) {
+  // at rest (beta 0) the cutoff is min_cutoff_hz: alpha = 1 / (1 + 1 / (2 pi 1 Hz 1 ms))
+  static constexpr float ALPHA = 0.0062440f;
+  Scalar slow({.axes = {IDENTITY}, .filter = Filter::ONE_EURO, .min_cutoff_hz = 1.0f, .beta = 0.0f});
+  check.near("one-euro's first frame", slow.process_one(-3000), -3000);
+  check.near("one-euro at rest", slow.process_one(-3000), -3000);
+  int16_t value = slow.process_one(20000);
+  check.near("one-euro's first step", value, int(-3000 + 23000 * ALPHA), 1);
+  int16_t last = value;
+  bool rising = true;
+  for (int i = 0; i < 200; i++) {
+    value = slow.process_one(20000);
+    rising &= value >= last && value <= 20000;
+    last = value;
+  }
+  check.is("one-euro approaching a step from below", rising);
+  // readings at the same time take the frame as it is
+  check.near("one-euro without time passing", slow.process_one(500, 0), 500);
+  check.near("one-euro going back in time", slow.process_one(700, -1000), 700);
+
+  // with beta, the cutoff rises with the speed, so it lags less when moving
+  Scalar fast({.axes = {IDENTITY}, .filter = Filter::ONE_EURO, .min_cutoff_hz = 1.0f, .beta = 50.0f});
+  fast.process_one(-3000);
+  check.is("one-euro lagging less when moving", fast.process_one(20000) > int(-3000 + 23000 * ALPHA) + 1);
+  for (int i = 0; i < 5000; i++) {
+    value = fast.process_one(20000);
+  }
+  check.near("one-euro settled", value, 20000, 1);
+  fast.pipeline.reset();
+  check.near("one-euro after a reset", fast.process_one(-32767), -32767);
+}
+
+static void check_radial_deadzone(Checker &check) {
+  // a 10% radial deadzone, the rest of the way out stretched over the full range
+  Scalar stick({.axes = {IDENTITY, IDENTITY}, .sticks = {{.x = 0, .y = 1, .deadzone = 3277}}});
+  auto out = stick.process({2000, 2000});
+  check.near("stick inside the deadzone, x", out[0], 0);
+  check.near("stick inside the deadzone, y", out[1], 0);
+  out = stick.process({3277, 0});
+  check.near("stick on the deadzone", out[0], 0);
+  out = stick.process({0, 3500});
+  check.near("stick just out of the deadzone, x", out[0], 0);
+  check.is("stick just out of the deadzone, y", out[1] > 0 && out[1] < 500);
+  out = stick.process({20000, 0});
+  check.near("stick out on x", out[0], 18582, 1);
+  check.near("stick out on x, y", out[1], 0);
+  out = stick.process({20000, 20000});
+  check.near("stick out diagonally, x", out[0], 19648, 1);
+  check.near("stick out diagonally, y", out[1], 19648, 1);
+  out = stick.process({-20000, 5000});
+  check.near("stick out left, x", out[0], -18690, 1);
+  check.near("stick out left, y", out[1], 4673, 1);
+  out = stick.process({0, -FULL_SCALE});
+  check.near("stick all the way down", out[1], -FULL_SCALE);
+  // in the corner, past full scale, the stick stays on the circle
+  out = stick.process({FULL_SCALE, FULL_SCALE});
+  check.near("stick in the corner, x", out[0], 23170, 1);
+  check.near("stick in the corner, y", out[1], 23170, 1);
+  out = stick.process({INT16_MIN, INT16_MIN});
+  check.near("stick past its minimum in the corner, x", out[0], -23170, 1);
+  check.near("stick past its minimum in the corner, y", out[1], -23170, 1);
+
+  // a stick whose axes don't exist is left out
+  Scalar missing({.axes = {IDENTITY}, .sticks = {{.x = 0, .y = 5, .deadzone = 3277}}});
+  check.near("stick with a missing axis", missing.process_one(2000), 2000);
+}
+
+static void check_axis_deadzones(Checker &check) {
+  Axis axis = IDENTITY;
+  axis.deadzone = 330;
+  axis.outer_deadzone = 330;
+  Scalar dead({.axes = {axis}});
+  check.near("axis on its deadzone", dead.process_one(330), 0);
+  check.near("axis on its deadzone (negative)", dead.process_one(-330), 0);
+  check.near("axis just out of its deadzone", dead.process_one(331), 1);
+  check.near("axis half way", dead.process_one(16384), 16384, 1);
+  check.near("axis half way (negative)", dead.process_one(-16384), -16384, 1);
+  check.near("axis on its outer deadzone", dead.process_one(FULL_SCALE - 330), FULL_SCALE);
+  check.near("axis at INT16_MIN", dead.process_one(INT16_MIN), -FULL_SCALE);
+
+  // deadzones which overlap leave one step between 0 and full scale
+  axis.deadzone = 30000;
+  axis.outer_deadzone = 30000;
+  Scalar overlapping({.axes = {axis}});
+  check.near("overlapping deadzones inside", overlapping.process_one(30000), 0);
+  check.near("overlapping deadzones outside", overlapping.process_one(30001), FULL_SCALE);
+  // a deadzone over full scale leaves the top value
+  axis.deadzone = 65535;
+  axis.outer_deadzone = 0;
+  Scalar all_dead({.axes = {axis}});
+  check.near("deadzone over full scale", all_dead.process_one(FULL_SCALE - 1), 0);
+  check.near("deadzone over full scale at full scale", all_dead.process_one(FULL_SCALE), FULL_SCALE);
+}
+
+static void check_curves(Checker &check) {
+  const auto square = Curve::power(2.0f);
+  const auto linear = Curve::power(1.0f);
+  const auto root = Curve::power(0.5f);
+  for (const auto *curve : {&square, &linear, &root}) {
+    check.near("curve at 0", curve->apply(0), 0);
+    check.near("curve at full scale", curve->apply(FULL_SCALE), FULL_SCALE, 1);
+    bool monotonic = true;
+    for (int magnitude = 1; magnitude <= FULL_SCALE; magnitude++) {
+      monotonic &= curve->apply(magnitude) >= curve->apply(magnitude - 1);
+    }
+    check.is("curve monotonic", monotonic);
+  }
+  bool straight = true;
+  for (int magnitude = 0; magnitude <= FULL_SCALE; magnitude += 97) {
+    straight &= std::abs(linear.apply(magnitude) - magnitude) <= 1;
+  }
+  check.is("power 1 curve straight", straight);
+  check.near("square curve half way", square.apply(16384), 8192, 1);
+  check.near("square curve a quarter of the way", square.apply(8192), 2048, 1);
+  // between its points it interpolates: with 1024 wide segments the error
+  // of x^2 is at most 1024^2 / 4 / FULL_SCALE
+  check.near("square curve between points", square.apply(16384 + 512), 8712, 9);
+  check.near("square root curve a quarter of the way", root.apply(8192), 16384, 1);
+
+  // through the pipeline the curve maps the magnitude, the sign is kept
+  Axis axis = IDENTITY;
+  axis.curve = &square;
+  Scalar curved({.axes = {axis}});
+  check.near("curved axis half way", curved.process_one(16384), 8192, 1);
+  check.near("curved axis half way (negative)", curved.process_one(-16384), -8192, 1);
+  check.near("curved axis past full scale", curved.process_one(INT16_MIN), -FULL_SCALE, 1);
+}
+
+size_t check_input_conditioning(FILE *out) {
+  Checker check{.out = out};
+  check_calibration(check);
+  check_iir(check);
+  check_one_euro(check);
+  check_radial_deadzone(check);
+  check_axis_deadzones(check);
+  check_curves(check);
+  fmt::print(out, "conditioning: {} of {} checks failed\n", check.failed, check.checks);
+  return check.failed;
+}
+
+} // namespace host
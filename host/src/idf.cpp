@@ -0,0 +1,437 @@
+#include "host_idf.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include <esp_app_desc.h>
+#include <esp_err.h>
+#include <esp_partition.h>
+#include <esp_pm.h>
+#include <esp_random.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <nvs_flash.h>
+
+#include "driver/gpio.h"
+#include "freertos/semphr.h"
+
+// A power management lock, its acquisitions are counted
+struct esp_pm_lock {
+  esp_pm_lock_type_t type;
+  std::string name;
+  size_t count{0};
+};
+
+// A one-shot timer, due at due_us while armed
+struct esp_timer {
+  esp_timer_create_args_t args;
+  int64_t due_us{0};
+  bool armed{false};
+};
+
+namespace host::idf {
+namespace {
+
+struct Partition {
+  esp_partition_t partition{};
+  std::string path;
+  std::vector<uint32_t> data; // word aligned, like a flash mapping
+  size_t size{0};             // of the partition, 0 for the file's
+  bool mapped{false};
+};
+
+std::map<std::string, Partition> &partitions() {
+  static std::map<std::string, Partition> p;
+  return p;
+}
+
+// Power management: the configuration, the locks and the light sleep callbacks
+struct PowerManagement {
+  std::mutex mutex;
+  esp_pm_config_t config{};
+  std::vector<esp_pm_lock *> locks;
+  esp_pm_sleep_cbs_register_config_t callbacks{};
+  uint64_t wake_gpios{0};
+  bool gpio_wakeup{false};
+  esp_sleep_wakeup_cause_t wakeup_cause{ESP_SLEEP_WAKEUP_UNDEFINED};
+  size_t light_sleeps{0};
+};
+
+PowerManagement &pm() {
+  static PowerManagement p;
+  return p;
+}
+
+// The timers made by esp_timer_create(), run by run_timers()
+struct Timers {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<esp_timer>> timers;
+};
+
+Timers &timers() {
+  static Timers t;
+  return t;
+}
+
+// with pm().mutex held
+size_t locks_held(esp_pm_lock_type_t type) {
+  size_t count = 0;
+  for (const auto *lock : pm().locks) {
+    count += lock->type == type ? lock->count : 0;
+  }
+  return count;
+}
+
+} // namespace
+
+void set_partition_file(const std::string &label, const std::string &path, size_t size) {
+  auto &partition = partitions()[label];
+  partition.path = path;
+  partition.size = size;
+  partition.partition.type = ESP_PARTITION_TYPE_DATA;
+  partition.partition.erase_size = 4096;
+  std::strncpy(partition.partition.label, label.c_str(), sizeof(partition.partition.label) - 1);
+}
+
+bool light_sleep(bool input) {
+  auto &p = pm();
+  esp_pm_light_sleep_cb_t exited;
+  void *arg;
+  {
+    std::lock_guard<std::mutex> lock(p.mutex);
+    if (!p.config.light_sleep_enable || locks_held(ESP_PM_NO_LIGHT_SLEEP)) {
+      return false;
+    }
+    // only a GPIO made a wake source wakes it, otherwise it's a timer
+    input = input && p.gpio_wakeup && p.wake_gpios;
+    p.wakeup_cause = input ? ESP_SLEEP_WAKEUP_GPIO : ESP_SLEEP_WAKEUP_TIMER;
+    p.light_sleeps++;
+    exited = p.callbacks.exit_cb;
+    arg = p.callbacks.exit_cb_user_arg;
+  }
+  if (exited) {
+    exited(0, arg);
+  }
+  return true;
+}
+
+size_t light_sleeps() {
+  std::lock_guard<std::mutex> lock(pm().mutex);
+  return pm().light_sleeps;
+}
+
+size_t lock_count(esp_pm_lock_type_t type) {
+  std::lock_guard<std::mutex> lock(pm().mutex);
+  return locks_held(type);
+}
+
+int cpu_freq_mhz() {
+  std::lock_guard<std::mutex> lock(pm().mutex);
+  return locks_held(ESP_PM_CPU_FREQ_MAX) ? pm().config.max_freq_mhz : pm().config.min_freq_mhz;
+}
+
+size_t run_timers() {
+  size_t count = 0;
+  // one at a time, unlocked, as a callback may start or stop timers
+  for (;;) {
+    esp_timer_cb_t callback = nullptr;
+    void *arg = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(timers().mutex);
+      int64_t now_us = esp_timer_get_time();
+      esp_timer *next = nullptr;
+      for (auto &timer : timers().timers) {
+        if (timer->armed && timer->due_us <= now_us && (!next || timer->due_us < next->due_us)) {
+          next = timer.get();
+        }
+      }
+      if (!next) {
+        return count;
+      }
+      next->armed = false;
+      callback = next->args.callback;
+      arg = next->args.arg;
+    }
+    if (callback) {
+      callback(arg);
+    }
+    count++;
+  }
+}
+
+} // namespace host::idf
+
+using namespace host::idf;
+
+// A binary semaphore, as xSemaphoreCreateBinary() makes
+struct QueueDefinition {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool available{false};
+};
+
+extern "C" {
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch (code) {
+  case ESP_OK: return "ESP_OK";
+  case ESP_FAIL: return "ESP_FAIL";
+  case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+  case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+  case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+  case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+  case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+  case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+  case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+  default: return "UNKNOWN ERROR";
+  }
+}
+
+int64_t esp_timer_get_time(void) {
+  static const auto boot = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot).count();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle) {
+  if (!create_args || !create_args->callback || !out_handle) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(timers().mutex);
+  auto timer = std::make_unique<esp_timer>();
+  timer->args = *create_args;
+  *out_handle = timer.get();
+  timers().timers.push_back(std::move(timer));
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  if (!timer) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(timers().mutex);
+  if (timer->armed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->due_us = esp_timer_get_time() + int64_t(timeout_us);
+  timer->armed = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (!timer) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(timers().mutex);
+  if (!timer->armed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->armed = false;
+  return ESP_OK;
+}
+
+uint32_t esp_random(void) {
+  // fixed seed, so runs of the simulator are repeatable
+  static std::mt19937 generator(0x1812);
+  return generator();
+}
+
+// the host has no fixed size heap, so these are made up (an ESP32's, roughly,
+// once Bluedroid is up)
+uint32_t esp_get_free_heap_size(void) { return 180 * 1024; }
+
+uint32_t esp_get_minimum_free_heap_size(void) { return 160 * 1024; }
+
+const esp_app_desc_t *esp_app_get_description(void) {
+  static const esp_app_desc_t description = {
+      .version = "host",
+      .project_name = "esp_hid_service_table",
+      .time = __TIME__,
+      .date = __DATE__,
+      .idf_ver = "host",
+  };
+  return &description;
+}
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+
+esp_err_t nvs_flash_erase(void) { return ESP_OK; }
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t,
+                                                const char *label) {
+  auto it = partitions().find(label ? label : "");
+  if (it == partitions().end() || (type != ESP_PARTITION_TYPE_ANY && type != it->second.partition.type)) {
+    return nullptr;
+  }
+  auto &partition = it->second;
+  if (partition.data.empty()) {
+    std::ifstream file(partition.path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!file && bytes.empty() && !partition.size) {
+      return nullptr;
+    }
+    if (partition.size) {
+      bytes.resize(partition.size, char(0xFF));
+    }
+    partition.data.assign((bytes.size() + 3) / 4, 0xFFFFFFFF);
+    std::memcpy(partition.data.data(), bytes.data(), bytes.size());
+    partition.partition.size = partition.data.size() * 4;
+  }
+  return &partition.partition;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle) {
+  auto it = partitions().find(partition->label);
+  if (it == partitions().end() || offset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  it->second.mapped = true;
+  *out_ptr = reinterpret_cast<const uint8_t *>(it->second.data.data()) + offset;
+  *out_handle = std::distance(partitions().begin(), it);
+  return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+  auto it = std::next(partitions().begin(), handle);
+  it->second.mapped = false;
+}
+
+// Change part of a partition, in memory and in its file
+static esp_err_t update_partition(const esp_partition_t *partition, size_t offset, size_t size,
+                                  const std::function<void(uint8_t *bytes)> &update) {
+  auto it = partitions().find(partition->label);
+  if (it == partitions().end() || offset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto bytes = reinterpret_cast<uint8_t *>(it->second.data.data()) + offset;
+  update(bytes);
+  std::fstream file(it->second.path, std::ios::binary | std::ios::in | std::ios::out);
+  if (!file) {
+    // not created yet, write all of it
+    file.open(it->second.path, std::ios::binary | std::ios::out);
+    file.write(reinterpret_cast<const char *>(it->second.data.data()), partition->size);
+  } else {
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char *>(bytes), size);
+  }
+  return file ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+  if (offset % partition->erase_size || size % partition->erase_size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return update_partition(partition, offset, size, [size](uint8_t *bytes) { std::memset(bytes, 0xFF, size); });
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) {
+  // like NOR flash, writing can only clear bits
+  return update_partition(partition, dst_offset, size, [src, size](uint8_t *bytes) {
+    for (size_t i = 0; i < size; i++) {
+      bytes[i] &= static_cast<const uint8_t *>(src)[i];
+    }
+  });
+}
+
+esp_err_t esp_pm_configure(const void *config) {
+  std::lock_guard<std::mutex> lock(pm().mutex);
+  pm().config = *static_cast<const esp_pm_config_t *>(config);
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int, const char *name,
+                             esp_pm_lock_handle_t *out_handle) {
+  std::lock_guard<std::mutex> lock(pm().mutex);
+  *out_handle = new esp_pm_lock{lock_type, name ? name : ""};
+  pm().locks.push_back(*out_handle);
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+  if (!handle) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(pm().mutex);
+  handle->count++;
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+  if (!handle) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(pm().mutex);
+  if (!handle->count) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  handle->count--;
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_light_sleep_register_cbs(esp_pm_sleep_cbs_register_config_t *cbs_conf) {
+  std::lock_guard<std::mutex> lock(pm().mutex);
+  pm().callbacks = *cbs_conf;
+  return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void) { return pm().wakeup_cause; }
+
+esp_err_t esp_sleep_enable_gpio_wakeup(void) {
+  std::lock_guard<std::mutex> lock(pm().mutex);
+  pm().gpio_wakeup = true;
+  return ESP_OK;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config) { return config->pin_bit_mask ? ESP_OK : ESP_ERR_INVALID_ARG; }
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+  if (gpio_num < 0 || gpio_num >= 40 || (intr_type != GPIO_INTR_LOW_LEVEL && intr_type != GPIO_INTR_HIGH_LEVEL)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(pm().mutex);
+  pm().wake_gpios |= 1ULL << gpio_num;
+  return ESP_OK;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) { return new QueueDefinition; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+  if (!sem) {
+    return pdFALSE;
+  }
+  std::unique_lock<std::mutex> lock(sem->mutex);
+  auto ready = [&] { return sem->available; };
+  if (ticks == portMAX_DELAY) {
+    sem->cv.wait(lock, ready);
+  } else if (!sem->cv.wait_for(lock, std::chrono::milliseconds(ticks), ready)) {
+    return pdFALSE;
+  }
+  sem->available = false;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  if (!sem) {
+    return pdFALSE;
+  }
+  std::lock_guard<std::mutex> lock(sem->mutex);
+  if (sem->available) {
+    return pdFALSE;
+  }
+  sem->available = true;
+  sem->cv.notify_one();
+  return pdTRUE;
+}
+
+} // extern "C"
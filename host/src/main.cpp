@@ -0,0 +1,1136 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+
+#include "battery_monitor.hpp"
+#include "digital_input.hpp"
+#include "hid_service.hpp"
+#include "input_bridge.hpp"
+#include "load_generator.hpp"
+
+#include "conditioning_checks.hpp"
+#include "host_app.hpp"
+#include "host_bluedroid.hpp"
+#include "gamepad_input.hpp"
+#include "host_idf.hpp"
+#include "motion.hpp"
+#include "profiles.hpp"
+#include "virtual_central.hpp"
+
+// hid_service_sim: hid_service (and the device profiles of main/) running on
+// the host Bluedroid stand-in, driven by a script of commands which a virtual
+// central and the application execute in turn, e.g. in CI:
+//
+//   hid_service_sim [--quiet] [--partition <label>=<file>[,<size>]] scripts/smoke.txt
+//
+// A partition with a size is created (erased) if its file doesn't exist.
+//
+// One command per line, '#' starts a comment:
+//
+//   start [interleaved|switch-during-table]
+//                               boot like app_main(). With interleaved, the
+//                               stack's events are delivered after every
+//                               step instead of once app_main() is done, with
+//                               switch-during-table until the HID table has
+//                               been requested, so that the profile switch
+//                               comes before the table's event.
+//   connect | disconnect | pair | mtu | discover
+//   read-report-map             and check it is the active profile's
+//   subscribe [report_id]       all input reports by default, 'battery' for
+//                               the Battery Service's battery level,
+//                               'telemetry' for the telemetry frames
+//   send <count> [report_id]    input reports (byte 0 counts on), running
+//                               connection events whenever the stack's
+//                               queue is full, then until it is empty
+//   burst <count> [report_id]   the same without running connection events
+//   events <count>              run connection events
+//   wait <ms>                   let ms go by without traffic, then run the
+//                               esp_timers which are due and connection
+//                               events until the stack's queue is empty
+//   link <queue> <per_event>    stack buffers / notifications per event
+//   switch <profile>            switch the device profile
+//   add-device <profile>        add a HID service with the profile
+//   device <index>              send and burst to the index-th HID service
+//   battery <level>             set the battery level directly
+//   battery-mv <mv> [n] [s]     n samples (1 by default) of a battery at mv
+//                               millivolts, s seconds (1) apart, for the
+//                               battery monitor
+//   read-battery                read the battery level (battery.read)
+//   identity <field> <value>   set one field of the device identity (name,
+//                               manufacturer, model or serial), its status
+//                               is identity.status
+//   sleep [input [delay_ms]]    light sleep and wake up, by an input (the
+//                               wake GPIO) if given, which takes delay_ms
+//                               longer to get going. Fails unless light
+//                               sleep is allowed.
+//   motion <count> [rate_hz] [swing]
+//                               count IMU samples (1000 Hz by default) through
+//                               the motion accumulator, sending its batch
+//                               reports (the gamepad-motion profile's) like
+//                               send: a slow wobble, or with swing a hand-held
+//                               swing with sensor noise. Each report must
+//                               decode to its samples (within half of its
+//                               deltas' unit). motion.samples_per_report,
+//                               motion.max_shift and motion.max_error are
+//                               the last run's.
+//   condition <frames> <raw...> the gamepad's raw analog readings (left x / y,
+//                               right x / y, brake, accelerator) frames
+//                               times, 1 ms apart, through its input
+//                               conditioning with the IIR filter. The last
+//                               frame's values are conditioned.<axis>.
+//   check-conditioning          check each stage of input conditioning's
+//                               scalar kernels on its own, failing if any
+//                               value is not what it should be
+//   buttons <pressed> [scans]   scan the gamepad's buttons scans times (1 by
+//                               default) while the inputs set in pressed
+//                               (e.g. 0x3) are, for the debouncer.
+//                               buttons.report is the report's buttons of
+//                               the debounced state, buttons.latency the
+//                               scans from the inputs' last change to the
+//                               debounced state's.
+//   bridge <count> [report_id] [chunk] [corrupt_every]
+//                               write count frames of input reports to the
+//                               input bridge through a pipe, every
+//                               corrupt_every-th with a bad CRC, then let it
+//                               read them, up to chunk bytes (all there are
+//                               by default) at a time, and send them like
+//                               send. bridge.* are its counts.
+//   load <rate_hz> <count> [burst] [report_id] [queue_limit]
+//                               send count input reports at rate_hz, burst
+//                               at a time, on the simulated link's clock
+//                               (running connection events until each is
+//                               due), skipping them while queue_limit are
+//                               queued in the stack. load.* are its results,
+//                               the same on every run.
+//   replay [file] [queue_limit] the same with an input trace, by default the
+//                               schedule of the last load
+//   record <file>               write the schedule of the last load as an
+//                               input trace, e.g. for the trace partition
+//   latency                     the report latency histograms
+//   timeline                    the connection timelines
+//   trace start                 record trace events (BLE callbacks, reports, ...)
+//   trace <file>                stop and write them, as Chrome JSON if the file
+//                               ends in .json, else as a Perfetto trace
+//   snoop start                 capture the ATT traffic in btsnoop format
+//   snoop save <partition>      save the capture to a partition, as on target
+//   snoop <file>                write the capture as a btsnoop file
+//   alloc start                 audit the allocations of the event and report
+//                               paths from now on (steady state)
+//   alloc                       the allocation sites since then
+//   read-diagnostics            read the diagnostics service's counters (the
+//                               read's ATT status is diag.status)
+//   credits <n> [nr]            grant n telemetry frames, with a write
+//                               without response if nr is given
+//   telemetry <count> [stream] [bytes] [reports] [flush]
+//                               queue count samples of bytes (12 by default),
+//                               the first reports of them each followed by
+//                               an input report, flush them (unless flush is
+//                               0, leaving the open frame to its max age) and
+//                               run connection events until the stack's
+//                               queue is empty. telemetry.stream.<n>.<samples|bytes|
+//                               dropped|bps> are a stream's counts.
+//   expect <value> <op> <x>     fail unless e.g. 'expect notifications == 100',
+//                               x can also be another value
+//   print                       all values, for writing expectations
+//
+// The firmware's log goes to stdout (--quiet drops it), the simulator's
+// results go to stderr. The exit code is 1 as soon as something fails.
+
+using Clock = std::chrono::steady_clock;
+
+static std::map<std::string, std::function<std::string()>> values;
+static host::VirtualCentral central({});
+static size_t startup_events = 0;
+static size_t report_map_length = 0;
+static bool report_map_matches = false;
+static double send_us_per_report = 0;
+static double reports_per_second = 0;
+static int diagnostics_status = -1;
+static int battery_read = -1;
+static esp_err_t identity_status = ESP_OK;
+static size_t telemetry_queued = 0;
+// the motion reports sent and the samples they carried, and the reports
+// which didn't decode to the samples put in
+static size_t motion_reports = 0;
+static size_t motion_samples = 0;
+static size_t motion_mismatches = 0;
+static int64_t motion_clock_us = 0;
+static float motion_samples_per_report = 0;
+static int motion_max_shift = 0;
+static int motion_max_error = 0;
+// the gamepad's input conditioning, and the values of its last frame
+static input_conditioning::Pipeline conditioning(gamepad_input::config(input_conditioning::Filter::IIR));
+static std::array<int16_t, gamepad_input::NUM_AXES> conditioned{};
+static int64_t conditioning_clock_us = 0;
+// the gamepad's buttons on a stand-in for the GPIOs, the scans which
+// changed their debounced state (each an immediate report on target), and
+// the scans the last change took since the inputs changed
+static uint32_t button_levels = 0;
+static digital_input::Scanner button_scanner({
+    .source = [](uint32_t &pressed) {
+      pressed = button_levels;
+      return true;
+    },
+});
+static size_t button_reports = 0;
+static int button_scans = 0; // since the inputs last changed
+static int button_latency = -1;
+// byte 0 of the next input report of each ID, so that the host sees them in
+// order across commands
+static std::map<uint8_t, uint8_t> report_counts;
+// the HID services the simulator adds, and the one send and burst use
+static std::deque<HidDevice> added_devices;
+static HidDevice *target_device = &hid_service_default_device();
+// the input bridge of app_main(), reading a pipe the simulator writes
+// frames to, chunk bytes at a time, and sending to the target device
+static int bridge_pipe[2] = {-1, -1};
+static size_t bridge_chunk = 0;
+static uint16_t bridge_sequence = 0;
+static input_bridge::Bridge bridge({
+    .read = [](uint8_t *buffer, size_t size, uint32_t timeout_ms) -> int {
+      pollfd readable{.fd = bridge_pipe[0], .events = POLLIN};
+      if (poll(&readable, 1, timeout_ms) <= 0) {
+        return 0;
+      }
+      return read(bridge_pipe[0], buffer, bridge_chunk ? std::min(size, bridge_chunk) : size);
+    },
+    .send = [](uint8_t report_id, const uint8_t *report, size_t length) {
+      target_device->send_input_report(report_id, report, length);
+    },
+    .on_coalesced = hid_service_add_coalesced_reports,
+});
+// the load generator of app_main(), on the simulated link's clock, and the
+// schedule of the last load, as a trace
+static load_generator::Generator generator({
+    .send = [](uint8_t report_id, const uint8_t *report, size_t length) {
+      std::array<uint8_t, load_generator::MAX_REPORT_LEN> counted;
+      std::copy(report, report + length, counted.begin());
+      counted[0] = report_counts[report_id]++;
+      target_device->send_input_report(report_id, counted.data(), length);
+      host::bluedroid::process_events();
+    },
+    .queue_depth = [] { return host::bluedroid::tx_queue_depth(); },
+    .now_us = [] { return host::bluedroid::link_time_us(); },
+    .wait_until = [](int64_t us) {
+      while (host::bluedroid::link_time_us() < us && host::bluedroid::is_connected()) {
+        host::bluedroid::run_connection_events(1);
+        host::bluedroid::process_events();
+      }
+    },
+});
+static std::vector<uint8_t> load_trace;
+static uint32_t load_dropped = 0;
+// the battery monitor of app_main(), on a stand-in for the ADC and a clock
+// which only the samples advance
+static uint32_t battery_mv = 0;
+static int64_t battery_clock_us = 0;
+static battery::Monitor battery_monitor({
+    .source = [](uint32_t &millivolts) {
+      millivolts = battery_mv;
+      return true;
+    },
+    .publish = [](uint8_t percent) { hid_service_set_battery_level(percent); },
+});
+static DiagnosticsCounters diagnostics{};
+
+static const DeviceProfile *active_profile() {
+  return hid_service_get_profile(hid_service_get_active_profile());
+}
+
+static void register_values() {
+  auto number = [](auto get) { return [get] { return std::to_string(get()); }; };
+  const auto &stats = host::bluedroid::stats();
+  const auto &counters = central.counters();
+  values["connected"] = number([] { return int(hid_service_is_connected()); });
+  values["hid_started"] = number([] { return int(host::hid_service_running()); });
+  values["device_started"] = number([] { return int(hid_service_default_device().is_started()); });
+  values["startup_events"] = number([] { return startup_events; });
+  values["profile"] = [] { return std::string(active_profile() ? active_profile()->name : ""); };
+  values["services"] = number([] { return central.services().size(); });
+  values["hid_services"] = number([] {
+    return std::count_if(central.services().begin(), central.services().end(), [](const auto &service) {
+      return service.uuid.len == ESP_UUID_LEN_16 && service.uuid.uuid.uuid16 == ESP_GATT_UUID_HID_SVC;
+    });
+  });
+  values["devices"] = number([] { return hid_service_get_num_devices(); });
+  values["input_reports"] = number([] { return central.input_reports().size(); });
+  values["report_map_len"] = number([] { return report_map_length; });
+  values["report_map_matches"] = number([] { return int(report_map_matches); });
+  values["mtu"] = number([] { return central.mtu(); });
+  values["interval"] = number([] { return host::bluedroid::connection_interval(); });
+  values["trace.events"] = number([] { return event_trace::size(); });
+  values["alloc.count"] = number([] { return alloc_audit::count(); });
+  values["alloc.bytes"] = number([] { return alloc_audit::bytes(); });
+  values["snoop.packets"] = number([] { return btsnoop::size(); });
+  values["notifications"] = number([&] { return counters.notifications; });
+  values["unsubscribed"] = number([&] { return counters.unsubscribed_notifications; });
+  values["out_of_order"] = number([&] { return counters.out_of_order; });
+  values["service_changed"] = number([&] { return counters.service_changed; });
+  values["att_round_trips"] = number([&] { return counters.att_round_trips; });
+  values["delivered"] = number([&] { return stats.notifications_delivered; });
+  values["dropped"] = number([&] { return stats.notifications_dropped; });
+  values["truncated"] = number([&] { return stats.notifications_truncated; });
+  values["connection_events"] = number([&] { return stats.connection_events; });
+  values["attr_tables_failed"] = number([&] { return stats.attr_tables_failed; });
+  values["events"] = number([&] { return stats.events_dispatched; });
+  const auto &latency = hid_service_get_report_latency();
+  values["latency.sent"] = number([&] { return latency.sent.load(); });
+  values["latency.completed"] = number([&] { return latency.completed.load(); });
+  values["latency.failed"] = number([&] { return latency.failed.load(); });
+  values["latency.lost"] = number([&] { return latency.lost.load(); });
+  values["latency.untracked"] = number([&] { return latency.untracked.load(); });
+  values["latency.coalesced"] = number([&] { return latency.coalesced.load(); });
+  values["latency.total.p99_us"] = number([&] { return latency.total.percentile(0.99f); });
+  values["latency.total.max_us"] = number([&] { return latency.total.max(); });
+  values["latency.wake.count"] = number([&] { return latency.wake_to_send.count(); });
+  values["latency.wake.max_us"] = number([&] { return latency.wake_to_send.max(); });
+  values["latency.wake.over_budget"] = number([&] { return latency.wake_over_budget.load(); });
+  values["pm.cpu_mhz"] = number([] { return host::idf::cpu_freq_mhz(); });
+  values["pm.in_flight"] = number([] { return power_save::reports_in_flight(); });
+  values["pm.no_light_sleep"] = number([] { return host::idf::lock_count(ESP_PM_NO_LIGHT_SLEEP); });
+  values["pm.light_sleep_allowed"] = number([] { return int(power_save::light_sleep_allowed()); });
+  values["pm.light_sleeps"] = number([] { return host::idf::light_sleeps(); });
+  // as the stack has them
+  auto dis_string = [](size_t index) {
+    return [index] {
+      auto attribute = host::bluedroid::find_attribute(dis_handle_table[index]);
+      return attribute ? std::string(attribute->value.begin(), attribute->value.end()) : std::string();
+    };
+  };
+  values["device_name"] = [] { return std::string(host::bluedroid::device_name()); };
+  values["dis.model"] = dis_string(DIS_IDX_MODEL_NUMBER_VAL);
+  values["dis.serial"] = dis_string(DIS_IDX_SERIAL_NUMBER_VAL);
+  values["identity.status"] = number([] { return identity_status; });
+  values["attr_values_set"] = number([&] { return stats.attr_values_set; });
+  values["attr_values_failed"] = number([&] { return stats.attr_values_failed; });
+  values["battery.level"] = number([] { return battery_monitor.level(); });
+  values["battery.published"] = number([] { return battery_monitor.published(); });
+  values["battery.publishes"] = number([] { return battery_monitor.stats().published; });
+  values["battery.within_hysteresis"] = number([] { return battery_monitor.stats().within_hysteresis; });
+  values["battery.rate_limited"] = number([] { return battery_monitor.stats().rate_limited; });
+  values["battery.bas"] = number([&] { return counters.battery_level; });
+  values["battery.bas_notifications"] = number([&] { return counters.battery_notifications; });
+  values["battery.hid"] = number([&] { return counters.battery_strength; });
+  values["battery.read"] = number([] { return battery_read; });
+  values["sessions"] = number([] { return hid_service_get_connection_timeline().size(); });
+  auto session = [](auto get) {
+    return [get] {
+      auto timeline = hid_service_get_connection_timeline();
+      return timeline.empty() ? std::string("none") : std::to_string(get(timeline.back()));
+    };
+  };
+  values["session.bonded"] = session([](const ConnectionSession &s) { return int(s.bonded); });
+  values["session.encrypted_us"] = session([](const ConnectionSession &s) { return s.time_to_encrypted(); });
+  values["session.subscribed_us"] = session([](const ConnectionSession &s) { return s.time_to_subscribed(); });
+  values["session.first_report_us"] = session([](const ConnectionSession &s) { return s.time_to_first_report(); });
+  values["session.mtu"] = session([](const ConnectionSession &s) { return s.mtu; });
+  values["session.interval"] = session([](const ConnectionSession &s) { return s.interval; });
+  values["diag.status"] = number([] { return diagnostics_status; });
+  values["diag.reports_sent"] = number([] { return uint32_t(diagnostics.reports_sent); });
+  values["diag.reports_dropped"] = number([] { return uint32_t(diagnostics.reports_dropped); });
+  values["diag.congestion_ms"] = number([] { return uint32_t(diagnostics.congestion_ms); });
+  values["diag.interval"] = number([] { return uint16_t(diagnostics.conn_interval); });
+  values["diag.mtu"] = number([] { return uint16_t(diagnostics.mtu); });
+  values["diag.rssi"] = number([] { return int(diagnostics.rssi); });
+  values["diag.p99_us"] = number([] { return uint32_t(diagnostics.latency_p99_us); });
+  values["telemetry.frames"] = number([&] { return counters.telemetry_frames; });
+  values["telemetry.samples"] = number([&] { return counters.telemetry_samples; });
+  values["telemetry.bytes"] = number([&] { return counters.telemetry_bytes; });
+  values["telemetry.lost"] = number([&] { return counters.telemetry_lost; });
+  values["telemetry.malformed"] = number([&] { return counters.telemetry_malformed; });
+  values["telemetry.queued"] = number([] { return telemetry_queued; });
+  values["telemetry.sent"] = number([] { return hid_service_get_telemetry_stats().frames_sent; });
+  values["telemetry.failed"] = number([] { return hid_service_get_telemetry_stats().frames_failed; });
+  values["telemetry.credit_waits"] = number([] { return hid_service_get_telemetry_stats().credit_waits; });
+  values["telemetry.input_waits"] = number([] { return hid_service_get_telemetry_stats().input_waits; });
+  values["telemetry.bytes_per_frame"] = number([] {
+    auto stats = hid_service_get_telemetry_stats();
+    return stats.frames_sent ? stats.frame_bytes_sent / stats.frames_sent : 0;
+  });
+  values["motion.reports"] = number([] { return motion_reports; });
+  values["motion.samples"] = number([] { return motion_samples; });
+  values["motion.mismatches"] = number([] { return motion_mismatches; });
+  values["motion.samples_per_report"] = number([] { return int64_t(motion_samples_per_report); });
+  values["motion.max_shift"] = number([] { return motion_max_shift; });
+  values["motion.max_error"] = number([] { return motion_max_error; });
+  for (size_t axis = 0; axis < conditioned.size(); axis++) {
+    values[fmt::format("conditioned.{}", axis)] = number([axis] { return conditioned[axis]; });
+  }
+  values["buttons.pressed"] = number([] { return button_scanner.pressed(); });
+  values["buttons.report"] = number([] { return gamepad_input::button_map.apply(button_scanner.pressed()); });
+  values["buttons.reports"] = number([] { return button_reports; });
+  values["buttons.latency"] = number([] { return button_latency; });
+  values["buttons.changes"] = number([] { return button_scanner.stats().changes; });
+  values["buttons.bounces"] = number([] { return button_scanner.stats().bounces; });
+  values["bridge.frames"] = number([] { return bridge.framing_stats().frames; });
+  values["bridge.crc_errors"] = number([] { return bridge.framing_stats().crc_errors; });
+  values["bridge.skipped"] = number([] { return bridge.framing_stats().bytes_skipped; });
+  values["bridge.reads"] = number([] { return bridge.stats().reads; });
+  values["bridge.missed"] = number([] { return bridge.stats().missed; });
+  values["bridge.coalesced"] = number([] { return bridge.stats().coalesced; });
+  values["bridge.sent"] = number([] { return bridge.stats().sent; });
+  values["bridge.p99_us"] = number([] { return bridge.stats().read_to_send.percentile(0.99f); });
+  values["bridge.max_us"] = number([] { return bridge.stats().read_to_send.max(); });
+  values["load.scheduled"] = number([] { return generator.stats().scheduled; });
+  values["load.sent"] = number([] { return generator.stats().sent; });
+  values["load.shed"] = number([] { return generator.stats().shed; });
+  values["load.dropped"] = number([] { return load_dropped; });
+  values["load.offered_hz"] = number([] { return int64_t(generator.stats().offered_hz()); });
+  values["load.achieved_hz"] = number([] { return int64_t(generator.stats().achieved_hz()); });
+  values["load.queue_max"] = number([] { return generator.stats().max_queue_depth; });
+  values["load.late_max_us"] = number([] { return generator.stats().lateness.max(); });
+  values["send_us_per_report"] = number([] { return int64_t(send_us_per_report); });
+  values["reports_per_second"] = number([] { return int64_t(reports_per_second); });
+}
+
+static std::optional<std::string> value_of(const std::string &name) {
+  if (name.starts_with("reports.")) {
+    const auto &reports = central.counters().reports;
+    auto it = reports.find(std::stoi(name.substr(8)));
+    return std::to_string(it == reports.end() ? 0 : it->second);
+  }
+  if (name.starts_with("telemetry.stream.")) {
+    // telemetry.stream.<n>.<count>
+    auto dot = name.find('.', 17);
+    auto stats = hid_service_get_telemetry_stats();
+    size_t stream = std::stoul(name.substr(17, dot - 17));
+    if (dot == std::string::npos || stream >= stats.streams.size()) {
+      return std::nullopt;
+    }
+    const auto &counts = stats.streams[stream];
+    auto count = name.substr(dot + 1);
+    if (count == "samples") {
+      return std::to_string(counts.samples);
+    } else if (count == "bytes") {
+      return std::to_string(counts.bytes);
+    } else if (count == "dropped") {
+      return std::to_string(counts.dropped);
+    } else if (count == "bps") {
+      return std::to_string(counts.bytes_per_second());
+    }
+    return std::nullopt;
+  }
+  auto it = values.find(name);
+  if (it == values.end()) {
+    return std::nullopt;
+  }
+  return it->second();
+}
+
+static size_t deliver_events() { return host::bluedroid::process_events(); }
+
+static int report_index(int report_id) {
+  const auto &table = target_device->table();
+  for (size_t i = 0; i < table.num_input_reports(); i++) {
+    if (report_id < 0 || table.input_report_id(i) == report_id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/// Run connection events until the stack has sent what it queued
+static void drain() {
+  while (host::bluedroid::tx_queue_depth() && host::bluedroid::is_connected()) {
+    host::bluedroid::run_connection_events(1);
+    deliver_events();
+  }
+}
+
+static bool send(FILE *out, size_t count, int report_id, bool run_events) {
+  int index = report_index(report_id);
+  if (index < 0) {
+    fmt::print(out, "report {} is not in the active report map\n", report_id);
+    return false;
+  }
+  uint8_t id = target_device->table().input_report_id(index);
+  std::vector<uint8_t> report(target_device->table().input_report_size(index));
+  auto &link = host::bluedroid::link_config();
+  const auto &stats = host::bluedroid::stats();
+  auto delivered = stats.notifications_delivered;
+  auto connection_events = stats.connection_events;
+  auto link_time_us = host::bluedroid::link_time_us();
+  Clock::duration elapsed{};
+  for (size_t i = 0; i < count; i++) {
+    while (run_events && host::bluedroid::tx_queue_depth() >= link.tx_queue_size) {
+      host::bluedroid::run_connection_events(1);
+      deliver_events();
+    }
+    report[0] = report_counts[id]++;
+    auto t0 = Clock::now();
+    target_device->send_input_report(id, report.data(), report.size());
+    elapsed += Clock::now() - t0;
+    deliver_events();
+  }
+  drain();
+  delivered = stats.notifications_delivered - delivered;
+  connection_events = stats.connection_events - connection_events;
+  link_time_us = host::bluedroid::link_time_us() - link_time_us;
+  send_us_per_report = std::chrono::duration<double, std::micro>(elapsed).count() / count;
+  reports_per_second = link_time_us ? delivered * 1e6 / link_time_us : 0;
+  fmt::print(out, "sent {} reports (id {}, {} bytes) at {:.2f} us each, {} delivered in {} connection events "
+                  "({:.0f} reports/s at {:.2f} ms)\n",
+             count, id, report.size(), send_us_per_report, delivered, connection_events, reports_per_second,
+             host::bluedroid::connection_interval() * 1.25);
+  return true;
+}
+
+static bool send_bridged(FILE *out, size_t count, int report_id, size_t chunk, size_t corrupt_every) {
+  int index = report_index(report_id);
+  if (index < 0) {
+    fmt::print(out, "report {} is not in the active report map\n", report_id);
+    return false;
+  }
+  if (bridge_pipe[0] < 0 && pipe(bridge_pipe) != 0) {
+    return false;
+  }
+  uint8_t id = target_device->table().input_report_id(index);
+  std::vector<uint8_t> report(target_device->table().input_report_size(index));
+  std::array<uint8_t, input_bridge::MAX_FRAME_LEN> frame;
+  for (size_t i = 0; i < count; i++) {
+    report[0] = report_counts[id]++;
+    size_t length = input_bridge::encode(id, bridge_sequence++, report, frame.data());
+    if (!length) {
+      return false;
+    }
+    if (corrupt_every && (i + 1) % corrupt_every == 0) {
+      frame[sizeof(input_bridge::FrameHeader)] ^= 0xff;
+    }
+    if (write(bridge_pipe[1], frame.data(), length) != ssize_t(length)) {
+      return false;
+    }
+  }
+  // let the bridge read until the pipe is empty
+  bridge_chunk = chunk;
+  auto &link = host::bluedroid::link_config();
+  auto sent = bridge.stats().sent;
+  for (auto reads = bridge.stats().reads;; reads = bridge.stats().reads) {
+    while (host::bluedroid::tx_queue_depth() >= link.tx_queue_size) {
+      host::bluedroid::run_connection_events(1);
+      deliver_events();
+    }
+    bridge.poll(0);
+    deliver_events();
+    if (bridge.stats().reads == reads) {
+      break;
+    }
+  }
+  drain();
+  fmt::print(out, "bridged {} frames (id {}, {} bytes), {} reports sent\n", count, id, report.size(),
+             bridge.stats().sent - sent);
+  return true;
+}
+
+// run a load, counting the reports the stack dropped during it
+static bool run_load(FILE *out, const char *name, const load_generator::Source &source, int64_t duration_us,
+                     size_t queue_limit) {
+  if (!host::bluedroid::is_connected()) {
+    fmt::print(out, "not connected\n");
+    return false;
+  }
+  const auto &latency = hid_service_get_report_latency();
+  uint32_t dropped = latency.failed + latency.lost;
+  generator.set_queue_limit(queue_limit);
+  const auto &stats = generator.run(source, duration_us);
+  drain();
+  load_dropped = latency.failed + latency.lost - dropped;
+  fmt::print(out,
+             "{}: {} of {} reports sent ({} shed, {} dropped), {:.0f} of {:.0f} reports/s, queue max {} mean "
+             "{:.1f}, late p99 {} us max {} us\n",
+             name, stats.sent, stats.scheduled, stats.shed, load_dropped, stats.achieved_hz(), stats.offered_hz(),
+             stats.max_queue_depth, stats.mean_queue_depth(), stats.lateness.percentile(0.99f), stats.lateness.max());
+  return true;
+}
+
+static bool load(FILE *out, int rate_hz, int count, int burst, int report_id, size_t queue_limit) {
+  int index = report_index(report_id);
+  if (index < 0 || rate_hz <= 0 || count <= 0 || burst <= 0) {
+    fmt::print(out, "report {} is not in the active report map\n", report_id);
+    return false;
+  }
+  load_generator::Pattern pattern({
+      .report_id = target_device->table().input_report_id(index),
+      .report = std::vector<uint8_t>(target_device->table().input_report_size(index)),
+      .rate_hz = uint32_t(rate_hz),
+      .count = uint32_t(count),
+      .burst = uint32_t(burst),
+  });
+  // keep the schedule, for replay and record
+  load_generator::TraceWriter writer;
+  for (load_generator::Event event; pattern.next(event);) {
+    writer.add(event.time_us, event.report_id, event.report);
+  }
+  load_trace = writer.finish(pattern.duration_us());
+  pattern.rewind();
+  return run_load(out, "load", pattern.source(), pattern.duration_us(), queue_limit);
+}
+
+static bool replay(FILE *out, const std::string &path, size_t queue_limit) {
+  std::vector<uint8_t> file_trace;
+  if (!path.empty()) {
+    std::ifstream file(path, std::ios::binary);
+    file_trace.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  load_generator::TraceReader trace;
+  if (!trace.open(path.empty() ? load_trace : file_trace)) {
+    fmt::print(out, "no valid input trace{}\n", path.empty() ? "" : " in " + path);
+    return false;
+  }
+  return run_load(out, "replay", trace.source(), trace.duration_us(), queue_limit);
+}
+
+static bool send_motion(FILE *out, size_t count, int rate_hz, bool swing) {
+  if (report_index(GAMEPAD_MOTION_REPORT_ID) < 0 || rate_hz <= 0) {
+    fmt::print(out, "report {} is not in the active report map\n", GAMEPAD_MOTION_REPORT_ID);
+    return false;
+  }
+  motion::Accumulator<GAMEPAD_MOTION_SAMPLES> accumulator;
+  std::deque<motion::Sample> pending; // put in, but not sent yet
+  auto &link = host::bluedroid::link_config();
+  size_t reports = 0;
+  motion_max_shift = 0;
+  motion_max_error = 0;
+  auto send_batch = [&] {
+    const auto &report = accumulator.report();
+    std::array<motion::Sample, GAMEPAD_MOTION_SAMPLES> decoded;
+    size_t decoded_count = motion::decode(report, decoded);
+    // deltas are rounded to units of 2^shift, with the error carried forward
+    int tolerance = report.shift ? 1 << (report.shift - 1) : 0;
+    bool same = decoded_count <= pending.size();
+    for (size_t i = 0; i < decoded_count && same; i++) {
+      const auto &sample = pending[i];
+      same = decoded[i].timestamp_us == (sample.timestamp_us / motion::TICK_US % 65536) * motion::TICK_US;
+      for (size_t axis = 0; axis < 3; axis++) {
+        int error = std::max(std::abs(decoded[i].accel[axis] - sample.accel[axis]),
+                             std::abs(decoded[i].gyro[axis] - sample.gyro[axis]));
+        motion_max_error = std::max(motion_max_error, error);
+        same = same && error <= tolerance;
+      }
+    }
+    motion_max_shift = std::max<int>(motion_max_shift, report.shift);
+    motion_mismatches += !same;
+    pending.erase(pending.begin(), pending.begin() + std::min(decoded_count, pending.size()));
+    while (host::bluedroid::tx_queue_depth() >= link.tx_queue_size) {
+      host::bluedroid::run_connection_events(1);
+      deliver_events();
+    }
+    target_device->send_input_report(GAMEPAD_MOTION_REPORT_ID, reinterpret_cast<const uint8_t *>(&report),
+                                     sizeof(report));
+    deliver_events();
+    motion_samples += decoded_count;
+    reports++;
+  };
+  int64_t flush_interval_us = host::bluedroid::connection_interval() * 1250;
+  // fixed seed, so runs are repeatable
+  std::mt19937 noise_generator(0x1812);
+  auto noise = [&](int amplitude) {
+    return std::uniform_int_distribution<int>(-amplitude, amplitude)(noise_generator);
+  };
+  for (size_t i = 0; i < count; i++) {
+    float t = motion_clock_us / 1e6f;
+    motion::Sample sample{.timestamp_us = motion_clock_us};
+    if (swing) {
+      // swung back and forth at 2 Hz: +-2 g (at 4096 / g) and +-1000 dps (at
+      // 16.4 / dps), up to ~210 LSB a sample, with the sensors' noise
+      float phase = 2 * M_PI * 2 * t;
+      sample.accel[0] = int16_t(8192 * sinf(phase) + noise(40));
+      sample.accel[1] = int16_t(2048 * cosf(phase) + noise(40));
+      sample.accel[2] = int16_t(4096 + noise(40));
+      sample.gyro[0] = int16_t(noise(20));
+      sample.gyro[1] = int16_t(16400 * cosf(phase) + noise(20));
+      sample.gyro[2] = int16_t(3000 * sinf(phase / 2) + noise(20));
+    } else {
+      // a wobble and a turn, and halfway through a knock
+      sample.accel[0] = int16_t(300 * sinf(2 * M_PI * t) + (i == count / 2 ? 2000 : 0));
+      sample.accel[2] = 4096;
+      sample.gyro[2] = int16_t(3000 * sinf(2 * M_PI * 0.5f * t));
+    }
+    motion_clock_us += 1000000 / rate_hz;
+    pending.push_back(sample);
+    if (accumulator.add(sample, flush_interval_us)) {
+      send_batch();
+    }
+  }
+  if (accumulator.flush()) {
+    send_batch();
+  }
+  drain();
+  motion_reports += reports;
+  motion_samples_per_report = reports ? float(count) / reports : 0;
+  fmt::print(out, "sent {} motion samples in {} reports ({:.1f} samples each, {} byte reports)\n", count, reports,
+             reports ? float(count) / reports : 0.0f, sizeof(accumulator.report()));
+  return pending.empty();
+}
+
+/// The allocation sites, named by the function (and offset into the binary,
+/// for addr2line) of their caller
+static void print_allocations(FILE *out) {
+  fmt::print(out, "{} allocations ({} bytes) since 'alloc start'\n", alloc_audit::count(), alloc_audit::bytes());
+  for (const auto &site : alloc_audit::sites()) {
+    std::string caller = "unknown";
+    Dl_info info;
+    if (site.caller && dladdr(reinterpret_cast<void *>(site.caller), &info)) {
+      int status = -1;
+      char *name = info.dli_sname ? abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status) : nullptr;
+      caller = fmt::format("{} ({}+{:#x})", name ? name : info.dli_sname ? info.dli_sname : "?", info.dli_fname,
+                           site.caller - reinterpret_cast<uintptr_t>(info.dli_fbase));
+      std::free(name);
+    }
+    fmt::print(out, "  {}{}: {} allocations, {} bytes, from {}\n", site.scope, site.exempt ? " (exempt)" : "",
+               site.count, site.bytes, caller);
+  }
+}
+
+/// Read the diagnostics counters like a phone app would: find the service by
+/// its UUID and read the characteristic's value
+static bool read_diagnostics(FILE *out) {
+  const host::VirtualCentral::Characteristic *counters = nullptr;
+  for (const auto &service : central.services()) {
+    for (const auto &characteristic : service.characteristics) {
+      if (DIAG_SERVICE_UUID.matches(service.uuid) && DIAG_COUNTERS_UUID.matches(characteristic.uuid)) {
+        counters = &characteristic;
+      }
+    }
+  }
+  if (!counters) {
+    fmt::print(out, "no diagnostics service, discover first\n");
+    return false;
+  }
+  std::vector<uint8_t> value;
+  diagnostics_status = central.read(counters->value_handle, value);
+  deliver_events();
+  if (diagnostics_status != ESP_GATT_OK) {
+    fmt::print(out, "diagnostics: read failed with {:#04x}\n", diagnostics_status);
+    return true;
+  }
+  if (value.size() != sizeof(diagnostics)) {
+    fmt::print(out, "diagnostics: {} bytes, expected {}\n", value.size(), sizeof(diagnostics));
+    return false;
+  }
+  std::copy(value.begin(), value.end(), reinterpret_cast<uint8_t *>(&diagnostics));
+  const auto &d = diagnostics;
+  fmt::print(out, "diagnostics v{}: up {} ms, reports {} sent, {} dropped, {} coalesced, congested {} ms, interval {}, "
+                  "latency {}, timeout {}, mtu {}, phy {}/{}, rssi {} dBm, heap {} free ({} min), latency p50 {} us, "
+                  "p99 {} us, max {} us\n",
+             d.version, uint32_t(d.uptime_ms), uint32_t(d.reports_sent), uint32_t(d.reports_dropped),
+             uint32_t(d.reports_coalesced), uint32_t(d.congestion_ms), uint16_t(d.conn_interval),
+             uint16_t(d.conn_latency), uint16_t(d.conn_timeout), uint16_t(d.mtu), d.tx_phy, d.rx_phy, d.rssi,
+             uint32_t(d.free_heap), uint32_t(d.min_free_heap), uint32_t(d.latency_p50_us),
+             uint32_t(d.latency_p99_us), uint32_t(d.latency_max_us));
+  return true;
+}
+
+static bool compare(const std::string &actual, const std::string &op, const std::string &expected) {
+  char *end = nullptr;
+  double a = std::strtod(actual.c_str(), &end);
+  bool numeric = !actual.empty() && *end == '\0';
+  double b = std::strtod(expected.c_str(), &end);
+  numeric = numeric && !expected.empty() && *end == '\0';
+  if (!numeric) {
+    return op == "==" ? actual == expected : op == "!=" ? actual != expected : false;
+  }
+  if (op == "==") return a == b;
+  if (op == "!=") return a != b;
+  if (op == "<") return a < b;
+  if (op == "<=") return a <= b;
+  if (op == ">") return a > b;
+  if (op == ">=") return a >= b;
+  return false;
+}
+
+static bool run(FILE *out, const std::string &line) {
+  std::istringstream in(line);
+  std::string command;
+  in >> command;
+  std::vector<std::string> args;
+  for (std::string arg; in >> arg;) {
+    args.push_back(arg);
+  }
+  auto arg = [&](size_t i, int fallback) { return i < args.size() ? std::stoi(args[i]) : fallback; };
+
+  if (command == "start") {
+    auto order = host::StartOrder::AFTER_APP_MAIN;
+    if (!args.empty() && args[0] == "interleaved") {
+      order = host::StartOrder::INTERLEAVED;
+    } else if (!args.empty() && args[0] == "switch-during-table") {
+      order = host::StartOrder::SWITCH_DURING_TABLE;
+    } else if (!args.empty()) {
+      return false;
+    }
+    startup_events = host::start_app(order);
+    fmt::print(out, "started in {} stack events, profile '{}'\n", startup_events,
+               active_profile() ? active_profile()->name : "");
+    return host::hid_service_running();
+  } else if (command == "connect") {
+    bool ok = central.connect();
+    deliver_events();
+    return ok;
+  } else if (command == "disconnect") {
+    central.disconnect();
+    deliver_events();
+  } else if (command == "pair") {
+    central.pair();
+    deliver_events();
+    return host::bluedroid::is_encrypted();
+  } else if (command == "mtu") {
+    fmt::print(out, "mtu {}\n", central.exchange_mtu());
+    deliver_events();
+  } else if (command == "discover") {
+    bool ok = central.discover();
+    deliver_events();
+    for (const auto &service : central.services()) {
+      fmt::print(out, "service {} handles {}-{}, {} characteristics\n",
+                 service.uuid.len == ESP_UUID_LEN_16 ? fmt::format("{:#06x}", service.uuid.uuid.uuid16) : "(128-bit)",
+                 service.start_handle, service.end_handle, service.characteristics.size());
+    }
+    return ok;
+  } else if (command == "read-report-map") {
+    std::vector<uint8_t> report_map;
+    auto status = central.read_report_map(report_map);
+    deliver_events();
+    auto profile = active_profile();
+    report_map_length = report_map.size();
+    report_map_matches = profile && report_map.size() == profile->report_descriptor_len &&
+                         std::equal(report_map.begin(), report_map.end(), profile->report_descriptor);
+    fmt::print(out, "report map: {} bytes, {}\n", report_map.size(),
+               report_map_matches ? "matches the active profile" : "does NOT match the active profile");
+    return status == ESP_GATT_OK;
+  } else if (command == "subscribe") {
+    bool ok;
+    if (!args.empty() && args[0] == "battery") {
+      ok = central.subscribe_battery_level();
+    } else if (!args.empty() && args[0] == "telemetry") {
+      ok = central.subscribe_telemetry();
+    } else {
+      ok = central.subscribe(arg(0, 0));
+    }
+    deliver_events();
+    return ok;
+  } else if (command == "send" || command == "burst") {
+    return send(out, arg(0, 1), arg(1, -1), command == "send");
+  } else if (command == "motion") {
+    return send_motion(out, arg(0, 1000), arg(1, 1000), args.size() > 2 && args[2] == "swing");
+  } else if (command == "condition") {
+    std::array<int16_t, gamepad_input::NUM_AXES> raw{};
+    if (args.size() != raw.size() + 1) {
+      return false;
+    }
+    for (size_t axis = 0; axis < raw.size(); axis++) {
+      raw[axis] = arg(axis + 1, 0);
+    }
+    for (int i = 0; i < arg(0, 1); i++) {
+      conditioning_clock_us += 1000;
+      conditioning.process(raw.data(), conditioned.data(), conditioning_clock_us);
+    }
+    fmt::print(out, "conditioned to {}\n", fmt::join(conditioned, " "));
+  } else if (command == "check-conditioning") {
+    return host::check_input_conditioning(out) == 0;
+  } else if (command == "buttons") {
+    if (args.empty()) {
+      return false;
+    }
+    uint32_t levels = std::stoul(args[0], nullptr, 0);
+    if (levels != button_levels) {
+      button_levels = levels;
+      button_scans = 0;
+    }
+    for (int i = 0; i < arg(1, 1); i++) {
+      button_scans++;
+      if (button_scanner.scan()) {
+        button_reports++;
+        button_latency = button_scans;
+      }
+    }
+    fmt::print(out, "buttons {:#x} debounced to {:#x}\n", button_levels, button_scanner.pressed());
+  } else if (command == "load") {
+    return load(out, arg(0, 1000), arg(1, 1000), arg(2, 1), arg(3, -1), arg(4, 0));
+  } else if (command == "replay") {
+    bool file = !args.empty() && !std::isdigit(args[0][0]);
+    return replay(out, file ? args[0] : "", arg(file, 0));
+  } else if (command == "record") {
+    if (args.empty() || load_trace.empty()) {
+      return false;
+    }
+    std::ofstream file(args[0], std::ios::binary);
+    file.write(reinterpret_cast<const char *>(load_trace.data()), load_trace.size());
+    fmt::print(out, "record: {} bytes written to {}\n", load_trace.size(), args[0]);
+    return bool(file);
+  } else if (command == "bridge") {
+    return send_bridged(out, arg(0, 1), arg(1, -1), arg(2, 0), arg(3, 0));
+  } else if (command == "events") {
+    host::bluedroid::run_connection_events(arg(0, 1));
+    deliver_events();
+  } else if (command == "wait") {
+    std::this_thread::sleep_for(std::chrono::milliseconds(arg(0, 1)));
+    host::idf::run_timers();
+    deliver_events();
+    drain();
+  } else if (command == "link") {
+    host::bluedroid::link_config() = {size_t(arg(0, 20)), size_t(arg(1, 6))};
+  } else if (command == "switch") {
+    int index = args.empty() ? -1 : hid_service_find_profile(args[0]);
+    if (index < 0 || !hid_service_switch_profile(index)) {
+      return false;
+    }
+    deliver_events();
+    // the host only sees the new service once the indication got through
+    host::bluedroid::run_connection_events(1);
+    deliver_events();
+  } else if (command == "add-device") {
+    int index = args.empty() ? -1 : hid_service_find_profile(args[0]);
+    if (index < 0) {
+      return false;
+    }
+    auto &device = added_devices.emplace_back();
+    if (!device.switch_profile(index) || !hid_service_add_device(device)) {
+      return false;
+    }
+    deliver_events();
+    host::bluedroid::run_connection_events(1);
+    deliver_events();
+  } else if (command == "device") {
+    auto device = hid_service_get_device(arg(0, 0));
+    if (!device) {
+      return false;
+    }
+    target_device = device;
+  } else if (command == "battery") {
+    hid_service_set_battery_level(arg(0, 100));
+    deliver_events();
+    drain();
+  } else if (command == "battery-mv") {
+    if (args.empty()) {
+      return false;
+    }
+    battery_mv = arg(0, 0);
+    for (int i = 0; i < arg(1, 1); i++) {
+      battery_clock_us += arg(2, 1) * 1000000LL;
+      battery_monitor.update(battery_clock_us);
+      deliver_events();
+      drain();
+    }
+    fmt::print(out, "battery at {} mV: level {}%, published {}%\n", battery_monitor.millivolts(),
+               battery_monitor.level(), battery_monitor.published());
+  } else if (command == "read-battery") {
+    auto level = central.battery_level();
+    std::vector<uint8_t> value;
+    if (!level || central.read(level->value_handle, value) != ESP_GATT_OK || value.size() != 1) {
+      return false;
+    }
+    battery_read = value[0];
+  } else if (command == "identity") {
+    if (args.size() != 2) {
+      return false;
+    }
+    DeviceIdentity identity;
+    if (args[0] == "name") {
+      identity.device_name = args[1];
+    } else if (args[0] == "manufacturer") {
+      identity.manufacturer_name = args[1];
+    } else if (args[0] == "model") {
+      identity.model_number = args[1];
+    } else if (args[0] == "serial") {
+      identity.serial_number = args[1];
+    } else {
+      return false;
+    }
+    identity_status = hid_service_set_identity(identity);
+    deliver_events();
+  } else if (command == "sleep") {
+    bool input = !args.empty() && args[0] == "input";
+    if (!host::idf::light_sleep(input)) {
+      fmt::print(out, "light sleep is not allowed ({} no light sleep locks held)\n",
+                 host::idf::lock_count(ESP_PM_NO_LIGHT_SLEEP));
+      return false;
+    }
+    // e.g. the flash and the PLL settling
+    std::this_thread::sleep_for(std::chrono::milliseconds(arg(1, 0)));
+  } else if (command == "latency") {
+    hid_service_dump_report_latency();
+    const auto &latency = hid_service_get_report_latency();
+    for (auto [name, histogram] : {std::pair{"send call", &latency.send_call}, std::pair{"stack", &latency.stack},
+                                   std::pair{"total", &latency.total}, std::pair{"wake to send", &latency.wake_to_send}}) {
+      fmt::print(out, "{}: {} reports, p50 {} us, p99 {} us, max {} us\n", name, histogram->count(),
+                 histogram->percentile(0.5f), histogram->percentile(0.99f), histogram->max());
+    }
+  } else if (command == "timeline") {
+    hid_service_dump_connection_timeline();
+    for (const auto &session : hid_service_get_connection_timeline()) {
+      fmt::print(out, "connection {} ({}):", session.id, session.bonded ? "bonded" : "new");
+      for (size_t i = 0; i < session.milestone_us.size(); i++) {
+        if (session.milestone_us[i] != ConnectionSession::NOT_REACHED) {
+          fmt::print(out, " {} at {} us,", connection_milestone_name(ConnectionMilestone(i)), session.milestone_us[i]);
+        }
+      }
+      fmt::print(out, " mtu {}, interval {}\n", session.mtu, session.interval);
+    }
+  } else if (command == "trace") {
+    if (args.empty()) {
+      return false;
+    }
+    if (args[0] == "start") {
+      event_trace::start();
+      return true;
+    }
+    std::ofstream file(args[0], std::ios::binary);
+    auto write = [&](std::string_view chunk) { file.write(chunk.data(), chunk.size()); };
+    size_t overwritten = event_trace::overwritten();
+    bool json = args[0].ends_with(".json");
+    size_t count = json ? event_trace::export_chrome_json(write) : event_trace::export_perfetto(write);
+    fmt::print(out, "trace: {} events ({} overwritten) written to {} as {}\n", count, overwritten, args[0],
+               json ? "Chrome JSON" : "Perfetto protobuf");
+    return bool(file);
+  } else if (command == "snoop") {
+    if (args.empty()) {
+      return false;
+    }
+    if (args[0] == "start") {
+      btsnoop::start();
+      return true;
+    }
+    if (args[0] == "save") {
+      return args.size() == 2 && btsnoop::save(args[1]) == ESP_OK;
+    }
+    std::ofstream file(args[0], std::ios::binary);
+    size_t count = btsnoop::export_file([&](std::span<const uint8_t> chunk) {
+      file.write(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+    });
+    fmt::print(out, "snoop: {} packets ({} overwritten) written to {}\n", count, btsnoop::overwritten(), args[0]);
+    return bool(file);
+  } else if (command == "alloc") {
+    if (!args.empty() && args[0] == "start") {
+      alloc_audit::start();
+      return true;
+    }
+    print_allocations(out);
+  } else if (command == "read-diagnostics") {
+    return read_diagnostics(out);
+  } else if (command == "credits") {
+    bool ok = central.grant_telemetry_credits(arg(0, 1), args.size() < 2);
+    deliver_events();
+    return ok;
+  } else if (command == "telemetry") {
+    // e.g. a 6-axis IMU sample: 16-bit acceleration and rotation
+    std::vector<uint8_t> sample(arg(2, 12));
+    // and the input reports of a gamepad in use at the same time
+    int index = report_index(-1);
+    size_t reports = index < 0 ? 0 : arg(3, 0);
+    std::vector<uint8_t> report(index < 0 ? 0 : target_device->table().input_report_size(index));
+    telemetry_queued = 0;
+    for (size_t i = 0; i < size_t(arg(0, 1)); i++) {
+      if (!sample.empty()) {
+        sample[0] = uint8_t(i);
+      }
+      telemetry_queued += hid_service_send_telemetry(arg(1, 0), sample.data(), sample.size());
+      if (i < reports) {
+        uint8_t id = target_device->table().input_report_id(index);
+        report[0] = report_counts[id]++;
+        target_device->send_input_report(id, report.data(), report.size());
+      }
+      deliver_events();
+    }
+    if (arg(4, 1)) {
+      hid_service_flush_telemetry();
+    }
+    deliver_events();
+    drain();
+  } else if (command == "expect") {
+    if (args.size() != 3) {
+      return false;
+    }
+    auto actual = value_of(args[0]);
+    if (!actual) {
+      fmt::print(out, "unknown value '{}'\n", args[0]);
+      return false;
+    }
+    // compared to a number, a string or another value
+    auto expected = value_of(args[2]).value_or(args[2]);
+    if (!compare(*actual, args[1], expected)) {
+      fmt::print(out, "expected {} {} {} ({}), but it is {}\n", args[0], args[1], args[2], expected, *actual);
+      return false;
+    }
+  } else if (command == "print") {
+    for (const auto &[name, get] : values) {
+      fmt::print(out, "  {} = {}\n", name, get());
+    }
+    for (const auto &[id, count] : central.counters().reports) {
+      fmt::print(out, "  reports.{} = {}\n", id, count);
+    }
+  } else {
+    fmt::print(out, "unknown command '{}'\n", command);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool quiet = false;
+  std::string script_path;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--quiet") {
+      quiet = true;
+    } else if (arg == "--partition" && i + 1 < argc) {
+      std::string partition = argv[++i];
+      auto eq = partition.find('=');
+      auto comma = partition.find(',', eq);
+      size_t size = comma == std::string::npos ? 0 : std::stoul(partition.substr(comma + 1), nullptr, 0);
+      host::idf::set_partition_file(partition.substr(0, eq), partition.substr(eq + 1, comma - eq - 1), size);
+    } else {
+      script_path = arg;
+    }
+  }
+  if (script_path.empty()) {
+    fmt::print(stderr, "usage: {} [--quiet] [--partition <label>=<file>[,<size>]] <script>\n", argv[0]);
+    return 2;
+  }
+  std::ifstream script(script_path);
+  if (!script) {
+    fmt::print(stderr, "could not open '{}'\n", script_path);
+    return 2;
+  }
+  if (quiet) {
+    std::freopen("/dev/null", "w", stdout);
+  }
+
+  host::bluedroid::reset();
+  register_values();
+  int line_number = 0;
+  for (std::string line; std::getline(script, line);) {
+    line_number++;
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    fmt::print(stderr, "> {}\n", line);
+    std::fflush(stdout);
+    bool ok = run(stderr, line);
+    // the firmware's deferred log, before what the next command logs
+    deferred_log::flush();
+    if (!ok) {
+      fmt::print(stderr, "{}:{}: FAILED: {}\n", script_path, line_number, line);
+      return 1;
+    }
+  }
+  fmt::print(stderr, "{}: passed\n", script_path);
+  return 0;
+}
@@ -0,0 +1,333 @@
+#include "virtual_central.hpp"
+
+#include <algorithm>
+
+#include "hid_report_descriptor.hpp"
+#include "telemetry_service_table.hpp"
+
+namespace host {
+
+static bool is_uuid(const esp_bt_uuid_t &uuid, uint16_t uuid16) {
+  return uuid.len == ESP_UUID_LEN_16 && uuid.uuid.uuid16 == uuid16;
+}
+
+static esp_bt_uuid_t uuid_from(const uint8_t *bytes, size_t length) {
+  esp_bt_uuid_t uuid{};
+  if (length == ESP_UUID_LEN_16) {
+    uuid.len = ESP_UUID_LEN_16;
+    uuid.uuid.uuid16 = bytes[0] | bytes[1] << 8;
+  } else if (length == ESP_UUID_LEN_128) {
+    uuid.len = ESP_UUID_LEN_128;
+    std::copy_n(bytes, ESP_UUID_LEN_128, uuid.uuid.uuid128);
+  }
+  return uuid;
+}
+
+VirtualCentral::VirtualCentral(const Config &config) : config_(config) {}
+
+bool VirtualCentral::connect() {
+  bluedroid::Peer peer;
+  peer.on_notification = [this](uint16_t handle, std::span<const uint8_t> value, bool indication) {
+    on_notification(handle, value, indication);
+  };
+  peer.on_connection_update = [this](uint16_t min_interval, uint16_t max_interval) {
+    return on_connection_update(min_interval, max_interval);
+  };
+  mtu_ = ESP_GATT_DEF_BLE_MTU_SIZE;
+  return bluedroid::connect(config_.address.data(), peer);
+}
+
+void VirtualCentral::disconnect() { bluedroid::disconnect(); }
+
+void VirtualCentral::pair() { bluedroid::encrypt(); }
+
+uint16_t VirtualCentral::exchange_mtu() {
+  counters_.att_round_trips++;
+  mtu_ = bluedroid::exchange_mtu(config_.mtu);
+  return mtu_;
+}
+
+bool VirtualCentral::discover() {
+  services_.clear();
+  subscribed_.clear();
+  last_value_.clear();
+  service_changed_handle_ = 0;
+  battery_level_handle_ = 0;
+  telemetry_handle_ = 0;
+
+  // every attribute's handle and type
+  std::vector<std::pair<uint16_t, esp_bt_uuid_t>> attributes;
+  uint32_t next = 1;
+  while (next <= 0xFFFF) {
+    counters_.att_round_trips++;
+    auto batch = bluedroid::find_information(next, 0xFFFF);
+    if (batch.empty()) {
+      break;
+    }
+    attributes.insert(attributes.end(), batch.begin(), batch.end());
+    next = batch.back().first + 1;
+  }
+
+  // then the declarations, which give them their structure
+  for (const auto &[handle, type] : attributes) {
+    std::vector<uint8_t> value;
+    if (is_uuid(type, ESP_GATT_UUID_PRI_SERVICE) || is_uuid(type, ESP_GATT_UUID_SEC_SERVICE)) {
+      if (read(handle, value) != ESP_GATT_OK) {
+        return false;
+      }
+      services_.push_back({uuid_from(value.data(), value.size()), handle, handle});
+    } else if (services_.empty()) {
+      return false;
+    } else if (is_uuid(type, ESP_GATT_UUID_INCLUDE_SERVICE)) {
+      if (read(handle, value) != ESP_GATT_OK || value.size() < 4) {
+        return false;
+      }
+      services_.back().included_services.push_back(value[0] | value[1] << 8);
+    } else if (is_uuid(type, ESP_GATT_UUID_CHAR_DECLARE)) {
+      if (read(handle, value) != ESP_GATT_OK || value.size() < 5) {
+        return false;
+      }
+      Characteristic characteristic;
+      characteristic.properties = value[0];
+      characteristic.declaration_handle = handle;
+      characteristic.value_handle = value[1] | value[2] << 8;
+      characteristic.uuid = uuid_from(value.data() + 3, value.size() - 3);
+      services_.back().characteristics.push_back(characteristic);
+    } else if (!services_.back().characteristics.empty()) {
+      auto &characteristic = services_.back().characteristics.back();
+      if (is_uuid(type, ESP_GATT_UUID_CHAR_CLIENT_CONFIG)) {
+        characteristic.cccd_handle = handle;
+      } else if (is_uuid(type, ESP_GATT_UUID_RPT_REF_DESCR)) {
+        if (read(handle, value) != ESP_GATT_OK || value.size() != 2) {
+          return false;
+        }
+        characteristic.report_id = value[0];
+        characteristic.report_type = value[1];
+      }
+    }
+    services_.back().end_handle = handle;
+    if (!services_.back().characteristics.empty()) {
+      services_.back().characteristics.back().end_handle = handle;
+    }
+  }
+
+  // hosts want to know when the database changes
+  if (auto gatt = find_service(0x1801)) {
+    for (const auto &characteristic : gatt->characteristics) {
+      if (is_uuid(characteristic.uuid, ESP_GATT_UUID_GATT_SRV_CHGD) && characteristic.cccd_handle) {
+        const uint8_t indicate[] = {0x02, 0x00};
+        counters_.att_round_trips++;
+        bluedroid::write(characteristic.cccd_handle, indicate);
+        service_changed_handle_ = characteristic.value_handle;
+      }
+    }
+  }
+  needs_discovery_ = false;
+  return true;
+}
+
+const VirtualCentral::DiscoveredService *VirtualCentral::find_service(uint16_t uuid16) const {
+  auto it = std::find_if(services_.begin(), services_.end(),
+                         [&](const DiscoveredService &service) { return is_uuid(service.uuid, uuid16); });
+  return it == services_.end() ? nullptr : &*it;
+}
+
+std::vector<const VirtualCentral::Characteristic *> VirtualCentral::input_reports() const {
+  std::vector<const Characteristic *> reports;
+  if (auto hid = find_service(ESP_GATT_UUID_HID_SVC)) {
+    for (const auto &characteristic : hid->characteristics) {
+      if (is_uuid(characteristic.uuid, ESP_GATT_UUID_HID_REPORT) && characteristic.report_type == 0x01) {
+        reports.push_back(&characteristic);
+      }
+    }
+  }
+  return reports;
+}
+
+esp_gatt_status_t VirtualCentral::read_once(uint16_t handle, uint16_t offset, std::vector<uint8_t> &value) {
+  counters_.att_round_trips++;
+  return bluedroid::read(handle, offset, value);
+}
+
+esp_gatt_status_t VirtualCentral::read(uint16_t handle, std::vector<uint8_t> &value) {
+  value.clear();
+  while (true) {
+    std::vector<uint8_t> chunk;
+    auto status = read_once(handle, value.size(), chunk);
+    if (status != ESP_GATT_OK) {
+      return status;
+    }
+    value.insert(value.end(), chunk.begin(), chunk.end());
+    // a full response means there may be more
+    if (chunk.size() < size_t(mtu_ - 1)) {
+      return ESP_GATT_OK;
+    }
+  }
+}
+
+esp_gatt_status_t VirtualCentral::read_report_map(std::vector<uint8_t> &report_map) {
+  if (auto hid = find_service(ESP_GATT_UUID_HID_SVC)) {
+    for (const auto &characteristic : hid->characteristics) {
+      if (is_uuid(characteristic.uuid, ESP_GATT_UUID_HID_REPORT_MAP)) {
+        auto status = read(characteristic.value_handle, report_map);
+        // Generic Device Controls: Battery Strength, whose values aren't a sequence
+        battery_report_id_ = status == ESP_GATT_OK ? hid::descriptor::report_id_of(report_map, 0x00060020) : -1;
+        return status;
+      }
+    }
+  }
+  return ESP_GATT_NOT_FOUND;
+}
+
+const VirtualCentral::Characteristic *VirtualCentral::battery_level() const {
+  if (auto bas = find_service(ESP_GATT_UUID_BATTERY_SERVICE_SVC)) {
+    for (const auto &characteristic : bas->characteristics) {
+      if (is_uuid(characteristic.uuid, ESP_GATT_UUID_BATTERY_LEVEL)) {
+        return &characteristic;
+      }
+    }
+  }
+  return nullptr;
+}
+
+bool VirtualCentral::subscribe_battery_level() {
+  auto level = battery_level();
+  if (!level || !level->cccd_handle) {
+    return false;
+  }
+  const uint8_t notify[] = {0x01, 0x00};
+  counters_.att_round_trips++;
+  if (bluedroid::write(level->cccd_handle, notify) != ESP_GATT_OK) {
+    return false;
+  }
+  battery_level_handle_ = level->value_handle;
+  return true;
+}
+
+const VirtualCentral::Characteristic *VirtualCentral::find_characteristic(
+    const gatt::Uuid &service_uuid, const gatt::Uuid &characteristic_uuid) const {
+  for (const auto &service : services_) {
+    if (!service_uuid.matches(service.uuid)) {
+      continue;
+    }
+    for (const auto &characteristic : service.characteristics) {
+      if (characteristic_uuid.matches(characteristic.uuid)) {
+        return &characteristic;
+      }
+    }
+  }
+  return nullptr;
+}
+
+bool VirtualCentral::subscribe_telemetry() {
+  auto data = find_characteristic(TELEMETRY_SERVICE_UUID, TELEMETRY_DATA_UUID);
+  if (!data || !data->cccd_handle) {
+    return false;
+  }
+  const uint8_t notify[] = {0x01, 0x00};
+  counters_.att_round_trips++;
+  if (bluedroid::write(data->cccd_handle, notify) != ESP_GATT_OK) {
+    return false;
+  }
+  telemetry_handle_ = data->value_handle;
+  telemetry_sequence_ = -1;
+  return true;
+}
+
+bool VirtualCentral::grant_telemetry_credits(uint16_t credits, bool with_response) {
+  auto credits_characteristic = find_characteristic(TELEMETRY_SERVICE_UUID, TELEMETRY_CREDITS_UUID);
+  if (!credits_characteristic) {
+    return false;
+  }
+  const uint8_t value[] = {uint8_t(credits), uint8_t(credits >> 8)};
+  if (with_response) {
+    counters_.att_round_trips++;
+  }
+  return bluedroid::write(credits_characteristic->value_handle, value, with_response) == ESP_GATT_OK;
+}
+
+void VirtualCentral::on_telemetry_frame(std::span<const uint8_t> frame) {
+  TelemetryFrameHeader header;
+  if (frame.size() < sizeof(header)) {
+    counters_.telemetry_malformed++;
+    return;
+  }
+  std::copy_n(frame.begin(), sizeof(header), reinterpret_cast<uint8_t *>(&header));
+  if (telemetry_sequence_ >= 0) {
+    counters_.telemetry_lost += uint16_t(header.sequence - telemetry_sequence_);
+  }
+  telemetry_sequence_ = uint16_t(header.sequence + 1);
+  size_t offset = sizeof(header);
+  for (size_t i = 0; i < header.num_samples; i++) {
+    if (offset + sizeof(TelemetrySampleHeader) > frame.size() ||
+        offset + sizeof(TelemetrySampleHeader) + frame[offset + 1] > frame.size()) {
+      counters_.telemetry_malformed++;
+      return;
+    }
+    counters_.telemetry_bytes += frame[offset + 1];
+    offset += sizeof(TelemetrySampleHeader) + frame[offset + 1];
+  }
+  if (header.version != TELEMETRY_FRAME_VERSION || offset != frame.size()) {
+    counters_.telemetry_malformed++;
+    return;
+  }
+  counters_.telemetry_frames++;
+  counters_.telemetry_samples += header.num_samples;
+}
+
+bool VirtualCentral::subscribe(uint8_t report_id) {
+  bool subscribed = false;
+  for (auto report : input_reports()) {
+    if ((report_id != 0 && report->report_id != report_id) || !report->cccd_handle) {
+      continue;
+    }
+    const uint8_t notify[] = {0x01, 0x00};
+    counters_.att_round_trips++;
+    if (bluedroid::write(report->cccd_handle, notify) != ESP_GATT_OK) {
+      return false;
+    }
+    subscribed_[report->value_handle] = report->report_id;
+    subscribed = true;
+  }
+  return subscribed;
+}
+
+void VirtualCentral::on_notification(uint16_t handle, std::span<const uint8_t> value, bool indication) {
+  if (indication && handle == service_changed_handle_) {
+    counters_.service_changed++;
+    needs_discovery_ = true;
+    return;
+  }
+  counters_.notifications++;
+  counters_.notification_bytes += value.size();
+  if (handle == battery_level_handle_ && handle) {
+    counters_.battery_notifications++;
+    counters_.battery_level = value.empty() ? -1 : value[0];
+    return;
+  }
+  if (handle == telemetry_handle_ && handle) {
+    on_telemetry_frame(value);
+    return;
+  }
+  auto subscription = subscribed_.find(handle);
+  if (subscription == subscribed_.end()) {
+    counters_.unsubscribed_notifications++;
+    return;
+  }
+  counters_.reports[subscription->second]++;
+  if (subscription->second == battery_report_id_) {
+    counters_.battery_strength = value.empty() ? -1 : value[0];
+  } else if (!value.empty()) {
+    auto last = last_value_.find(handle);
+    if (last != last_value_.end() && value[0] != uint8_t(last->second + 1)) {
+      counters_.out_of_order++;
+    }
+    last_value_[handle] = value[0];
+  }
+}
+
+uint16_t VirtualCentral::on_connection_update(uint16_t min_interval, uint16_t max_interval) {
+  return std::clamp(config_.min_interval, min_interval, max_interval);
+}
+
+} // namespace host
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "hid.hpp"
+
+namespace cc {
+
+  // Consumer control (media keys), one usage at a time
+  struct InputReport {
+    uint16_t usage; // consumer usage ID (e.g. hid::VOLUME_INCREMENT), 0 = none
+  } __attribute__((packed));
+
+  template <uint8_t REPORT_ID = 1>
+  static constexpr uint8_t report_descriptor[] = {
+    hid::USAGE_PAGE,
+    hid::CONSUMER,
+    hid::USAGE,
+    hid::CONSUMER_CONTROL,
+    hid::START_COLLECTION,
+    hid::APPLICATION,
+    hid::REPORT_ID,
+    REPORT_ID,
+    hid::LOGICAL_MINIMUM,
+    0x00,
+    hid::LOGICAL_MAXIMUM_16,
+    hid::low_byte(0x3FF),
+    hid::high_byte(0x3FF),
+    hid::USAGE_MINIMUM,
+    0x00,
+    hid::USAGE_MAXIMUM_16,
+    hid::low_byte(0x3FF),
+    hid::high_byte(0x3FF),
+    hid::REPORT_SIZE,
+    0x10,
+    hid::REPORT_COUNT,
+    0x01,
+    hid::INPUT,
+    0x00, // (Data,Array,Abs)
+    hid::END_COLLECTION // Application
+  };
+
+} // namespace cc
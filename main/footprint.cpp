@@ -0,0 +1,46 @@
+#include "footprint.hpp"
+
+#include <array>
+#include <cstdint>
+
+#include <esp_heap_caps.h>
+#include <esp_system.h>
+#include <fmt/format.h>
+
+namespace footprint {
+
+struct Stage {
+  const char *name;
+  int32_t bytes; ///< may be negative, if the stage freed more than it kept
+};
+
+static constexpr size_t MAX_STAGES = 8;
+static std::array<Stage, MAX_STAGES> stages;
+static size_t num_stages = 0;
+static uint32_t free_at_mark = 0;
+
+void start() {
+  num_stages = 0;
+  free_at_mark = esp_get_free_heap_size();
+}
+
+void mark(const char *stage) {
+  uint32_t free_now = esp_get_free_heap_size();
+  if (num_stages < MAX_STAGES) {
+    stages[num_stages++] = {stage, int32_t(free_at_mark - free_now)};
+  }
+  free_at_mark = free_now;
+}
+
+std::string json(const char *state) {
+  std::string stage_bytes;
+  for (size_t i = 0; i < num_stages; i++) {
+    stage_bytes += fmt::format("{}\"{}\":{}", i ? "," : "", stages[i].name, stages[i].bytes);
+  }
+  return fmt::format("{{\"footprint\":\"{}\",\"free_heap\":{},\"min_free_heap\":{},\"largest_free_block\":{},"
+                     "\"stages\":{{{}}}}}",
+                     state, esp_get_free_heap_size(), esp_get_minimum_free_heap_size(),
+                     heap_caps_get_largest_free_block(MALLOC_CAP_8BIT), stage_bytes);
+}
+
+} // namespace footprint
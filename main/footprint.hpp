@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+// Heap footprint of the example: the heap each init stage took, and what is
+// left at steady state, as one line of JSON for tools/footprint.py (which
+// reads the static RAM and flash of each component from the linker map):
+//
+//   footprint::start();
+//   nvs_flash_init();
+//   footprint::mark("nvs");
+//   ...
+//   fmt::print("{}\n", footprint::json("advertising"));
+//
+// {"footprint":"advertising","free_heap":...,"min_free_heap":...,
+//  "largest_free_block":...,"stages":{"nvs":...,...}}
+
+namespace footprint {
+
+/// Start measuring: the next mark() is relative to the heap now
+void start();
+
+/// The heap the stage took since the previous mark (or start), the name must
+/// be a literal
+void mark(const char *stage);
+
+/// The heap now, in the state (e.g. "advertising" or "connected"), and the
+/// stages marked so far
+std::string json(const char *state);
+
+} // namespace footprint
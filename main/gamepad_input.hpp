@@ -0,0 +1,74 @@
+#pragma once
+
+#include "digital_input.hpp"
+#include "input_conditioning.hpp"
+#include "xbox.hpp"
+
+namespace gamepad_input {
+
+  // The inputs of the gamepad profile. The analog ones, in the order they
+  // are read, are two sticks on 12-bit ADC channels and two triggers read as
+  // 10 bits, conditioned (see input_conditioning.hpp) before an
+  // xb::InputReport is built from them. The buttons are debounced (see
+  // digital_input.hpp) and mapped to the report's buttons.
+
+  enum Input : uint8_t { LEFT_X, LEFT_Y, RIGHT_X, RIGHT_Y, BRAKE, ACCELERATOR, NUM_AXES };
+
+  static constexpr int16_t STICK_CENTER = 2048;
+  static constexpr int16_t STICK_MAX = 4095;
+  static constexpr int16_t TRIGGER_MAX = 1023;
+
+  /// Nominal calibration, a 10% radial deadzone on the sticks and a little
+  /// outer deadzone everywhere, so full deflection is full scale
+  inline input_conditioning::Pipeline::Config config(input_conditioning::Filter filter) {
+    input_conditioning::Axis stick{
+        .raw_min = 0, .raw_center = STICK_CENTER, .raw_max = STICK_MAX, .outer_deadzone = 330};
+    input_conditioning::Axis trigger{
+        .raw_min = 0, .raw_center = 0, .raw_max = TRIGGER_MAX, .deadzone = 330, .outer_deadzone = 330};
+    return {
+        .axes = {stick, stick, stick, stick, trigger, trigger},
+        .sticks = {{.x = LEFT_X, .y = LEFT_Y, .deadzone = 3277}, {.x = RIGHT_X, .y = RIGHT_Y, .deadzone = 3277}},
+        .filter = filter,
+    };
+  }
+
+  /// The buttons, as their bits of the report's buttons: bit i is btn_<i + 1>
+  /// (Button i + 1), bit 16 is options (AC Back)
+  enum Button : uint8_t { A = 0, B = 1, X = 3, Y = 4, L1 = 6, R1 = 7, MENU = 11, MODE = 12, L3 = 13, R3 = 14, BACK = 16 };
+
+  /// The buttons in the order of their inputs, e.g. CONFIG_BUTTON_GPIOS
+  inline constexpr digital_input::ButtonMap button_map{A, B, X, Y, L1, R1, MENU, MODE, L3, R3, BACK};
+
+  /// Fill in the report's buttons from their bits (see button_map)
+  inline void set_buttons(uint32_t buttons, xb::InputReport &report) {
+    report.btn_1 = buttons & 1;
+    report.btn_2 = (buttons >> 1) & 1;
+    report.btn_3 = (buttons >> 2) & 1;
+    report.btn_4 = (buttons >> 3) & 1;
+    report.btn_5 = (buttons >> 4) & 1;
+    report.btn_6 = (buttons >> 5) & 1;
+    report.btn_7 = (buttons >> 6) & 1;
+    report.btn_8 = (buttons >> 7) & 1;
+    report.btn_9 = (buttons >> 8) & 1;
+    report.btn_10 = (buttons >> 9) & 1;
+    report.btn_11 = (buttons >> 10) & 1;
+    report.btn_12 = (buttons >> 11) & 1;
+    report.btn_13 = (buttons >> 12) & 1;
+    report.btn_14 = (buttons >> 13) & 1;
+    report.btn_15 = (buttons >> 14) & 1;
+    report.options = (buttons >> BACK) & 1;
+  }
+
+  /// Fill in the report's axes from conditioned values
+  inline void build_report(const int16_t *conditioned, xb::InputReport &report) {
+    auto axis = [](int16_t value) { return uint16_t(value + 32768); };
+    auto trigger = [](int16_t value) { return uint16_t(value >> 5); };
+    report.axis_x = axis(conditioned[LEFT_X]);
+    report.axis_y = axis(conditioned[LEFT_Y]);
+    report.axis_z = axis(conditioned[RIGHT_X]);
+    report.axis_rz = axis(conditioned[RIGHT_Y]);
+    report.brake = trigger(conditioned[BRAKE]);
+    report.accelerator = trigger(conditioned[ACCELERATOR]);
+  }
+
+} // namespace gamepad_input
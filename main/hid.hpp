@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
 // see: https://usb.org/sites/default/files/hut1_4.pdf
 
 namespace hid {
@@ -49,6 +54,8 @@ static constexpr int LEDS = 0x08;
 static constexpr int BUTTON = 0x09;
 static constexpr int CONSUMER = 0x0C;
 static constexpr int PHYSICAL_INTERFACE = 0x0F;
+static constexpr int SENSORS = 0x20;
+static constexpr int VENDOR_DEFINED = 0xFF00; // with USAGE_PAGE_16
 
 // usage types
 static constexpr int POINTER = 0x01;
@@ -105,7 +112,14 @@ static constexpr int ACCELERATOR = 0xC4;
 static constexpr int BRAKE = 0xC5;
 static constexpr int STEERING = 0xC8;
 
+// keyboard / keypad
+static constexpr int KEY_A = 0x04;
+static constexpr int KEYBOARD_APPLICATION = 0x65;
+static constexpr int KEYBOARD_LEFT_CONTROL = 0xE0;
+static constexpr int KEYBOARD_RIGHT_GUI = 0xE7;
+
 // consumer controls
+static constexpr int CONSUMER_CONTROL = 0x01;
 static constexpr int POWER = 0x30;
 static constexpr int RESET = 0x31;
 static constexpr int SLEEP = 0x32;
@@ -130,6 +144,16 @@ static constexpr int AC_PROPERTIES = 0x209;
 static constexpr int AC_HOME = 0x223;
 static constexpr int AC_BACK = 0x224;
 
+// sensors (usage page SENSORS), the 16-bit ones with USAGE_16
+static constexpr int MOTION_ACCELEROMETER_3D = 0x73;
+static constexpr int MOTION_GYROMETER_3D = 0x76;
+static constexpr int ACCELERATION_AXIS_X = 0x453;
+static constexpr int ACCELERATION_AXIS_Y = 0x454;
+static constexpr int ACCELERATION_AXIS_Z = 0x455;
+static constexpr int ANGULAR_VELOCITY_X_AXIS = 0x457;
+static constexpr int ANGULAR_VELOCITY_Y_AXIS = 0x458;
+static constexpr int ANGULAR_VELOCITY_Z_AXIS = 0x459;
+
 // unit types
 static constexpr int ANGULAR_POSITION = 0x12;
 
@@ -181,4 +205,13 @@ static constexpr int DF = (VARIABLE);         ///< Dynamic flag, read-write sing
 static constexpr uint8_t low_byte(uint16_t v) { return v & 0xFF; }
 
 static constexpr uint8_t high_byte(uint16_t v) { return v >> 8; }
+
+/// Concatenate report descriptors (with distinct report IDs) into the report
+/// descriptor of a composite device
+template <size_t... Ns> static constexpr std::array<uint8_t, (Ns + ...)> concat(const uint8_t (&...descriptors)[Ns]) {
+  std::array<uint8_t, (Ns + ...)> result{};
+  size_t offset = 0;
+  ((std::copy(descriptors, descriptors + Ns, result.begin() + offset), offset += Ns), ...);
+  return result;
+}
 } // namespace hid
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "hid.hpp"
+
+namespace kb {
+
+  // Boot-protocol compatible keyboard report
+  struct InputReport {
+    uint8_t modifiers; // bit per modifier key, left control (bit 0) to right gui (bit 7)
+    uint8_t reserved;
+    uint8_t keys[6]; // up to 6 concurrently pressed keys (usage IDs), 0 = none
+  } __attribute__((packed));
+
+  template <uint8_t REPORT_ID = 1>
+  static constexpr uint8_t report_descriptor[] = {
+    hid::USAGE_PAGE,
+    hid::GENERIC_DESKTOP,
+    hid::USAGE,
+    hid::KEYBOARD,
+    hid::START_COLLECTION,
+    hid::APPLICATION,
+    hid::REPORT_ID,
+    REPORT_ID,
+
+    // modifier keys
+    hid::USAGE_PAGE,
+    hid::KEYBOARD_CONTROLS,
+    hid::USAGE_MINIMUM,
+    hid::KEYBOARD_LEFT_CONTROL,
+    hid::USAGE_MAXIMUM,
+    hid::KEYBOARD_RIGHT_GUI,
+    hid::LOGICAL_MINIMUM,
+    0x00,
+    hid::LOGICAL_MAXIMUM,
+    0x01,
+    hid::REPORT_SIZE,
+    0x01,
+    hid::REPORT_COUNT,
+    0x08,
+    hid::INPUT,
+    0x02, // (Data,Var,Abs)
+
+    // reserved byte
+    hid::REPORT_SIZE,
+    0x08,
+    hid::REPORT_COUNT,
+    0x01,
+    hid::INPUT,
+    0x01, // constant
+
+    // keys
+    hid::USAGE_MINIMUM,
+    0x00,
+    hid::USAGE_MAXIMUM,
+    hid::KEYBOARD_APPLICATION,
+    hid::LOGICAL_MINIMUM,
+    0x00,
+    hid::LOGICAL_MAXIMUM,
+    hid::KEYBOARD_APPLICATION,
+    hid::REPORT_SIZE,
+    0x08,
+    hid::REPORT_COUNT,
+    0x06,
+    hid::INPUT,
+    0x00, // (Data,Array,Abs)
+
+    hid::END_COLLECTION // Application
+  };
+
+} // namespace kb
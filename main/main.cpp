@@ -1,13 +1,28 @@
+#include <charconv>
 #include <chrono>
+#include <cmath>
+#include <mutex>
+#include <string_view>
 #include <thread>
+#include <vector>
 
 #include <esp_random.h>
 
+#include "battery_monitor.hpp"
+#include "digital_input.hpp"
 #include "hid_service.hpp"
+#include "input_bridge.hpp"
+#include "load_generator.hpp"
 
 #include "logger.hpp"
 #include "task.hpp"
 
+#include "footprint.hpp"
+#include "gamepad_input.hpp"
+#include "motion.hpp"
+#include "mouse.hpp"
+#include "profiles.hpp"
+#include "report_bench.hpp"
 #include "xbox.hpp"
 
 void remove_all_bonded_devices(void) {
@@ -23,11 +38,43 @@ void remove_all_bonded_devices(void) {
     free(dev_list);
 }
 
+// the GPIOs of a comma separated list, e.g. "4, 5,18"
+static std::vector<int> parse_gpios(std::string_view list) {
+  std::vector<int> gpios;
+  while (!list.empty()) {
+    auto comma = list.find(',');
+    auto item = list.substr(0, comma);
+    while (item.starts_with(' ')) {
+      item.remove_prefix(1);
+    }
+    int gpio;
+    if (std::from_chars(item.data(), item.data() + item.size(), gpio).ec == std::errc()) {
+      gpios.push_back(gpio);
+    }
+    list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+  }
+  return gpios;
+}
+
+#if CONFIG_LOAD_GENERATOR
+// the hid service's side of a load generator run, for its results
+static load_generator::Delivery report_delivery() {
+  const auto &latency = hid_service_get_report_latency();
+  return {
+      .dropped = latency.failed + latency.lost,
+      .completed = latency.completed,
+      .latency_p50_us = latency.total.percentile(0.5f),
+      .latency_p99_us = latency.total.percentile(0.99f),
+      .latency_max_us = latency.total.max(),
+  };
+}
+#endif
+
 using namespace std::chrono_literals;
 
 extern "C" void app_main(void) {
   static auto start = std::chrono::high_resolution_clock::now();
-  static auto elapsed = [&]() {
+  [[maybe_unused]] static auto elapsed = [&]() {
     auto now = std::chrono::high_resolution_clock::now();
     return std::chrono::duration<float>(now - start).count();
   };
@@ -35,6 +82,8 @@ extern "C" void app_main(void) {
   espp::Logger logger({.tag = "HID Service Table Example", .level = espp::Logger::Verbosity::DEBUG});
 
   logger.info("Bootup");
+  // the heap each init stage takes, see tools/footprint.py
+  footprint::start();
 
   // Initialize NVS.
   auto ret = nvs_flash_init();
@@ -43,6 +92,16 @@ extern "C" void app_main(void) {
     ret = nvs_flash_init();
   }
   ESP_ERROR_CHECK( ret );
+  footprint::mark("nvs");
+
+  // DFS and light sleep while no report is in flight, before the controller
+  // takes its power management locks
+  power_save::init();
+#if CONFIG_POWER_SAVE_LIGHT_SLEEP
+  if (CONFIG_INPUT_WAKE_GPIO >= 0) {
+    power_save::add_wake_gpio(CONFIG_INPUT_WAKE_GPIO, 0);
+  }
+#endif
 
   logger.info("Device name: '{}'", CONFIG_DEVICE_NAME);
 
@@ -77,69 +136,241 @@ extern "C" void app_main(void) {
     logger.error("enable bluetooth failed");
     return;
   }
+  footprint::mark("bluetooth");
 
   remove_all_bonded_devices();
 
   // initialize the hid service table
-  hid_service_init(CONFIG_DEVICE_NAME);
+  // trace from the stack's first callback on (does nothing without CONFIG_EVENT_TRACE)
+  event_trace::start();
+  // capture the ATT traffic (does nothing without CONFIG_BTSNOOP_CAPTURE)
+  btsnoop::start();
+  // the identity the attribute tables are created with (profiles may override
+  // the PnP ID, manufacturer name and model number): the model number is the
+  // product ID in hex
+  std::string model_number = fmt::format("{:04x}", CONFIG_PRODUCT_ID);
+  std::string serial_number = fmt::format("{:010d}", esp_random());
+  hid_service_init(DeviceIdentity{
+      .device_name = CONFIG_DEVICE_NAME,
+      .vendor_id = CONFIG_VENDOR_ID,
+      .product_id = CONFIG_PRODUCT_ID,
+      .product_version = CONFIG_PRODUCT_VERSION,
+      .manufacturer_name = CONFIG_MANUFACTURER_NAME,
+      .model_number = model_number,
+      .serial_number = serial_number,
+  });
+  footprint::mark("hid_service");
 
-  // set the device plug and play ID (vendor ID, product ID, product version)
-  uint16_t vendor_id = CONFIG_VENDOR_ID;
-  uint16_t product_id = CONFIG_PRODUCT_ID;
-  uint16_t product_version = CONFIG_PRODUCT_VERSION;
-  hid_service_set_pnp_id(vendor_id, product_id, product_version);
+  // register the device profiles and activate the configured one, which sets
+  // the (compile-time minimized) report descriptor, input reports, plug and
+  // play ID and appearance
+  int default_profile = register_device_profiles();
 
-  // set the manufacturer name
-  std::string manufacturer_name = CONFIG_MANUFACTURER_NAME;
-  hid_service_set_manufacturer_name(manufacturer_name);
+  // add any profiles provisioned in the profile bundle partition (see
+  // components/hid_profile_bundle), which can also provide the default
+  hid_service_load_profile_bundle("profiles");
+  std::string_view bundle_profile = CONFIG_PROFILE_BUNDLE_DEFAULT_PROFILE;
+  if (!bundle_profile.empty()) {
+    int index = hid_service_find_profile(bundle_profile);
+    if (index >= 0) {
+      default_profile = index;
+    } else {
+      logger.warn("Profile '{}' not found, using the built-in default", bundle_profile);
+    }
+  }
 
-  // set the model number string, which is the product ID in hex
-  std::string model_number = fmt::format("{:04x}", product_id);
-  hid_service_set_model_number(model_number);
+  hid_service_switch_profile(default_profile);
+  footprint::mark("profiles");
+
+#if CONFIG_REPORT_BENCHMARK
+  // measure the input report path once a host has connected (and had time
+  // to subscribe), printing one line of JSON per stage
+  logger.info("Waiting for a connection to benchmark the input report path");
+  while (!hid_service_is_connected()) {
+    std::this_thread::sleep_for(100ms);
+  }
+  std::this_thread::sleep_for(5s);
+  run_report_path_benchmarks({
+      .iterations = CONFIG_REPORT_BENCHMARK_ITERATIONS,
+      // a connection interval or two, for the stack to send what was queued
+      .drain = [] { std::this_thread::sleep_for(30ms); },
+      .on_result = [](const BenchmarkResult &result) { fmt::print("{}\n", benchmark_result_json(result)); },
+  });
+#endif
+
+  // steady state from here on: the stack's callbacks and the input report
+  // path must not allocate (does nothing without CONFIG_ALLOC_AUDIT)
+  alloc_audit::start();
+
+  // the gamepad's report, whose buttons the button task fills in (and whose
+  // axes the demo does)
+  static xb::InputReport gamepad_report{};
+  static std::mutex gamepad_report_mutex;
+
+  // the gamepad's buttons, scanned every CONFIG_DIGITAL_INPUT_SCAN_PERIOD_MS
+  // and reported as soon as one changed
+  static std::vector<int> button_pins = parse_gpios(CONFIG_BUTTON_GPIOS);
+  static digital_input::Scanner button_scanner({
+      .source = button_pins.empty() ? nullptr : digital_input::gpio_source(button_pins),
+  });
+  espp::Task button_task({
+      .name = "Button Task",
+      .callback = [&](auto &m, auto &cv) -> bool {
+        auto start = std::chrono::steady_clock::now();
+        if (button_scanner.scan()) {
+          auto profile = hid_service_get_profile(hid_service_get_active_profile());
+          std::lock_guard<std::mutex> report_lock(gamepad_report_mutex);
+          gamepad_input::set_buttons(gamepad_input::button_map.apply(button_scanner.pressed()), gamepad_report);
+          if (hid_service_is_connected() && profile &&
+              has_input_report(*profile, GAMEPAD_REPORT_ID, sizeof(gamepad_report))) {
+            hid_service_send_input_report(GAMEPAD_REPORT_ID, (const uint8_t *)&gamepad_report, sizeof(gamepad_report));
+          }
+        }
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait_until(lock, start + std::chrono::milliseconds(CONFIG_DIGITAL_INPUT_SCAN_PERIOD_MS));
+        return false;
+      },
+      .stack_size_bytes = 4096,
+  });
+  if (!button_pins.empty()) {
+    button_task.start();
+  }
 
-  // set the serial number
-  uint32_t random_number = esp_random();
-  std::string serial_number = fmt::format("{:010d}", random_number);
-  hid_service_set_serial_number(serial_number);
+#if CONFIG_INPUT_BRIDGE
+  // input reports from a PC or another MCU, framed over a UART (see
+  // input_bridge.hpp), sent on as soon as they arrive
+  auto bridge_read = input_bridge::uart_transport(CONFIG_INPUT_BRIDGE_UART_PORT, CONFIG_INPUT_BRIDGE_BAUD_RATE,
+                                                  CONFIG_INPUT_BRIDGE_RX_GPIO, CONFIG_INPUT_BRIDGE_TX_GPIO,
+                                                  2 * CONFIG_INPUT_BRIDGE_RX_BUFFER_SIZE,
+                                                  CONFIG_INPUT_BRIDGE_RX_TIMEOUT_SYMBOLS);
+  static input_bridge::Bridge bridge({
+      .read = bridge_read,
+      .send = [](uint8_t report_id, const uint8_t *report, size_t length) {
+        hid_service_send_input_report(report_id, report, length);
+      },
+      // counted with the reports the diagnostics service reports as coalesced
+      .on_coalesced = hid_service_add_coalesced_reports,
+      .buffer_size = CONFIG_INPUT_BRIDGE_RX_BUFFER_SIZE,
+  });
+  espp::Task bridge_task({
+      .name = "Input Bridge Task",
+      .callback = [&](auto &m, auto &cv) -> bool {
+        bridge.poll(100);
+        return false;
+      },
+      .stack_size_bytes = 4096,
+  });
+  if (bridge_read) {
+    bridge_task.start();
+  }
+#endif
 
-  // set the HID report descriptor (to be the same as the xbox elite wireless controller)
-  hid_service_set_report_descriptor((uint8_t*)xb::report_descriptor, sizeof(xb::report_descriptor));
+#if CONFIG_LOAD_GENERATOR
+  // a repeatable load once per connection: the trace in its partition, else
+  // the active profile's first input report at a fixed rate
+  static load_generator::TraceReader trace;
+  static bool have_trace = load_generator::map_trace(CONFIG_LOAD_GENERATOR_TRACE_PARTITION, trace);
+  static load_generator::Generator generator({
+      .send = [](uint8_t report_id, const uint8_t *report, size_t length) {
+        hid_service_send_input_report(report_id, report, length);
+      },
+      .queue_depth = []() -> size_t {
+        const auto &latency = hid_service_get_report_latency();
+        return latency.sent - latency.completed - latency.failed - latency.lost;
+      },
+      .queue_limit = CONFIG_LOAD_GENERATOR_QUEUE_LIMIT,
+  });
+  espp::Task load_task({
+      .name = "Load Generator Task",
+      .callback = [&](auto &m, auto &cv) -> bool {
+        {
+          std::unique_lock<std::mutex> lock(m);
+          cv.wait_for(lock, 100ms);
+        }
+        static bool ran = false;
+        if (!hid_service_is_connected()) {
+          ran = false;
+          return false;
+        }
+        if (ran) {
+          return false;
+        }
+        ran = true;
+        // time for the host to subscribe
+        std::this_thread::sleep_for(5s);
+        auto profile = hid_service_get_profile(hid_service_get_active_profile());
+        if (!hid_service_is_connected() || !profile || !profile->num_input_reports) {
+          return false;
+        }
+        hid_service_reset_report_latency();
+        if (have_trace) {
+          trace.rewind();
+          const auto &stats = generator.run(trace.source(), trace.duration_us());
+          fmt::print("{}\n", load_generator::result_json("trace", stats, report_delivery()));
+        } else {
+          load_generator::Pattern pattern({
+              .report_id = profile->input_report_ids[0],
+              .report = std::vector<uint8_t>(profile->input_report_sizes[0]),
+              .rate_hz = CONFIG_LOAD_GENERATOR_RATE_HZ,
+              .count = CONFIG_LOAD_GENERATOR_RATE_HZ * CONFIG_LOAD_GENERATOR_SECONDS,
+              .burst = CONFIG_LOAD_GENERATOR_BURST,
+          });
+          const auto &stats = generator.run(pattern.source(), pattern.duration_us());
+          auto name = fmt::format("{}_{}hz_x{}", profile->name, CONFIG_LOAD_GENERATOR_RATE_HZ,
+                                  CONFIG_LOAD_GENERATOR_BURST);
+          fmt::print("{}\n", load_generator::result_json(name, stats, report_delivery()));
+        }
+        return false;
+      },
+      .stack_size_bytes = 6 * 1024,
+  });
+  load_task.start();
+#endif
 
+#if CONFIG_DEMO_INPUT_REPORTS
   // make a task to send input reports every second
   espp::Task task({
       .name = "Input Report Task",
         .callback = [&](auto &m, auto &cv) -> bool {
           auto start = std::chrono::steady_clock::now();
-          if (hid_service_is_connected()) {
+          event_trace::instant("Input Report Task", "wakeup");
+          auto profile = hid_service_get_profile(hid_service_get_active_profile());
+          if (hid_service_is_connected() && profile && profile->name == "mouse") {
+            // jiggle the mouse back and forth
+            static mouse::InputReport report{};
+            static int8_t direction = 1;
+            report.x = direction;
+            hid_service_send_input_report(1, (const uint8_t*)&report, sizeof(report));
+            direction = -direction;
+          } else if (hid_service_is_connected() && profile &&
+                     has_input_report(*profile, GAMEPAD_REPORT_ID, sizeof(xb::InputReport))) {
             logger.debug("[{:.3f}] Sending new input report!", elapsed());
-            static xb::InputReport report;
+            auto &report = gamepad_report;
             static constexpr size_t report_size = sizeof(xb::InputReport);
-            static constexpr uint16_t AXIS_UP_VALUE = 65534;
-            static constexpr uint16_t AXIS_DOWN_VALUE = 0;
-            static constexpr uint16_t AXIS_CENTER_VALUE = 32767;
+            // the simulated readings are noiseless, so they aren't filtered
+            static input_conditioning::Pipeline pipeline(gamepad_input::config(input_conditioning::Filter::NONE));
+            static std::array<int16_t, gamepad_input::NUM_AXES> raw = {
+                gamepad_input::STICK_CENTER, gamepad_input::STICK_CENTER, gamepad_input::STICK_CENTER,
+                gamepad_input::STICK_CENTER, 0, 0};
+            static std::array<int16_t, gamepad_input::NUM_AXES> conditioned;
             static bool go_up = true;
+            auto send_readings = [&] {
+              std::lock_guard<std::mutex> report_lock(gamepad_report_mutex);
+              pipeline.process(raw.data(), conditioned.data(), esp_timer_get_time());
+              gamepad_input::build_report(conditioned.data(), report);
+              hid_service_send_input_report(GAMEPAD_REPORT_ID, (const uint8_t*)&report, report_size);
+            };
             // toggle the 'b' button, which acts as the 'back' button on Android
             // report.btn_2 = !report.btn_2; // NOTE: disabling this because it's really annoying...
             // toggle the up/down on the left joystick (axis_y, center is 32768, up is 65535, down is 0)
-            if (go_up) {
-              report.axis_y = AXIS_UP_VALUE;
-              hid_service_send_input_report((const uint8_t*)&report, report_size);
-
-            } else {
-              report.axis_y = AXIS_DOWN_VALUE;
-              hid_service_send_input_report((const uint8_t*)&report, report_size);
-            }
+            raw[gamepad_input::LEFT_Y] = go_up ? gamepad_input::STICK_MAX : 0;
+            send_readings();
             // put it back to center
-            report.axis_y = AXIS_CENTER_VALUE;
-            hid_service_send_input_report((const uint8_t*)&report, report_size);
+            raw[gamepad_input::LEFT_Y] = gamepad_input::STICK_CENTER;
+            send_readings();
             // toggle the direction
             go_up = !go_up;
-            // update the battery level
-            static uint8_t battery_level = 0;
-            battery_level = (battery_level) % 100 + 5;
-            hid_service_set_battery_level(battery_level);
           }
-
           std::unique_lock<std::mutex> lock(m);
           cv.wait_until(lock, start + 1s);
           // we don't want to stop the task, so return false
@@ -149,8 +380,130 @@ extern "C" void app_main(void) {
         });
   task.start();
 
-  // loop forever
+  // with the gamepad-motion profile, a simulated 1 kHz IMU read out every
+  // 10 ms (as from its FIFO), batched into one motion report per connection
+  // interval
+  espp::Task motion_task({
+      .name = "Motion Task",
+      .callback = [&](auto &m, auto &cv) -> bool {
+        auto start = std::chrono::steady_clock::now();
+        static motion::Accumulator<GAMEPAD_MOTION_SAMPLES> accumulator;
+        static int64_t next_sample_us = 0;
+        int64_t now_us = esp_timer_get_time();
+        auto profile = hid_service_get_profile(hid_service_get_active_profile());
+        if (!hid_service_is_connected() || !profile ||
+            !has_input_report(*profile, GAMEPAD_MOTION_REPORT_ID, sizeof(accumulator.report()))) {
+          next_sample_us = now_us;
+        }
+        int64_t flush_interval_us = hid_service_get_connection_interval() * 1250;
+        for (; next_sample_us < now_us; next_sample_us += 1000) {
+          // a slow wobble around 1 g (at 4096 / g) and a turn back and forth
+          float t = next_sample_us / 1e6f;
+          motion::Sample sample{
+              .timestamp_us = next_sample_us,
+              .accel = {int16_t(200 * sinf(2 * M_PI * t)), 0, 4096},
+              .gyro = {0, 0, int16_t(2000 * sinf(2 * M_PI * 0.5f * t))},
+          };
+          if (accumulator.add(sample, flush_interval_us)) {
+            hid_service_send_input_report(GAMEPAD_MOTION_REPORT_ID, (const uint8_t *)&accumulator.report(),
+                                          sizeof(accumulator.report()));
+          }
+        }
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait_until(lock, start + 10ms);
+        return false;
+      },
+      .stack_size_bytes = 4096,
+  });
+  motion_task.start();
+#endif
+
+  // the battery level, from an ADC1 channel or else a simulated battery which
+  // slowly discharges (with some noise), sampled every second
+#if CONFIG_BATTERY_ADC_CHANNEL >= 0
+  battery::Source battery_source = battery::adc_source(CONFIG_BATTERY_ADC_CHANNEL, CONFIG_BATTERY_DIVIDER_X100);
+#else
+  battery::Source battery_source = [](uint32_t &millivolts) {
+    static uint32_t discharged_mv = 0;
+    discharged_mv = (discharged_mv + 1) % 900;
+    millivolts = 4150 - discharged_mv + esp_random() % 31 - 15;
+    return true;
+  };
+#endif
+  battery::Monitor battery_monitor({
+      .source = battery_source,
+      .publish = [](uint8_t percent) { hid_service_set_battery_level(percent); },
+  });
+
+  // loop forever, cycling through the registered profiles if configured to
+  auto last_switch = std::chrono::steady_clock::now();
+#if CONFIG_BTSNOOP_CAPTURE
+  bool was_connected = false;
+#endif
+#if CONFIG_ALLOC_AUDIT
+  size_t allocations = 0;
+#endif
+#if CONFIG_INPUT_BRIDGE
+  uint32_t bridge_frames = 0;
+#endif
+  // the heap at steady state, once advertising and once connected
+  bool footprint_printed = false;
+  bool connected_footprint_printed = false;
   while (true) {
     std::this_thread::sleep_for(1s);
+    battery_monitor.update();
+    if (!footprint_printed) {
+      fmt::print("{}\n", footprint::json("advertising"));
+      footprint_printed = true;
+    }
+    if (!connected_footprint_printed && hid_service_is_connected()) {
+      fmt::print("{}\n", footprint::json("connected"));
+      connected_footprint_printed = true;
+    }
+#if CONFIG_BTSNOOP_CAPTURE
+    // keep the capture of the last connection across a reset, see
+    // components/btsnoop/tools/btsnoop_extract.cpp
+    if (was_connected && !hid_service_is_connected()) {
+      btsnoop::save("btsnoop");
+    }
+    was_connected = hid_service_is_connected();
+#endif
+#if CONFIG_ALLOC_AUDIT
+    // print the sites whenever the audited paths allocated again
+    if (alloc_audit::count() != allocations) {
+      allocations = alloc_audit::count();
+      alloc_audit::print();
+    }
+#endif
+#if CONFIG_INPUT_BRIDGE
+    // the bridge's counts, every second that frames came in
+    if (bridge.framing_stats().frames != bridge_frames) {
+      bridge_frames = bridge.framing_stats().frames;
+      const auto &framing = bridge.framing_stats();
+      const auto &stats = bridge.stats();
+      logger.info("Bridge: {} frames ({} CRC errors, {} missed, {} coalesced), {} reports sent, read to send p50 "
+                  "{} us, p99 {} us, max {} us",
+                  framing.frames, framing.crc_errors, stats.missed, stats.coalesced, stats.sent,
+                  stats.read_to_send.percentile(0.5f), stats.read_to_send.percentile(0.99f),
+                  stats.read_to_send.max());
+    }
+#endif
+#if CONFIG_EVENT_TRACE
+    // print what was traced since boot once, for chrome://tracing or ui.perfetto.dev
+    if (event_trace::is_recording() && elapsed() >= CONFIG_EVENT_TRACE_DUMP_AFTER_SECONDS) {
+#if CONFIG_EVENT_TRACE_DUMP_PERFETTO
+      event_trace::print(event_trace::Format::PERFETTO);
+#else
+      event_trace::print(event_trace::Format::CHROME_JSON);
+#endif
+    }
+#endif
+    if (CONFIG_PROFILE_SWITCH_PERIOD_SECONDS > 0 &&
+        std::chrono::steady_clock::now() - last_switch >= std::chrono::seconds(CONFIG_PROFILE_SWITCH_PERIOD_SECONDS)) {
+      size_t next = (hid_service_get_active_profile() + 1) % hid_service_get_num_profiles();
+      logger.info("Switching to profile '{}'", hid_service_get_profile(next)->name);
+      hid_service_switch_profile(next);
+      last_switch = std::chrono::steady_clock::now();
+    }
   }
 }
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "hid.hpp"
+
+namespace motion {
+
+  // A motion report carries a batch of IMU samples: the first one as it is,
+  // the others as differences to the sample before them, so that one report a
+  // connection interval carries an IMU's full rate (e.g. 8 samples of 1 kHz
+  // every 7.5 ms). The differences are int8s in units of 2^shift, the batch's
+  // shift being the smallest which its largest step fits in: exact while the
+  // samples change by 127 or less, within 2^shift / 2 of them otherwise.
+
+  /// One reading of a 6-axis IMU, in its raw units
+  struct Sample {
+    int64_t timestamp_us;
+    int16_t accel[3];
+    int16_t gyro[3];
+  };
+
+  /// Timestamps are sent in ticks of this many microseconds
+  static constexpr int64_t TICK_US = 100;
+
+  /// The largest shift of a batch's deltas, which any int16 step fits in
+  static constexpr uint8_t MAX_SHIFT = 10;
+
+  /// A sample after the first one of a batch, relative to the sample before it
+  struct Delta {
+    uint8_t ticks;   // since the sample before
+    int8_t accel[3]; // in units of 2^shift
+    int8_t gyro[3];
+  } __attribute__((packed));
+
+  template <size_t SAMPLES>
+  struct InputReport {
+    uint16_t timestamp; // of the first sample, in ticks (wraps around every 6.5 s)
+    uint8_t count;      // samples in the batch, the deltas past count - 1 are 0
+    uint8_t shift;      // the deltas are in units of 2^shift ([0,MAX_SHIFT])
+    int16_t accel[3];
+    int16_t gyro[3];
+    Delta deltas[SAMPLES - 1];
+  } __attribute__((packed));
+
+  /// The report of a batch of up to SAMPLES samples. The host's HID parser
+  /// sees the first sample's acceleration and angular velocity, the deltas
+  /// are bytes for the application to decode (see decode()).
+  template <uint8_t REPORT_ID = 5, size_t SAMPLES = 8>
+  static constexpr uint8_t report_descriptor[] = {
+    hid::USAGE_PAGE_16,
+    hid::low_byte(hid::VENDOR_DEFINED),
+    hid::high_byte(hid::VENDOR_DEFINED),
+    hid::USAGE,
+    0x01, // motion batch
+    hid::START_COLLECTION,
+    hid::APPLICATION,
+    hid::REPORT_ID,
+    REPORT_ID,
+
+    // timestamp ([0,65535] ticks)
+    hid::USAGE,
+    0x02,
+    hid::LOGICAL_MINIMUM,
+    0x00,
+    hid::LOGICAL_MAXIMUM_32,
+    hid::low_byte(65535),
+    hid::high_byte(65535),
+    0x00,
+    0x00,
+    hid::REPORT_SIZE,
+    0x10,
+    hid::REPORT_COUNT,
+    0x01,
+    hid::INPUT,
+    0x02, // (Data,Var,Abs)
+    // sample count ([0,SAMPLES])
+    hid::USAGE,
+    0x03,
+    hid::LOGICAL_MINIMUM,
+    0x00,
+    hid::LOGICAL_MAXIMUM,
+    uint8_t(SAMPLES),
+    hid::REPORT_SIZE,
+    0x08,
+    hid::REPORT_COUNT,
+    0x01,
+    hid::INPUT,
+    0x02, // (Data,Var,Abs)
+    // deltas' shift ([0,MAX_SHIFT])
+    hid::USAGE,
+    0x05,
+    hid::LOGICAL_MINIMUM,
+    0x00,
+    hid::LOGICAL_MAXIMUM,
+    MAX_SHIFT,
+    hid::REPORT_SIZE,
+    0x08,
+    hid::REPORT_COUNT,
+    0x01,
+    hid::INPUT,
+    0x02, // (Data,Var,Abs)
+
+    // first sample: acceleration x / y / z ([-32768,32767])
+    hid::USAGE_PAGE,
+    hid::SENSORS,
+    hid::USAGE,
+    hid::MOTION_ACCELEROMETER_3D,
+    hid::START_COLLECTION,
+    hid::PHYSICAL,
+    hid::USAGE_16,
+    hid::low_byte(hid::ACCELERATION_AXIS_X),
+    hid::high_byte(hid::ACCELERATION_AXIS_X),
+    hid::USAGE_16,
+    hid::low_byte(hid::ACCELERATION_AXIS_Y),
+    hid::high_byte(hid::ACCELERATION_AXIS_Y),
+    hid::USAGE_16,
+    hid::low_byte(hid::ACCELERATION_AXIS_Z),
+    hid::high_byte(hid::ACCELERATION_AXIS_Z),
+    hid::LOGICAL_MINIMUM_16,
+    0x00,
+    0x80, // -32768
+    hid::LOGICAL_MAXIMUM_16,
+    0xFF,
+    0x7F, // 32767
+    hid::REPORT_SIZE,
+    0x10,
+    hid::REPORT_COUNT,
+    0x03,
+    hid::INPUT,
+    0x02, // (Data,Var,Abs)
+    hid::END_COLLECTION, // Physical
+
+    // and angular velocity x / y / z ([-32768,32767])
+    hid::USAGE,
+    hid::MOTION_GYROMETER_3D,
+    hid::START_COLLECTION,
+    hid::PHYSICAL,
+    hid::USAGE_16,
+    hid::low_byte(hid::ANGULAR_VELOCITY_X_AXIS),
+    hid::high_byte(hid::ANGULAR_VELOCITY_X_AXIS),
+    hid::USAGE_16,
+    hid::low_byte(hid::ANGULAR_VELOCITY_Y_AXIS),
+    hid::high_byte(hid::ANGULAR_VELOCITY_Y_AXIS),
+    hid::USAGE_16,
+    hid::low_byte(hid::ANGULAR_VELOCITY_Z_AXIS),
+    hid::high_byte(hid::ANGULAR_VELOCITY_Z_AXIS),
+    hid::LOGICAL_MINIMUM_16,
+    0x00,
+    0x80, // -32768
+    hid::LOGICAL_MAXIMUM_16,
+    0xFF,
+    0x7F, // 32767
+    hid::REPORT_SIZE,
+    0x10,
+    hid::REPORT_COUNT,
+    0x03,
+    hid::INPUT,
+    0x02, // (Data,Var,Abs)
+    hid::END_COLLECTION, // Physical
+
+    // the other samples' deltas (bytes [0,255])
+    hid::USAGE_PAGE_16,
+    hid::low_byte(hid::VENDOR_DEFINED),
+    hid::high_byte(hid::VENDOR_DEFINED),
+    hid::USAGE,
+    0x04,
+    hid::LOGICAL_MINIMUM,
+    0x00,
+    hid::LOGICAL_MAXIMUM_16,
+    hid::low_byte(255),
+    hid::high_byte(255),
+    hid::REPORT_SIZE,
+    0x08,
+    hid::REPORT_COUNT,
+    uint8_t(sizeof(Delta) * (SAMPLES - 1)),
+    hid::INPUT,
+    0x02, // (Data,Var,Abs)
+
+    hid::END_COLLECTION // Application
+  };
+
+  /// Packs samples into reports of up to SAMPLES samples. A batch is done
+  /// once it holds SAMPLES samples or spans the flush interval (the
+  /// connection interval, for one report per connection event), or when the
+  /// next sample came 255 ticks or more after the last, in which case that
+  /// sample starts the next batch. A batch is encoded when it is done, with
+  /// the shift of its largest step, each delta rounded from the sample to
+  /// what the host decoded before it so that the error is carried forward
+  /// rather than added up.
+  ///
+  ///   motion::Accumulator<8> accumulator;
+  ///   ...
+  ///   if (accumulator.add(sample, hid_service_get_connection_interval() * 1250)) {
+  ///     hid_service_send_input_report(5, (const uint8_t *)&accumulator.report(),
+  ///                                   sizeof(accumulator.report()));
+  ///   }
+  template <size_t SAMPLES>
+  class Accumulator {
+  public:
+    static_assert(SAMPLES >= 2 && sizeof(Delta) * (SAMPLES - 1) <= 255, "the deltas' report count is 8 bits");
+
+    /// @param flush_interval_us  0 to only send full batches
+    /// @return true if a batch is done, see report()
+    bool add(const Sample &sample, int64_t flush_interval_us) {
+      bool done = false;
+      int64_t first_us = samples_[0].timestamp_us;
+      if (count_ && (!fits(sample) || (flush_interval_us > 0 && sample.timestamp_us - first_us >= flush_interval_us))) {
+        done = finish();
+      }
+      samples_[count_++] = sample;
+      if (count_ == SAMPLES) {
+        done = finish();
+      }
+      return done;
+    }
+
+    /// Finish the batch being built, if it has samples
+    /// @return true if a batch is done, see report()
+    bool flush() { return count_ && finish(); }
+
+    /// The batch which was done last
+    const InputReport<SAMPLES> &report() const { return done_; }
+
+  protected:
+    static int64_t ticks(const Sample &sample) { return sample.timestamp_us / TICK_US; }
+
+    bool fits(const Sample &sample) const {
+      int64_t elapsed = ticks(sample) - ticks(samples_[count_ - 1]);
+      return elapsed >= 0 && elapsed <= UINT8_MAX;
+    }
+
+    /// The smallest shift a step fits in, the error carried from the step
+    /// before (at most 2^shift / 2) included
+    static uint8_t shift_for(int step) {
+      uint8_t shift = 0;
+      while (shift < MAX_SHIFT && step > (shift ? (INT8_MAX - 1) << shift : INT8_MAX)) {
+        shift++;
+      }
+      return shift;
+    }
+
+    /// The delta, in units of 2^shift, which takes the decoded value closest
+    /// to the sample's, without leaving the int16 range
+    static int8_t quantize(int16_t value, int &decoded, uint8_t shift) {
+      int half = shift ? 1 << (shift - 1) : 0;
+      int delta = std::clamp((value - decoded + half) >> shift, int(INT8_MIN), int(INT8_MAX));
+      while (decoded + delta * (1 << shift) > INT16_MAX) {
+        delta--;
+      }
+      while (decoded + delta * (1 << shift) < INT16_MIN) {
+        delta++;
+      }
+      decoded += delta * (1 << shift);
+      return int8_t(delta);
+    }
+
+    bool finish() {
+      int largest = 0;
+      for (size_t i = 1; i < count_; i++) {
+        for (size_t axis = 0; axis < 3; axis++) {
+          largest = std::max({largest, std::abs(samples_[i].accel[axis] - samples_[i - 1].accel[axis]),
+                              std::abs(samples_[i].gyro[axis] - samples_[i - 1].gyro[axis])});
+        }
+      }
+      done_ = {};
+      done_.timestamp = uint16_t(ticks(samples_[0]));
+      done_.count = uint8_t(count_);
+      done_.shift = shift_for(largest);
+      int accel[3], gyro[3]; // as the host decodes them
+      for (size_t axis = 0; axis < 3; axis++) {
+        done_.accel[axis] = accel[axis] = samples_[0].accel[axis];
+        done_.gyro[axis] = gyro[axis] = samples_[0].gyro[axis];
+      }
+      for (size_t i = 1; i < count_; i++) {
+        Delta delta{.ticks = uint8_t(ticks(samples_[i]) - ticks(samples_[i - 1]))};
+        for (size_t axis = 0; axis < 3; axis++) {
+          delta.accel[axis] = quantize(samples_[i].accel[axis], accel[axis], done_.shift);
+          delta.gyro[axis] = quantize(samples_[i].gyro[axis], gyro[axis], done_.shift);
+        }
+        memcpy(&done_.deltas[i - 1], &delta, sizeof(delta));
+      }
+      count_ = 0;
+      return true;
+    }
+
+    std::array<Sample, SAMPLES> samples_{};
+    size_t count_{0};
+    InputReport<SAMPLES> done_{};
+  };
+
+  /// The samples of a report, their timestamps in microseconds from its
+  /// first sample's (wrapping) tick count
+  /// @return The number of samples
+  template <size_t SAMPLES>
+  static size_t decode(const InputReport<SAMPLES> &report, std::array<Sample, SAMPLES> &samples) {
+    size_t count = std::min<size_t>(report.count, SAMPLES);
+    uint8_t shift = std::min(report.shift, MAX_SHIFT);
+    Sample sample{.timestamp_us = int64_t(report.timestamp) * TICK_US};
+    for (size_t axis = 0; axis < 3; axis++) {
+      sample.accel[axis] = report.accel[axis];
+      sample.gyro[axis] = report.gyro[axis];
+    }
+    for (size_t i = 0; i < count; i++) {
+      if (i > 0) {
+        Delta delta;
+        memcpy(&delta, &report.deltas[i - 1], sizeof(delta));
+        sample.timestamp_us += delta.ticks * TICK_US;
+        for (size_t axis = 0; axis < 3; axis++) {
+          sample.accel[axis] = int16_t(sample.accel[axis] + delta.accel[axis] * (1 << shift));
+          sample.gyro[axis] = int16_t(sample.gyro[axis] + delta.gyro[axis] * (1 << shift));
+        }
+      }
+      samples[i] = sample;
+    }
+    return count;
+  }
+
+} // namespace motion
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "hid.hpp"
+
+namespace mouse {
+
+  struct InputReport {
+    uint8_t btn_left : 1;
+    uint8_t btn_right : 1;
+    uint8_t btn_middle : 1;
+  uint8_t : 5; // unused bits
+    int8_t x;
+    int8_t y;
+    int8_t wheel;
+  } __attribute__((packed));
+
+  template <uint8_t REPORT_ID = 1>
+  static constexpr uint8_t report_descriptor[] = {
+    hid::USAGE_PAGE,
+    hid::GENERIC_DESKTOP,
+    hid::USAGE,
+    hid::MOUSE,
+    hid::START_COLLECTION,
+    hid::APPLICATION,
+    hid::REPORT_ID,
+    REPORT_ID,
+    hid::USAGE,
+    hid::POINTER,
+    hid::START_COLLECTION,
+    hid::PHYSICAL,
+
+    // buttons (3)
+    hid::USAGE_PAGE,
+    hid::BUTTON,
+    hid::USAGE_MINIMUM,
+    hid::BUTTON_1,
+    hid::USAGE_MAXIMUM,
+    hid::BUTTON_3,
+    hid::LOGICAL_MINIMUM,
+    0x00,
+    hid::LOGICAL_MAXIMUM,
+    0x01,
+    hid::REPORT_SIZE,
+    0x01,
+    hid::REPORT_COUNT,
+    0x03,
+    hid::INPUT,
+    0x02, // (Data,Var,Abs)
+    // padding for buttons
+    hid::REPORT_SIZE,
+    0x05,
+    hid::REPORT_COUNT,
+    0x01,
+    hid::INPUT,
+    0x03, // constant
+
+    // x / y / wheel ([-127, 127], relative)
+    hid::USAGE_PAGE,
+    hid::GENERIC_DESKTOP,
+    hid::USAGE,
+    hid::AXIS_X,
+    hid::USAGE,
+    hid::AXIS_Y,
+    hid::USAGE,
+    hid::WHEEL,
+    hid::LOGICAL_MINIMUM,
+    0x81, // -127
+    hid::LOGICAL_MAXIMUM,
+    0x7F, // 127
+    hid::REPORT_SIZE,
+    0x08,
+    hid::REPORT_COUNT,
+    0x03,
+    hid::INPUT,
+    0x06, // (Data,Var,Rel)
+
+    hid::END_COLLECTION, // Physical
+    hid::END_COLLECTION  // Application
+  };
+
+} // namespace mouse
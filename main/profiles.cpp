@@ -0,0 +1,147 @@
+#include "profiles.hpp"
+
+#include "deferred_log.hpp"
+#include "hid_report_descriptor.hpp"
+
+#include "consumer.hpp"
+#include "keyboard.hpp"
+#include "motion.hpp"
+#include "mouse.hpp"
+#include "xbox.hpp"
+
+// the callbacks run on the BTC task, so they log deferred
+static deferred_log::Logger dlogger({.tag = "Profiles", .level = espp::Logger::Verbosity::INFO});
+
+// Espressif's USB vendor ID, with product IDs for development use only.
+// Replace these with your own before shipping.
+static constexpr uint16_t DEV_VENDOR_ID = 0x303A;
+static constexpr uint16_t DEV_PRODUCT_ID_KEYBOARD = 0x8101;
+static constexpr uint16_t DEV_PRODUCT_ID_MOUSE = 0x8102;
+static constexpr uint16_t DEV_PRODUCT_ID_CONSUMER = 0x8103;
+static constexpr uint16_t DEV_PRODUCT_ID_COMPOSITE = 0x8104;
+
+// every report map is minimized at compile time, and its input reports are
+// extracted so each one gets its own HID Report characteristic
+static constexpr auto gamepad_descriptor = hid::descriptor::minimize(xb::report_descriptor);
+static_assert(hid::descriptor::same_layout(xb::report_descriptor, gamepad_descriptor.bytes()),
+              "minimized report descriptor must describe the same reports");
+static constexpr auto gamepad_reports = hid::descriptor::report_ids<HID_MAX_INPUT_REPORTS>(gamepad_descriptor.bytes());
+// the battery strength report, which hid_service feeds with the battery level
+static constexpr int gamepad_battery_report = hid::descriptor::report_id_of(
+  gamepad_descriptor.bytes(), uint32_t(hid::GENERIC_DEVICE_CONTROLS) << 16 | hid::BATTERY_STRENGTH);
+static_assert(gamepad_battery_report == 4, "the gamepad reports its battery strength");
+static_assert(gamepad_reports.ids[0] == GAMEPAD_REPORT_ID && gamepad_reports.bytes[0] == sizeof(xb::InputReport),
+              "the gamepad report is as long as its descriptor says");
+
+// the gamepad and its motion batch report, in a vendor collection of its own
+static constexpr auto gamepad_motion_report_descriptor =
+  hid::concat(xb::report_descriptor, motion::report_descriptor<GAMEPAD_MOTION_REPORT_ID, GAMEPAD_MOTION_SAMPLES>);
+static constexpr auto gamepad_motion_descriptor = hid::descriptor::minimize(gamepad_motion_report_descriptor);
+static_assert(hid::descriptor::same_layout(gamepad_motion_report_descriptor, gamepad_motion_descriptor.bytes()),
+              "minimized report descriptor must describe the same reports");
+static constexpr auto gamepad_motion_reports =
+  hid::descriptor::report_ids<HID_MAX_INPUT_REPORTS>(gamepad_motion_descriptor.bytes());
+static_assert(gamepad_motion_reports.bytes[2] == sizeof(motion::InputReport<GAMEPAD_MOTION_SAMPLES>),
+              "the motion report is as long as its descriptor says");
+
+static constexpr auto keyboard_descriptor = hid::descriptor::minimize(kb::report_descriptor<1>);
+static_assert(hid::descriptor::same_layout(kb::report_descriptor<1>, keyboard_descriptor.bytes()),
+              "minimized report descriptor must describe the same reports");
+static constexpr auto keyboard_reports = hid::descriptor::report_ids<HID_MAX_INPUT_REPORTS>(keyboard_descriptor.bytes());
+
+static constexpr auto mouse_descriptor = hid::descriptor::minimize(mouse::report_descriptor<1>);
+static_assert(hid::descriptor::same_layout(mouse::report_descriptor<1>, mouse_descriptor.bytes()),
+              "minimized report descriptor must describe the same reports");
+static constexpr auto mouse_reports = hid::descriptor::report_ids<HID_MAX_INPUT_REPORTS>(mouse_descriptor.bytes());
+
+static constexpr auto consumer_descriptor = hid::descriptor::minimize(cc::report_descriptor<1>);
+static_assert(hid::descriptor::same_layout(cc::report_descriptor<1>, consumer_descriptor.bytes()),
+              "minimized report descriptor must describe the same reports");
+static constexpr auto consumer_reports = hid::descriptor::report_ids<HID_MAX_INPUT_REPORTS>(consumer_descriptor.bytes());
+
+// keyboard (report 1) + mouse (report 2) + consumer control (report 3)
+static constexpr auto composite_report_descriptor =
+  hid::concat(kb::report_descriptor<1>, mouse::report_descriptor<2>, cc::report_descriptor<3>);
+static constexpr auto composite_descriptor = hid::descriptor::minimize(composite_report_descriptor);
+static_assert(hid::descriptor::same_layout(composite_report_descriptor, composite_descriptor.bytes()),
+              "minimized report descriptor must describe the same reports");
+static constexpr auto composite_reports = hid::descriptor::report_ids<HID_MAX_INPUT_REPORTS>(composite_descriptor.bytes());
+
+template <size_t N>
+static DeviceProfile make_profile(std::string_view name,
+                                  const hid::descriptor::MinimizedDescriptor<N> &descriptor,
+                                  const hid::descriptor::ReportIds<HID_MAX_INPUT_REPORTS> &reports,
+                                  uint16_t vendor_id, uint16_t product_id, uint16_t appearance,
+                                  int battery_report_id = -1) {
+  DeviceProfile profile;
+  profile.name = name;
+  profile.report_descriptor = descriptor.data.data();
+  profile.report_descriptor_len = descriptor.size;
+  profile.vendor_id = vendor_id;
+  profile.product_id = product_id;
+  profile.product_version = CONFIG_PRODUCT_VERSION;
+  profile.appearance = appearance;
+  std::copy(reports.ids.begin(), reports.ids.begin() + reports.count, profile.input_report_ids);
+  std::copy(reports.bytes.begin(), reports.bytes.begin() + reports.count, profile.input_report_sizes);
+  profile.num_input_reports = reports.count;
+  profile.battery_report_id = battery_report_id;
+  // the names are literals, so they outlive the deferred log records
+  profile.on_activate = [](const DeviceProfile &profile) {
+    DLOG_INFO(dlogger, "Profile '{}' active ({} byte report map, {} input reports)",
+              profile.name.data(), profile.report_descriptor_len, profile.num_input_reports);
+  };
+  profile.on_report_subscription = [name](uint8_t report_id, bool enabled) {
+    DLOG_INFO(dlogger, "Profile '{}': notifications for report {} {}", name.data(), report_id,
+              enabled ? "enabled" : "disabled");
+  };
+  return profile;
+}
+
+bool has_input_report(const DeviceProfile &profile, uint8_t report_id, size_t size) {
+  for (size_t i = 0; i < profile.num_input_reports; i++) {
+    if (profile.input_report_ids[i] == report_id && profile.input_report_sizes[i] == size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int register_device_profiles() {
+  int gamepad = hid_service_register_profile(
+    make_profile("gamepad", gamepad_descriptor, gamepad_reports,
+                 CONFIG_VENDOR_ID, CONFIG_PRODUCT_ID, ESP_BLE_APPEARANCE_HID_GAMEPAD, gamepad_battery_report));
+  int gamepad_motion = hid_service_register_profile(
+    make_profile("gamepad-motion", gamepad_motion_descriptor, gamepad_motion_reports,
+                 CONFIG_VENDOR_ID, CONFIG_PRODUCT_ID, ESP_BLE_APPEARANCE_HID_GAMEPAD, gamepad_battery_report));
+  int keyboard = hid_service_register_profile(
+    make_profile("keyboard", keyboard_descriptor, keyboard_reports,
+                 DEV_VENDOR_ID, DEV_PRODUCT_ID_KEYBOARD, ESP_BLE_APPEARANCE_HID_KEYBOARD));
+  int mouse = hid_service_register_profile(
+    make_profile("mouse", mouse_descriptor, mouse_reports,
+                 DEV_VENDOR_ID, DEV_PRODUCT_ID_MOUSE, ESP_BLE_APPEARANCE_HID_MOUSE));
+  int consumer = hid_service_register_profile(
+    make_profile("consumer-control", consumer_descriptor, consumer_reports,
+                 DEV_VENDOR_ID, DEV_PRODUCT_ID_CONSUMER, ESP_BLE_APPEARANCE_GENERIC_HID));
+  int composite = hid_service_register_profile(
+    make_profile("keyboard-mouse-consumer", composite_descriptor, composite_reports,
+                 DEV_VENDOR_ID, DEV_PRODUCT_ID_COMPOSITE, ESP_BLE_APPEARANCE_GENERIC_HID));
+
+#if CONFIG_DEVICE_PROFILE_GAMEPAD_MOTION
+  return gamepad_motion;
+#elif CONFIG_DEVICE_PROFILE_KEYBOARD
+  return keyboard;
+#elif CONFIG_DEVICE_PROFILE_MOUSE
+  return mouse;
+#elif CONFIG_DEVICE_PROFILE_CONSUMER
+  return consumer;
+#elif CONFIG_DEVICE_PROFILE_COMPOSITE
+  return composite;
+#else
+  (void)gamepad_motion;
+  (void)keyboard;
+  (void)mouse;
+  (void)consumer;
+  (void)composite;
+  return gamepad;
+#endif
+}
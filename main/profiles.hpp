@@ -0,0 +1,21 @@
+#pragma once
+
+#include "hid_service.hpp"
+
+/// The gamepad's input report (an xb::InputReport), in the gamepad and
+/// gamepad-motion profiles
+static constexpr uint8_t GAMEPAD_REPORT_ID = 1;
+
+/// The motion report of the gamepad-motion profile: batches of this many IMU
+/// samples (see motion.hpp)
+static constexpr uint8_t GAMEPAD_MOTION_REPORT_ID = 5;
+static constexpr size_t GAMEPAD_MOTION_SAMPLES = 8;
+
+/// Whether the profile has an input report with the ID and size, e.g. to
+/// send the gamepad's reports with whichever profile has them
+bool has_input_report(const DeviceProfile &profile, uint8_t report_id, size_t size);
+
+/// Register the gamepad, gamepad with motion, keyboard, mouse, consumer
+/// control and composite profiles with the hid service.
+/// @return The index of the default profile (see CONFIG_DEVICE_PROFILE_*)
+int register_device_profiles();
@@ -0,0 +1,274 @@
+#include "report_bench.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <numeric>
+
+#include "digital_input.hpp"
+#include "hid_service.hpp"
+#include "input_conditioning.hpp"
+
+#include "gamepad_input.hpp"
+#include "xbox.hpp"
+
+#if defined(ESP_PLATFORM)
+#include <esp_cpu.h>
+
+static const char *platform = CONFIG_IDF_TARGET;
+// the CPU's cycle counter, read in a few cycles
+static inline uint32_t ticks() { return esp_cpu_get_cycle_count(); }
+static uint32_t ticks_to_ns(uint64_t ticks) { return ticks * 1000 / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ; }
+#else
+static const char *platform = "host";
+static inline uint32_t ticks() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+static uint32_t ticks_to_ns(uint64_t ticks) { return ticks; }
+#endif
+
+// keep the compiler from optimizing away what is being measured
+template <typename T> static inline void keep(const T &value) { asm volatile("" : : "r"(&value) : "memory"); }
+
+static constexpr std::array<std::pair<espp::Logger::Verbosity, const char *>, 5> log_levels = {{
+    {espp::Logger::Verbosity::DEBUG, "debug"},
+    {espp::Logger::Verbosity::INFO, "info"},
+    {espp::Logger::Verbosity::WARN, "warn"},
+    {espp::Logger::Verbosity::ERROR, "error"},
+    {espp::Logger::Verbosity::NONE, "none"},
+}};
+
+static espp::Logger logger({.tag = "report_bench", .level = espp::Logger::Verbosity::INFO});
+
+// the same message through the deferred log, which only stores a record
+static deferred_log::Logger deferred_logger({.tag = "HID BLE", .level = espp::Logger::Verbosity::DEBUG});
+
+class Stage {
+public:
+  Stage(const BenchmarkConfig &config, uint32_t overhead) : config_(config), overhead_(overhead) {}
+
+  /// Time f() on its own, iterations times, calling settle (not timed) every
+  /// batch_size iterations and at the end, e.g. for the stack to send the
+  /// queued reports
+  template <typename F>
+  BenchmarkResult run(std::string name, std::string variant, size_t iterations, const std::function<void()> &settle,
+                      F &&f) {
+    samples_.resize(iterations);
+    for (size_t i = 0; i < iterations; i++) {
+      if (settle && i % config_.batch_size == 0) {
+        settle();
+      }
+      uint32_t start = ticks();
+      f(i);
+      uint32_t elapsed = ticks() - start;
+      samples_[i] = elapsed > overhead_ ? elapsed - overhead_ : 0;
+    }
+    if (settle) {
+      settle();
+    }
+    std::sort(samples_.begin(), samples_.end());
+    uint64_t total = std::accumulate(samples_.begin(), samples_.end(), uint64_t{0});
+    BenchmarkResult result{
+        .name = std::move(name),
+        .variant = std::move(variant),
+        .iterations = iterations,
+        .min_ns = ticks_to_ns(samples_.front()),
+        .median_ns = ticks_to_ns(samples_[iterations / 2]),
+        .p99_ns = ticks_to_ns(samples_[iterations * 99 / 100]),
+        .max_ns = ticks_to_ns(samples_.back()),
+        .mean_ns = ticks_to_ns(total / iterations),
+    };
+    if (config_.on_result) {
+      config_.on_result(result);
+    }
+    return result;
+  }
+
+  /// The cost of reading the clock twice, subtracted from every sample
+  static uint32_t calibrate() {
+    std::array<uint32_t, 255> samples;
+    for (auto &sample : samples) {
+      uint32_t start = ticks();
+      sample = ticks() - start;
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+  }
+
+protected:
+  const BenchmarkConfig &config_;
+  uint32_t overhead_;
+  std::vector<uint32_t> samples_;
+};
+
+size_t compare_conditioning_kernels(size_t frames) {
+  auto scalar_config = gamepad_input::config(input_conditioning::Filter::IIR);
+  scalar_config.kernels = input_conditioning::Kernels::SCALAR;
+  auto pie_config = scalar_config;
+  pie_config.kernels = input_conditioning::Kernels::PIE;
+  input_conditioning::Pipeline scalar(scalar_config), pie(pie_config);
+  if (pie.kernels() != input_conditioning::Kernels::PIE) {
+    return 0; // not built in
+  }
+  std::array<int16_t, gamepad_input::NUM_AXES> raw{}, scalar_out{}, pie_out{};
+  uint32_t state = 0x1812;
+  size_t mismatches = 0;
+  for (size_t i = 0; i < frames; i++) {
+    for (auto &value : raw) {
+      // xorshift, over the full range and 512 past either end
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      value = int16_t(int32_t(state % (gamepad_input::STICK_MAX + 1025)) - 512);
+    }
+    // and every so often held at either end, for the filters to settle there
+    if (i / 64 % 4 == 1) {
+      raw.fill(i % 2 ? -512 : gamepad_input::STICK_MAX + 512);
+    }
+    scalar.process(raw.data(), scalar_out.data(), i * 1000);
+    pie.process(raw.data(), pie_out.data(), i * 1000);
+    if (scalar_out != pie_out) {
+      if (!mismatches) {
+        logger.error("The PIE kernels conditioned frame {} as {}, the scalar ones as {}", i, pie_out, scalar_out);
+      }
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+std::vector<BenchmarkResult> run_report_path_benchmarks(const BenchmarkConfig &config) {
+  std::vector<BenchmarkResult> results;
+  // timing kernels which condition differently would be meaningless
+  if (size_t mismatches = compare_conditioning_kernels(config.iterations)) {
+    logger.error("The PIE and scalar conditioning kernels differ on {} of {} frames", mismatches, config.iterations);
+    return results;
+  }
+  Stage stage(config, Stage::calibrate());
+  auto restore_log_level = hid_service_get_log_level();
+
+  // conditioning a frame of the gamepad's analog inputs (one-euro filtered,
+  // so every stage is scalar but the calibration), then with the IIR filter
+  // on each kernel there is
+  std::array<int16_t, gamepad_input::NUM_AXES> raw{}, conditioned{};
+  auto condition = [&](input_conditioning::Pipeline &pipeline) {
+    return [&, pipeline = &pipeline](size_t i) {
+      for (size_t axis = 0; axis < raw.size(); axis++) {
+        raw[axis] = (i * (axis + 7) * 13) & gamepad_input::STICK_MAX;
+      }
+      pipeline->process(raw.data(), conditioned.data(), i * 1000);
+      keep(conditioned);
+    };
+  };
+  {
+    input_conditioning::Pipeline pipeline(gamepad_input::config(input_conditioning::Filter::ONE_EURO));
+    results.push_back(stage.run("condition_inputs", "one_euro", config.iterations, nullptr, condition(pipeline)));
+  }
+  for (auto [kernels, kernels_name] : {std::pair{input_conditioning::Kernels::SCALAR, "iir_scalar"},
+                                       std::pair{input_conditioning::Kernels::PIE, "iir_pie"}}) {
+    auto pipeline_config = gamepad_input::config(input_conditioning::Filter::IIR);
+    pipeline_config.kernels = kernels;
+    input_conditioning::Pipeline pipeline(pipeline_config);
+    if (pipeline.kernels() != kernels) {
+      continue; // not built in
+    }
+    results.push_back(stage.run("condition_inputs", kernels_name, config.iterations, nullptr, condition(pipeline)));
+  }
+
+  // debouncing a sample of all the buttons and mapping the debounced ones to
+  // the report's buttons
+  digital_input::Debouncer debouncer;
+  results.push_back(stage.run("debounce_buttons", "", config.iterations, nullptr, [&](size_t i) {
+    uint32_t changed = debouncer.update((i >> 2) * 0x9e3779b9u);
+    uint32_t buttons = gamepad_input::button_map.apply(debouncer.state());
+    keep(changed);
+    keep(buttons);
+  }));
+
+  // building a report from the inputs
+  xb::InputReport report{};
+  results.push_back(stage.run("build_report", "xb::InputReport", config.iterations, nullptr, [&](size_t i) {
+    report.axis_x = i * 7;
+    report.axis_y = i * 11;
+    report.axis_z = i * 13;
+    report.axis_rz = i * 17;
+    report.brake = i;
+    report.accelerator = i >> 1;
+    report.hat = i & 0x0f;
+    report.btn_1 = i & 1;
+    report.btn_2 = (i >> 1) & 1;
+    report.btn_4 = (i >> 2) & 1;
+    report.btn_5 = (i >> 3) & 1;
+    report.home = (i >> 4) & 1;
+    keep(report);
+  }));
+
+  // the log call at the top of hid_service_send_input_report(), at each
+  // verbosity the logger can be configured with
+  for (auto [level, level_name] : log_levels) {
+    espp::Logger logger({.tag = "HID BLE", .level = level});
+    bool enabled = level <= espp::Logger::Verbosity::INFO;
+    results.push_back(stage.run("log_info", level_name, enabled ? config.logging_iterations : config.iterations,
+                                nullptr, [&](size_t) {
+                                  logger.info("Sending input report {} of length {}", 1, sizeof(report));
+                                }));
+  }
+
+  for (auto [level, level_name] : log_levels) {
+    deferred_logger.set_verbosity(level);
+    // printed every batch, so the ring never fills
+    results.push_back(stage.run("deferred_log_info", level_name, config.iterations, deferred_log::flush, [&](size_t) {
+      DLOG_INFO(deferred_logger, "Sending input report {} of length {}", 1, sizeof(report));
+    }));
+  }
+
+  results.push_back(stage.run("is_connected", "", config.iterations, nullptr, [&](size_t) {
+    bool connected = hid_service_is_connected();
+    keep(connected);
+  }));
+
+  // the rest needs someone to send to
+  esp_gatt_if_t gatts_if;
+  uint16_t conn_id, attr_handle;
+  const auto &table = hid_service_default_device().table();
+  uint8_t report_id = table.input_report_id(0);
+  if (!hid_service_get_input_report_handle(report_id, gatts_if, conn_id, attr_handle)) {
+    return results;
+  }
+  std::vector<uint8_t> data(table.input_report_size(0));
+  std::copy_n(reinterpret_cast<const uint8_t *>(&report), std::min(data.size(), sizeof(report)), data.begin());
+
+  // the stack sends what was queued and the deferred log is printed between
+  // batches, so neither fills up
+  std::function<void()> settle = [&] {
+    if (config.drain) {
+      config.drain();
+    }
+    deferred_log::flush();
+  };
+
+  // the stack queueing the notification for the BTC task
+  results.push_back(stage.run("send_indicate", "", config.iterations, settle, [&](size_t i) {
+    data[0] = i;
+    esp_ble_gatts_send_indicate(gatts_if, conn_id, attr_handle, data.size(), data.data(), false);
+  }));
+
+  // and everything together, at each verbosity of the hid service's logger
+  for (auto [level, level_name] : log_levels) {
+    hid_service_set_log_level(level);
+    results.push_back(stage.run("send_input_report", level_name, config.iterations, settle, [&](size_t i) {
+      data[0] = i;
+      hid_service_send_input_report(report_id, data.data(), data.size());
+    }));
+  }
+  hid_service_set_log_level(restore_log_level);
+  return results;
+}
+
+std::string benchmark_result_json(const BenchmarkResult &result) {
+  return fmt::format("{{\"benchmark\":\"{}\",\"variant\":\"{}\",\"platform\":\"{}\",\"iterations\":{},"
+                     "\"min_ns\":{},\"median_ns\":{},\"p99_ns\":{},\"max_ns\":{},\"mean_ns\":{}}}",
+                     result.name, result.variant, platform, result.iterations, result.min_ns, result.median_ns,
+                     result.p99_ns, result.max_ns, result.mean_ns);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/// Timings of one stage of the input report path, in nanoseconds (measured in
+/// CPU cycles on target, with the steady clock on the host), with the cost of
+/// reading the clock subtracted.
+struct BenchmarkResult {
+  std::string name;    ///< stage, e.g. "send_input_report"
+  std::string variant; ///< e.g. the log level it ran at, may be empty
+  size_t iterations{0};
+  uint32_t min_ns{0};
+  uint32_t median_ns{0};
+  uint32_t p99_ns{0};
+  uint32_t max_ns{0};
+  uint32_t mean_ns{0};
+};
+
+struct BenchmarkConfig {
+  size_t iterations{1000};
+  /// iterations of the espp::Logger stages which log at an enabled level,
+  /// since on target each of those waits for the UART
+  size_t logging_iterations{100};
+  /// reports sent between calls to drain, so the stack's queue never fills
+  size_t batch_size{8};
+  /// let the stack send what has been queued, not timed
+  std::function<void()> drain{nullptr};
+  /// called with each result as soon as it is measured
+  std::function<void(const BenchmarkResult &)> on_result{nullptr};
+};
+
+/// Measure the stages of hid_service_send_input_report() one at a time:
+/// conditioning the gamepad's analog inputs (per filter and kernels, see
+/// gamepad_input.hpp), debouncing its buttons, building an xb::InputReport, the hid service's log call at each
+/// verbosity (with espp::Logger and with the deferred log), the connected
+/// check, the stack's send (queueing) call on its own, and the whole send at
+/// each verbosity. The stages which send need a subscribed connection and are
+/// skipped without one. The hid service's log level is restored afterwards.
+/// Nothing is measured (no results) if the conditioning kernels disagree,
+/// see compare_conditioning_kernels().
+std::vector<BenchmarkResult> run_report_path_benchmarks(const BenchmarkConfig &config);
+
+/// Run frames of raw inputs (the full range and past it) through the
+/// gamepad's IIR filtered conditioning on the scalar and on the PIE kernels,
+/// which must condition them the same
+/// @return The number of frames they conditioned differently, 0 if the PIE
+///         kernels are not built in
+size_t compare_conditioning_kernels(size_t frames);
+
+/// The result as a single line of JSON, e.g.
+/// {"benchmark":"send_input_report","variant":"none","platform":"esp32","iterations":1000,...}
+std::string benchmark_result_json(const BenchmarkResult &result);
@@ -0,0 +1,33 @@
+# Lean build: the HID function (the services, the device profiles, the
+# profile bundle partition) without the name tables, verbose logging, demo
+# code and the debugging features. Applied on top of sdkconfig.defaults:
+#
+#   idf.py -B build-lean -D SDKCONFIG=build-lean/sdkconfig \
+#     -D SDKCONFIG_DEFAULTS="sdkconfig.defaults;sdkconfig.lean" build
+#
+# and compared with the default build by tools/footprint.py --diff.
+
+# optimize for size, and drop the assertion messages
+CONFIG_COMPILER_OPTIMIZATION_SIZE=y
+CONFIG_COMPILER_OPTIMIZATION_ASSERTIONS_SILENT=y
+CONFIG_NEWLIB_NANO_FORMAT=y
+
+# warnings and errors only, the stack's debug logs compiled out
+CONFIG_LOG_DEFAULT_LEVEL_WARN=y
+CONFIG_LOG_MAXIMUM_LEVEL_WARN=y
+CONFIG_BT_STACK_NO_LOG=y
+CONFIG_DEFERRED_LOG_MIN_LEVEL=2
+CONFIG_DEFERRED_LOG_RING_SIZE=16
+
+# a HID device is a GATT server only
+CONFIG_BT_GATTC_ENABLE=n
+
+# no event names, demo reports or debugging features
+CONFIG_HID_SERVICE_EVENT_NAMES=n
+CONFIG_DEMO_INPUT_REPORTS=n
+CONFIG_REPORT_BENCHMARK=n
+CONFIG_EVENT_TRACE=n
+CONFIG_BTSNOOP_CAPTURE=n
+CONFIG_DIAGNOSTICS_SERVICE=n
+CONFIG_TELEMETRY_SERVICE=n
+CONFIG_ALLOC_AUDIT=n
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Send input reports to the input bridge over a serial port.
+
+The bridge (components/input_bridge, enabled with CONFIG_INPUT_BRIDGE) reads
+frames from a UART and sends their reports to the host. This sends reports
+with hex payloads as they are, or counts byte 0 of one report up, at a rate:
+
+    python tools/bridge_send.py /dev/ttyUSB0 --report 1 --hex 00000080008000800080000000000000
+    python tools/bridge_send.py /dev/ttyUSB0 --report 1 --size 16 --count 1000 --rate 1000
+
+A frame is the sync bytes a5 5a, the report ID, the payload's length, a
+16-bit sequence number, the payload and the CRC-16/CCITT-FALSE of everything
+but the sync bytes, the numbers little endian (see input_bridge.hpp).
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+SYNC = b'\xa5\x5a'
+MAX_PAYLOAD_LEN = 64
+
+
+def crc16(data, crc=0xffff):
+    """CRC-16/CCITT-FALSE, as input_bridge::crc16()"""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xffff
+    return crc
+
+
+def encode(report_id, sequence, payload):
+    if len(payload) > MAX_PAYLOAD_LEN:
+        raise ValueError('a report is at most {} bytes'.format(MAX_PAYLOAD_LEN))
+    body = struct.pack('<BBH', report_id, len(payload), sequence & 0xffff) + payload
+    return SYNC + body + struct.pack('<H', crc16(body))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('port', help='the serial port wired to the bridge UART, e.g. /dev/ttyUSB0')
+    parser.add_argument('--baud', type=int, default=921600, help='CONFIG_INPUT_BRIDGE_BAUD_RATE')
+    parser.add_argument('--report', type=int, default=1, help='the report ID')
+    parser.add_argument('--hex', action='append', default=[], help='a report to send, in hex (repeatable)')
+    parser.add_argument('--size', type=int, default=16, help='the report size, without --hex')
+    parser.add_argument('--count', type=int, default=1, help='reports to send, without --hex')
+    parser.add_argument('--rate', type=float, default=0, help='reports per second, 0 for as fast as possible')
+    args = parser.parse_args()
+
+    try:
+        import serial
+    except ImportError:
+        sys.exit('error: pyserial is needed, pip install pyserial')
+
+    if args.hex:
+        reports = [bytes.fromhex(report) for report in args.hex]
+    else:
+        reports = [bytes([i & 0xff]) + bytes(args.size - 1) for i in range(args.count)]
+    with serial.Serial(args.port, args.baud) as port:
+        start = time.monotonic()
+        for sequence, report in enumerate(reports):
+            if args.rate:
+                delay = start + sequence / args.rate - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+            port.write(encode(args.report, sequence, report))
+        port.flush()
+    print('sent {} reports of report {}'.format(len(reports), args.report))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""Static RAM and flash of each component, from the app's linker map.
+
+Run by the `footprint` target of the project:
+
+    idf.py build
+    cmake --build build --target footprint
+
+or directly, to add the heap the example reports at boot (the
+{"footprint":...} lines, see main/footprint.hpp) or to compare two builds:
+
+    idf.py monitor | tee monitor.log
+    python tools/footprint.py build/esp_hid_service_table.map --heap monitor.log
+    python tools/footprint.py build-lean/esp_hid_service_table.map --diff build/footprint.json
+
+A component is the archive an input section comes from (libhid_service.a is
+hid_service, libstdc++.a is stdc++), objects linked on their own are
+"(objects)". Static RAM is IRAM + DRAM .data + .bss, flash is the code,
+the read-only data and the initial values of IRAM and .data.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+# input section lines: " .text.foo  0x400d0cfc  0x8c  path/libfoo.a(foo.cpp.obj)",
+# the name is on a line of its own when it is long
+INPUT_SECTION = re.compile(r'^ (\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$')
+SECTION_NAME = re.compile(r'^ (\S+)$')
+OUTPUT_SECTION = re.compile(r'^(\.\S+)')
+ARCHIVE = re.compile(r'([^/\\]+)\.a\((.+)\)$')
+
+KINDS = ['code', 'rodata', 'iram', 'data', 'bss']
+
+
+def kind_of(output_section):
+    """What an output section's bytes are, None for the ones which take no memory"""
+    name = output_section.lower()
+    if 'dummy' in name or 'noload' in name or name.startswith('.debug') or name.startswith('.comment'):
+        return None
+    if name.startswith('.iram'):
+        return 'iram'
+    if name.startswith('.dram0.bss') or name.startswith('.dram0.noinit') or name in ('.bss', '.noinit'):
+        return 'bss'
+    if name.startswith('.dram0.data') or name == '.data':
+        return 'data'
+    if name.startswith('.flash.text') or name.startswith('.flash_text') or name == '.text':
+        return 'code'
+    if name.startswith('.flash.rodata') or name.startswith('.flash.appdesc') or name == '.rodata':
+        return 'rodata'
+    return None
+
+
+def component_of(path):
+    match = ARCHIVE.search(path)
+    if not match:
+        return '(objects)'
+    name = match.group(1)
+    return name[3:] if name.startswith('lib') else name
+
+
+def parse_map(path):
+    components = {}
+    with open(path, errors='replace') as file:
+        lines = iter(file)
+        for line in lines:
+            if line.startswith('Linker script and memory map'):
+                break
+        kind = None
+        pending_name = None
+        for line in lines:
+            line = line.rstrip('\n')
+            output = OUTPUT_SECTION.match(line)
+            if output:
+                kind = kind_of(output.group(1))
+                pending_name = None
+                continue
+            if kind is None:
+                continue
+            section = INPUT_SECTION.match(line)
+            if section:
+                name = section.group(1) or pending_name
+                pending_name = None
+                size = int(section.group(3), 16)
+                if not size or name is None or name == '*fill*':
+                    continue
+                sizes = components.setdefault(component_of(section.group(4)), dict.fromkeys(KINDS, 0))
+                sizes[kind] += size
+                continue
+            name = SECTION_NAME.match(line)
+            pending_name = name.group(1) if name and not line.startswith(' *') else None
+    return components
+
+
+def static_ram(sizes):
+    return sizes['iram'] + sizes['data'] + sizes['bss']
+
+
+def flash(sizes):
+    return sizes['code'] + sizes['rodata'] + sizes['iram'] + sizes['data']
+
+
+def print_table(components, base=None):
+    header = ['component', 'code', 'rodata', 'iram', 'data', 'bss', 'static ram', 'flash']
+    print('{:<32}'.format(header[0]) + ''.join('{:>11}'.format(h) for h in header[1:]))
+    rows = []
+    for name in set(components) | set(base or {}):
+        sizes = components.get(name, dict.fromkeys(KINDS, 0))
+        values = [sizes[k] for k in KINDS] + [static_ram(sizes), flash(sizes)]
+        if base is not None:
+            old = base.get(name, dict.fromkeys(KINDS, 0))
+            values = [v - o for v, o in zip(values, [old[k] for k in KINDS] + [static_ram(old), flash(old)])]
+            if not any(values):
+                continue
+        rows.append((name, values))
+    rows.sort(key=lambda row: (-abs(row[1][-1]), -abs(row[1][-2]), row[0]))
+    totals = [sum(row[1][i] for row in rows) for i in range(len(header) - 1)]
+    number = '{:>+11}' if base is not None else '{:>11}'
+    for name, values in rows + [('total', totals)]:
+        print('{:<32}'.format(name) + ''.join(number.format(v) for v in values))
+
+
+def print_heap(path):
+    footprints = []
+    with open(path, errors='replace') as file:
+        for line in file:
+            start = line.find('{"footprint"')
+            if start >= 0:
+                try:
+                    footprints.append(json.loads(line[start:]))
+                except ValueError:
+                    pass
+    if not footprints:
+        print('no {{"footprint":...}} lines in {}'.format(path))
+        return
+    print()
+    print('heap taken by each init stage:')
+    for stage, size in footprints[0].get('stages', {}).items():
+        print('  {:<30}{:>11}'.format(stage, size))
+    print('heap at steady state:')
+    for footprint in footprints:
+        print('  {:<30}{:>11} free, {} min free, {} largest free block'.format(
+            footprint['footprint'], footprint['free_heap'], footprint['min_free_heap'],
+            footprint['largest_free_block']))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('map', help='the linker map of the app, build/<project>.map')
+    parser.add_argument('--json', help='also write the sizes to this file, for --diff')
+    parser.add_argument('--diff', help='print the change from the sizes of another build (written by --json)')
+    parser.add_argument('--heap', help='a monitor log with the {"footprint":...} lines of the example')
+    args = parser.parse_args()
+
+    if not os.path.exists(args.map):
+        sys.exit('error: no linker map at {}, build the app first'.format(args.map))
+    components = parse_map(args.map)
+    if not components:
+        sys.exit('error: {} has no memory map'.format(args.map))
+    base = None
+    if args.diff:
+        with open(args.diff) as file:
+            base = json.load(file)['components']
+    print_table(components, base)
+    if args.json:
+        with open(args.json, 'w') as file:
+            json.dump({'map': os.path.abspath(args.map), 'components': components}, file, indent=1, sort_keys=True)
+    if args.heap:
+        print_heap(args.heap)
+
+
+if __name__ == '__main__':
+    main()
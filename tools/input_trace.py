@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Build, or print, input traces for the load generator.
+
+A trace is a schedule of input reports which the load generator
+(components/load_generator) replays, on target from the trace partition
+(CONFIG_LOAD_GENERATOR_TRACE_PARTITION) or in the host simulator:
+
+    python tools/input_trace.py csv recording.csv -o trace.bin
+    python tools/input_trace.py pattern --report 1 --size 16 --rate 1000 --count 5000 --burst 4 -o trace.bin
+    python tools/input_trace.py dump trace.bin
+    parttool.py write_partition --partition-name trace --input trace.bin
+
+A CSV has one report per line: the time in microseconds from the start, the
+report ID and the report in hex, e.g. "1000,1,0000008000800080". Lines
+starting with # are skipped.
+
+The format (all integers little endian, see load_generator.hpp) is a header
+(magic "HIDT", version, header size, number of records, duration in us,
+total size) and a record per report: its time in us, report ID and length,
+then the report.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+MAGIC = 0x54444948
+VERSION = 1
+HEADER = struct.Struct('<IHHIII')
+RECORD = struct.Struct('<IBB')
+MAX_REPORT_LEN = 255
+
+
+def build(records, duration_us=None):
+    """The trace of (time_us, report_id, report) records, in time order"""
+    body = bytearray()
+    last_time_us = 0
+    for time_us, report_id, report in records:
+        if len(report) > MAX_REPORT_LEN:
+            raise ValueError('a report is at most {} bytes'.format(MAX_REPORT_LEN))
+        if time_us < last_time_us:
+            raise ValueError('the report at {} us is before the one at {} us'.format(time_us, last_time_us))
+        body += RECORD.pack(time_us, report_id, len(report)) + report
+        last_time_us = time_us
+    duration_us = max(duration_us or 0, last_time_us)
+    return HEADER.pack(MAGIC, VERSION, HEADER.size, len(records), duration_us, HEADER.size + len(body)) + body
+
+
+def parse(data):
+    """The duration and the (time_us, report_id, report) records of a trace"""
+    if len(data) < HEADER.size:
+        raise ValueError('too small for a trace')
+    magic, version, header_size, num_records, duration_us, total_size = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION or header_size != HEADER.size or total_size > len(data):
+        raise ValueError('not a trace (or a version this tool does not know)')
+    records = []
+    offset = header_size
+    for _ in range(num_records):
+        time_us, report_id, length = RECORD.unpack_from(data, offset)
+        offset += RECORD.size
+        records.append((time_us, report_id, bytes(data[offset:offset + length])))
+        offset += length
+    if offset != total_size:
+        raise ValueError('the records do not add up to the total size')
+    return duration_us, records
+
+
+def from_csv(path):
+    records = []
+    with open(path, newline='') as file:
+        for row in csv.reader(file):
+            if not row or row[0].lstrip().startswith('#'):
+                continue
+            records.append((int(row[0], 0), int(row[1], 0), bytes.fromhex(row[2].strip())))
+    return records
+
+
+def from_pattern(args):
+    """As load_generator::Pattern: byte 0 counts up, bursts start on the rate's schedule"""
+    records = []
+    for i in range(args.count):
+        burst_start = i - i % args.burst
+        report = bytes([i & 0xff]) + bytes(args.size - 1)
+        records.append((burst_start * 1000000 // args.rate, args.report, report))
+    return records, args.count * 1000000 // args.rate
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest='command', required=True)
+    from_csv_parser = commands.add_parser('csv', help='build a trace from a CSV')
+    from_csv_parser.add_argument('csv')
+    from_csv_parser.add_argument('--duration-us', type=int, help='of the trace, by default its last report')
+    from_csv_parser.add_argument('-o', '--output', required=True)
+    pattern_parser = commands.add_parser('pattern', help='build a trace of a synthetic pattern')
+    pattern_parser.add_argument('--report', type=int, default=1, help='the report ID')
+    pattern_parser.add_argument('--size', type=int, default=16, help='the report size')
+    pattern_parser.add_argument('--rate', type=int, default=1000, help='reports per second')
+    pattern_parser.add_argument('--count', type=int, default=1000)
+    pattern_parser.add_argument('--burst', type=int, default=1, help='reports sent back to back')
+    pattern_parser.add_argument('-o', '--output', required=True)
+    dump_parser = commands.add_parser('dump', help='print a trace')
+    dump_parser.add_argument('trace')
+    args = parser.parse_args()
+
+    try:
+        if args.command == 'dump':
+            with open(args.trace, 'rb') as file:
+                duration_us, records = parse(file.read())
+            print('{} reports over {} us'.format(len(records), duration_us))
+            for time_us, report_id, report in records:
+                print('{:10d} {:3d} {}'.format(time_us, report_id, report.hex()))
+            return
+        if args.command == 'csv':
+            records, duration_us = from_csv(args.csv), args.duration_us
+        else:
+            if args.size < 1 or args.rate < 1 or args.burst < 1:
+                sys.exit('error: the size, rate and burst must be at least 1')
+            records, duration_us = from_pattern(args)
+        trace = build(records, duration_us)
+    except (OSError, ValueError, IndexError) as error:
+        sys.exit('error: {}'.format(error))
+    with open(args.output, 'wb') as file:
+        file.write(trace)
+    print('{} reports, {} bytes written to {}'.format(len(records), len(trace), args.output))
+
+
+if __name__ == '__main__':
+    main()